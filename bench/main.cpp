@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// 各デバイスのドライバーの処理を決まった回数実行し, I2C周波数ごとに処理速度, I2Cの通信量と使用率, CPUの使用率,
+// 1回の処理時間の分布を測定する. 結果はUSBシリアルへCSVで出力する. #で始まる行はコメント.
+// I2Cの通信量と時間, 待機時間はcommon/instr.hの計測から求める(CMakeLists.txtでHAL_INSTR=1).
+//
+// USBシリアルを接続すると測定を開始し, 終了後に何か1文字送ると再度測定する.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bme280.h"
+#include "envcalc.h"
+#include "hardware/clocks.h"
+#include "hardware/i2c.h"
+#include "infrared.h"
+#include "lcdaqm.h"
+#include "pico/stdio_usb.h"
+#include "pico/stdlib.h"
+#include "scd41.h"
+#include "tsl2572.h"
+
+// -----------------
+// Configurations
+
+#define BENCH_BME280_COUNT 100     // BME280::forced()の回数
+#define BENCH_TSL2572_COUNT 20     // tsl2572_single_auto_measure()の回数
+#define BENCH_SCD41_COUNT 5        // SCD41の定期測定の読み出し回数. 1回5秒
+#define BENCH_LCD_COUNT 100        // LCDの全画面書き換えの回数
+#define BENCH_IR_COUNT 20          // 赤外線の送受信の回数. 送信LEDの光が受信器に届くようにしておく
+#define BENCH_USE_LCD 1            // 1でLCDを測定する(RPi TPH Monitor). LCDは接続を確認できないので指定する
+#define BENCH_ENVCALC_COUNT 10000  // 温度, 湿度, 気圧から求める指標(common/envcalc.h)の計算の回数
+
+// 測定するI2C周波数[Hz]. 各デバイスの対応する周波数まで測定する
+static const uint32_t bench_speeds[] = {100000, 400000, 1000000};
+
+// -----------------
+
+#define BENCH_MAX_COUNT 100  // 1回の処理時間を記録する最大数. 各回数はこれ以下にする
+#define BENCH_IR_LENGTH 67   // 送受信する赤外線データの要素数. NECフォーマットの1フレーム
+
+// 測定する処理
+typedef struct {
+  const char* name;
+  uint32_t max_baud;  // デバイスが対応するI2C周波数の上限[Hz]. 0ならI2Cを使わないので周波数を変えない
+  uint count;         // 処理の回数
+
+  // 測定前の準備. デバイスが無ければfalse
+  bool (*setup)();
+
+  // 1回の処理. 失敗ならfalse. 処理時間を呼び出し全体と別にする場合はlatency_us[us]に入れる
+  bool (*run)(uint32_t* latency_us);
+
+  // 測定後の処理. 不要ならNULL
+  void (*teardown)();
+} bench_workload_t;
+
+static BME280 bme280(0x76);
+static bool ir_ready = false;
+static uint32_t ir_words[BENCH_IR_LENGTH + 1];  // 送信するワード列
+static uint ir_word_count = 0;
+static uint32_t ir_received[BENCH_IR_LENGTH * 2];
+static uint64_t pio_bytes = 0;  // PIOのFIFOとDMAで転送したバイト数. instrで計測しない分
+
+static bool bme280_setup() {
+  return bme280.check_id();
+}
+
+static bool bme280_run(uint32_t* latency_us) {
+  return bme280.forced();
+}
+
+static bool tsl2572_setup() {
+  return tsl2572_check_id();
+}
+
+static bool tsl2572_run(uint32_t* latency_us) {
+  return tsl2572_single_auto_measure();
+}
+
+static bool scd41_setup() {
+  if (!scd41_get_serial_number(NULL)) return false;
+  scd41_start_periodic_measurement();
+  return true;
+}
+
+// 定期測定のデータ準備を100msおきに確認し, 準備できたら読み出す. 処理時間は読み出しのみ
+static bool scd41_run(uint32_t* latency_us) {
+  absolute_time_t deadline = make_timeout_time_ms(10000);
+  while (!scd41_get_data_ready_status()) {
+    if (time_reached(deadline)) return false;
+    hal_sleep_ms(100);
+  }
+  uint32_t start = time_us_32();
+  bool ok = scd41_read_measurement(0);
+  *latency_us = time_us_32() - start;
+  return ok;
+}
+
+static void scd41_teardown() {
+  scd41_stop_periodic_measurement(true);
+}
+
+static bool lcd_setup() {
+  lcdaqm_init();
+  lcdaqm_fb_clear();
+  return true;
+}
+
+// 全ての文字を書き換えて送信する
+static bool lcd_run(uint32_t* latency_us) {
+  static uint32_t frame = 0;
+  lcdaqm_fb_print_fixed(0, 0, frame++, 0, 0, LCDAQM_COLS);
+  lcdaqm_fb_invalidate();
+  return lcdaqm_fb_flush() > 0;
+}
+
+static bool ir_setup() {
+  return ir_ready;
+}
+
+// 1フレームをDMAで送信し, 受信完了までを1回の処理とする
+static bool ir_run(uint32_t* latency_us) {
+  infrared_receive_start(ir_received, sizeof(ir_received) / sizeof(ir_received[0]), 1000);
+  infrared_playback_entry_t entry = {ir_words, ir_word_count, 1};
+  if (!infrared_playback_start(&entry, 1)) {
+    infrared_receive_cancel();
+    return false;
+  }
+  int n;
+  while ((n = infrared_receive_poll()) == INFRARED_RECEIVE_PENDING) {
+    hal_sleep_ms(1);  // RX FIFOがあふれない間隔で読み出す
+  }
+  while (infrared_playback_busy()) hal_sleep_ms(1);
+  pio_bytes += (ir_word_count + (n > 0 ? n : 0)) * 4;
+  return n == BENCH_IR_LENGTH;
+}
+
+static const bench_workload_t workloads[] = {
+    {"bme280_forced", 1000000, BENCH_BME280_COUNT, bme280_setup, bme280_run, NULL},
+    {"tsl2572_auto_measure", 400000, BENCH_TSL2572_COUNT, tsl2572_setup, tsl2572_run, NULL},
+    {"scd41_read_measurement", 400000, BENCH_SCD41_COUNT, scd41_setup, scd41_run, scd41_teardown},
+#if BENCH_USE_LCD
+    {"lcdaqm_full_refresh", 400000, BENCH_LCD_COUNT, lcd_setup, lcd_run, NULL},
+#endif
+    {"ir_loopback", 0, BENCH_IR_COUNT, ir_setup, ir_run, NULL},
+};
+
+static int compare_u32(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Returns: 昇順に並べたvaluesのpパーセンタイル(最近順位法)
+static uint32_t percentile(const uint32_t* values, uint n, uint p) {
+  uint rank = (p * n + 99) / 100;
+  return values[rank ? rank - 1 : 0];
+}
+
+// Returns: value / divの小数点以下1桁の固定小数の文字列
+static const char* fixed1(char* buf, uint size, uint64_t value, uint64_t div) {
+  uint64_t x10 = div ? (value * 10 + div / 2) / div : 0;
+  snprintf(buf, size, "%lu.%lu", (unsigned long)(x10 / 10), (unsigned long)(x10 % 10));
+  return buf;
+}
+
+// 処理をcount回実行し, 結果を1行出力する
+static void bench_run(const bench_workload_t* w, uint32_t baud) {
+  if (w->max_baud) i2c_set_baudrate(i2c_default, baud);
+  if (!w->setup()) {
+    printf("# %s: device not found\n", w->name);
+    return;
+  }
+
+  static uint32_t latency[BENCH_MAX_COUNT];
+  uint count = MIN(w->count, BENCH_MAX_COUNT);
+  uint errors = 0;
+  instr_reset();
+  pio_bytes = 0;
+  uint64_t start = time_us_64();
+  for (uint i = 0; i < count; i++) {
+    uint32_t t0 = time_us_32();
+    uint32_t lat = UINT32_MAX;
+    if (!w->run(&lat)) errors++;
+    latency[i] = lat != UINT32_MAX ? lat : time_us_32() - t0;
+  }
+  uint64_t elapsed_us = time_us_64() - start;
+  if (w->teardown) w->teardown();
+
+  // I2Cの通信量と時間, 待機時間の合計
+  uint64_t bytes = pio_bytes;
+  uint64_t bus = 0;
+  uint64_t sleep = 0;
+  for (uint d = 0; d < INSTR_DRIVERS; d++) {
+    instr_stats_t s;
+    for (uint op = INSTR_I2C_WRITE; op <= INSTR_I2C_READ; op++) {
+      instr_get(d, op, &s);
+      bytes += s.bytes;
+      bus += s.total;
+    }
+    instr_get(d, INSTR_SLEEP, &s);
+    sleep += s.total;
+  }
+  uint64_t bus_us = instr_us(bus);
+  uint64_t busy_us = elapsed_us - MIN(instr_us(sleep), elapsed_us);
+
+  qsort(latency, count, sizeof(latency[0]), compare_u32);
+  char sps[16], bus_pct[16], busy_pct[16];
+  printf("%s,%lu,%u,%u,%s,%lu,%s,%s,%lu,%lu,%lu\n", w->name, (unsigned long)(w->max_baud ? baud : 0), count, errors,
+         fixed1(sps, sizeof(sps), count * 1000000ull, elapsed_us),
+         (unsigned long)(bytes * 1000000 / MAX(elapsed_us, 1)), fixed1(bus_pct, sizeof(bus_pct), bus_us * 100, elapsed_us),
+         fixed1(busy_pct, sizeof(busy_pct), busy_us * 100, elapsed_us), (unsigned long)percentile(latency, count, 50),
+         (unsigned long)percentile(latency, count, 99), (unsigned long)latency[count - 1]);
+}
+
+// 温度, 湿度, 気圧から求める指標の計算を, 入力を変えながらBENCH_ENVCALC_COUNT回ずつ実行し, 1回の処理時間を出力する
+static void bench_envcalc() {
+  static const char* const names[] = {"dew_point", "absolute_humidity", "heat_index", "sea_level_pressure",
+                                      "altitude"};
+  printf("metric,calls,ns_per_call,cycles_per_call\n");
+  for (uint m = 0; m < sizeof(names) / sizeof(names[0]); m++) {
+    volatile int32_t sink = 0;
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < BENCH_ENVCALC_COUNT; i++) {
+      int32_t t = 2000 + (int32_t)(i % 1500);  // 20～35℃
+      uint32_t h = 3000 + i % 6000;            // 30～90%
+      uint32_t p = 95000 + i % 8000;           // 950～1030hPa
+      switch (m) {
+        case 0:
+          sink = envcalc_dew_point_x100(t, h);
+          break;
+        case 1:
+          sink = (int32_t)envcalc_absolute_humidity_x100(t, h);
+          break;
+        case 2:
+          sink = envcalc_heat_index_x100(t, h);
+          break;
+        case 3:
+          sink = (int32_t)envcalc_sea_level_pressure_x100(p, t, 100);
+          break;
+        default:
+          sink = envcalc_altitude_m(p, ENVCALC_SEA_LEVEL_PRESSURE_X100);
+          break;
+      }
+    }
+    uint64_t elapsed_us = time_us_64() - start;
+    (void)sink;
+    printf("%s,%u,%lu,%lu\n", names[m], BENCH_ENVCALC_COUNT, (unsigned long)(elapsed_us * 1000 / BENCH_ENVCALC_COUNT),
+           (unsigned long)(elapsed_us * (clock_get_hz(clk_sys) / 1000000) / BENCH_ENVCALC_COUNT));
+  }
+}
+
+// 全ての処理を, 対応する全てのI2C周波数で測定する
+static void bench_all() {
+  printf("# clk_sys %lu [Hz]\n", (unsigned long)clock_get_hz(clk_sys));
+  printf("workload,baud,samples,errors,samples_per_s,bytes_per_s,bus_pct,busy_pct,p50_us,p99_us,max_us\n");
+  for (const bench_workload_t& w : workloads) {
+    if (!w.max_baud) {
+      bench_run(&w, 0);
+      continue;
+    }
+    for (uint32_t baud : bench_speeds) {
+      if (baud <= w.max_baud) bench_run(&w, baud);
+    }
+  }
+  i2c_set_baudrate(i2c_default, 100000);
+  bench_envcalc();
+  printf("# done\n");
+}
+
+// NECフォーマットの1フレーム(カスタムコード0x00FF, データ0x45)を送信用のワード列にする
+static void ir_prepare() {
+  uint32_t data[BENCH_IR_LENGTH];
+  uint n = 0;
+  data[n++] = 9000;
+  data[n++] = 4500;
+  uint32_t code = 0x00FF45BA;
+  for (int i = 0; i < 32; i++) {
+    data[n++] = 560;
+    data[n++] = (code >> i) & 1 ? 1690 : 560;
+  }
+  data[n++] = 560;
+  ir_word_count = infrared_encode_send_words(data, n, 0, ir_words);
+}
+
+int main() {
+  stdio_init_all();
+  instr_init();
+  scd41_init_i2c();  // 全てのセンサーで同じI2Cインスタンスとピンを使用
+  ir_ready = infrared_send_init() && infrared_receive_init();
+  if (ir_ready) ir_prepare();
+
+  while (!stdio_usb_connected()) sleep_ms(100);
+  sleep_ms(500);
+  while (1) {
+    bench_all();
+    getchar();  // 何か1文字受信したら再度測定する
+  }
+}
@@ -4,10 +4,13 @@
  * SPDX-License-Identifier: MIT
  */
 
+#define HAL_DRIVER INSTR_BME280  // 計測(common/instr.h)でのドライバーの番号
 #include "bme280.h"
 
 #include <stdio.h>
 
+#include "numfmt.h"
+
 // コンストラクタ
 //
 // Args:
@@ -22,15 +25,7 @@ BME280::BME280(uint8_t i2c_addr, i2c_inst_t* i2c, uint i2c_sda_pin, uint i2c_scl
 // I2Cを初期化
 // すでに初期化している場合は不要
 void BME280::init_i2c(uint baudrate) {
-  i2c_init(i2c, baudrate);
-
-  gpio_init(i2c_sda_pin);
-  gpio_pull_up(i2c_sda_pin);
-  gpio_set_function(i2c_sda_pin, GPIO_FUNC_I2C);
-
-  gpio_init(i2c_scl_pin);
-  gpio_pull_up(i2c_scl_pin);
-  gpio_set_function(i2c_scl_pin, GPIO_FUNC_I2C);
+  hal_i2c_init_pins(i2c, baudrate, i2c_sda_pin, i2c_scl_pin);
 }
 
 // I2Cでセンサーのレジスターのデータを連続して読み出す
@@ -42,9 +37,9 @@ void BME280::init_i2c(uint baudrate) {
 //
 // Returns: 成功でtrue, 失敗でfalse
 bool BME280::read_registers(uint8_t reg_addr, uint8_t* data, uint32_t length) {
-  if (1 != i2c_write_blocking(i2c, i2c_addr, &reg_addr, 1, true))
+  if (1 != hal_i2c_write_blocking(i2c, i2c_addr, &reg_addr, 1, true))
     return false;
-  if (length != i2c_read_blocking(i2c, i2c_addr, data, length, false))
+  if (length != hal_i2c_read_blocking(i2c, i2c_addr, data, length, false))
     return false;
   return true;
 }
@@ -70,7 +65,7 @@ uint8_t BME280::read_register(uint8_t reg_addr) {
 // Returns: 成功でtrue, 失敗でfalse
 bool BME280::write_register(uint8_t reg_addr, uint8_t data) {
   uint8_t buf[] = {reg_addr, data};
-  if (sizeof(buf) != i2c_write_blocking(i2c, i2c_addr, buf, sizeof(buf), false))
+  if (sizeof(buf) != hal_i2c_write_blocking(i2c, i2c_addr, buf, sizeof(buf), false))
     return false;
   return true;
 }
@@ -180,27 +175,53 @@ void BME280::read_measured_values() {
   while (0 != (read_status() & 0x8)) bme280_delay(1);  // 測定中の場合は待機
   read_calibration_data();
   read_adc();
+  calculate_measured_values();
+}
 
-  temperature = compensate_temperature();
-  pressure = compensate_pressure();
-  humidity = compensate_humidity();
+// calibration_dataとADCレジスターの値から測定値を計算し, temperature, pressure, humidityと整数の測定値に入れる.
+// I2Cの通信は行わない. キャリブレーションデータは変化しないので, 定期測定では1度読み出せばよい.
+void BME280::calculate_measured_values() {
+  temperature_x100 = compensate_temperature_int();
+  uint32_t p = compensate_pressure_int();
+  uint32_t h = compensate_humidity_int();
+  pressure_x100 = (p + 128) >> 8;
+  humidity_x100 = (h * 100 + 512) >> 10;
+
+  temperature = (float)temperature_x100 / 100;
+  pressure = ((float)p) / 25600;
+  humidity = ((float)h) / 1024;
 }
 
-// calibration_dataとadc_temperatureの値から気圧を計算し, temperatureに入れる
+// calibration_dataとadc_temperatureの値から温度[℃]を計算する
 float BME280::compensate_temperature() {
+  return ((float)compensate_temperature_int()) / 100;
+}
+
+// calibration_dataとadc_temperatureの値から温度を整数で計算し, t_fineを更新する
+//
+// Returns: 温度[0.01℃]
+int32_t BME280::compensate_temperature_int() {
   int32_t var1, var2, T;
-  var1 = ((((adc_temperature >> 3) - ((int32_t)calibration_data.dig_T1 << 1))) * ((int32_t)calibration_data.dig_T2)) >> 11;
-  var2 = (((((adc_temperature >> 4) - ((int32_t)calibration_data.dig_T1)) * ((adc_temperature >> 4) - ((int32_t)calibration_data.dig_T1))) >> 12) *
+  var1 = (((((int32_t)adc_temperature >> 3) - ((int32_t)calibration_data.dig_T1 << 1))) * ((int32_t)calibration_data.dig_T2)) >> 11;
+  var2 = ((((((int32_t)adc_temperature >> 4) - ((int32_t)calibration_data.dig_T1)) * (((int32_t)adc_temperature >> 4) - ((int32_t)calibration_data.dig_T1))) >> 12) *
           ((int32_t)calibration_data.dig_T3)) >>
          14;
   t_fine = var1 + var2;
   T = (t_fine * 5 + 128) >> 8;
-  return ((float)T / 100);
+  return T;
 }
 
-// calibration_dataとadc_pressureの値から気圧を計算し, pressureに入れる
+// calibration_dataとadc_pressureの値から気圧[hPa]を計算する
 // compensate_temperatureで計算したt_fineの値を利用するので前もって実行が必要
 float BME280::compensate_pressure() {
+  return ((float)compensate_pressure_int()) / 25600;
+}
+
+// calibration_dataとadc_pressureの値から気圧を整数で計算する
+// compensate_temperatureで計算したt_fineの値を利用するので前もって実行が必要
+//
+// Returns: 気圧[Pa]の24bit整数部, 8bit小数部の固定小数. 256で割るとPa
+uint32_t BME280::compensate_pressure_int() {
   int64_t var1, var2, p;
   var1 = ((int64_t)t_fine) - 128000;
   var2 = var1 * var1 * (int64_t)calibration_data.dig_P6;
@@ -216,15 +237,23 @@ float BME280::compensate_pressure() {
   var1 = (((int64_t)calibration_data.dig_P9) * (p >> 13) * (p >> 13)) >> 25;
   var2 = (((int64_t)calibration_data.dig_P8) * p) >> 19;
   p = ((p + var1 + var2) >> 8) + (((int64_t)calibration_data.dig_P7) << 4);
-  return ((float)(uint32_t)p) / 25600;
+  return (uint32_t)p;
 }
 
-// calibration_dataとadc_humidityの値から気圧を計算し, humidityに入れる
+// calibration_dataとadc_humidityの値から湿度[%]を計算する
 // compensate_temperatureで計算したt_fineの値を利用するので前もって実行が必要
 float BME280::compensate_humidity() {
+  return ((float)compensate_humidity_int()) / 1024;
+}
+
+// calibration_dataとadc_humidityの値から湿度を整数で計算する
+// compensate_temperatureで計算したt_fineの値を利用するので前もって実行が必要
+//
+// Returns: 湿度[%]の22bit整数部, 10bit小数部の固定小数. 1024で割ると%
+uint32_t BME280::compensate_humidity_int() {
   int32_t v_x1_u32r;
   v_x1_u32r = (t_fine - ((int32_t)76800));
-  v_x1_u32r = (((((adc_humidity << 14) - (((int32_t)calibration_data.dig_H4) << 20) -
+  v_x1_u32r = ((((((int32_t)adc_humidity << 14) - (((int32_t)calibration_data.dig_H4) << 20) -
                   (((int32_t)calibration_data.dig_H5) * v_x1_u32r)) +
                  ((int32_t)16384)) >>
                 15) *
@@ -241,7 +270,7 @@ float BME280::compensate_humidity() {
                             4));
   v_x1_u32r = (v_x1_u32r < 0 ? 0 : v_x1_u32r);
   v_x1_u32r = (v_x1_u32r > 419430400 ? 419430400 : v_x1_u32r);
-  return ((float)(uint32_t)(v_x1_u32r >> 12)) / 1024;
+  return (uint32_t)(v_x1_u32r >> 12);
 }
 
 void BME280::print_calibration_data() {
@@ -267,15 +296,32 @@ void BME280::print_calibration_data() {
 }
 
 void BME280::print_adc() {
-  printf("ADC data\n");
-  printf(" adc_temperature : 0x%X\n", adc_temperature);
-  printf(" adc_pressure : 0x%X\n", adc_pressure);
-  printf(" adc_humitiy : 0x%X\n", adc_humidity);
+  char buf[32];
+  puts("ADC data");
+  unsigned n = numfmt_str(buf, sizeof(buf), " adc_temperature : 0x");
+  numfmt_hex(buf + n, sizeof(buf) - n, adc_temperature, 0);
+  puts(buf);
+  n = numfmt_str(buf, sizeof(buf), " adc_pressure : 0x");
+  numfmt_hex(buf + n, sizeof(buf) - n, adc_pressure, 0);
+  puts(buf);
+  n = numfmt_str(buf, sizeof(buf), " adc_humitiy : 0x");
+  numfmt_hex(buf + n, sizeof(buf) - n, adc_humidity, 0);
+  puts(buf);
 }
 
 void BME280::print_measurement_data() {
-  printf("Measurement Data\n");
-  printf(" Temp : %.1fC\n", temperature);
-  printf(" Pressure : %.1fhPa\n", pressure);
-  printf(" Humidity : %.1f%%\n", humidity);
+  char buf[32];
+  puts("Measurement Data");
+  unsigned n = numfmt_str(buf, sizeof(buf), " Temp : ");
+  n += numfmt_fixed(buf + n, sizeof(buf) - n, temperature_x100, 2, 1, 0, ' ');
+  numfmt_str(buf + n, sizeof(buf) - n, "C");
+  puts(buf);
+  n = numfmt_str(buf, sizeof(buf), " Pressure : ");
+  n += numfmt_fixed(buf + n, sizeof(buf) - n, pressure_x100, 2, 1, 0, ' ');
+  numfmt_str(buf + n, sizeof(buf) - n, "hPa");
+  puts(buf);
+  n = numfmt_str(buf, sizeof(buf), " Humidity : ");
+  n += numfmt_fixed(buf + n, sizeof(buf) - n, humidity_x100, 2, 1, 0, ' ');
+  numfmt_str(buf + n, sizeof(buf) - n, "%");
+  puts(buf);
 }
@@ -7,13 +7,12 @@
 #ifndef BME280_H
 #define BME280_H
 
-#include "hardware/i2c.h"
-#include "pico/stdlib.h"
+#include "hal.h"
 
 // -----------------
 // Configurations
 
-#define bme280_delay(x) sleep_ms(x)  // xミリ秒待機
+#define bme280_delay(x) hal_sleep_ms(x)  // xミリ秒待機
 
 // -----------------
 
@@ -99,6 +98,11 @@ class BME280 {
   float pressure = 0;     // 測定気圧[hPa]
   float humidity = 0;     // 測定湿度[%]
 
+  // 整数の測定値. 浮動小数を使わずに表示, 計算する場合に使用
+  int32_t temperature_x100 = 0;  // 測定温度[0.01℃]
+  uint32_t pressure_x100 = 0;    // 測定気圧[0.01hPa]. Paと同じ
+  uint32_t humidity_x100 = 0;    // 測定湿度[0.01%]
+
   BME280(uint8_t i2c_addr = 0x76, i2c_inst_t* i2c = i2c_default,
          uint i2c_sda_pin = 4, uint i2c_scl_pin = 5);
   void init_i2c(uint baudrate = 100000);
@@ -115,9 +119,13 @@ class BME280 {
   void write_reset();
   bool forced();
   void read_measured_values();
+  void calculate_measured_values();
   float compensate_temperature();
   float compensate_pressure();
   float compensate_humidity();
+  int32_t compensate_temperature_int();
+  uint32_t compensate_pressure_int();
+  uint32_t compensate_humidity_int();
 
   void print_calibration_data();
   void print_adc();
@@ -8,27 +8,61 @@
 
 #include "bme280.h"
 #include "pico/stdlib.h"
+#include "telemetry.h"
+
+// 1なら測定結果をバイナリのレコード(common/telemetry.h)で送信する. PC側はhost/telemetry_dumpで表示する.
+// 0ならテキストで表示する
+#define OUTPUT_TELEMETRY 1
+
+// 1ならOUTPUT_TELEMETRYで, 計算前のADCの値とキャリブレーションデータも送信する.
+// PC側はhost/sensor_replayで, 記録した値からドライバーと同じ計算で測定値を求め直せる
+#define OUTPUT_RAW 0
 
 // センサー制御クラスのインスタンスを作成
 // 引数にI2Cデバイスアドレスを指定
 BME280 bme280(0x76);
 
+#if OUTPUT_TELEMETRY
+static telemetry_t telemetry;
+#endif
+
 int main() {
   stdio_init_all();
   bme280.init_i2c();  // 通信に使うI2Cインスタンスとピンを初期化
+#if OUTPUT_TELEMETRY
+  telemetry_init(&telemetry, telemetry_usb_write, NULL);  // printfを通さずUSBシリアルへ送信する
+#endif
 
   while (1) {
     bool ret = bme280.forced();  // 測定を1回行い, 成功したらtemperature, pressure, humidity変数に結果を入れる
+#if OUTPUT_TELEMETRY
+    if (ret) {
+      // 整数の測定値(temperature_x100など)をそのまま送信する
+      int32_t values[3] = {bme280.temperature_x100, (int32_t)bme280.pressure_x100, (int32_t)bme280.humidity_x100};
+      uint64_t now = time_us_64();
+      telemetry_send(&telemetry, TELEMETRY_BME280, 0, now, values, 3);
+#if OUTPUT_RAW
+      // キャリブレーションデータは途中から受信しても計算できるように毎回送る
+      telemetry_begin(&telemetry, TELEMETRY_BME280_CAL, 0, now);
+      for (int i = 0; i < BME280::CAL_LENGTH; i++) telemetry_put(&telemetry, bme280.calibration_data.byte[i]);
+      telemetry_end(&telemetry);
+      int32_t raw[3] = {(int32_t)bme280.adc_temperature, (int32_t)bme280.adc_pressure, (int32_t)bme280.adc_humidity};
+      telemetry_send(&telemetry, TELEMETRY_BME280_RAW, 0, now, raw, 3);
+#endif
+    } else {
+      int32_t values[2] = {TELEMETRY_EVENT_NOT_FOUND, TELEMETRY_BME280};
+      telemetry_send(&telemetry, TELEMETRY_EVENT, 0, time_us_64(), values, 2);
+    }
+#else
     printf("----------------\n");
     if (ret) {
-      // 測定成功
-      printf("Measurement Data\n");
-      printf(" Temp : %.1fC\n", bme280.temperature);     // 温度を表示
-      printf(" Pressure : %.1fhPa\n", bme280.pressure);  // 気圧を表示
-      printf(" Humidity : %.1f%%\n", bme280.humidity);   // 湿度を表示
+      // 測定成功. 温度, 気圧, 湿度を表示
+      // printfの浮動小数変換を使わないよう, 整数の測定値(temperature_x100など)を固定小数として表示する
+      bme280.print_measurement_data();
     } else {
       printf("BME280 not found\n");  // 測定失敗
     }
+#endif
     sleep_ms(3000);
   }
 }
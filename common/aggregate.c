@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "aggregate.h"
+
+static void aggregate_clear(aggregate_pane_t* p) {
+  p->count = 0;
+  p->min = INT32_MAX;
+  p->max = INT32_MIN;
+  p->sum = 0;
+  p->sum_sq = 0;
+}
+
+// 集計の初期化
+//
+// Args:
+//   a: 集計の状態
+//   panes: ペインの配列. pane_count個
+//   pane_count: 窓に含めるペインの数. 1で重ならない窓, 2以上でスライドする窓
+//   pane_us: ペインの長さ[us]. 集計結果を出力する周期
+//   ema_shift: EMAの係数を1/2^ema_shiftにする. 1サンプルごとに更新するので, 時定数は約2^ema_shift回の測定
+void aggregate_init(aggregate_t* a, aggregate_pane_t* panes, uint32_t pane_count, uint64_t pane_us, uint8_t ema_shift) {
+  a->panes = panes;
+  a->pane_count = pane_count;
+  a->pane_us = pane_us;
+  a->pane = 0;
+  a->head = 0;
+  a->started = false;
+  a->offset = 0;
+  a->ema_shift = ema_shift;
+  a->ema = 0;
+  for (uint32_t i = 0; i < pane_count; i++) aggregate_clear(&panes[i]);
+}
+
+// 直近pane_count個のペインを集計する
+//
+// Returns: サンプルがあればtrue
+static bool aggregate_result(const aggregate_t* a, aggregate_result_t* result) {
+  uint32_t count = 0;
+  int32_t min = INT32_MAX;
+  int32_t max = INT32_MIN;
+  int64_t sum = 0;
+  int64_t sum_sq = 0;
+  for (uint32_t i = 0; i < a->pane_count; i++) {
+    const aggregate_pane_t* p = &a->panes[i];
+    if (!p->count) continue;
+    count += p->count;
+    if (p->min < min) min = p->min;
+    if (p->max > max) max = p->max;
+    sum += p->sum;
+    sum_sq += p->sum_sq;
+  }
+  if (!count) return false;
+
+  // 平均を整数に丸めたmとすると, 差の2乗の合計はsum_sq - 2 * m * sum + count * m^2.
+  // mと真の平均の差は0.5以下なので, 分散の誤差は0.25以下
+  int64_t n = count;
+  int64_t m = (sum >= 0 ? sum + n / 2 : sum - n / 2) / n;
+  int64_t ss = sum_sq - 2 * m * sum + n * m * m;
+  uint64_t length = a->pane_us * a->pane_count;
+  uint64_t end = (a->pane + 1) * a->pane_us;
+  result->start_us = end > length ? end - length : 0;
+  result->length_us = length;
+  result->count = count;
+  result->min = min;
+  result->max = max;
+  result->mean = (int32_t)(a->offset + m);
+  result->variance = ss > 0 ? ((uint64_t)ss + count / 2) / count : 0;
+  result->ema = (int32_t)((a->ema + 0x8000) >> 16);
+  return true;
+}
+
+// 現在のペインを終え, ペインの番号paneまで進める. 間のペインは空にする
+static void aggregate_advance(aggregate_t* a, uint64_t pane) {
+  uint64_t n = pane - a->pane;
+  if (n > a->pane_count) n = a->pane_count;
+  for (uint64_t i = 0; i < n; i++) {
+    a->head = (a->head + 1) % a->pane_count;
+    aggregate_clear(&a->panes[a->head]);
+  }
+  a->pane = pane;
+}
+
+// サンプルを追加する. サンプルの時刻が次のペインに入った場合は, 先に終わった窓を集計してresultに入れる
+//
+// Args:
+//   a: 集計の状態
+//   time_us: サンプルの時刻[us]. 前のサンプル以上
+//   value: 値
+//   result: 終わった窓の集計結果
+//
+// Returns: 窓が終わり, resultに集計結果を入れた場合はtrue
+bool aggregate_add(aggregate_t* a, uint64_t time_us, int32_t value, aggregate_result_t* result) {
+  uint64_t pane = time_us / a->pane_us;
+  bool closed = false;
+  if (!a->started) {
+    a->started = true;
+    a->pane = pane;
+    a->offset = value;
+    a->ema = (int64_t)value * 65536;
+  } else if (pane > a->pane) {
+    closed = aggregate_result(a, result);
+    aggregate_advance(a, pane);
+  }
+
+  aggregate_pane_t* p = &a->panes[a->head];
+  int64_t d = (int64_t)value - a->offset;
+  p->count++;
+  if (value < p->min) p->min = value;
+  if (value > p->max) p->max = value;
+  p->sum += d;
+  p->sum_sq += d * d;
+  a->ema += ((int64_t)value * 65536 - a->ema) >> a->ema_shift;
+  return closed;
+}
+
+// 時刻が次のペインに入っていれば, 終わった窓を集計する. サンプルが途絶えても窓ごとに集計結果を出力する場合に呼ぶ
+//
+// Args:
+//   a: 集計の状態
+//   now_us: 現在の時刻[us]
+//   result: 終わった窓の集計結果
+//
+// Returns: 窓が終わり, resultに集計結果を入れた場合はtrue. 窓にサンプルが無ければfalse
+bool aggregate_poll(aggregate_t* a, uint64_t now_us, aggregate_result_t* result) {
+  uint64_t pane = now_us / a->pane_us;
+  if (!a->started || pane <= a->pane) return false;
+  bool closed = aggregate_result(a, result);
+  aggregate_advance(a, pane);
+  return closed;
+}
+
+// Returns: valueの平方根. 小数点以下切り捨て. 分散から標準偏差を求める
+uint32_t aggregate_sqrt(uint64_t value) {
+  uint64_t root = 0;
+  uint64_t bit = 1ull << 62;
+  while (bit > value) bit >>= 2;
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+// 測定値を一定時間の窓ごとに集計し, 最小, 最大, 平均, 分散, EMA(指数移動平均)を求める.
+// サンプルを1つずつ出力する代わりに窓ごとの集計を出力すれば, 出力の量が減っても最小と最大は残る.
+//
+// 窓は時刻をpane_usごとに区切った区間(ペイン)の組で, ペインが終わるたびに直近pane_count個のペインを集計する.
+//   pane_count = 1: 重ならない窓(tumbling). pane_usごとに, その間のサンプルを集計する
+//   pane_count > 1: スライドする窓(sliding). pane_usごとに, 直近pane_us * pane_countの間のサンプルを集計する
+// サンプルの追加はペインの累積値を更新するだけで, 窓の長さによらず一定の時間で済む. 集計はペインの数に比例する.
+//
+// 値は0.01℃単位などの整数のまま扱い, 浮動小数は使わない. 合計と2乗の合計は最初のサンプルとの差で累積するので,
+// 値の大きな気圧でも64bitの累積があふれず, 分散を丸め誤差なく求められる.
+// 倍精度で求めた集計との誤差はhost/aggregate_checkで確認する.
+//
+//   static aggregate_pane_t panes[1];
+//   static aggregate_t temperature;
+//   aggregate_init(&temperature, panes, 1, 60000000, 4);  // 60秒ごと, EMAの係数1/16
+//
+//   aggregate_result_t r;
+//   if (aggregate_add(&temperature, time_us_64(), temperature_x100, &r)) print(&r);  // 窓が終わった
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ペインの累積値
+typedef struct {
+  uint32_t count;
+  int32_t min;
+  int32_t max;
+  int64_t sum;     // 基準値との差の合計
+  int64_t sum_sq;  // 基準値との差の2乗の合計
+} aggregate_pane_t;
+
+// 窓の集計結果. 値の単位は入力と同じ
+typedef struct {
+  uint64_t start_us;   // 窓の開始時刻
+  uint64_t length_us;  // 窓の長さ
+  uint32_t count;      // サンプル数
+  int32_t min;
+  int32_t max;
+  int32_t mean;        // 平均. 四捨五入
+  uint64_t variance;   // 分散(母分散). 単位は入力の単位の2乗
+  int32_t ema;         // 窓の最後のサンプルまでのEMA
+} aggregate_result_t;
+
+typedef struct {
+  aggregate_pane_t* panes;  // 直近のペイン. 環状に使う
+  uint32_t pane_count;
+  uint64_t pane_us;
+  uint64_t pane;            // 現在のペインの番号. 時刻 / pane_us
+  uint32_t head;            // 現在のペインのpanesでの位置
+  bool started;             // 1つ以上のサンプルを追加した
+  int32_t offset;           // 合計の基準値. 最初のサンプル
+  uint8_t ema_shift;        // EMAの係数 1 / 2^ema_shift
+  int64_t ema;              // EMA. 下位16bitが小数部
+} aggregate_t;
+
+void aggregate_init(aggregate_t* a, aggregate_pane_t* panes, uint32_t pane_count, uint64_t pane_us, uint8_t ema_shift);
+bool aggregate_add(aggregate_t* a, uint64_t time_us, int32_t value, aggregate_result_t* result);
+bool aggregate_poll(aggregate_t* a, uint64_t now_us, aggregate_result_t* result);
+uint32_t aggregate_sqrt(uint64_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "button.h"
+
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "ring.h"
+
+#if BUTTON_USE_PIO
+#include "pioinput.h"
+#endif
+
+#define BUTTON_EDGES (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE)
+
+// 登録したスイッチ1つ分の状態
+typedef struct {
+  uint8_t pin;
+  bool active_low;        // 押すとLowになるならtrue
+  volatile bool pressed;  // チャタリング除去後の状態
+  uint32_t edge_us;       // 状態確定待ちの最初のエッジの時刻
+  alarm_id_t long_alarm;  // 長押し判定用のアラーム. 0でなし
+} button_t;
+
+static button_t buttons[BUTTON_MAX];
+static uint button_count = 0;
+static uint32_t button_irq_mask = 0;  // 登録したピンのビットマスク
+
+static button_event_t button_queue_buf[BUTTON_QUEUE_LENGTH];
+static ring_t button_queue = RING_INIT(button_queue_buf);  // アラームのコールバックが書き込み, メインループが読み出す
+
+// ピンを読み出し, 押されているかを返す
+static inline bool button_read(const button_t* b) {
+  return gpio_get(b->pin) != b->active_low;
+}
+
+static void button_push(const button_t* b, button_event_type_t type, uint32_t time_us) {
+  button_event_t event = {time_us, b->pin, (uint8_t)type};
+  ring_push(&button_queue, &event);
+}
+
+static int64_t button_long_press_callback(alarm_id_t id, void* user_data) {
+  button_t* b = (button_t*)user_data;
+  b->long_alarm = 0;
+  if (b->pressed) button_push(b, BUTTON_LONG_PRESS, time_us_32());
+  return 0;
+}
+
+// 確定した状態を反映し, 変化していればイベントを追加する
+static void button_set_state(button_t* b, bool pressed, uint32_t edge_us) {
+  if (pressed == b->pressed) return;
+  b->pressed = pressed;
+  if (pressed) {
+    button_push(b, BUTTON_PRESS, edge_us);
+    int32_t remain = BUTTON_LONG_PRESS_US - (int32_t)(time_us_32() - edge_us);
+    b->long_alarm = add_alarm_in_us(remain > 0 ? remain : 0, button_long_press_callback, b, true);
+    if (b->long_alarm < 0) b->long_alarm = 0;  // アラームの空きがない場合は長押しを検出しない
+  } else {
+    button_push(b, BUTTON_RELEASE, edge_us);
+    if (b->long_alarm) cancel_alarm(b->long_alarm);
+    b->long_alarm = 0;
+  }
+}
+
+#if BUTTON_USE_PIO
+// pioinputで変化を確定した時に呼ばれる
+static void button_pioinput_callback(uint pin, bool level, uint64_t time_us) {
+  for (uint i = 0; i < button_count; i++) {
+    button_t* b = &buttons[i];
+    if (b->pin == pin) button_set_state(b, level != b->active_low, (uint32_t)time_us);
+  }
+}
+#else
+// エッジ検出からBUTTON_DEBOUNCE_US後に呼ばれ, ピンの状態を確定する
+static int64_t button_debounce_callback(alarm_id_t id, void* user_data) {
+  button_t* b = (button_t*)user_data;
+  button_set_state(b, button_read(b), b->edge_us);
+
+  gpio_set_irq_enabled(b->pin, BUTTON_EDGES, true);  // 古いエッジを消去してから割り込みを再開
+  if (button_read(b) != b->pressed) {
+    // 割り込み停止中にもう一度変化していた. エッジを取りこぼしているので, 改めて確定を待つ.
+    gpio_set_irq_enabled(b->pin, BUTTON_EDGES, false);
+    b->edge_us = time_us_32();
+    return BUTTON_DEBOUNCE_US;  // 正の値はこのコールバックから戻った時刻からBUTTON_DEBOUNCE_US後に再実行
+  }
+  return 0;
+}
+
+static void button_gpio_irq_handler() {
+  for (uint i = 0; i < button_count; i++) {
+    button_t* b = &buttons[i];
+    if (!(gpio_get_irq_event_mask(b->pin) & BUTTON_EDGES)) continue;
+
+    // 状態が確定するまで, このピンのエッジ(チャタリング)を無視する
+    gpio_set_irq_enabled(b->pin, BUTTON_EDGES, false);
+    gpio_acknowledge_irq(b->pin, BUTTON_EDGES);
+    b->edge_us = time_us_32();
+    if (add_alarm_in_us(BUTTON_DEBOUNCE_US, button_debounce_callback, b, true) < 0) {
+      gpio_set_irq_enabled(b->pin, BUTTON_EDGES, true);  // アラームの空きがない. 次のエッジで再試行
+    }
+  }
+}
+#endif
+
+// スイッチを登録し, GPIOの初期化と割り込みを設定する
+//
+// Args:
+//   pin: スイッチが接続されているGPIO番号
+//   active_low: スイッチを押すとGNDと導通してLowになるならtrue. プルアップする.
+//               falseならプルダウンし, Highで押されたとみなす.
+//
+// Returns: 成功でtrue. 登録数がBUTTON_MAXを超える場合, BUTTON_USE_PIOでPIOに空きがない場合false.
+bool button_add(uint pin, bool active_low) {
+  if (button_count >= BUTTON_MAX || pin >= 32) return false;
+
+  gpio_init(pin);
+  if (active_low) {
+    gpio_pull_up(pin);
+  } else {
+    gpio_pull_down(pin);
+  }
+  sleep_ms(5);  // プルアップによるGPIOの電圧が安定するまで待機
+
+  button_t* b = &buttons[button_count];
+  b->pin = pin;
+  b->active_low = active_low;
+  b->pressed = button_read(b);
+  b->long_alarm = 0;
+
+#if BUTTON_USE_PIO
+  button_count++;
+  if (!pioinput_add(pin, button_pioinput_callback)) {
+    button_count--;
+    return false;
+  }
+  return true;
+#else
+  // 割り込みハンドラーを登録し直して, 対象のピンにpinを加える
+  if (button_irq_mask) gpio_remove_raw_irq_handler_masked(button_irq_mask, button_gpio_irq_handler);
+  button_irq_mask |= 1u << pin;
+  button_count++;
+  gpio_add_raw_irq_handler_masked(button_irq_mask, button_gpio_irq_handler);
+  gpio_set_irq_enabled(pin, BUTTON_EDGES, true);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+  return true;
+#endif
+}
+
+// チャタリング除去後のスイッチの状態
+//
+// Returns: 押されていればtrue. 登録していないピンはfalse.
+bool button_is_pressed(uint pin) {
+  for (uint i = 0; i < button_count; i++) {
+    if (buttons[i].pin == pin) return buttons[i].pressed;
+  }
+  return false;
+}
+
+// イベントキューからイベントを1つ取り出す. 待たずに処理を返す.
+//
+// Returns: イベントがあればtrue
+bool button_get_event(button_event_t* event) {
+  return ring_pop(&button_queue, event);
+}
+
+static int64_t button_wake_callback(alarm_id_t id, void* user_data) {
+  return 0;  // __wfi()から復帰させるだけ
+}
+
+// イベントを待って1つ取り出す. 待っている間は__wfi()でコアを停止する.
+//
+// Args:
+//   event: イベントの格納先
+//   timeout_ms: 待つ時間[ms]. 0なら期限なし.
+//
+// Returns: イベントがあればtrue, タイムアウトでfalse
+bool button_wait_event(button_event_t* event, uint32_t timeout_ms) {
+  absolute_time_t deadline = timeout_ms ? make_timeout_time_ms(timeout_ms) : at_the_end_of_time;
+  alarm_id_t wake = timeout_ms ? add_alarm_at(deadline, button_wake_callback, NULL, false) : 0;
+
+  bool ret = false;
+  while (1) {
+    if (ring_pop(&button_queue, event)) {
+      ret = true;
+      break;
+    }
+    if (time_reached(deadline)) break;
+
+    // 確認から__wfi()までの間に割り込みが来ると次の割り込みまで起きないので, 割り込みを止めて確認する.
+    // 割り込みを止めていても, 保留中の割り込みがあれば__wfi()は復帰する.
+    uint32_t status = save_and_disable_interrupts();
+    if (ring_count(&button_queue) == 0 && !time_reached(deadline)) __wfi();
+    restore_interrupts(status);
+  }
+
+  if (wake > 0) cancel_alarm(wake);
+  return ret;
+}
+
+// キューが満杯で捨てたイベントの数
+uint32_t button_dropped_events() {
+  return button_queue.drops;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef BUTTON_H
+#define BUTTON_H
+
+// 割り込みによるスイッチ入力とチャタリング除去.
+// GPIOのエッジ割り込みで変化を検出し, アラームでBUTTON_DEBOUNCE_US後にもう一度読み出して状態を確定する.
+// 確定までの間はそのピンのエッジ割り込みを止めるので, チャタリングで割り込みが連続することはない.
+// 押した, 離した, 長押しのイベントをキューに入れるので, メインループはbutton_wait_eventで
+// __wfi()しながら待てる. GPIOのポーリングでコアを占有しない.
+//
+// BUTTON_USE_PIOを1にすると, エッジ割り込みとアラームの代わりにpioinputでサンプリングとチャタリング除去を行う.
+// チャタリング除去の時間はpioinput.hのPIOINPUT_SAMPLE_US, PIOINPUT_STABLE_SAMPLESで決まる.
+//
+// 割り込みハンドラーはbutton_addを呼んだコアで, アラームはデフォルトのアラームプールで動作する.
+// 両者の割り込み優先度は同じなので互いに割り込まない. button_addはコア0から呼ぶこと.
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#define BUTTON_MAX 4                  // 登録できるスイッチの数
+#define BUTTON_DEBOUNCE_US 20000      // エッジ検出から状態を確定するまでの時間[us]. チャタリングより長くする
+#define BUTTON_LONG_PRESS_US 1000000  // 長押しとみなす時間[us]
+#define BUTTON_QUEUE_LENGTH 16        // イベントキューの長さ. 2のべき乗
+#ifndef BUTTON_USE_PIO
+#define BUTTON_USE_PIO 0  // 1でPIOによるチャタリング除去を使用
+#endif
+
+// -----------------
+
+typedef enum {
+  BUTTON_PRESS,       // 押した
+  BUTTON_RELEASE,     // 離した
+  BUTTON_LONG_PRESS,  // 押したままBUTTON_LONG_PRESS_US経過した. 離した時にはBUTTON_RELEASEも発生する
+} button_event_type_t;
+
+typedef struct {
+  uint32_t time_us;  // 発生時刻[us]. 押した, 離したは最初のエッジの時刻. time_us_32()と同じ基準
+  uint8_t pin;       // GPIO番号
+  uint8_t type;      // button_event_type_t
+} button_event_t;
+
+bool button_add(uint pin, bool active_low);
+bool button_is_pressed(uint pin);
+bool button_get_event(button_event_t* event);
+bool button_wait_event(button_event_t* event, uint32_t timeout_ms);
+uint32_t button_dropped_events();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "deadband.h"
+
+// 変化時の出力の初期化. 最初のdeadband_updateは必ず出力する
+//
+// Args:
+//   d: 状態
+//   threshold: 出力する差. 前回出力した値との差がこの値を超えたら出力する. 0なら値が変わるたびに出力
+//   permille: 出力する差の前回の値に対する割合[0.1%]. thresholdと大きい方を使う. 0で使わない
+//   max_silence_us: 最大の無出力時間[us]. 値が変わらなくても, 前回の出力からこの時間が過ぎたら出力する. 0で無制限
+void deadband_init(deadband_t* d, int32_t threshold, uint16_t permille, uint64_t max_silence_us) {
+  d->threshold = threshold;
+  d->permille = permille;
+  d->max_silence_us = max_silence_us;
+  d->published = false;
+  d->value = 0;
+  d->time_us = 0;
+  d->updates = 0;
+  d->publishes = 0;
+}
+
+// 新しい測定値を出力するか判定する. 出力する場合は前回出力した値をvalueにする
+//
+// Args:
+//   d: 状態
+//   time_us: 測定値の時刻[us]
+//   value: 測定値
+//
+// Returns: 出力する場合はtrue. 出力する値はd->value
+bool deadband_update(deadband_t* d, uint64_t time_us, int32_t value) {
+  d->updates++;
+  if (d->published) {
+    int64_t diff = (int64_t)value - d->value;
+    if (diff < 0) diff = -diff;
+    int64_t threshold = d->threshold;
+    if (d->permille) {
+      int64_t relative = ((d->value < 0 ? -(int64_t)d->value : d->value) * d->permille) / 1000;
+      if (relative > threshold) threshold = relative;
+    }
+    bool silent = !d->max_silence_us || time_us - d->time_us < d->max_silence_us;
+    if (diff <= threshold && silent) return false;
+  }
+  d->published = true;
+  d->value = value;
+  d->time_us = time_us;
+  d->publishes++;
+  return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+// 測定値の変化時の出力(report-on-change). 前回出力した値との差がしきい値を超えたか,
+// 最後の出力から最大の無出力時間が過ぎた場合だけ出力する.
+// 室内の測定値はほとんど変わらないので, USBシリアル, フラッシュの記録, LCDの書き換えを大きく減らせる.
+// しきい値は値の単位の差(threshold)と, 前回の値に対する割合(permille)の大きい方.
+// 照度のように値の範囲が広い測定値は割合で指定する.
+// 判定はhost/deadband_checkで確認する. host/flashlog_simも同じしきい値で記録するサンプルを選ぶ.
+//
+//   static deadband_t temperature;
+//   deadband_init(&temperature, 10, 0, 600000000);  // 0.1℃を超える変化か10分ごと
+//
+//   if (deadband_update(&temperature, time_us_64(), temperature_x100)) print(temperature.value);
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  int32_t threshold;        // 出力する差. この値を超えたら出力する
+  uint16_t permille;        // 出力する差の前回の値に対する割合[0.1%]. 0で使わない
+  uint64_t max_silence_us;  // 最大の無出力時間[us]. 0で無制限
+  bool published;           // 1度でも出力した
+  int32_t value;            // 前回出力した値
+  uint64_t time_us;         // 前回出力した時刻
+  uint32_t updates;         // deadband_updateを呼んだ回数
+  uint32_t publishes;       // 出力した回数
+} deadband_t;
+
+void deadband_init(deadband_t* d, int32_t threshold, uint16_t permille, uint64_t max_silence_us);
+bool deadband_update(deadband_t* d, uint64_t time_us, int32_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
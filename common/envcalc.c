@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "envcalc.h"
+
+// 対数と指数はQ24(下位24bitが小数部)の固定小数で扱う
+#define ENVCALC_LN2 11629080            // ln(2)
+#define ENVCALC_LOG2E 24204406          // log2(e)
+#define ENVCALC_LOG2_10000 222930821    // log2(10000). 湿度[0.01%]を割合にする
+#define ENVCALC_MAGNUS_B 295614546      // Magnusの式の係数b = 17.62
+#define ENVCALC_MAGNUS_C 24312          // Magnusの式の係数c = 243.12℃ [0.01℃]
+#define ENVCALC_KELVIN 27315            // 0℃ [0.01K]
+#define ENVCALC_BARO_EXPONENT 88179034  // 気圧高度の式の指数 g / (R L) = 5.25588
+#define ENVCALC_BARO_INVERSE 3192085    // 指数の逆数 R L / g = 0.190263
+#define ENVCALC_BARO_HEIGHT 443308      // 標準大気の T0 / L = 44330.8m [0.1m]
+
+// log2(1 + i / 256). Q24. 区間の間は直線補間し, 誤差は3e-6以下
+static const uint32_t envcalc_log2_table[257] = {
+    0, 94364, 188362, 281996, 375270, 468185, 560745, 652952,
+    744810, 836320, 927485, 1018309, 1108793, 1198939, 1288752, 1378232,
+    1467383, 1556207, 1644705, 1732882, 1820738, 1908277, 1995500, 2082410,
+    2169009, 2255299, 2341283, 2426963, 2512340, 2597417, 2682196, 2766679,
+    2850868, 2934766, 3018374, 3101694, 3184728, 3267478, 3349946, 3432134,
+    3514044, 3595678, 3677038, 3758124, 3838941, 3919488, 3999768, 4079782,
+    4159533, 4239023, 4318251, 4397222, 4475935, 4554394, 4632599, 4710552,
+    4788255, 4865709, 4942916, 5019878, 5096595, 5173071, 5249305, 5325300,
+    5401057, 5476578, 5551864, 5626916, 5701737, 5776327, 5850688, 5924821,
+    5998727, 6072409, 6145867, 6219103, 6292118, 6364913, 6437490, 6509850,
+    6581994, 6653924, 6725641, 6797146, 6868440, 6939525, 7010402, 7081072,
+    7151536, 7221795, 7291852, 7361706, 7431359, 7500812, 7570066, 7639123,
+    7707984, 7776649, 7845119, 7913397, 7981483, 8049377, 8117082, 8184598,
+    8251926, 8319067, 8386022, 8452793, 8519380, 8585785, 8652008, 8718050,
+    8783912, 8849596, 8915102, 8980431, 9045584, 9110562, 9175366, 9239998,
+    9304457, 9368745, 9432863, 9496811, 9560591, 9624203, 9687648, 9750928,
+    9814042, 9876993, 9939780, 10002404, 10064867, 10127170, 10189312, 10251295,
+    10313120, 10374787, 10436298, 10497652, 10558852, 10619897, 10680789, 10741528,
+    10802114, 10862550, 10922835, 10982970, 11042956, 11102794, 11162484, 11222028,
+    11281425, 11340677, 11399784, 11458748, 11517568, 11576245, 11634780, 11693175,
+    11751428, 11809542, 11867517, 11925353, 11983051, 12040612, 12098037, 12155325,
+    12212479, 12269497, 12326382, 12383133, 12439752, 12496238, 12552593, 12608817,
+    12664911, 12720875, 12776710, 12832416, 12887994, 12943445, 12998770, 13053968,
+    13109041, 13163988, 13218811, 13273511, 13328087, 13382540, 13436871, 13491080,
+    13545168, 13599135, 13652983, 13706711, 13760320, 13813810, 13867183, 13920438,
+    13973576, 14026597, 14079503, 14132294, 14184969, 14237530, 14289978, 14342312,
+    14394532, 14446641, 14498638, 14550523, 14602297, 14653961, 14705514, 14756958,
+    14808293, 14859519, 14910637, 14961648, 15012551, 15063347, 15114037, 15164621,
+    15215099, 15265473, 15315742, 15365906, 15415967, 15465925, 15515779, 15565531,
+    15615181, 15664730, 15714177, 15763523, 15812769, 15861915, 15910962, 15959909,
+    16008758, 16057508, 16106160, 16154714, 16203172, 16251532, 16299796, 16347964,
+    16396036, 16444013, 16491896, 16539683, 16587377, 16634976, 16682482, 16729896,
+    16777216,
+};
+
+// 2^(i / 256). Q28. 区間の間は直線補間し, 相対誤差は2e-6以下
+static const uint32_t envcalc_exp2_table[257] = {
+    268435456, 269163258, 269893034, 270624788, 271358526, 272094254, 272831976, 273571699,
+    274313427, 275057166, 275802922, 276550699, 277300504, 278052342, 278806219, 279562139,
+    280320109, 281080134, 281842219, 282606371, 283372595, 284140896, 284911280, 285683753,
+    286458320, 287234987, 288013760, 288794645, 289577647, 290362771, 291150025, 291939412,
+    292730940, 293524615, 294320441, 295118424, 295918571, 296720888, 297525380, 298332053,
+    299140913, 299951967, 300765219, 301580676, 302398344, 303218229, 304040337, 304864674,
+    305691246, 306520060, 307351120, 308184433, 309020006, 309857844, 310697954, 311540342,
+    312385013, 313231975, 314081233, 314932793, 315786663, 316642847, 317501353, 318362187,
+    319225354, 320090862, 320958716, 321828924, 322701490, 323576423, 324453728, 325333411,
+    326215479, 327099939, 327986797, 328876059, 329767733, 330661824, 331558339, 332457285,
+    333358668, 334262495, 335168773, 336077507, 336988706, 337902375, 338818521, 339737152,
+    340658272, 341581891, 342508013, 343436647, 344367798, 345301474, 346237681, 347176426,
+    348117717, 349061560, 350007962, 350956930, 351908471, 352862591, 353819299, 354778600,
+    355740503, 356705013, 357672138, 358641886, 359614263, 360589276, 361566933, 362547240,
+    363530205, 364515836, 365504138, 366495121, 367488790, 368485153, 369484217, 370485991,
+    371490480, 372497693, 373507637, 374520319, 375535746, 376553927, 377574868, 378598578,
+    379625062, 380654330, 381686389, 382721246, 383758908, 384799384, 385842681, 386888807,
+    387937769, 388989575, 390044233, 391101750, 392162134, 393225394, 394291536, 395360569,
+    396432500, 397507337, 398585089, 399665763, 400749367, 401835909, 402925396, 404017838,
+    405113241, 406211615, 407312966, 408417304, 409524635, 410634969, 411748314, 412864676,
+    413984066, 415106491, 416231959, 417360478, 418492057, 419626704, 420764428, 421905236,
+    423049137, 424196139, 425346252, 426499482, 427655840, 428815332, 429977969, 431143757,
+    432312707, 433484825, 434660122, 435838605, 437020283, 438205166, 439393260, 440584576,
+    441779122, 442976907, 444177939, 445382228, 446589781, 447800609, 449014720, 450232122,
+    451452825, 452676838, 453904170, 455134829, 456368824, 457606166, 458846862, 460090922,
+    461338355, 462589170, 463843377, 465100984, 466362000, 467626436, 468894300, 470165601,
+    471440350, 472718554, 474000224, 475285369, 476573998, 477866122, 479161748, 480460887,
+    481763549, 483069742, 484379477, 485692763, 487009610, 488330027, 489654024, 490981611,
+    492312797, 493647592, 494986007, 496328050, 497673732, 499023062, 500376051, 501732708,
+    503093043, 504457067, 505824789, 507196219, 508571368, 509950244, 511332860, 512719224,
+    514109347, 515503238, 516900910, 518302370, 519707630, 521116701, 522529591, 523946313,
+    525366875, 526791290, 528219566, 529651714, 531087746, 532527671, 533971500, 535419243,
+    536870912,
+};
+
+// Returns: a / bを四捨五入した値. bは正
+static int64_t envcalc_div_round(int64_t a, int64_t b) {
+  return (a >= 0 ? a + b / 2 : a - b / 2) / b;
+}
+
+// Returns: valueの平方根. 小数点以下切り捨て
+static uint32_t envcalc_sqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > value) bit >>= 2;
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Returns: log2(x). Q24. xは1以上
+static int32_t envcalc_log2(uint32_t x) {
+  int n = 31 - __builtin_clz(x);
+  uint32_t m = x << (31 - n);     // 先頭の1をbit31に合わせる
+  uint32_t i = (m >> 23) & 0xFF;  // 表の区間
+  uint32_t f = (m << 9) >> 17;    // 区間内の位置. 15bit
+  uint32_t d = envcalc_log2_table[i + 1] - envcalc_log2_table[i];
+  return (n << 24) + (int32_t)(envcalc_log2_table[i] + ((d * f) >> 15));
+}
+
+// Returns: 2^x. xはQ24. 結果は下位frac_bitsが小数部の固定小数. 表せる範囲を超えたらUINT32_MAX
+static uint32_t envcalc_exp2(int32_t x, int frac_bits) {
+  int32_t n = x >> 24;                  // 整数部. 負の値は切り下げ
+  uint32_t i = ((uint32_t)x >> 16) & 0xFF;
+  uint32_t f = (uint32_t)x & 0xFFFF;
+  uint32_t d = envcalc_exp2_table[i + 1] - envcalc_exp2_table[i];
+  uint32_t m = envcalc_exp2_table[i] + (((d >> 5) * f) >> 11);  // 2^(xの小数部). Q28
+  int32_t shift = n + frac_bits - 28;
+  if (shift > 3) return UINT32_MAX;
+  if (shift >= 0) return m << shift;
+  if (shift < -31) return 0;
+  return (m + (1u << (-shift - 1))) >> -shift;
+}
+
+// Returns: Magnusの式の b T / (c + T). Q24
+static int32_t envcalc_magnus(int32_t temperature_x100) {
+  return (int32_t)envcalc_div_round((int64_t)ENVCALC_MAGNUS_B * temperature_x100,
+                                    ENVCALC_MAGNUS_C + temperature_x100);
+}
+
+// 露点をMagnusの式(b = 17.62, c = 243.12℃)で求める
+//
+// Args:
+//   temperature_x100: 温度[0.01℃]. -40℃以上
+//   humidity_x100: 相対湿度[0.01%]. 0は0.01%とする
+//
+// Returns: 露点[0.01℃]
+int32_t envcalc_dew_point_x100(int32_t temperature_x100, uint32_t humidity_x100) {
+  if (humidity_x100 < 1) humidity_x100 = 1;
+  if (humidity_x100 > 10000) humidity_x100 = 10000;
+  // γ = ln(RH) + b T / (c + T), 露点 = c γ / (b - γ)
+  int32_t ln_rh = (int32_t)(((int64_t)(envcalc_log2(humidity_x100) - ENVCALC_LOG2_10000) * ENVCALC_LN2) >> 24);
+  int32_t gamma = ln_rh + envcalc_magnus(temperature_x100);
+  return (int32_t)envcalc_div_round((int64_t)ENVCALC_MAGNUS_C * gamma, ENVCALC_MAGNUS_B - gamma);
+}
+
+// 絶対湿度(1m^3の空気に含まれる水蒸気の質量)を求める. 飽和水蒸気圧はMagnusの式 6.112hPa * exp(b T / (c + T))
+//
+// Args:
+//   temperature_x100: 温度[0.01℃]. -40℃以上
+//   humidity_x100: 相対湿度[0.01%]
+//
+// Returns: 絶対湿度[0.01g/m^3]
+uint32_t envcalc_absolute_humidity_x100(int32_t temperature_x100, uint32_t humidity_x100) {
+  int32_t x = (int32_t)(((int64_t)envcalc_magnus(temperature_x100) * ENVCALC_LOG2E) >> 24);
+  uint64_t e = envcalc_exp2(x, 16);  // exp(b T / (c + T)). Q16
+  // 水蒸気圧e[hPa]から 216.679 * e / T[K]. 6.112 * 216.679 = 1324.342
+  return (uint32_t)envcalc_div_round((int64_t)(e * humidity_x100 * 1324342),
+                                     ((int64_t)1000 * (temperature_x100 + ENVCALC_KELVIN)) << 16);
+}
+
+// 暑さ指数(heat index, 体感温度)を米国気象局(NWS)の計算方法で求める.
+// 80°F(26.7℃)未満では簡易式, 以上ではRothfuszの回帰式と湿度による補正を使う
+//
+// Args:
+//   temperature_x100: 温度[0.01℃]
+//   humidity_x100: 相対湿度[0.01%]
+//
+// Returns: 暑さ指数[0.01℃]
+int32_t envcalc_heat_index_x100(int32_t temperature_x100, uint32_t humidity_x100) {
+  if (humidity_x100 > 10000) humidity_x100 = 10000;
+  int64_t t = (int64_t)temperature_x100 * 9 + 16000;  // 温度[0.002°F]. ℃からの換算で端数が出ない単位
+  int64_t r = humidity_x100;                          // [0.01%]
+  int64_t hi;                                         // [0.01°F]
+  // 簡易式 HI = (T + 61 + (T - 68) * 1.2 + RH * 0.094) / 2. (HI + T) / 2 >= 80°Fなら回帰式を使う
+  if (4200 * t + 470 * r < 170300000) {
+    hi = envcalc_div_round(220 * t - 1030000 + 47 * r, 1000);
+  } else {
+    // Rothfuszの回帰式をTについて整理し, 各係数を1e-9単位で求める
+    int64_t a = -42379000000 + 101433313 * r - 5481717 * r * r / 1000;
+    int64_t b = 2049015230 - 2247554 * r + 85282 * r * r / 1000;
+    int64_t c = -6837830 + 122874 * r / 10 - 199 * r * r / 1000;
+    hi = envcalc_div_round(a + (b + c * t / 500) * t / 500, 10000000);
+    if (r < 1300 && t > 40000 && t < 56000) {
+      // 低湿度の補正 ((13 - RH) / 4) * sqrt((17 - |T - 95|) / 17)
+      int64_t d = t > 47500 ? t - 47500 : 47500 - t;
+      uint32_t s = envcalc_sqrt((uint32_t)(((uint64_t)(8500 - d) << 30) / 8500));  // Q15
+      hi -= ((1300 - r) * s / 4 + (1 << 14)) >> 15;
+    } else if (r > 8500 && t > 40000 && t < 43500) {
+      // 高湿度の補正 ((RH - 85) / 10) * ((87 - T) / 5)
+      hi += envcalc_div_round((r - 8500) * (43500 - t), 25000);
+    }
+  }
+  return (int32_t)envcalc_div_round((hi - 3200) * 5, 9);
+}
+
+// 測定地点の気圧を海面気圧に換算する. 気温減率0.0065K/mの標準大気の式
+//   P0 = P * ((T + 0.0065 h) / T)^5.25588  (T: 測定地点の気温[K])
+//
+// Args:
+//   pressure_x100: 気圧[0.01hPa]
+//   temperature_x100: 気温[0.01℃]
+//   altitude_m: 測定地点の標高[m]
+//
+// Returns: 海面気圧[0.01hPa]
+uint32_t envcalc_sea_level_pressure_x100(uint32_t pressure_x100, int32_t temperature_x100, int32_t altitude_m) {
+  int32_t t = (temperature_x100 + ENVCALC_KELVIN) * 100;  // [1e-4K]. L h = 0.65h [1e-4K]
+  int32_t e = envcalc_log2((uint32_t)(t + altitude_m * 65)) - envcalc_log2((uint32_t)t);
+  uint64_t factor = envcalc_exp2((int32_t)(((int64_t)e * ENVCALC_BARO_EXPONENT) >> 24), 28);  // Q28
+  return (uint32_t)((pressure_x100 * factor + (1 << 27)) >> 28);
+}
+
+// 気圧から標高を推定する. 標準大気の式 h = 44330.8m * (1 - (P / P0)^0.190263)
+// SCD41の気圧補正(scd41_set_sensor_altitude)に使える. 海面気圧は天候で±30hPa程度変わるので, 誤差は±250m程度
+//
+// Args:
+//   pressure_x100: 気圧[0.01hPa]
+//   sea_level_pressure_x100: 海面気圧[0.01hPa]. 不明ならENVCALC_SEA_LEVEL_PRESSURE_X100
+//
+// Returns: 標高[m]
+int32_t envcalc_altitude_m(uint32_t pressure_x100, uint32_t sea_level_pressure_x100) {
+  int32_t e = envcalc_log2(pressure_x100) - envcalc_log2(sea_level_pressure_x100);
+  int64_t ratio = envcalc_exp2((int32_t)(((int64_t)e * ENVCALC_BARO_INVERSE) >> 24), 28);  // Q28
+  return (int32_t)envcalc_div_round(((1ll << 28) - ratio) * ENVCALC_BARO_HEIGHT, (1ll << 28) * 10);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef ENVCALC_H
+#define ENVCALC_H
+
+// 温度, 湿度, 気圧から求める指標(露点, 絶対湿度, 暑さ指数, 海面気圧, 標高)を整数演算で計算する.
+// logf, expf, powfを使わず, log2と2^xを表とその間の直線補間で近似するので, FPUの無いRP2040でも短時間で済む.
+// 入力と出力はBME280の整数の測定値と同じく0.01℃, 0.01%, 0.01hPa単位.
+// 倍精度の計算との誤差と計算時間はhost/envcalc_benchで確認する.
+//
+//   int32_t dew = envcalc_dew_point_x100(bme280.temperature_x100, bme280.humidity_x100);  // 0.01℃
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENVCALC_SEA_LEVEL_PRESSURE_X100 101325  // 標準大気の海面気圧[0.01hPa]
+
+int32_t envcalc_dew_point_x100(int32_t temperature_x100, uint32_t humidity_x100);
+uint32_t envcalc_absolute_humidity_x100(int32_t temperature_x100, uint32_t humidity_x100);
+int32_t envcalc_heat_index_x100(int32_t temperature_x100, uint32_t humidity_x100);
+uint32_t envcalc_sea_level_pressure_x100(uint32_t pressure_x100, int32_t temperature_x100, int32_t altitude_m);
+int32_t envcalc_altitude_m(uint32_t pressure_x100, uint32_t sea_level_pressure_x100);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,467 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "flashlog.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+#ifdef LIB_PICO_FLASH
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#endif
+
+#define FLASHLOG_PAYLOAD_BITS (FLASHLOG_PAYLOAD_SIZE * 8)
+#define FLASHLOG_PAGES_PER_SECTOR (FLASHLOG_SECTOR_SIZE / FLASHLOG_PAGE_SIZE)
+
+static inline uint32_t flashlog_zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t flashlog_unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// 差の符号の値のビット数. 先頭の1の数(0から5)で選ぶ
+static const uint8_t flashlog_code_length[6] = {0, 2, 4, 8, 16, 32};
+
+// Returns: zigzag符号化した値vの符号の先頭の1の数
+static uint32_t flashlog_code_prefix(uint32_t v) {
+  uint32_t prefix = 0;
+  while (prefix < 5 && (v >> flashlog_code_length[prefix]) != 0) prefix++;
+  return prefix;
+}
+
+// Returns: zigzag符号化した値vの符号のビット数
+static uint32_t flashlog_code_bits(uint32_t v) {
+  uint32_t prefix = flashlog_code_prefix(v);
+  return prefix + (prefix < 5) + flashlog_code_length[prefix];
+}
+
+// payloadのbit番目からvalueの下位nビットを上位から書き込む. payloadは0で初期化しておく
+static void flashlog_put_bits(uint8_t* payload, uint32_t* bit, uint32_t value, uint32_t n) {
+  for (uint32_t i = n; i > 0; i--) {
+    if ((value >> (i - 1)) & 1) payload[*bit >> 3] |= (uint8_t)(0x80 >> (*bit & 7));
+    (*bit)++;
+  }
+}
+
+static uint32_t flashlog_get_bits(const uint8_t* payload, uint32_t* bit, uint32_t n) {
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    value = (value << 1) | ((payload[*bit >> 3] >> (7 - (*bit & 7))) & 1);
+    (*bit)++;
+  }
+  return value;
+}
+
+// 先頭の1の数, 0(最大の長さでは省略), 値の順に書き込む
+static void flashlog_put_code(uint8_t* payload, uint32_t* bit, uint32_t v) {
+  uint32_t prefix = flashlog_code_prefix(v);
+  flashlog_put_bits(payload, bit, ((1u << prefix) - 1) << 1, prefix + (prefix < 5));
+  flashlog_put_bits(payload, bit, v, flashlog_code_length[prefix]);
+}
+
+static uint32_t flashlog_get_code(const uint8_t* payload, uint32_t* bit) {
+  uint32_t prefix = 0;
+  while (prefix < 5 && flashlog_get_bits(payload, bit, 1)) prefix++;
+  return flashlog_get_bits(payload, bit, flashlog_code_length[prefix]);
+}
+
+// Returns: ブロックのCRC. commitとcrc自体を除く
+static uint16_t flashlog_block_crc(const uint8_t* page) {
+  uint16_t crc = telemetry_crc16(0xFFFF, page + 1, offsetof(flashlog_header_t, crc) - 1);
+  return telemetry_crc16(crc, page + sizeof(flashlog_header_t), FLASHLOG_PAYLOAD_SIZE);
+}
+
+// ブロックの確認
+//
+// Args:
+//   page: ページの先頭
+//
+// Returns: 書き込みが完了したブロックならtrue. 消去済み, 書き込み途中, 壊れたブロックはfalse
+bool flashlog_block_valid(const uint8_t* page) {
+  flashlog_header_t h;
+  memcpy(&h, page, sizeof(h));
+  if (h.commit != 0x00 || h.magic != FLASHLOG_MAGIC) return false;
+  if (h.channels == 0 || h.channels > FLASHLOG_MAX_CHANNELS) return false;
+  if (h.count == 0 || h.bits > FLASHLOG_PAYLOAD_BITS) return false;
+  return h.crc == flashlog_block_crc(page);
+}
+
+static bool flashlog_page_erased(const uint8_t* page) {
+  for (uint32_t i = 0; i < FLASHLOG_PAGE_SIZE; i++) {
+    if (page[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+static void flashlog_new_block(flashlog_t* log) {
+  memset(log->block, 0, sizeof(log->block));
+  log->bits = 0;
+  log->count = 0;
+  log->prev_delta = 0;
+}
+
+// 記録の初期化. 領域の既存の記録を調べ, 最新のブロックの次から記録を続ける
+//
+// Args:
+//   log: 記録の状態
+//   flash: フラッシュの領域と操作. 内容をコピーする
+//   channels: 1サンプルの値の数. 1からFLASHLOG_MAX_CHANNELS
+//
+// Returns: 成功でtrue. 領域の大きさかチャンネル数が不正ならfalse
+bool flashlog_init(flashlog_t* log, const flashlog_flash_t* flash, uint8_t channels) {
+  if (channels == 0 || channels > FLASHLOG_MAX_CHANNELS) return false;
+  if (flash->size % FLASHLOG_SECTOR_SIZE || flash->size < FLASHLOG_SECTOR_SIZE * 2) return false;
+  memset(log, 0, sizeof(*log));
+  log->flash = *flash;
+  log->channels = channels;
+
+  uint32_t pages = flash->size / FLASHLOG_PAGE_SIZE;
+  bool found = false;
+  uint32_t newest = 0;
+  for (uint32_t p = 0; p < pages; p++) {
+    const uint8_t* page = flash->base + p * FLASHLOG_PAGE_SIZE;
+    if (!flashlog_block_valid(page)) continue;
+    flashlog_header_t h;
+    memcpy(&h, page, sizeof(h));
+    if (!found || (int32_t)(h.seq - log->seq) >= 0) {
+      found = true;
+      newest = p;
+      log->seq = h.seq;
+      log->boot = h.boot;
+    }
+  }
+  if (found) {
+    log->seq++;
+    log->boot++;
+    log->write_page = (newest + 1) % pages;
+  }
+
+  // セクターの終わりまで消去済みのページから書き込む. 書き込み途中で電源が切れたページは飛ばす.
+  // セクターの先頭から書き込む場合に消去されていないページがあれば, 消去の途中で電源が切れたのでセクターを消去し直す
+  uint32_t end = (log->write_page / FLASHLOG_PAGES_PER_SECTOR + 1) * FLASHLOG_PAGES_PER_SECTOR;
+  uint32_t p = end;
+  while (p > log->write_page && flashlog_page_erased(flash->base + (p - 1) * FLASHLOG_PAGE_SIZE)) p--;
+  if (log->write_page % FLASHLOG_PAGES_PER_SECTOR && p < end) {
+    log->write_page = p;
+    log->ready = end - p;
+  } else if (log->write_page % FLASHLOG_PAGES_PER_SECTOR) {
+    log->write_page = end % pages;
+  } else if (p == log->write_page) {
+    log->ready = FLASHLOG_PAGES_PER_SECTOR;
+  }
+
+  // 前もって消去したセクター. 再起動のたびに消去し直さない
+  while (log->ready <= FLASHLOG_PAGES_PER_SECTOR) {
+    const uint8_t* sector = flash->base + ((log->write_page + log->ready) % pages) * FLASHLOG_PAGE_SIZE;
+    uint32_t n = 0;
+    while (n < FLASHLOG_PAGES_PER_SECTOR && flashlog_page_erased(sector + n * FLASHLOG_PAGE_SIZE)) n++;
+    if (n < FLASHLOG_PAGES_PER_SECTOR) break;
+    log->ready += FLASHLOG_PAGES_PER_SECTOR;
+  }
+
+  flashlog_new_block(log);
+  return true;
+}
+
+// 符号化中のブロックを書き込み待ちにする. 待ちがいっぱいならブロックを捨てる
+//
+// Returns: 捨てた場合はfalse
+static bool flashlog_seal(flashlog_t* log) {
+  if (log->count == 0) return true;
+  bool ok = log->queue_count < FLASHLOG_QUEUE_BLOCKS;
+  if (ok) {
+    flashlog_header_t h = {
+        .commit = 0xFF,
+        .channels = log->channels,
+        .magic = FLASHLOG_MAGIC,
+        .seq = log->seq++,
+        .boot = log->boot,
+        .count = log->count,
+        .bits = (uint16_t)log->bits,
+        .crc = 0,
+    };
+    memcpy(log->block, &h, sizeof(h));
+    h.crc = flashlog_block_crc(log->block);
+    memcpy(log->block + offsetof(flashlog_header_t, crc), &h.crc, sizeof(h.crc));
+    uint32_t tail = (log->queue_head + log->queue_count) % FLASHLOG_QUEUE_BLOCKS;
+    memcpy(log->queue[tail], log->block, FLASHLOG_PAGE_SIZE);
+    log->queue_count++;
+  } else {
+    log->stats.dropped += log->count;
+  }
+  flashlog_new_block(log);
+  return ok;
+}
+
+// 2番目以降のサンプルを前のサンプルとの差で符号化する
+//
+// Returns: ブロックに収まらず書き込まなかった場合はfalse
+static bool flashlog_append_delta(flashlog_t* log, uint32_t time, const int32_t* values) {
+  uint32_t delta = time - log->prev_time;
+  uint32_t codes[1 + FLASHLOG_MAX_CHANNELS];
+  codes[0] = flashlog_zigzag((int32_t)(delta - log->prev_delta));
+  uint32_t size = 1 + flashlog_code_bits(codes[0]);
+  bool same = codes[0] == 0;
+  for (uint32_t i = 0; i < log->channels; i++) {
+    codes[1 + i] = flashlog_zigzag((int32_t)((uint32_t)values[i] - (uint32_t)log->prev[i]));
+    size += flashlog_code_bits(codes[1 + i]);
+    same = same && codes[1 + i] == 0;
+  }
+  if (same) size = 1;
+  if (log->bits + size > FLASHLOG_PAYLOAD_BITS) return false;
+
+  uint8_t* payload = log->block + sizeof(flashlog_header_t);
+  if (same) {
+    flashlog_put_bits(payload, &log->bits, 0, 1);
+  } else {
+    flashlog_put_bits(payload, &log->bits, 1, 1);
+    for (uint32_t i = 0; i <= log->channels; i++) flashlog_put_code(payload, &log->bits, codes[i]);
+  }
+  log->prev_delta = delta;
+  return true;
+}
+
+// 1サンプルを記録する. RAM上で符号化するだけで, フラッシュにはアクセスしない.
+// ブロックがいっぱいになったら書き込み待ちにし, 新しいブロックを開始する
+//
+// Args:
+//   log: 記録の状態
+//   time: 時刻. 単位は任意で, 前のサンプル以上の値. 一定の間隔なら時刻の符号は1bitになる
+//   values: flashlog_initで指定したチャンネル数の値. 無い値はFLASHLOG_NO_VALUE
+//
+// Returns: 書き込み待ちがいっぱいでブロックを捨てた場合はfalse
+bool flashlog_append(flashlog_t* log, uint32_t time, const int32_t* values) {
+  bool ok = true;
+  if (log->count && !flashlog_append_delta(log, time, values)) ok = flashlog_seal(log);
+  if (!log->count) {
+    // ブロックの最初のサンプルはそのまま書き込む
+    uint8_t* payload = log->block + sizeof(flashlog_header_t);
+    flashlog_put_bits(payload, &log->bits, time, 32);
+    for (uint32_t i = 0; i < log->channels; i++) flashlog_put_bits(payload, &log->bits, (uint32_t)values[i], 32);
+  }
+  log->count++;
+  log->prev_time = time;
+  memcpy(log->prev, values, log->channels * sizeof(values[0]));
+  log->stats.samples++;
+  return ok;
+}
+
+// 符号化中のブロックを途中でも書き込み待ちにする. 書き出しの前などに使う
+void flashlog_flush(flashlog_t* log) {
+  flashlog_seal(log);
+}
+
+// フラッシュの書き込み, 消去を1回行う. 記録とは別のタスクから定期的に呼ぶ.
+// 書き込み待ちのブロックが無ければ, 書き込み先の次のセクターを前もって消去する
+//
+// Returns: フラッシュにアクセスした場合はtrue
+bool flashlog_service(flashlog_t* log) {
+  uint32_t pages = log->flash.size / FLASHLOG_PAGE_SIZE;
+  if (log->queue_count && log->ready) {
+    uint8_t* block = log->queue[log->queue_head];
+    uint32_t offset = log->write_page * FLASHLOG_PAGE_SIZE;
+    // 失敗した場合は次の呼び出しで同じ書き込みをやり直す
+    if (!log->committing) {
+      // データを書き込む. commitは0xFFのまま
+      if (!log->flash.program(offset, block, log->flash.ctx)) {
+        log->stats.errors++;
+        return true;
+      }
+      log->committing = true;
+      return true;
+    }
+    // 同じページを再度書き込み, commitだけを0x00にする. 書き込み済みのビットは変わらない
+    block[0] = 0x00;
+    if (!log->flash.program(offset, block, log->flash.ctx)) {
+      log->stats.errors++;
+      return true;
+    }
+    log->committing = false;
+    log->queue_head = (log->queue_head + 1) % FLASHLOG_QUEUE_BLOCKS;
+    log->queue_count--;
+    log->write_page = (log->write_page + 1) % pages;
+    log->ready--;
+    log->stats.blocks++;
+    return true;
+  }
+
+  // 書き込み先のセクターの残りに加えて, 次のセクターまで消去しておく
+  if (log->ready <= FLASHLOG_PAGES_PER_SECTOR) {
+    uint32_t page = (log->write_page + log->ready) % pages;
+    if (!log->flash.erase(page * FLASHLOG_PAGE_SIZE, log->flash.ctx)) {
+      log->stats.errors++;
+      return true;
+    }
+    log->ready += FLASHLOG_PAGES_PER_SECTOR;
+    log->stats.erases++;
+    return true;
+  }
+  return false;
+}
+
+// Returns: 書き込み待ちのブロックがあればtrue
+bool flashlog_busy(const flashlog_t* log) {
+  return log->queue_count > 0;
+}
+
+// 読み出しの初期化. 通し番号が最も小さいブロックから読み出す
+//
+// Args:
+//   r: 読み出しの状態
+//   base: 領域の先頭. flashlog_exportの出力のページ列でもよい
+//   size: 領域のバイト数
+void flashlog_reader_init(flashlog_reader_t* r, const uint8_t* base, uint32_t size) {
+  memset(r, 0, sizeof(*r));
+  r->base = base;
+  r->pages = size / FLASHLOG_PAGE_SIZE;
+  bool found = false;
+  uint32_t oldest = 0;
+  for (uint32_t p = 0; p < r->pages; p++) {
+    const uint8_t* page = base + p * FLASHLOG_PAGE_SIZE;
+    if (!flashlog_block_valid(page)) continue;
+    flashlog_header_t h;
+    memcpy(&h, page, sizeof(h));
+    if (!found || (int32_t)(h.seq - oldest) < 0) {
+      found = true;
+      oldest = h.seq;
+      r->page = p;
+    }
+  }
+  r->remaining = found ? r->pages : 0;
+}
+
+// Returns: 次のブロックの先頭. 通し番号が前のブロックより大きいブロックのみ. 無ければNULL
+static const uint8_t* flashlog_next_block(flashlog_reader_t* r) {
+  while (r->remaining) {
+    const uint8_t* page = r->base + r->page * FLASHLOG_PAGE_SIZE;
+    r->page = (r->page + 1) % r->pages;
+    r->remaining--;
+    if (!flashlog_block_valid(page)) continue;
+    flashlog_header_t h;
+    memcpy(&h, page, sizeof(h));
+    if (r->started && (int32_t)(h.seq - r->last_seq) <= 0) continue;  // 消去しきれなかった古いブロック
+    r->started = true;
+    r->last_seq = h.seq;
+    return page;
+  }
+  return NULL;
+}
+
+// 次のサンプルを読み出す
+//
+// Args:
+//   r: 読み出しの状態
+//   sample: 読み出したサンプル
+//
+// Returns: 読み出した場合はtrue. 最後まで読み出した場合はfalse
+bool flashlog_read(flashlog_reader_t* r, flashlog_sample_t* sample) {
+  if (r->index >= r->count) {
+    r->block = flashlog_next_block(r);
+    if (!r->block) return false;
+    flashlog_header_t h;
+    memcpy(&h, r->block, sizeof(h));
+    r->bit = 0;
+    r->index = 0;
+    r->count = h.count;
+    r->delta = 0;
+    r->sample.boot = h.boot;
+    r->sample.channels = h.channels;
+  }
+
+  const uint8_t* payload = r->block + sizeof(flashlog_header_t);
+  flashlog_sample_t* s = &r->sample;
+  if (r->index == 0) {
+    s->time = flashlog_get_bits(payload, &r->bit, 32);
+    for (uint32_t i = 0; i < s->channels; i++) s->values[i] = (int32_t)flashlog_get_bits(payload, &r->bit, 32);
+  } else if (!flashlog_get_bits(payload, &r->bit, 1)) {
+    s->time += r->delta;
+  } else {
+    r->delta += (uint32_t)flashlog_unzigzag(flashlog_get_code(payload, &r->bit));
+    s->time += r->delta;
+    for (uint32_t i = 0; i < s->channels; i++) {
+      s->values[i] = (int32_t)((uint32_t)s->values[i] + (uint32_t)flashlog_unzigzag(flashlog_get_code(payload, &r->bit)));
+    }
+  }
+  r->index++;
+  *sample = *s;
+  return true;
+}
+
+// 記録を古い順に出力する. 先頭に"FLASHLOG"とページ数(4byte, リトルエンディアン), 続いて有効なブロックのページ.
+// 書き込み待ちのブロックは含まないので, 先にflashlog_flushとflashlog_serviceで書き込んでおく
+//
+// Args:
+//   log: 記録の状態
+//   write: 出力関数. PicoのUSBシリアルへ送る場合はtelemetry_usb_write
+//   ctx: writeへ渡す値
+void flashlog_export(const flashlog_t* log, flashlog_write_fn_t write, void* ctx) {
+  flashlog_reader_t r;
+  flashlog_reader_init(&r, log->flash.base, log->flash.size);
+  uint32_t count = 0;
+  while (flashlog_next_block(&r)) count++;
+
+  uint8_t head[12] = {'F', 'L', 'A', 'S', 'H', 'L', 'O', 'G'};
+  for (int i = 0; i < 4; i++) head[8 + i] = (uint8_t)(count >> (i * 8));
+  write(head, sizeof(head), ctx);
+
+  flashlog_reader_init(&r, log->flash.base, log->flash.size);
+  const uint8_t* page;
+  for (uint32_t i = 0; i < count && (page = flashlog_next_block(&r)); i++) write(page, FLASHLOG_PAGE_SIZE, ctx);
+}
+
+#ifdef LIB_PICO_FLASH
+
+#define FLASHLOG_PICO_TIMEOUT_MS 100  // もう一方のコアを止めるまでの待ち時間の上限
+
+typedef struct {
+  uint32_t offset;  // フラッシュの先頭からのバイト数
+  const uint8_t* data;
+} flashlog_pico_op_t;
+
+static uint32_t flashlog_pico_offset;  // 領域のフラッシュの先頭からのバイト数
+
+static void flashlog_pico_erase_op(void* param) {
+  flashlog_pico_op_t* op = (flashlog_pico_op_t*)param;
+  flash_range_erase(op->offset, FLASHLOG_SECTOR_SIZE);
+}
+
+static void flashlog_pico_program_op(void* param) {
+  flashlog_pico_op_t* op = (flashlog_pico_op_t*)param;
+  flash_range_program(op->offset, op->data, FLASHLOG_PAGE_SIZE);
+}
+
+static bool flashlog_pico_erase(uint32_t offset, void* ctx) {
+  flashlog_pico_op_t op = {flashlog_pico_offset + offset, NULL};
+  return flash_safe_execute(flashlog_pico_erase_op, &op, FLASHLOG_PICO_TIMEOUT_MS) == PICO_OK;
+}
+
+static bool flashlog_pico_program(uint32_t offset, const uint8_t* data, void* ctx) {
+  flashlog_pico_op_t op = {flashlog_pico_offset + offset, data};
+  return flash_safe_execute(flashlog_pico_program_op, &op, FLASHLOG_PICO_TIMEOUT_MS) == PICO_OK;
+}
+
+// Picoのフラッシュの最後のsizeバイトを記録の領域にする. プログラムと重ならない大きさにする.
+// 書き込み, 消去の間はXIPが止まるので, flash_safe_executeでもう一方のコアと割り込みを止める.
+// もう一方のコアでもプログラムを実行している場合は, そのコアでflash_safe_execute_core_initを呼んでおく
+//
+// Args:
+//   flash: 設定するフラッシュの領域と操作
+//   size: 領域のバイト数. FLASHLOG_SECTOR_SIZEの倍数
+void flashlog_pico_flash(flashlog_flash_t* flash, uint32_t size) {
+  flashlog_pico_offset = PICO_FLASH_SIZE_BYTES - size;
+  flash->base = (const uint8_t*)(XIP_BASE + flashlog_pico_offset);
+  flash->size = size;
+  flash->erase = flashlog_pico_erase;
+  flash->program = flashlog_pico_program;
+  flash->ctx = NULL;
+}
+
+#endif
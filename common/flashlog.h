@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef FLASHLOG_H
+#define FLASHLOG_H
+
+// 測定値をフラッシュメモリーの専用の領域に圧縮して記録する. USBを接続していない間の測定値も残る.
+//
+// 1サンプルは時刻と整数の値の組(チャンネル数は記録ごとに指定). 1ページ(256byte)を1ブロックとし,
+// ブロックの先頭のサンプルはそのまま, 以降は時刻の間隔の変化と前のサンプルとの差をビット単位の可変長で符号化する.
+//   サンプル: '0'なら時刻の間隔と全ての値が前のサンプルと同じ. '1'なら時刻の間隔の変化と値の差が続く
+//   差(zigzag): '0'=0, '10'+2bit, '110'+4bit, '1110'+8bit, '11110'+16bit, '11111'+32bit
+// 値は記録したい分解能の整数にしてから渡す(温度なら0.1℃単位など). 変化が無ければ1サンプル1bitになる.
+//
+// 領域はセクター(4KB)の環で, 古いセクターから順に消去して上書きする. 全てのセクターが同じ回数ずつ消去される.
+// ブロックの書き込みは2段階で, 先頭のcommitを0xFFのまま書き込んでから, commitだけを0x00にする.
+// 書き込み中に電源が切れたブロックはcommitかCRCで判別し, 読み出しと起動時の復旧で読み飛ばす.
+//
+// flashlog_appendはRAM上で符号化するだけで, フラッシュにはアクセスしない. 書き込みと消去はflashlog_serviceで
+// 1回ずつ行う. 書き込み中のセクターの次のセクターを前もって消去しておくので, 記録が消去を待つことはない.
+//
+// フラッシュの読み書きはflashlog_flash_tの関数で行い, Pico SDKに依存しない(flashlog_pico_flashを除く).
+// ホスト側のツールも同じコードで記録の読み出しとシミュレーションを行う. CRCはtelemetry.cのtelemetry_crc16を使う.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#define FLASHLOG_MAX_CHANNELS 8  // 1サンプルの値の最大数
+#define FLASHLOG_QUEUE_BLOCKS 4  // 書き込みを待つブロックの最大数. 超えたブロックは捨てる
+
+// -----------------
+
+#define FLASHLOG_PAGE_SIZE 256     // 書き込みの単位. 1ブロック
+#define FLASHLOG_SECTOR_SIZE 4096  // 消去の単位
+#define FLASHLOG_MAGIC 0x4C46      // ブロックの目印 "FL"
+#define FLASHLOG_NO_VALUE INT32_MIN  // 値が無いチャンネル(センサーが無い, まだ測定していない)
+
+// ブロックの先頭. 残りがペイロード
+typedef struct {
+  uint8_t commit;    // 0x00で書き込み完了. 最後に書き込む. 消去した状態は0xFF
+  uint8_t channels;  // 1サンプルの値の数
+  uint16_t magic;    // FLASHLOG_MAGIC
+  uint32_t seq;      // ブロックの通し番号. 書き込むたびに1増える
+  uint16_t boot;     // 起動の番号. flashlog_initのたびに1増える
+  uint16_t count;    // サンプル数
+  uint16_t bits;     // ペイロードのビット数
+  uint16_t crc;      // channelsからペイロードの最後までのCRC-16/CCITT-FALSE(crcとcommitを除く)
+} flashlog_header_t;
+
+#define FLASHLOG_PAYLOAD_SIZE (FLASHLOG_PAGE_SIZE - sizeof(flashlog_header_t))
+
+// フラッシュの領域と操作
+typedef struct {
+  const uint8_t* base;  // 領域の先頭. 読み出しはここから直接行う(PicoではXIPのアドレス)
+  uint32_t size;        // 領域のバイト数. FLASHLOG_SECTOR_SIZEの倍数で2セクター以上
+
+  // offsetのセクターを消去する. Returns: 成功でtrue
+  bool (*erase)(uint32_t offset, void* ctx);
+
+  // offsetのページにFLASHLOG_PAGE_SIZEバイトを書き込む. Returns: 成功でtrue
+  bool (*program)(uint32_t offset, const uint8_t* data, void* ctx);
+
+  void* ctx;
+} flashlog_flash_t;
+
+typedef struct {
+  uint16_t boot;  // 記録した起動の番号
+  uint32_t time;  // flashlog_appendで指定した時刻
+  uint8_t channels;
+  int32_t values[FLASHLOG_MAX_CHANNELS];
+} flashlog_sample_t;
+
+typedef struct {
+  uint32_t samples;  // 記録したサンプル数
+  uint32_t blocks;   // 書き込んだブロック数
+  uint32_t erases;   // 消去したセクター数
+  uint32_t dropped;  // 書き込みが間に合わず捨てたサンプル数
+  uint32_t errors;   // 失敗した書き込み, 消去の回数
+} flashlog_stats_t;
+
+typedef struct {
+  flashlog_flash_t flash;
+  uint8_t channels;
+  uint16_t boot;
+  uint32_t seq;         // 次のブロックの通し番号
+  uint32_t write_page;  // 次に書き込むページの番号
+  uint32_t ready;       // write_pageから続く消去済みのページ数
+
+  // 符号化中のブロック
+  uint8_t block[FLASHLOG_PAGE_SIZE];
+  uint32_t bits;        // 書き込んだペイロードのビット数
+  uint16_t count;       // サンプル数
+  uint32_t prev_time;   // 前のサンプルの時刻
+  uint32_t prev_delta;  // 前のサンプルとの時刻の間隔
+  int32_t prev[FLASHLOG_MAX_CHANNELS];
+
+  // 書き込みを待つブロック
+  uint8_t queue[FLASHLOG_QUEUE_BLOCKS][FLASHLOG_PAGE_SIZE];
+  uint32_t queue_head;
+  uint32_t queue_count;
+  bool committing;  // 先頭のブロックのデータを書き込み済みで, commitの書き込みを待っている
+
+  flashlog_stats_t stats;
+} flashlog_t;
+
+// 記録を古い順に読み出す. 領域を直接読むので, 読み出し中に書き込むと途中のブロックを読み飛ばすことがある
+typedef struct {
+  const uint8_t* base;
+  uint32_t pages;
+  uint32_t page;       // 次に読むページ
+  uint32_t remaining;  // 残りのページ数
+  uint32_t last_seq;   // 最後に読んだブロックの通し番号
+  bool started;        // 1つ以上のブロックを読んだ
+
+  // 復号中のブロック
+  const uint8_t* block;
+  uint32_t bit;
+  uint16_t index;
+  uint16_t count;
+  flashlog_sample_t sample;
+  uint32_t delta;
+} flashlog_reader_t;
+
+// 出力関数. telemetry_write_fn_tと同じ形
+typedef void (*flashlog_write_fn_t)(const uint8_t* data, uint32_t len, void* ctx);
+
+bool flashlog_init(flashlog_t* log, const flashlog_flash_t* flash, uint8_t channels);
+bool flashlog_append(flashlog_t* log, uint32_t time, const int32_t* values);
+void flashlog_flush(flashlog_t* log);
+bool flashlog_service(flashlog_t* log);
+bool flashlog_busy(const flashlog_t* log);
+void flashlog_export(const flashlog_t* log, flashlog_write_fn_t write, void* ctx);
+
+bool flashlog_block_valid(const uint8_t* page);
+void flashlog_reader_init(flashlog_reader_t* r, const uint8_t* base, uint32_t size);
+bool flashlog_read(flashlog_reader_t* r, flashlog_sample_t* sample);
+
+#ifdef LIB_PICO_FLASH
+void flashlog_pico_flash(flashlog_flash_t* flash, uint32_t size);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
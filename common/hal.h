@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+// デバイスドライバー(bme280, scd41, tsl2572, lcdaqm, infrared)が使うI2C, 時間, PIOの関数.
+// 関数名はPico SDKの関数名にhal_を付けたもので, 引数と戻り値も同じ.
+//
+// Picoではマクロとstatic inline関数でPico SDKの関数をそのまま呼ぶので, オーバーヘッドはない.
+// HAL_HOSTを定義してビルドすると, ホスト側の実装(host/hal_host.cpp)を呼ぶ.
+// ホスト側ではI2Cをデバイスのシミュレーターにつなぎ, 時間は仮想的な時刻で扱う. 待機は仮想的な時刻を進めるだけなので,
+// ドライバーをPC上で実行し, 通信回数や処理時間を測定できる.
+//
+// HAL_INSTRを1にしてビルドすると, I2C転送, 待機, PIOのFIFO待ちを計測付きの関数で呼ぶ(common/instr.h).
+
+#ifdef HAL_HOST
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+typedef struct hal_i2c_inst i2c_inst_t;  // ホスト側ではI2Cインスタンスを区別しない
+
+#define i2c_default ((i2c_inst_t*)0)
+#define PICO_DEFAULT_I2C_SDA_PIN 4
+#define PICO_DEFAULT_I2C_SCL_PIN 5
+#define PICO_ERROR_GENERIC (-1)
+#define PICO_ERROR_TIMEOUT (-2)
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+void hal_i2c_init_pins(i2c_inst_t* i2c, uint baudrate, uint sda_pin, uint scl_pin);
+int hal_i2c_write_blocking(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop);
+int hal_i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop,
+                             uint timeout_us);
+int hal_i2c_read_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop);
+void hal_sleep_ms(uint32_t ms);
+uint64_t hal_time_us_64();
+
+static inline absolute_time_t hal_make_timeout_time_us(uint64_t us) {
+  return hal_time_us_64() + us;
+}
+
+static inline bool hal_time_reached(absolute_time_t t) {
+  return hal_time_us_64() >= t;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "pico/stdlib.h"
+
+#define hal_i2c_write_blocking i2c_write_blocking
+#define hal_i2c_write_timeout_us i2c_write_timeout_us
+#define hal_i2c_read_blocking i2c_read_blocking
+#define hal_sleep_ms sleep_ms
+#define hal_time_us_64 time_us_64
+#define hal_make_timeout_time_us make_timeout_time_us
+#define hal_time_reached time_reached
+#define hal_pio_sm_put_blocking pio_sm_put_blocking  // hardware/pio.hを読み込んだソースファイルでのみ使える
+
+// I2Cインスタンスを初期化し, SDA, SCLピンをプルアップしてI2Cに割り当てる
+static inline void hal_i2c_init_pins(i2c_inst_t* i2c, uint baudrate, uint sda_pin, uint scl_pin) {
+  i2c_init(i2c, baudrate);
+
+  gpio_init(sda_pin);
+  gpio_pull_up(sda_pin);
+  gpio_set_function(sda_pin, GPIO_FUNC_I2C);
+
+  gpio_init(scl_pin);
+  gpio_pull_up(scl_pin);
+  gpio_set_function(scl_pin, GPIO_FUNC_I2C);
+}
+
+#endif
+
+#include "instr.h"
+
+#ifndef HAL_DRIVER
+#define HAL_DRIVER INSTR_OTHER
+#endif
+
+// HAL_IMPLはhal_関数を実装するソースファイル(host/hal_host.cpp)で定義し, 計測付きの関数に置き換えない
+#if HAL_INSTR && !defined(HAL_IMPL)
+
+// 計測付きの関数. 元の関数を呼び, 所要時間をinstr_recordで記録する
+static inline int hal_instr_i2c_write_blocking(uint8_t driver, i2c_inst_t* i2c, uint8_t addr, const uint8_t* src,
+                                               size_t len, bool nostop) {
+  uint32_t start = instr_now();
+  int n = hal_i2c_write_blocking(i2c, addr, src, len, nostop);
+  instr_record(driver, INSTR_I2C_WRITE, start, n > 0 ? n : 0, n >= 0);
+  return n;
+}
+
+static inline int hal_instr_i2c_write_timeout_us(uint8_t driver, i2c_inst_t* i2c, uint8_t addr, const uint8_t* src,
+                                                 size_t len, bool nostop, uint timeout_us) {
+  uint32_t start = instr_now();
+  int n = hal_i2c_write_timeout_us(i2c, addr, src, len, nostop, timeout_us);
+  instr_record(driver, INSTR_I2C_WRITE, start, n > 0 ? n : 0, n >= 0);
+  return n;
+}
+
+static inline int hal_instr_i2c_read_blocking(uint8_t driver, i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len,
+                                              bool nostop) {
+  uint32_t start = instr_now();
+  int n = hal_i2c_read_blocking(i2c, addr, dst, len, nostop);
+  instr_record(driver, INSTR_I2C_READ, start, n > 0 ? n : 0, n >= 0);
+  return n;
+}
+
+static inline void hal_instr_sleep_ms(uint8_t driver, uint32_t ms) {
+  uint32_t start = instr_now();
+  hal_sleep_ms(ms);
+  instr_record(driver, INSTR_SLEEP, start, 0, true);
+}
+
+#undef hal_i2c_write_blocking
+#undef hal_i2c_write_timeout_us
+#undef hal_i2c_read_blocking
+#undef hal_sleep_ms
+#undef hal_pio_sm_put_blocking
+#define hal_i2c_write_blocking(i2c, addr, src, len, nostop) \
+  hal_instr_i2c_write_blocking(HAL_DRIVER, i2c, addr, src, len, nostop)
+#define hal_i2c_write_timeout_us(i2c, addr, src, len, nostop, timeout_us) \
+  hal_instr_i2c_write_timeout_us(HAL_DRIVER, i2c, addr, src, len, nostop, timeout_us)
+#define hal_i2c_read_blocking(i2c, addr, dst, len, nostop) \
+  hal_instr_i2c_read_blocking(HAL_DRIVER, i2c, addr, dst, len, nostop)
+#define hal_sleep_ms(ms) hal_instr_sleep_ms(HAL_DRIVER, ms)
+
+// hardware/pio.hに依存しないようにマクロにする
+#define hal_pio_sm_put_blocking(pio, sm, data)                          \
+  do {                                                                  \
+    uint32_t hal_instr_start = instr_now();                             \
+    pio_sm_put_blocking(pio, sm, data);                                 \
+    instr_record(HAL_DRIVER, INSTR_PIO_WAIT, hal_instr_start, 4, true); \
+  } while (0)
+
+#endif
+
+#endif
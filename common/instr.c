@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "hal.h"
+
+#if HAL_INSTR
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__ARM_ARCH_8M_MAIN__) && !defined(HAL_HOST)
+#include "hardware/clocks.h"
+#endif
+
+static instr_stats_t instr_stats[INSTR_DRIVERS][INSTR_OPS];
+
+static const char* const instr_driver_names[INSTR_DRIVERS] = {"other", "bme280", "scd41", "tsl2572", "lcdaqm",
+                                                               "infrared"};
+static const char* const instr_op_names[INSTR_OPS] = {"i2c_write", "i2c_read", "sleep", "pio_wait"};
+
+// 計測を開始する. Cortex-M33ではサイクルカウンターを有効にする. サイクルカウンターはコアごとにあるので,
+// ドライバーを呼ぶコアで呼ぶこと
+void instr_init() {
+#if defined(__ARM_ARCH_8M_MAIN__) && !defined(HAL_HOST)
+  m33_hw->demcr |= M33_DEMCR_TRCENA_BITS;
+  m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+#endif
+  instr_reset();
+}
+
+// 1回の処理を記録する. hal.hの計測付きの関数から呼ぶ
+//
+// Args:
+//   driver: ドライバーの番号. instr_driver_t
+//   op: 処理の種類. instr_op_t
+//   start: 処理の開始時のinstr_now()
+//   bytes: 転送したバイト数
+//   ok: 転送に成功したらtrue
+void instr_record(uint8_t driver, uint8_t op, uint32_t start, uint32_t bytes, bool ok) {
+  uint32_t d = instr_now() - start;
+  instr_stats_t* s = &instr_stats[driver][op];
+  s->calls++;
+  s->bytes += bytes;
+  if (!ok) s->errors++;
+  if (d > s->max) s->max = d;
+  s->total += d;
+  uint k = d ? 32 - __builtin_clz(d) : 0;  // dのbit数
+  s->hist[k < INSTR_BUCKETS ? k : INSTR_BUCKETS - 1]++;
+}
+
+// 記録を取得する
+//
+// Args:
+//   driver: ドライバーの番号. instr_driver_t
+//   op: 処理の種類. instr_op_t
+//   stats: 記録のコピー先
+void instr_get(uint8_t driver, uint8_t op, instr_stats_t* stats) {
+  *stats = instr_stats[driver][op];
+}
+
+// 記録を消去する
+void instr_reset() {
+  memset(instr_stats, 0, sizeof(instr_stats));
+}
+
+// 計測した時間をusに変換する
+//
+// Args:
+//   t: 時間[INSTR_UNIT]
+//
+// Returns: 時間[us]
+uint64_t instr_us(uint64_t t) {
+#if defined(__ARM_ARCH_8M_MAIN__) && !defined(HAL_HOST)
+  return t * 1000000 / clock_get_hz(clk_sys);
+#else
+  return t;
+#endif
+}
+
+// 記録のある処理を1行ずつ表示する. 続く行にヒストグラムの度数のある区間を"<区間の上限:度数"で表示する.
+// 最後の区間は上限を超えたものも含むので">=区間の下限:度数"とする
+void instr_print() {
+  printf("time unit: %s\n", INSTR_UNIT);
+  printf("%-8s %-9s %9s %10s %7s %12s %10s\n", "driver", "op", "calls", "bytes", "errors", "total", "max");
+  for (uint d = 0; d < INSTR_DRIVERS; d++) {
+    for (uint op = 0; op < INSTR_OPS; op++) {
+      const instr_stats_t* s = &instr_stats[d][op];
+      if (!s->calls) continue;
+      printf("%-8s %-9s %9lu %10lu %7lu %12llu %10lu\n ", instr_driver_names[d], instr_op_names[op],
+             (unsigned long)s->calls, (unsigned long)s->bytes, (unsigned long)s->errors,
+             (unsigned long long)s->total, (unsigned long)s->max);
+      for (uint k = 0; k < INSTR_BUCKETS - 1; k++) {
+        if (s->hist[k]) printf(" <%lu:%lu", 1ul << k, (unsigned long)s->hist[k]);
+      }
+      if (s->hist[INSTR_BUCKETS - 1]) {
+        printf(" >=%lu:%lu", 1ul << (INSTR_BUCKETS - 2), (unsigned long)s->hist[INSTR_BUCKETS - 1]);
+      }
+      printf("\n");
+    }
+  }
+}
+
+// USBシリアルなどから受信した1文字の要求を処理する. 'i'で記録を表示し, 'r'で記録を消去する
+//
+// Returns: 計測の要求だった場合はtrue
+bool instr_command(int c) {
+  if (c == 'i') {
+    instr_print();
+  } else if (c == 'r') {
+    instr_reset();
+    printf("instr reset\n");
+  } else {
+    return false;
+  }
+  return true;
+}
+
+#ifndef HAL_HOST
+// USBシリアルからの要求を確認する. ブロックしない. 他の文字も受け付ける場合はinstr_commandを使う
+void instr_poll() {
+  instr_command(getchar_timeout_us(0));
+}
+#endif
+
+#endif
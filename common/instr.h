@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef INSTR_H
+#define INSTR_H
+
+// デバイスドライバーのI2C転送, 待機, PIOのFIFO待ちの回数, バイト数, 所要時間を, ドライバーと処理の種類ごとに記録する.
+// 所要時間は最大値, 合計と, 2のべき乗ごとの度数分布(ヒストグラム)にする.
+//
+// HAL_INSTRを1にしてビルドすると, hal.hのhal_関数が計測付きの関数に置き換わる. 0なら計測のコードは全て無くなる.
+// ドライバーは自身のヘッダーを読み込む前にHAL_DRIVERを定義して, どのドライバーの処理かを区別する.
+//   #define HAL_DRIVER INSTR_BME280  // 計測(common/instr.h)でのドライバーの番号
+//   #include "bme280.h"
+//
+// 時間の単位はINSTR_UNIT. Cortex-M33(RP2350)はDWTのサイクルカウンター, Cortex-M0+(RP2040)はタイマーの1us,
+// ホスト側は仮想的な時刻の1us. 記録は計測するコアで行い, 表示中に他のコアが更新することがあるので目安とする.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#ifndef HAL_INSTR
+#define HAL_INSTR 0  // 1でドライバーの処理を計測する. CMakeLists.txtでHAL_INSTR=1を定義してもよい
+#endif
+#define INSTR_BUCKETS 32  // ヒストグラムの区間の数. 区間kは2^(k-1)以上2^k未満. 0は所要時間0
+
+// -----------------
+
+// ドライバーの番号. HAL_DRIVERに指定する
+typedef enum {
+  INSTR_OTHER,  // HAL_DRIVERを定義していないソースファイル
+  INSTR_BME280,
+  INSTR_SCD41,
+  INSTR_TSL2572,
+  INSTR_LCDAQM,
+  INSTR_INFRARED,
+  INSTR_DRIVERS,
+} instr_driver_t;
+
+// 処理の種類
+typedef enum {
+  INSTR_I2C_WRITE,
+  INSTR_I2C_READ,
+  INSTR_SLEEP,     // sleep_msでの待機
+  INSTR_PIO_WAIT,  // PIOのFIFOに空きができるまでの待機を含む書き込み
+  INSTR_OPS,
+} instr_op_t;
+
+typedef struct {
+  uint32_t calls;                // 呼び出し回数
+  uint32_t bytes;                // 転送したバイト数
+  uint32_t errors;               // 失敗した転送の回数(NAK, タイムアウト)
+  uint32_t max;                  // 最大の所要時間[INSTR_UNIT]
+  uint64_t total;                // 所要時間の合計[INSTR_UNIT]
+  uint32_t hist[INSTR_BUCKETS];  // 所要時間のヒストグラム
+} instr_stats_t;
+
+#if HAL_INSTR
+
+#if defined(__ARM_ARCH_8M_MAIN__) && !defined(HAL_HOST)
+#include "hardware/structs/m33.h"
+#define INSTR_UNIT "cycles"
+
+// Returns: 現在のサイクル数
+static inline uint32_t instr_now() {
+  return m33_hw->dwt_cyccnt;
+}
+#elif !defined(HAL_HOST)
+#include "hardware/timer.h"
+#define INSTR_UNIT "us"
+
+static inline uint32_t instr_now() {
+  return time_us_32();
+}
+#else
+#define INSTR_UNIT "us"
+
+uint64_t hal_time_us_64();
+
+static inline uint32_t instr_now() {
+  return (uint32_t)hal_time_us_64();
+}
+#endif
+
+void instr_init();
+void instr_record(uint8_t driver, uint8_t op, uint32_t start, uint32_t bytes, bool ok);
+void instr_get(uint8_t driver, uint8_t op, instr_stats_t* stats);
+void instr_reset();
+uint64_t instr_us(uint64_t t);
+void instr_print();
+bool instr_command(int c);
+#ifndef HAL_HOST
+void instr_poll();
+#endif
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "numfmt.h"
+
+static const uint32_t pow10_table[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+// 空文字列にして0を返す
+static unsigned numfmt_fail(char* buf, unsigned size) {
+  if (size > 0) buf[0] = 0;
+  return 0;
+}
+
+// 符号, 整数部, 小数部をwidth文字に右詰めで書き込む
+//
+// Args:
+//   negative: 負の数ならtrue
+//   int_part: 整数部
+//   frac_part: 小数部. frac_digits桁
+//   frac_digits: 小数部の桁数. 0なら小数点を書かない
+//   width: 最小文字数. 足りない分はpadで埋める
+//   pad: ' 'なら符号の前, '0'なら符号の後を埋める
+static unsigned numfmt_compose(char* buf, unsigned size, bool negative, uint32_t int_part, uint32_t frac_part,
+                               unsigned frac_digits, unsigned width, char pad) {
+  char digits[10];  // 整数部を下の桁から格納. uint32_tは最大10桁
+  unsigned n_digits = 0;
+  do {
+    digits[n_digits++] = '0' + int_part % 10;
+    int_part /= 10;
+  } while (int_part);
+
+  unsigned len = (negative ? 1 : 0) + n_digits + (frac_digits ? 1 + frac_digits : 0);
+  unsigned total = len < width ? width : len;
+  if (total + 1 > size) return numfmt_fail(buf, size);
+
+  char* p = buf;
+  unsigned fill = total - len;
+  if (pad != '0') {
+    while (fill--) *p++ = pad;
+  }
+  if (negative) *p++ = '-';
+  if (pad == '0') {
+    while (fill--) *p++ = '0';
+  }
+  while (n_digits) *p++ = digits[--n_digits];
+  if (frac_digits) {
+    *p++ = '.';
+    for (unsigned i = frac_digits; i > 0; i--) {
+      *p++ = '0' + (frac_part / pow10_table[i - 1]) % 10;
+    }
+  }
+  *p = 0;
+  return total;
+}
+
+// 文字列をコピーする
+//
+// Returns: 書き込んだ文字数
+unsigned numfmt_str(char* buf, unsigned size, const char* str) {
+  unsigned n = 0;
+  while (str[n]) n++;
+  if (n + 1 > size) return numfmt_fail(buf, size);
+  for (unsigned i = 0; i <= n; i++) buf[i] = str[i];
+  return n;
+}
+
+// 符号なし整数を10進数で書き込む
+//
+// Args:
+//   buf: 書き込み先
+//   size: bufのバイト数. 終端のNULL文字を含む
+//   value: 値
+//   width: 最小文字数. 0なら詰めない
+//   pad: 足りない分を埋める文字. ' 'か'0'
+//
+// Returns: 書き込んだ文字数
+unsigned numfmt_uint(char* buf, unsigned size, uint32_t value, unsigned width, char pad) {
+  return numfmt_compose(buf, size, false, value, 0, 0, width, pad);
+}
+
+// 符号付き整数を10進数で書き込む. 引数はnumfmt_uintと同じ
+unsigned numfmt_int(char* buf, unsigned size, int32_t value, unsigned width, char pad) {
+  uint32_t abs_value = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  return numfmt_compose(buf, size, value < 0, abs_value, 0, 0, width, pad);
+}
+
+// 固定小数を書き込む. 表示桁数に合わせて四捨五入する.
+// 例: value=2345, scale=2 (0.01単位), frac_digits=1 なら "23.5"
+//
+// Args:
+//   buf: 書き込み先
+//   size: bufのバイト数. 終端のNULL文字を含む
+//   value: 10^-scale単位の値
+//   scale: valueの小数部の桁数. 0-9
+//   frac_digits: 表示する小数部の桁数. scale以下
+//   width: 最小文字数. 0なら詰めない
+//   pad: 足りない分を埋める文字. ' 'か'0'
+//
+// Returns: 書き込んだ文字数
+unsigned numfmt_fixed(char* buf, unsigned size, int32_t value, unsigned scale, unsigned frac_digits,
+                      unsigned width, char pad) {
+  if (scale > 9 || frac_digits > scale) return numfmt_fail(buf, size);
+
+  bool negative = value < 0;
+  uint32_t abs_value = negative ? 0u - (uint32_t)value : (uint32_t)value;
+
+  // 表示しない桁を四捨五入で落とす
+  uint32_t drop = pow10_table[scale - frac_digits];
+  uint32_t rounded = abs_value / drop;
+  if (abs_value % drop >= (drop + 1) / 2 && drop > 1) rounded++;
+
+  uint32_t unit = pow10_table[frac_digits];
+  uint32_t int_part = rounded / unit;
+  uint32_t frac_part = rounded % unit;
+  if (int_part == 0 && frac_part == 0) negative = false;  // "-0.0"にしない
+  return numfmt_compose(buf, size, negative, int_part, frac_part, frac_digits, width, pad);
+}
+
+// 16進数(大文字)で書き込む
+//
+// Args:
+//   buf: 書き込み先
+//   size: bufのバイト数. 終端のNULL文字を含む
+//   value: 値
+//   digits: 最小桁数. 足りない分は0で埋める
+//
+// Returns: 書き込んだ文字数
+unsigned numfmt_hex(char* buf, unsigned size, uint32_t value, unsigned digits) {
+  unsigned n = 1;
+  while (n < 8 && (value >> (n * 4))) n++;
+  if (n < digits) n = digits;
+  if (n + 1 > size) return numfmt_fail(buf, size);
+  for (unsigned i = 0; i < n; i++) {
+    unsigned pos = n - 1 - i;  // 下から何桁目か
+    uint32_t d = pos < 8 ? (value >> (pos * 4)) & 0xF : 0;
+    buf[i] = d < 10 ? '0' + d : 'A' + d - 10;
+  }
+  buf[n] = 0;
+  return n;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef NUMFMT_H
+#define NUMFMT_H
+
+// 整数, 固定小数の数値を文字列に変換する.
+// printfを使わず, ヒープも可変長引数も使用しない. 変換先は呼び出し側のバッファー.
+//
+// 各関数は書き込んだ文字数(終端のNULL文字を除く)を返すので, 続けて書き込む場合は戻り値だけポインターを進める.
+//   char buf[32];
+//   uint n = numfmt_str(buf, sizeof(buf), "Temp : ");
+//   n += numfmt_fixed(buf + n, sizeof(buf) - n, 2345, 2, 1, 0, ' ');  // "23.5"
+// バッファーが足りない場合は何も書き込まず0を返す(bufが1バイト以上あれば空文字列にする).
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+unsigned numfmt_str(char* buf, unsigned size, const char* str);
+unsigned numfmt_uint(char* buf, unsigned size, uint32_t value, unsigned width, char pad);
+unsigned numfmt_int(char* buf, unsigned size, int32_t value, unsigned width, char pad);
+unsigned numfmt_fixed(char* buf, unsigned size, int32_t value, unsigned scale, unsigned frac_digits,
+                      unsigned width, char pad);
+unsigned numfmt_hex(char* buf, unsigned size, uint32_t value, unsigned digits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pioinput.h"
+
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "pioinput.pio.h"
+
+#define PIOINPUT_CYCLES_PER_SAMPLE 8  // pioinput.pioの1サンプルあたりのサイクル数
+
+// 登録したピン1つ分の状態
+typedef struct {
+  uint8_t pin;
+  PIO pio;
+  uint sm;
+  uint offset;
+  pioinput_callback_t callback;
+  volatile bool level;  // 確定したレベル
+  uint64_t start_us;    // サンプル番号0の時刻
+  uint32_t last_index;  // 前回受け取ったサンプル番号(31bit)
+  uint64_t index_high;  // サンプル番号の桁あふれ分
+} pioinput_t;
+
+static pioinput_t inputs[PIOINPUT_MAX];
+static uint input_count = 0;
+static uint32_t pio_irq_added = 0;  // 割り込みハンドラーを登録したPIOのビットマスク
+
+static void pioinput_irq_handler() {
+  for (uint i = 0; i < input_count; i++) {
+    pioinput_t* in = &inputs[i];
+    while (!pio_sm_is_rx_fifo_empty(in->pio, in->sm)) {
+      uint32_t word = pio_sm_get(in->pio, in->sm);
+      uint32_t index = word >> 1;
+
+      // 31bitのサンプル番号を64bitに拡張する. 変化の間隔が2^31サンプル未満であれば正しく動作する
+      if (index < in->last_index) in->index_high += 1u << 31;
+      in->last_index = index;
+      uint64_t first = in->index_high + index - (PIOINPUT_STABLE_SAMPLES - 1);  // 新しいレベルの最初のサンプル
+
+      in->level = word & 1;
+      if (in->callback) in->callback(in->pin, in->level, in->start_us + first * PIOINPUT_SAMPLE_US);
+    }
+  }
+}
+
+// 同じPIOで動作中のpioinputがあれば, そのプログラムを共有してステートマシンだけ割り当てる.
+// なければ空きのあるPIOにプログラムを追加する.
+static bool pioinput_claim(pioinput_t* in) {
+  for (uint i = 0; i < input_count; i++) {
+    int sm = pio_claim_unused_sm(inputs[i].pio, false);
+    if (sm >= 0) {
+      in->pio = inputs[i].pio;
+      in->sm = sm;
+      in->offset = inputs[i].offset;
+      return true;
+    }
+  }
+  return pio_claim_free_sm_and_add_program_for_gpio_range(&pioinput_program, &in->pio, &in->sm, &in->offset,
+                                                          in->pin, 1, true);
+}
+
+// ピンを登録し, PIOによるサンプリングを開始する.
+// ピンのプルアップ, プルダウンは呼び出し側で設定すること.
+//
+// Args:
+//   pin: GPIO番号
+//   callback: 変化を確定した時に割り込みから呼ばれる関数. NULLならpioinput_levelで状態を読むだけ.
+//
+// Returns: 成功でtrue. 登録数がPIOINPUT_MAXを超えるか, PIOに空きがない場合false.
+bool pioinput_add(uint pin, pioinput_callback_t callback) {
+  if (input_count >= PIOINPUT_MAX) return false;
+  pioinput_t* in = &inputs[input_count];
+  in->pin = pin;
+  if (!pioinput_claim(in)) return false;
+
+  gpio_init(pin);  // 入力を有効化. プルアップ, プルダウンは変更されない
+  pio_sm_config c = pioinput_program_get_default_config(in->offset);
+  sm_config_set_jmp_pin(&c, pin);
+  sm_config_set_in_shift(&c, false, false, 32);
+  sm_config_set_clkdiv(&c, ((float)clock_get_hz(clk_sys)) * PIOINPUT_SAMPLE_US / 1000000 /
+                               PIOINPUT_CYCLES_PER_SAMPLE);  // 8サイクル/サンプル
+  pio_sm_init(in->pio, in->sm, in->offset, &c);
+  pio_sm_set_consecutive_pindirs(in->pio, in->sm, pin, 1, false);
+  pio_sm_put(in->pio, in->sm, PIOINPUT_STABLE_SAMPLES - 2);  // 変化を確定する連続サンプル数をPIOプログラムへ送信
+
+  in->callback = callback;
+  in->level = gpio_get(pin);
+  in->last_index = 0;
+  in->index_high = 0;
+
+  // RX FIFOにデータが入ったら割り込み. PIOごとに1回だけハンドラーを登録する
+  uint pio_index = pio_get_index(in->pio);
+  uint irq_num = pio_get_irq_num(in->pio, 0);
+  if (!(pio_irq_added & (1u << pio_index))) {
+    irq_add_shared_handler(irq_num, pioinput_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(irq_num, true);
+    pio_irq_added |= 1u << pio_index;
+  }
+  pio_set_irqn_source_enabled(in->pio, 0, pio_get_rx_fifo_not_empty_interrupt_source(in->sm), true);
+
+  input_count++;
+  in->start_us = time_us_64();
+  pio_sm_set_enabled(in->pio, in->sm, true);
+  return true;
+}
+
+// 確定したレベル
+//
+// Returns: Highならtrue. 登録していないピンはfalse.
+bool pioinput_level(uint pin) {
+  for (uint i = 0; i < input_count; i++) {
+    if (inputs[i].pin == pin) return inputs[i].level;
+  }
+  return false;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef PIOINPUT_H
+#define PIOINPUT_H
+
+// PIOによる入力ピンのサンプリングとチャタリング除去.
+// ピンごとにPIOのステートマシンを1つ使い, PIOINPUT_SAMPLE_USおきに読み出す.
+// 新しいレベルがPIOINPUT_STABLE_SAMPLES回連続した時だけ, 変化を確定したサンプル番号をRX FIFOへ送る.
+// CPUはRX FIFOの割り込みで変化を受け取るだけなので, チャタリング除去の処理時間はかからず, 遅延も一定になる.
+// 変化の時刻はサンプル番号から計算するので, 割り込みの遅延に影響されない.
+//
+// RP2350ではErrata RP2350-E9により, 内蔵プルダウンで保持されたピンの入力を有効にし続けると電圧が上昇してHighに固定される.
+// PIOは入力を常時有効にする必要があるので, 内蔵プルダウンは使わずにプルアップか外部の駆動でピンのレベルを決めること.
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#define PIOINPUT_SAMPLE_US 1000     // サンプリング周期[us]. 3000以下
+#define PIOINPUT_STABLE_SAMPLES 20  // 変化を確定する連続サンプル数. 2以上
+#define PIOINPUT_MAX 4              // 登録できるピンの数
+
+// -----------------
+
+// 変化を確定した時に割り込みから呼ばれる関数
+//
+// Args:
+//   pin: GPIO番号
+//   level: 新しいレベル
+//   time_us: 新しいレベルになった最初のサンプルの時刻[us]. time_us_64()と同じ基準
+typedef void (*pioinput_callback_t)(uint pin, bool level, uint64_t time_us);
+
+bool pioinput_add(uint pin, pioinput_callback_t callback);
+bool pioinput_level(uint pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
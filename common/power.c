@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "power.h"
+
+#include <stdio.h>
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/pll.h"
+#include "hardware/sync.h"
+#include "hardware/xosc.h"
+#if PICO_RP2350
+#include "hardware/powman.h"
+#include "hardware/structs/timer.h"
+#include "pico/aon_timer.h"
+#endif
+
+// 復帰用のGPIO
+typedef struct {
+  uint pin;
+  uint32_t events;  // GPIO_IRQ_xの組み合わせ
+  power_fn_t fn;    // エッジで呼ぶ関数. NULLなら他のドライバーが割り込みを処理する
+  void* arg;
+} power_pin_t;
+
+static power_pin_t power_pins[POWER_MAX_WAKE_PINS];
+static uint power_pin_count = 0;
+static uint32_t power_irq_mask = 0;  // fnを指定したピンのビットマスク
+static power_state_t power_max_state = POWER_SLEEP;
+static power_fn_t power_resume_fn = NULL;
+static void* power_resume_arg = NULL;
+static uint32_t power_sys_khz = 0;   // 復帰時に戻すclk_sysの周波数[kHz]
+static uint64_t power_start_us = 0;  // power_initの時刻
+static power_stats_t power_stats;
+static volatile bool power_alarm_fired = false;
+
+static const char* const power_state_names[POWER_STATES] = {"run", "sleep", "deep", "dormant"};
+
+// power_add_wake_pinでfnを指定したピンのエッジを消去し, fnを呼ぶ
+static void power_gpio_irq_handler() {
+  for (uint i = 0; i < power_pin_count; i++) {
+    power_pin_t* p = &power_pins[i];
+    if (!p->fn) continue;
+    uint32_t events = gpio_get_irq_event_mask(p->pin) & p->events;
+    if (!events) continue;
+    gpio_acknowledge_irq(p->pin, events);
+    power_stats.pin_wakes++;
+    p->fn(p->arg);
+  }
+}
+
+static int64_t power_alarm_callback(alarm_id_t id, void* arg) {
+  power_alarm_fired = true;
+  return 0;  // __wfi()から復帰させるだけ
+}
+
+// 待機の準備. 待機中に呼ぶ関数を登録する前に呼ぶ.
+//
+// Args:
+//   max_state: 使用する最も深い状態. もう一方のコアを動かす場合はPOWER_SLEEP.
+//              USBシリアルを使うビルドでは常にPOWER_SLEEPまで
+//   resume: DEEP_SLEEP, DORMANTから復帰し, クロックを戻した後に呼ぶ関数. PIOの再開など. 不要ならNULL
+//   arg: resumeへ渡す値
+void power_init(power_state_t max_state, power_fn_t resume, void* arg) {
+#if LIB_PICO_STDIO_USB
+  if (max_state > POWER_SLEEP) max_state = POWER_SLEEP;
+#endif
+  power_max_state = max_state;
+  power_resume_fn = resume;
+  power_resume_arg = arg;
+  power_sys_khz = clock_get_hz(clk_sys) / 1000;
+  power_start_us = time_us_64();
+  power_stats = (power_stats_t){0};
+#if PICO_RP2350
+  if (max_state >= POWER_DORMANT && !aon_timer_is_running()) {
+    struct timespec ts = {0, 0};
+    aon_timer_start(&ts);
+  }
+  powman_timer_set_1khz_tick_source_lposc();  // XOSCを止めてもAONタイマーが進むようにする
+#endif
+}
+
+// 待機から復帰させるGPIOを登録する. ピンの入力の設定(gpio_init, プルアップなど)は呼び出し側で行う.
+//
+// Args:
+//   pin: GPIO番号
+//   events: 復帰させるエッジ. GPIO_IRQ_EDGE_FALL, GPIO_IRQ_EDGE_RISEの組み合わせ
+//   fn: エッジで割り込みから呼ぶ関数. エッジの消去はこのモジュールで行う.
+//       NULLならpirやbuttonなど他のドライバーが割り込みを処理するピンとし, DORMANTからの復帰だけに使う
+//   arg: fnへ渡す値
+//
+// Returns: 成功でtrue. 登録数がPOWER_MAX_WAKE_PINSを超える場合はfalse
+bool power_add_wake_pin(uint pin, uint32_t events, power_fn_t fn, void* arg) {
+  if (power_pin_count >= POWER_MAX_WAKE_PINS) return false;
+  power_pins[power_pin_count++] = (power_pin_t){pin, events, fn, arg};
+  if (!fn) return true;
+
+  // 登録済みのピンとまとめて1つのハンドラーで処理する
+  if (power_irq_mask) gpio_remove_raw_irq_handler_masked(power_irq_mask, power_gpio_irq_handler);
+  power_irq_mask |= 1u << pin;
+  gpio_acknowledge_irq(pin, events);
+  gpio_add_raw_irq_handler_masked(power_irq_mask, power_gpio_irq_handler);
+  gpio_set_irq_enabled(pin, events, true);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+  return true;
+}
+
+// clk_sysをclk_ref(XOSC)に切り替え, PLL_SYSを止める. clk_periもclk_sysと同じく遅くなる
+static void power_clocks_slow() {
+  uint32_t ref_hz = clock_get_hz(clk_ref);
+  clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF, 0, ref_hz, ref_hz);
+  pll_deinit(pll_sys);
+}
+
+// PLL_SYSを再ロックし, clk_sysとclk_periを元の周波数に戻す
+static void power_clocks_restore() {
+  set_sys_clock_khz(power_sys_khz, true);
+}
+
+#if PICO_RP2350
+static void power_aon_alarm_callback() {
+  power_alarm_fired = true;
+}
+
+static int64_t power_aon_us(const struct timespec* ts) {
+  return (int64_t)ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+#endif
+
+// XOSCを止めて待機する. 割り込みを止めて呼ぶ
+//
+// Args:
+//   until: 復帰する時刻. timedがfalseならGPIOのエッジまで待つ
+//   timed: 時刻を指定した待機ならtrue. RP2040ではfalseのみ
+//   restore_us: クロックを戻すのにかかった時間[us]の格納先
+//
+// Returns: 待機した時間[us]. RP2040はタイマーが止まるため0
+static uint64_t power_dormant(absolute_time_t until, bool timed, uint32_t* restore_us) {
+  for (uint i = 0; i < power_pin_count; i++) {
+    gpio_set_dormant_irq_enabled(power_pins[i].pin, power_pins[i].events, true);
+  }
+  uint64_t before = time_us_64();
+#if PICO_RP2350
+  struct timespec aon_before;
+  aon_timer_get_time(&aon_before);
+  if (timed) {
+    int64_t at = power_aon_us(&aon_before) + absolute_time_diff_us(get_absolute_time(), until);
+    struct timespec ts = {(time_t)(at / 1000000), (long)(at % 1000000) * 1000};
+    aon_timer_enable_alarm(&ts, power_aon_alarm_callback, true);
+  }
+#endif
+
+  power_clocks_slow();
+  xosc_dormant();  // GPIOのエッジかAONタイマーのアラームまで止まる
+  uint64_t woke = time_us_64();
+  power_clocks_restore();
+  *restore_us = (uint32_t)(time_us_64() - woke);
+
+  for (uint i = 0; i < power_pin_count; i++) {
+    gpio_set_dormant_irq_enabled(power_pins[i].pin, power_pins[i].events, false);
+  }
+  uint64_t slept = woke - before;
+#if PICO_RP2350
+  if (timed) aon_timer_disable_alarm();
+  struct timespec aon_after;
+  aon_timer_get_time(&aon_after);
+  int64_t aon_us = power_aon_us(&aon_after) - power_aon_us(&aon_before);
+  int64_t timer_us = (int64_t)(time_us_64() - before);
+  if (aon_us > timer_us) {
+    // 止まっていた間の時間だけタイマーを進める. 時刻を飛ばしたアラームは発火しないので,
+    // デフォルトのアラームプールの割り込みを起こして期限の過ぎたアラームを処理させる
+    uint64_t t = time_us_64() + (uint64_t)(aon_us - timer_us);
+    timer_hw->timelw = (uint32_t)t;
+    timer_hw->timehw = (uint32_t)(t >> 32);
+    hardware_alarm_force_irq(alarm_pool_hardware_alarm_num(alarm_pool_get_default()));
+    slept = (uint64_t)aon_us;
+  }
+#endif
+  return slept;
+}
+
+// untilまで, もしくはGPIOなどの割り込みがあるまで待機する. 待ち時間が長いほど深い状態を使う.
+// sched_set_idleに渡すと, スケジューラーが次のタスクまで待機する間に呼ばれる.
+//
+// Args:
+//   until: 復帰する時刻. at_the_end_of_timeならGPIOのエッジまで待つ
+void power_wait_until(absolute_time_t until) {
+  uint64_t start = time_us_64();
+  uint64_t target = to_us_since_boot(until);
+  if (target <= start) return;
+  bool timed = !is_at_the_end_of_time(until);
+
+  uint64_t wait = target - start;
+  power_state_t state = POWER_SLEEP;
+  if (wait >= POWER_DORMANT_MIN_US) {
+    state = POWER_DORMANT;
+  } else if (wait >= POWER_DEEP_SLEEP_MIN_US) {
+    state = POWER_DEEP_SLEEP;
+  }
+#if !PICO_RP2350
+  if (state == POWER_DORMANT && timed) state = POWER_DEEP_SLEEP;  // RP2040はXOSCを止めるとタイマーで復帰できない
+#endif
+  if (state > power_max_state) state = power_max_state;
+  if (state > POWER_SLEEP) stdio_flush();  // clk_periが変わる前にUARTの出力を送り切る
+
+  alarm_id_t alarm = 0;
+  power_alarm_fired = false;
+  if (timed && state != POWER_DORMANT) {
+    alarm = add_alarm_at(until, power_alarm_callback, NULL, false);
+    if (alarm < 0) {  // アラームの空きがない
+      sleep_until(until);
+      return;
+    }
+    if (alarm == 0) return;  // 時刻を過ぎた
+  }
+
+  // 確認から__wfi()までの間に割り込みが来ると次の割り込みまで起きないので, 割り込みを止めて確認する.
+  // 割り込みを止めていても, 保留中の割り込みがあれば__wfi()は復帰する.
+  uint64_t slept = 0;
+  uint32_t restore_us = 0;
+  bool entered = false;
+  uint32_t status = save_and_disable_interrupts();
+  if (!power_alarm_fired) {
+    entered = true;
+    uint64_t before = time_us_64();
+    switch (state) {
+      case POWER_SLEEP:
+        __wfi();
+        slept = time_us_64() - before;
+        break;
+      case POWER_DEEP_SLEEP: {
+        power_clocks_slow();
+        __wfi();
+        uint64_t woke = time_us_64();
+        power_clocks_restore();
+        restore_us = (uint32_t)(time_us_64() - woke);
+        slept = woke - before;
+        break;
+      }
+      default:
+        slept = power_dormant(until, timed, &restore_us);
+        break;
+    }
+  }
+  restore_interrupts(status);  // 復帰の原因の割り込みはここで処理される
+  if (alarm > 0) cancel_alarm(alarm);
+  if (!entered) return;
+
+  if (state > POWER_SLEEP && power_resume_fn) power_resume_fn(power_resume_arg);
+  power_state_stats_t* s = &power_stats.states[state];
+  s->entries++;
+  s->time_us += slept;
+  if (restore_us > s->max_restore_us) s->max_restore_us = restore_us;
+  uint64_t now = time_us_64();
+  if (timed && now >= target) {
+    power_stats.timer_wakes++;
+    if (now - target > power_stats.max_late_us) power_stats.max_late_us = (uint32_t)(now - target);
+  } else {
+    power_stats.early_wakes++;
+  }
+}
+
+// 統計情報を読み出す. POWER_RUNの時間はpower_initからの時間のうち待機していない時間, 回数は待機から復帰した回数
+//
+// Args:
+//   stats: 統計情報の格納先
+void power_get_stats(power_stats_t* stats) {
+  *stats = power_stats;
+  uint64_t idle = 0;
+  for (uint i = POWER_SLEEP; i < POWER_STATES; i++) idle += stats->states[i].time_us;
+  uint64_t total = time_us_64() - power_start_us;
+  stats->states[POWER_RUN].time_us = total > idle ? total - idle : 0;
+  stats->states[POWER_RUN].entries = stats->timer_wakes + stats->early_wakes;  // 待機から復帰した回数
+}
+
+// 状態ごとの回数, 時間と割合, 復帰の時間を表示する
+void power_print() {
+  power_stats_t stats;
+  power_get_stats(&stats);
+  uint64_t total = 0;
+  for (uint i = 0; i < POWER_STATES; i++) total += stats.states[i].time_us;
+  for (uint i = 0; i < POWER_STATES; i++) {
+    const power_state_stats_t* s = &stats.states[i];
+    uint32_t permille = total ? (uint32_t)((s->time_us * 1000 + total / 2) / total) : 0;
+    printf("power %-8s entries %lu time %llu[ms] %lu.%lu%% restore %lu[us]\n", power_state_names[i],
+           (unsigned long)s->entries, (unsigned long long)(s->time_us / 1000), (unsigned long)(permille / 10),
+           (unsigned long)(permille % 10), (unsigned long)s->max_restore_us);
+  }
+  printf("power wake timer %lu early %lu pin %lu late %lu[us]\n", (unsigned long)stats.timer_wakes,
+         (unsigned long)stats.early_wakes, (unsigned long)stats.pin_wakes, (unsigned long)stats.max_late_us);
+}
+
+// Returns: 状態の表示用の名前
+const char* power_state_name(power_state_t state) {
+  return state < POWER_STATES ? power_state_names[state] : "?";
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+// 次の処理の時刻まで, 待ち時間に応じた低消費電力の状態で待機する. sched_set_idleに渡して使う.
+//
+//   POWER_SLEEP:      __wfi()でコアを止める. クロックはそのまま. 復帰は割り込みの処理時間だけ
+//   POWER_DEEP_SLEEP: clk_sysをXOSC(12MHz)に切り替えてPLL_SYSを止め, __wfi()で待つ. 復帰時にPLLを再ロックする
+//   POWER_DORMANT:    XOSCも止める. タイマーも止まるので, 時刻はAONタイマー(RP2350)で測って進める
+//
+// どの状態もタイマーのアラームと, power_add_wake_pinで登録したGPIOのエッジで復帰する.
+// DORMANTはRP2350ではAONタイマーのアラームでも復帰するが, RP2040はタイマーで復帰できないので
+// 時刻を指定した待機ではDEEP_SLEEPまでとする.
+//
+// DEEP_SLEEP, DORMANTの間はclk_peri(UART, I2C, SPI)とPIOも遅くなるか止まる. 待機の前にstdioの出力を送り切り,
+// 復帰後にpower_initで指定した関数を呼ぶので, PIOの受信など途中の処理はそこでやり直す.
+// USBシリアル(LIB_PICO_STDIO_USB)はSDKが1msおきにアラームで処理し, USBのクロックも止められないため,
+// USBシリアルを使うビルドではSLEEPだけを使う. 電池で動かす場合はUARTのstdioにする.
+//
+// 待機はpower_wait_untilを呼んだコアだけで行う. もう一方のコアを動かしている場合はDEEP_SLEEP, DORMANTを使えないので,
+// power_initのmax_stateでPOWER_SLEEPを指定する.
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#define POWER_DEEP_SLEEP_MIN_US 5000  // DEEP_SLEEPにする最短の待ち時間[us]. PLLの再ロックより十分長くする
+#define POWER_DORMANT_MIN_US 200000   // DORMANTにする最短の待ち時間[us]. XOSCの起動とAONタイマーの分解能(1ms)より十分長くする
+#define POWER_MAX_WAKE_PINS 4         // 登録できる復帰用のGPIOの数
+
+// -----------------
+
+typedef enum {
+  POWER_RUN,         // 処理中
+  POWER_SLEEP,       // __wfi()
+  POWER_DEEP_SLEEP,  // PLL_SYSを止めて__wfi()
+  POWER_DORMANT,     // XOSCを止める
+  POWER_STATES,
+} power_state_t;
+
+// 復帰後に呼ぶ関数. 割り込みから呼ぶ場合もある
+typedef void (*power_fn_t)(void* arg);
+
+typedef struct {
+  uint32_t entries;         // 入った回数
+  uint64_t time_us;         // 合計時間[us]. POWER_RUNは待機以外の時間
+  uint32_t max_restore_us;  // 復帰からクロックと周辺機能を戻すまでの最大時間[us]
+} power_state_stats_t;
+
+typedef struct {
+  power_state_stats_t states[POWER_STATES];
+  uint32_t timer_wakes;  // 予定の時刻で復帰した回数
+  uint32_t early_wakes;  // 予定の時刻より前にGPIOや他の割り込みで復帰した回数
+  uint32_t pin_wakes;    // power_add_wake_pinのピンのエッジの回数
+  uint32_t max_late_us;  // 予定の時刻から処理を再開するまでの最大時間[us]. 復帰の遅れ
+} power_stats_t;
+
+void power_init(power_state_t max_state, power_fn_t resume, void* arg);
+bool power_add_wake_pin(uint pin, uint32_t events, power_fn_t fn, void* arg);
+void power_wait_until(absolute_time_t until);
+void power_get_stats(power_stats_t* stats);
+void power_print();
+const char* power_state_name(power_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
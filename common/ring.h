@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RING_H
+#define RING_H
+
+// 書き込み側1つ, 読み出し側1つ(SPSC)のロックフリーなリングバッファー.
+// 割り込みハンドラーからメインループへ, もしくはコア間でデータを受け渡す.
+// 書き込み側はring_push, 読み出し側はring_pop, ring_peekのみを呼ぶこと.
+//
+//   static button_event_t buf[16];  // 要素数は2のべき乗
+//   static ring_t ring = RING_INIT(buf);
+//
+// headは書き込み側だけ, tailは読み出し側だけが更新する. 要素のコピーと位置の更新の間にメモリーバリアを入れるので,
+// 割り込み禁止やスピンロックなしで別のコアとも受け渡しができる.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  void* buf;                // 要素の格納バッファー
+  uint32_t elem_size;       // 1要素のバイト数
+  uint32_t mask;            // 要素数-1. 要素数は2のべき乗
+  volatile uint32_t head;   // 書き込んだ要素の累計. 書き込み側のみ更新
+  volatile uint32_t tail;   // 読み出した要素の累計. 読み出し側のみ更新
+  volatile uint32_t drops;  // 満杯で書き込めなかった要素の累計. 書き込み側のみ更新
+} ring_t;
+
+// 配列bufを格納バッファーとするring_tの初期値. bufの要素数は2のべき乗にすること.
+#define RING_INIT(array) {(array), sizeof((array)[0]), sizeof(array) / sizeof((array)[0]) - 1, 0, 0, 0}
+
+// 格納バッファーを指定してリングバッファーを初期化する. 書き込み側, 読み出し側とも動作していない時に呼ぶこと.
+//
+// Args:
+//   r: リングバッファー
+//   buf: 格納バッファー
+//   elem_size: 1要素のバイト数
+//   length: 要素数. 2のべき乗
+static inline void ring_init(ring_t* r, void* buf, uint32_t elem_size, uint32_t length) {
+  r->buf = buf;
+  r->elem_size = elem_size;
+  r->mask = length - 1;
+  r->head = 0;
+  r->tail = 0;
+  r->drops = 0;
+}
+
+// 格納されている要素数
+static inline uint32_t ring_count(const ring_t* r) {
+  return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+// 要素を1つ書き込む. 書き込み側のみ呼ぶこと.
+//
+// Returns: 成功でtrue. 満杯ならfalseで, dropsを1増やす.
+static inline bool ring_push(ring_t* r, const void* elem) {
+  uint32_t head = r->head;
+  if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > r->mask) {
+    r->drops++;
+    return false;
+  }
+  memcpy((uint8_t*)r->buf + (head & r->mask) * r->elem_size, elem, r->elem_size);
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);  // 要素のコピー完了後に公開する
+  return true;
+}
+
+// 先頭の要素を取り出さずに読み出す. 読み出し側のみ呼ぶこと.
+//
+// Returns: 要素があればtrue
+static inline bool ring_peek(ring_t* r, void* elem) {
+  uint32_t tail = r->tail;
+  if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) return false;
+  memcpy(elem, (const uint8_t*)r->buf + (tail & r->mask) * r->elem_size, r->elem_size);
+  return true;
+}
+
+// 先頭の要素を取り出す. 読み出し側のみ呼ぶこと.
+//
+// Args:
+//   r: リングバッファー
+//   elem: 要素の格納先. NULLなら読み捨てる
+//
+// Returns: 要素があればtrue
+static inline bool ring_pop(ring_t* r, void* elem) {
+  uint32_t tail = r->tail;
+  if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) return false;
+  if (elem) memcpy(elem, (const uint8_t*)r->buf + (tail & r->mask) * r->elem_size, r->elem_size);
+  __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);  // 読み出し完了後に領域を解放する
+  return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
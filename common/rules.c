@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "rules.h"
+
+// ルール1つ分の状態
+typedef struct {
+  uint8_t raw;                      // 条件ごとの成立状態(ヒステリシス適用後)のビット
+  bool active;                      // 全ての条件を満たしている
+  uint32_t since[RULES_MAX_CONDS];  // 条件が成立した時刻[ms]
+  uint32_t deadline;                // 継続時間の判定が必要な時刻[ms]
+} rules_state_t;
+
+static const rules_rule_t* rules_table = 0;
+static uint32_t rules_count = 0;
+static int32_t rules_values[RULES_INPUT_MAX];
+static uint32_t rules_valid = 0;                     // 値が入力済みの入力のビット
+static uint32_t rules_input_rules[RULES_INPUT_MAX];  // 入力ごとに, 参照するルールのビット
+static rules_state_t rules_states[RULES_MAX];
+static uint32_t rules_timer_mask = 0;                // 継続時間の判定待ちのルールのビット
+static uint32_t rules_eval_count = 0;
+
+// 条件の成立状態を, 入力値とヒステリシスから更新する
+static bool rules_cond_raw(const rules_cond_t* c, bool prev) {
+  if (!(rules_valid & (1u << c->input))) return false;
+  int32_t v = rules_values[c->input];
+  if (c->op == RULES_GT) return prev ? v > c->threshold - c->hysteresis : v > c->threshold;
+  return prev ? v < c->threshold + c->hysteresis : v < c->threshold;
+}
+
+// ルールを評価し, 満たす状態が変わればactionを呼ぶ
+//
+// Args:
+//   i: ルール番号
+//   input: 変化した入力番号. 継続時間の判定のみの場合はRULES_INPUT_MAX
+//   now: 現在時刻[ms]
+static void rules_eval(uint32_t i, uint32_t input, uint32_t now) {
+  const rules_rule_t* r = &rules_table[i];
+  rules_state_t* st = &rules_states[i];
+  rules_eval_count++;
+
+  bool all = true;
+  uint32_t wait = UINT32_MAX;  // 継続時間を満たすまでの最短時間
+  for (uint32_t c = 0; c < r->n_cond; c++) {
+    const rules_cond_t* cond = &r->cond[c];
+    uint8_t bit = 1u << c;
+    if (cond->input == input) {
+      bool raw = rules_cond_raw(cond, st->raw & bit);
+      if (raw && !(st->raw & bit)) st->since[c] = now;
+      st->raw = raw ? (st->raw | bit) : (st->raw & ~bit);
+    }
+    if (!(st->raw & bit)) {
+      all = false;
+      continue;
+    }
+    uint32_t elapsed = now - st->since[c];
+    if (elapsed < cond->hold_ms) {
+      all = false;
+      if (cond->hold_ms - elapsed < wait) wait = cond->hold_ms - elapsed;
+    }
+  }
+
+  if (wait != UINT32_MAX) {
+    st->deadline = now + wait;
+    rules_timer_mask |= 1u << i;
+  } else {
+    rules_timer_mask &= ~(1u << i);
+  }
+
+  if (all != st->active) {
+    st->active = all;
+    if (r->action) r->action(r->arg, all);
+  }
+}
+
+// ルールのテーブルを登録し, 全ての状態を初期化する. 全ての条件は入力されるまで不成立.
+//
+// Args:
+//   table: ルールのテーブル. 登録後も保持すること
+//   n: ルールの数
+//
+// Returns: 成功でtrue. ルールの数か入力番号, 条件の数が範囲外ならfalse.
+bool rules_init(const rules_rule_t* table, uint32_t n) {
+  if (n > RULES_MAX) return false;
+  for (uint32_t i = 0; i < RULES_INPUT_MAX; i++) rules_input_rules[i] = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    if (table[i].n_cond == 0 || table[i].n_cond > RULES_MAX_CONDS) return false;
+    for (uint32_t c = 0; c < table[i].n_cond; c++) {
+      if (table[i].cond[c].input >= RULES_INPUT_MAX) return false;
+      rules_input_rules[table[i].cond[c].input] |= 1u << i;
+    }
+    rules_states[i] = (rules_state_t){0};
+  }
+  rules_table = table;
+  rules_count = n;
+  rules_valid = 0;
+  rules_timer_mask = 0;
+  rules_eval_count = 0;
+  return true;
+}
+
+// 入力の値を更新し, その入力を参照するルールを評価する. 値が変わらない場合は評価しない.
+//
+// Args:
+//   input: 入力番号
+//   value: 値. 単位はテーブルのthresholdと合わせる
+//   now_ms: 現在時刻[ms]
+void rules_update(uint32_t input, int32_t value, uint32_t now_ms) {
+  if (input >= RULES_INPUT_MAX) return;
+  uint32_t bit = 1u << input;
+  if ((rules_valid & bit) && rules_values[input] == value) return;
+  rules_values[input] = value;
+  rules_valid |= bit;
+
+  uint32_t mask = rules_input_rules[input];
+  while (mask) {
+    uint32_t i = __builtin_ctz(mask);
+    mask &= mask - 1;
+    rules_eval(i, input, now_ms);
+  }
+}
+
+// 継続時間の判定時刻になったルールを評価する
+//
+// Args:
+//   now_ms: 現在時刻[ms]
+void rules_poll(uint32_t now_ms) {
+  uint32_t mask = rules_timer_mask;
+  while (mask) {
+    uint32_t i = __builtin_ctz(mask);
+    mask &= mask - 1;
+    if ((int32_t)(now_ms - rules_states[i].deadline) >= 0) rules_eval(i, RULES_INPUT_MAX, now_ms);
+  }
+}
+
+// 次にrules_pollを呼ぶ必要がある時刻までの時間
+//
+// Args:
+//   now_ms: 現在時刻[ms]
+//
+// Returns: 時間[ms]. 0ならすぐに呼ぶ. 判定待ちがなければUINT32_MAX
+uint32_t rules_time_to_next(uint32_t now_ms) {
+  uint32_t next = UINT32_MAX;
+  uint32_t mask = rules_timer_mask;
+  while (mask) {
+    uint32_t i = __builtin_ctz(mask);
+    mask &= mask - 1;
+    int32_t remain = (int32_t)(rules_states[i].deadline - now_ms);
+    if (remain <= 0) return 0;
+    if ((uint32_t)remain < next) next = remain;
+  }
+  return next;
+}
+
+// ルールが全ての条件を満たしているか
+bool rules_active(uint32_t rule) {
+  return rule < rules_count && rules_states[rule].active;
+}
+
+// ルールを評価した累計回数
+uint32_t rules_evaluations() {
+  return rules_eval_count;
+}
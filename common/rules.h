@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+// センサーの値からアクチュエーターを動かすルールエンジン.
+// ルールはconstのテーブルとしてあらかじめ記述し(フラッシュに配置される), rules_initで登録する.
+//
+//   // CO2が1000ppmを超えた状態が60秒続いたらリレーON. 900ppmを下回ったらOFF.
+//   // 10分間検知なし, かつ明るさが50lux超ならIR送信.
+//   static const rules_rule_t table[] = {
+//     {{RULES_COND(IN_CO2, RULES_GT, 1000, 100, 60000)}, 1, relay_action, 0},
+//     {{RULES_COND(IN_MOTION, RULES_LT, 1, 0, 600000), RULES_COND(IN_LUX_X10, RULES_GT, 500, 50, 0)}, 2, ir_action, 1},
+//   };
+//
+// 入力が更新されると, その入力を参照するルールだけを評価する. 条件の状態はヒステリシス付きで保持し,
+// 全ての条件が成立すると, もしくは成立しなくなるとactionを呼ぶ.
+// 継続時間(hold_ms)の判定は入力が変化しなくても必要なので, rules_time_to_nextの時間後にrules_pollを呼ぶ.
+// ヒステリシス, 継続時間, 時刻の桁あふれの判定はhost/rules_simで確認する.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#define RULES_MAX 32        // 登録できるルールの数. 32以下
+#define RULES_INPUT_MAX 16  // 入力の数
+#define RULES_MAX_CONDS 2   // 1ルールあたりの条件の数
+
+// -----------------
+
+typedef enum {
+  RULES_GT,  // 入力 > threshold で成立. 入力 <= threshold - hysteresis で不成立
+  RULES_LT,  // 入力 < threshold で成立. 入力 >= threshold + hysteresis で不成立
+} rules_op_t;
+
+typedef struct {
+  uint8_t input;       // 入力番号. RULES_INPUT_MAX未満
+  uint8_t op;          // rules_op_t
+  uint32_t hold_ms;    // 成立してからこの時間[ms]継続したら満たしたとみなす. 0ですぐ
+  int32_t threshold;   // しきい値
+  int32_t hysteresis;  // 不成立に戻る時のしきい値との差. 0以上
+} rules_cond_t;
+
+#define RULES_COND(input, op, threshold, hysteresis, hold_ms) {(input), (op), (hold_ms), (threshold), (hysteresis)}
+
+// ルールの実行内容. 全ての条件を満たした時にactive=true, 満たさなくなった時にactive=falseで呼ばれる.
+typedef void (*rules_action_t)(uint32_t arg, bool active);
+
+typedef struct {
+  rules_cond_t cond[RULES_MAX_CONDS];  // 条件. 全て満たすとactionを実行
+  uint8_t n_cond;                      // 条件の数
+  rules_action_t action;
+  uint32_t arg;  // actionへ渡す値
+} rules_rule_t;
+
+bool rules_init(const rules_rule_t* table, uint32_t n);
+void rules_update(uint32_t input, int32_t value, uint32_t now_ms);
+void rules_poll(uint32_t now_ms);
+uint32_t rules_time_to_next(uint32_t now_ms);
+bool rules_active(uint32_t rule);
+uint32_t rules_evaluations();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
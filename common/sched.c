@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "sched.h"
+
+#include "hardware/sync.h"
+
+// 登録したタスク1つ分の状態
+typedef struct {
+  sched_task_fn_t fn;
+  void* arg;
+  uint64_t period_us;
+  uint64_t deadline_us;   // 周期の開始から期限までの時間
+  uint64_t release;       // 今回の周期の開始時刻
+  uint64_t wake;          // 次に呼ぶ時刻. 処理を分割していなければreleaseと同じ
+  volatile bool trigger;  // sched_triggerで次の周期を待たずに呼ぶ
+  sched_stats_t stats;
+} sched_task_t;
+
+static sched_task_t sched_tasks[SCHED_MAX_TASKS];
+static uint sched_count = 0;
+
+// 初期値の待機. untilになるか, 割り込みかsched_triggerの__sev()でイベントが来たら戻る.
+// sleep_untilは時刻まで戻らないので, 待機中のsched_triggerが次のタスクの時刻まで遅れる
+static void sched_wait_until(absolute_time_t until) {
+  best_effort_wfe_or_timeout(until);
+}
+
+static sched_idle_fn_t sched_idle = sched_wait_until;
+
+// タスクを登録する. sched_run等を呼ぶ前に全て登録すること.
+//
+// Args:
+//   name: 統計情報の表示用の名前
+//   fn: タスクの関数
+//   arg: fnへ渡す値
+//   period_ms: 周期[ms]
+//   deadline_ms: 周期の開始から完了までの期限[ms]. 0なら周期と同じ
+//   offset_ms: 現在から最初の周期の開始までの時間[ms]. タスクの開始時刻をずらして負荷を分散する
+//
+// Returns: タスク番号. 登録数がSCHED_MAX_TASKSを超える場合は-1
+int sched_add(const char* name, sched_task_fn_t fn, void* arg, uint32_t period_ms, uint32_t deadline_ms,
+              uint32_t offset_ms) {
+  if (sched_count >= SCHED_MAX_TASKS) return -1;
+  sched_task_t* t = &sched_tasks[sched_count];
+  t->fn = fn;
+  t->arg = arg;
+  t->period_us = period_ms * 1000ull;
+  t->deadline_us = (deadline_ms ? deadline_ms : period_ms) * 1000ull;
+  t->release = time_us_64() + offset_ms * 1000ull;
+  t->wake = t->release;
+  t->trigger = false;
+  t->stats = (sched_stats_t){0};
+  t->stats.name = name;
+  return sched_count++;
+}
+
+// 実行できるタスクのうち期限が最も早いものを1回呼ぶ. 待機はしない.
+//
+// Returns: タスクを呼んだらtrue. 実行できるタスクが無ければfalse
+bool sched_run_once() {
+  uint64_t now = time_us_64();
+  sched_task_t* next = NULL;
+  for (uint i = 0; i < sched_count; i++) {
+    sched_task_t* t = &sched_tasks[i];
+    if (t->trigger) {  // 周期の開始を現在にずらす. 以降の周期はここからの位相になる
+      t->trigger = false;
+      if (t->release > now) t->release = now;
+      t->wake = now;
+    }
+    if (t->wake > now) continue;
+    if (!next || t->release + t->deadline_us < next->release + next->deadline_us) next = t;
+  }
+  if (!next) return false;
+
+  uint32_t ret = next->fn(next->arg);
+  uint64_t end = time_us_64();
+  if (end - now > next->stats.max_exec_us) next->stats.max_exec_us = (uint32_t)(end - now);
+
+  if (ret) {
+    next->wake = end + ret;  // 処理を続ける. 期限は変わらない
+    return true;
+  }
+
+  next->stats.runs++;
+  uint64_t deadline = next->release + next->deadline_us;
+  if (end > deadline) {
+    next->stats.misses++;
+    if (end - deadline > next->stats.max_late_us) next->stats.max_late_us = (uint32_t)(end - deadline);
+  }
+
+  // 次の周期. 実行できないまま終わってしまった周期は飛ばし, 周期の位相は保つ
+  next->release += next->period_us;
+  if (next->release + next->period_us <= end) {
+    uint64_t n = (end - next->release) / next->period_us;
+    next->stats.skipped += n;
+    next->release += n * next->period_us;
+  }
+  next->wake = next->release;
+  return true;
+}
+
+// 次にタスクを呼ぶ時刻
+//
+// Returns: 最も早いタスクの時刻. タスクが無ければat_the_end_of_time
+absolute_time_t sched_next_time() {
+  uint64_t t = UINT64_MAX;
+  for (uint i = 0; i < sched_count; i++) {
+    if (sched_tasks[i].trigger) return get_absolute_time();  // 待機せずにすぐ呼ぶ
+    if (sched_tasks[i].wake < t) t = sched_tasks[i].wake;
+  }
+  return t == UINT64_MAX ? at_the_end_of_time : from_us_since_boot(t);
+}
+
+// タスクを実行し続ける. 実行できるタスクが無い間はsched_set_idleの関数(初期値は__wfe()で待つ)で
+// 次の時刻まで待機する. 処理は返らない.
+void sched_run() {
+  while (1) {
+    if (!sched_run_once()) sched_idle(sched_next_time());
+  }
+}
+
+// 実行できるタスクが無い間の待機の関数を設定する. sched_runを呼ぶ前に設定すること.
+//
+// Args:
+//   idle: 待機の関数. NULLで初期値の待機(__wfe())
+void sched_set_idle(sched_idle_fn_t idle) {
+  sched_idle = idle ? idle : sched_wait_until;
+}
+
+// タスクを次の周期まで待たずに呼ぶ. GPIO割り込みや, もう一方のコアからも呼べる.
+// __sev()で初期値の待機(__wfe())から戻し, 次のsched_run_onceで実行できるタスクになる. 処理を分割している途中なら,
+// 次の呼び出しを早める. power_wait_untilの__wfi()は__sev()では戻らないので, 同じコアの割り込みから呼ぶこと.
+//
+// Args:
+//   id: タスク番号
+void sched_trigger(uint id) {
+  if (id >= sched_count) return;
+  sched_tasks[id].trigger = true;
+  __sev();  // 待機の直前にtriggerを確認した後でも, イベントが残るので__wfe()はすぐに戻る
+}
+
+// 登録したタスクの数
+uint sched_task_count() {
+  return sched_count;
+}
+
+// タスクの統計情報を読み出す
+//
+// Args:
+//   id: タスク番号
+//   stats: 統計情報の格納先
+void sched_get_stats(uint id, sched_stats_t* stats) {
+  if (id < sched_count) *stats = sched_tasks[id].stats;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+// 周期と期限を持つタスクを1つのコアで順に実行する協調型のスケジューラー.
+// 実行できるタスクのうち, 期限が最も早いものから実行する(EDF). 実行中のタスクを中断することはない.
+//
+// タスクは待機せずに処理を返すこと. センサーの測定完了を待つ場合などは, 待ち時間を戻り値で返すと
+// その時間後に同じタスクをもう一度呼ぶ. 処理を分割している間も期限は変わらない.
+// 期限を過ぎて完了した回数と, 前の処理が終わらず飛ばした周期の数を記録する.
+// 実行できるタスクが無い間は__wfe()で次の時刻か, 割り込み, sched_triggerまで待機する.
+// 待機はsched_set_idleで差し替えられる(低消費電力の待機など).
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 8  // 登録できるタスクの数. 足りない場合はビルドの定義で指定する
+#endif
+
+// -----------------
+
+// タスクの関数
+//
+// Args:
+//   arg: sched_addで指定した値
+//
+// Returns: 0で今回の処理を完了し, 次の周期まで待つ. 正の値なら処理を続けるため, その時間[us]後にもう一度呼ぶ.
+typedef uint32_t (*sched_task_fn_t)(void* arg);
+
+typedef struct {
+  const char* name;
+  uint32_t runs;         // 完了した回数
+  uint32_t misses;       // 期限を過ぎて完了した回数
+  uint32_t skipped;      // 前の処理が終わらず飛ばした周期の数
+  uint32_t max_late_us;  // 期限を過ぎて完了した最大の時間[us]
+  uint32_t max_exec_us;  // 1回の呼び出しの最大実行時間[us]
+} sched_stats_t;
+
+// 待機の関数. untilまで, もしくは割り込みがあるまで待つ. untilより前に戻ってもよい
+typedef void (*sched_idle_fn_t)(absolute_time_t until);
+
+int sched_add(const char* name, sched_task_fn_t fn, void* arg, uint32_t period_ms, uint32_t deadline_ms,
+              uint32_t offset_ms);
+bool sched_run_once();
+absolute_time_t sched_next_time();
+void sched_run();
+void sched_set_idle(sched_idle_fn_t idle);
+void sched_trigger(uint id);
+uint sched_task_count();
+void sched_get_stats(uint id, sched_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
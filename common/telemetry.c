@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "telemetry.h"
+
+#ifdef LIB_PICO_STDIO_USB
+#include "pico/stdio/driver.h"
+#include "pico/stdio_usb.h"
+#endif
+#ifdef LIB_PICO_STDIO_UART
+#include "hardware/uart.h"
+#endif
+
+// CRC-16/CCITT-FALSEの4bitずつの計算テーブル. 256要素のテーブルよりフラッシュが少なくて済む
+static const uint16_t telemetry_crc_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+// CRC-16/CCITT-FALSEを計算する
+//
+// Args:
+//   crc: 前のデータまでのCRC. 最初は0xFFFF
+//   data: データ
+//   len: バイト数
+//
+// Returns: dataまでのCRC
+uint16_t telemetry_crc16(uint16_t crc, const uint8_t* data, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    crc = (uint16_t)(crc << 4) ^ telemetry_crc_table[(crc >> 12) ^ (data[i] >> 4)];
+    crc = (uint16_t)(crc << 4) ^ telemetry_crc_table[(crc >> 12) ^ (data[i] & 0x0F)];
+  }
+  return crc;
+}
+
+// 現在のブロックを送信し, 次のブロックを開始する
+static void telemetry_flush_block(telemetry_t* t) {
+  t->block[0] = (uint8_t)t->len;
+  t->write(t->block, t->len, t->ctx);
+  t->bytes += t->len;
+  t->len = 1;
+}
+
+// 1byteをCOBSで符号化する. 0x00でブロックを区切り, 0x00が254byte続かない場合もブロックを区切る
+static void telemetry_cobs(telemetry_t* t, uint8_t b) {
+  if (b == 0) {
+    telemetry_flush_block(t);
+    return;
+  }
+  t->block[t->len++] = b;
+  if (t->len == 255) telemetry_flush_block(t);
+}
+
+// レコードの1byteを書き込む
+static inline void telemetry_byte(telemetry_t* t, uint8_t b) {
+  t->crc = (uint16_t)(t->crc << 4) ^ telemetry_crc_table[(t->crc >> 12) ^ (b >> 4)];
+  t->crc = (uint16_t)(t->crc << 4) ^ telemetry_crc_table[(t->crc >> 12) ^ (b & 0x0F)];
+  telemetry_cobs(t, b);
+}
+
+static void telemetry_varint(telemetry_t* t, uint32_t v) {
+  while (v >= 0x80) {
+    telemetry_byte(t, (uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  telemetry_byte(t, (uint8_t)v);
+}
+
+// 送信の初期化
+//
+// Args:
+//   t: 送信の状態
+//   write: 符号化したデータの送信関数. PicoのUSBシリアルへ送る場合はtelemetry_usb_write, UARTはtelemetry_uart_write
+//   ctx: writeへ渡す値
+void telemetry_init(telemetry_t* t, telemetry_write_fn_t write, void* ctx) {
+  t->write = write;
+  t->ctx = ctx;
+  t->crc = 0xFFFF;
+  t->len = 1;
+  t->frames = 0;
+  t->bytes = 0;
+}
+
+// レコードを開始する. 続けてtelemetry_put, telemetry_put_arrayで値を書き込み, telemetry_endで送信を完了する
+//
+// Args:
+//   t: 送信の状態
+//   type: レコードの種類. telemetry_type_t
+//   id: センサー番号. 同じ種類のセンサーが複数ある場合に区別する
+//   time_us: 測定時刻[us]
+void telemetry_begin(telemetry_t* t, uint8_t type, uint8_t id, uint64_t time_us) {
+  t->crc = 0xFFFF;
+  t->len = 1;
+  telemetry_byte(t, type);
+  telemetry_byte(t, id);
+  // 時刻は64bitなので32bitの変換を2段に分ける
+  while (time_us >= 0x80000000ull) {
+    telemetry_byte(t, (uint8_t)(time_us | 0x80));
+    time_us >>= 7;
+  }
+  telemetry_varint(t, (uint32_t)time_us);
+}
+
+// 値を1つ書き込む
+void telemetry_put(telemetry_t* t, int32_t value) {
+  telemetry_varint(t, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));  // zigzag
+}
+
+// 値の配列を書き込む. 赤外線の受信バッファーなどをコピーせずに送信する
+//
+// Args:
+//   t: 送信の状態
+//   values: 値の配列. 各要素はINT32_MAX以下
+//   length: 要素数
+void telemetry_put_array(telemetry_t* t, const uint32_t* values, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) telemetry_varint(t, values[i] << 1);  // 正の値のzigzag
+}
+
+// レコードを完了し, CRCと区切りを付けて送信する
+void telemetry_end(telemetry_t* t) {
+  uint16_t crc = t->crc;
+  telemetry_cobs(t, (uint8_t)(crc >> 8));
+  telemetry_cobs(t, (uint8_t)crc);
+  // 最後のブロックは区切りの0x00と一緒に送る. blockは255byteで送信済みなので最後の1byteは空いている
+  t->block[0] = (uint8_t)t->len;
+  t->block[t->len] = 0;
+  t->write(t->block, t->len + 1, t->ctx);
+  t->bytes += t->len + 1;
+  t->len = 1;
+  t->frames++;
+}
+
+// 値の配列を1つのレコードとして送信する
+//
+// Args:
+//   t: 送信の状態
+//   type: レコードの種類. telemetry_type_t
+//   id: センサー番号
+//   time_us: 測定時刻[us]
+//   values: 値の配列
+//   length: 要素数
+void telemetry_send(telemetry_t* t, uint8_t type, uint8_t id, uint64_t time_us, const int32_t* values,
+                    uint32_t length) {
+  telemetry_begin(t, type, id, time_us);
+  for (uint32_t i = 0; i < length; i++) telemetry_put(t, values[i]);
+  telemetry_end(t);
+}
+
+#ifdef LIB_PICO_STDIO_USB
+// PicoのUSBシリアルへの送信関数. printfを通さずUSBのドライバーへ直接渡すので, 改行コードの変換も行わない.
+// PCと接続していない間はUSBのドライバーが捨てる
+void telemetry_usb_write(const uint8_t* data, uint32_t len, void* ctx) {
+  stdio_usb.out_chars((const char*)data, (int)len);
+}
+#endif
+
+#ifdef LIB_PICO_STDIO_UART
+// stdioのUARTへの送信関数. 改行コードの変換を行わずに送る. 送り終わるまで待つ
+void telemetry_uart_write(const uint8_t* data, uint32_t len, void* ctx) {
+  uart_write_blocking(uart_default, data, len);
+}
+#endif
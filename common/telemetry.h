@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// 測定値をバイナリのレコードにしてUSBシリアルへ送信する.
+// テキストの表示に比べて送信量と変換の処理時間が少なく, PC側はhost/telemetry_dumpで復号する.
+//
+// レコード: 種類(1byte), センサー番号(1byte), 時刻[us](varint), 値(zigzag varint)の並び, CRC(2byte)
+// フレーム: レコードをCOBSで符号化し, 区切りとして0x00を付けたもの. 途中から受信しても次の0x00で同期できる.
+//   varint: 下位から7bitずつ, 続きがあれば最上位bitを1にする
+//   zigzag: 0, -1, 1, -2, ...を0, 1, 2, 3, ...にして, 絶対値の小さい負の値も短くする
+//   CRC: CRC-16/CCITT-FALSE(多項式0x1021, 初期値0xFFFF). 種類から値までを対象とし, 上位バイトから送る
+//
+// 値は測定結果の変数や受信バッファーから直接符号化し, COBSのブロック(最大255byte)がいっぱいになるたびに送信する.
+// レコード全体やテキストを作る中間バッファーは不要で, 長い赤外線データもそのまま送れる.
+//
+//   static telemetry_t telemetry;
+//   telemetry_init(&telemetry, telemetry_usb_write, NULL);
+//   int32_t values[3] = {temperature_x100, pressure_x100, humidity_x100};
+//   telemetry_send(&telemetry, TELEMETRY_BME280, 0, time_us_64(), values, 3);
+//
+// telemetry_usb_write, telemetry_uart_write以外はPico SDKに依存しない. host/telemetry_decoder.cppがtelemetry_crc16を, host/sensor_replay.cppが
+// 記録の作成にtelemetry_sendを使う.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// レコードの種類と値の並び. 値は全てint32_tの範囲
+typedef enum {
+  TELEMETRY_EVENT = 0,   // イベント. 値: イベント番号, 関係するレコードの種類
+  TELEMETRY_BME280 = 1,  // 値: 温度[0.01℃], 気圧[0.01hPa], 湿度[0.01%]
+  TELEMETRY_SCD41 = 2,   // 値: CO2濃度[ppm], 温度[0.01℃], 湿度[0.01%]
+  TELEMETRY_IR = 3,      // 値: 赤外線のON, OFFの時間[us]の並び(ONから). 個数は可変
+
+  // 変換前の値. PC側(host/sensor_replay)でドライバーと同じ計算を行い, 測定値を求め直す
+  TELEMETRY_BME280_RAW = 4,   // 値: ADCの温度, 気圧, 湿度の値. 先に送った同じセンサー番号のBME280_CALで計算する
+  TELEMETRY_BME280_CAL = 5,   // 値: キャリブレーションデータ(BME280::CalibrationData)のバイトの並び
+  TELEMETRY_TSL2572_RAW = 6,  // 値: ADCのCH0, CH1の値, 測定時のinteg_cycles, again
+  TELEMETRY_SCD41_RAW = 7,    // 値: CO2濃度[ppm], 読み出した温度, 湿度の値
+} telemetry_type_t;
+
+// TELEMETRY_EVENTのイベント番号
+typedef enum {
+  TELEMETRY_EVENT_START = 1,      // 測定を開始した
+  TELEMETRY_EVENT_FINISHED = 2,   // 測定を終了した
+  TELEMETRY_EVENT_NOT_FOUND = 3,  // センサーが応答しない
+  TELEMETRY_EVENT_FAILED = 4,     // 測定に失敗した
+} telemetry_event_t;
+
+// 符号化したデータの送信関数. dataは次の呼び出しまでに送信するか, コピーすること
+//
+// Args:
+//   data: 送信するデータ
+//   len: バイト数. 1-256
+//   ctx: telemetry_initで指定した値
+typedef void (*telemetry_write_fn_t)(const uint8_t* data, uint32_t len, void* ctx);
+
+typedef struct {
+  telemetry_write_fn_t write;
+  void* ctx;
+  uint16_t crc;        // 送信中のレコードのCRC
+  uint16_t len;        // blockに入っているバイト数. block[0]はCOBSのコードバイト
+  uint8_t block[256];  // 送信中のCOBSのブロック. 最後の1byteは区切りの0x00用
+  uint32_t frames;     // 送信したフレームの数
+  uint32_t bytes;      // 送信したバイト数
+} telemetry_t;
+
+void telemetry_init(telemetry_t* t, telemetry_write_fn_t write, void* ctx);
+void telemetry_begin(telemetry_t* t, uint8_t type, uint8_t id, uint64_t time_us);
+void telemetry_put(telemetry_t* t, int32_t value);
+void telemetry_put_array(telemetry_t* t, const uint32_t* values, uint32_t length);
+void telemetry_end(telemetry_t* t);
+void telemetry_send(telemetry_t* t, uint8_t type, uint8_t id, uint64_t time_us, const int32_t* values,
+                    uint32_t length);
+uint16_t telemetry_crc16(uint16_t crc, const uint8_t* data, uint32_t len);
+
+#ifdef LIB_PICO_STDIO_USB
+void telemetry_usb_write(const uint8_t* data, uint32_t len, void* ctx);
+#endif
+#ifdef LIB_PICO_STDIO_UART
+void telemetry_uart_write(const uint8_t* data, uint32_t len, void* ctx);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
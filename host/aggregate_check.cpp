@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/aggregate.hの整数演算の集計を, 全てのサンプルを残して倍精度で求めた集計と比べる.
+// 重ならない窓(tumbling)とスライドする窓(sliding)で, 値の範囲, サンプルの間隔, 途絶えた間のaggregate_pollを変えて確認する.
+// サンプル数, 最小, 最大, 窓の時刻は一致, 平均は四捨五入の0.5, 分散は丸めた平均による0.25と四捨五入の0.5,
+// EMAは小数部16bitの切り捨てと四捨五入の分を許容する. 超えた結果があれば終了コード1で終了する.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "aggregate.h"
+#include "check.h"
+
+namespace {
+
+struct Options {
+  uint32_t samples = 200000;  // シナリオごとのサンプル数
+  uint32_t seed = 1;
+  std::string scenario;  // 空で全て
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --samples N      samples per scenario (default: 200000)\n"
+      "  --seed N         random seed (default: 1)\n"
+      "  --scenario NAME  run only NAME (tumbling, sliding, offset, half_mean, wide_range, gaps)\n",
+      prog);
+}
+
+struct Sample {
+  uint64_t time_us;
+  int32_t value;
+};
+
+// サンプルの列の作り方
+struct Scenario {
+  const char* name;
+  uint32_t pane_count;
+  uint64_t pane_us;
+  uint8_t ema_shift;
+  uint64_t poll_us;  // サンプルの間にaggregate_pollを呼ぶ周期. 0で呼ばない
+  // Returns: 前のサンプルからの時間[us]
+  std::function<uint64_t(std::mt19937&)> interval;
+  // Returns: i番目のサンプルの値
+  std::function<int32_t(std::mt19937&, uint32_t)> value;
+};
+
+// 1つの項目の誤差の最大
+struct Error {
+  double max = 0;
+  uint64_t at = 0;  // 最大になった窓の終了時刻[us]
+
+  void add(double e, uint64_t end_us) {
+    e = std::fabs(e);
+    if (e > max) {
+      max = e;
+      at = end_us;
+    }
+  }
+};
+
+struct Result {
+  uint32_t windows = 0;     // 集計結果を比べた窓の数
+  uint32_t empty = 0;       // サンプルの無い窓の数. aggregate_pollがfalseを返すことを確認した
+  uint32_t mismatches = 0;  // サンプル数, 最小, 最大, 窓の時刻, 結果の有無の不一致
+  Error mean, variance, ema;
+};
+
+// 全てのサンプルを残し, 窓ごとに倍精度で集計する
+class Reference {
+ public:
+  explicit Reference(const Scenario& s) : s_(s) {}
+
+  void add(const Sample& x) {
+    if (samples_.empty()) ema_ = x.value;
+    ema_ += (x.value - ema_) / (1 << s_.ema_shift);
+    samples_.push_back(x);
+  }
+
+  // 最後のペインがpaneの窓を集計する
+  //
+  // Returns: サンプルがあればtrue
+  bool window(uint64_t pane, aggregate_result_t* r, double* mean, double* variance) const {
+    uint64_t end = (pane + 1) * s_.pane_us;
+    uint64_t length = s_.pane_us * s_.pane_count;
+    uint64_t start = end > length ? end - length : 0;
+    auto lo = std::lower_bound(samples_.begin(), samples_.end(), start,
+                               [](const Sample& a, uint64_t t) { return a.time_us < t; });
+    auto hi = std::lower_bound(samples_.begin(), samples_.end(), end,
+                               [](const Sample& a, uint64_t t) { return a.time_us < t; });
+    if (lo == hi) return false;
+    double sum = 0;
+    r->min = INT32_MAX;
+    r->max = INT32_MIN;
+    for (auto it = lo; it != hi; ++it) {
+      sum += it->value;
+      r->min = std::min(r->min, it->value);
+      r->max = std::max(r->max, it->value);
+    }
+    r->start_us = start;
+    r->length_us = length;
+    r->count = (uint32_t)(hi - lo);
+    *mean = sum / r->count;
+    double ss = 0;
+    for (auto it = lo; it != hi; ++it) ss += (it->value - *mean) * (it->value - *mean);
+    *variance = ss / r->count;
+    return true;
+  }
+
+  double ema() const { return ema_; }
+
+ private:
+  const Scenario& s_;
+  std::vector<Sample> samples_;
+  double ema_ = 0;
+};
+
+// 整数演算の集計結果を倍精度の集計と比べる. 窓はpaneで終わる
+void compare(const Reference& ref, uint64_t pane, bool closed, const aggregate_result_t& r, Result* res) {
+  aggregate_result_t e;
+  double mean, variance;
+  bool expected = ref.window(pane, &e, &mean, &variance);
+  if (expected != closed) {
+    res->mismatches++;
+    return;
+  }
+  if (!expected) {
+    res->empty++;
+    return;
+  }
+  res->windows++;
+  uint64_t end = e.start_us + e.length_us;
+  if (r.count != e.count || r.min != e.min || r.max != e.max || r.start_us != e.start_us ||
+      r.length_us != e.length_us) {
+    res->mismatches++;
+  }
+  res->mean.add(r.mean - mean, end);
+  res->variance.add((double)r.variance - variance, end);
+  res->ema.add(r.ema - ref.ema(), end);
+}
+
+// シナリオのサンプルを集計し, 窓が終わるたびに比べる
+Result run(const Scenario& s, const Options& opt) {
+  std::mt19937 rng(opt.seed);
+  std::vector<aggregate_pane_t> panes(s.pane_count);
+  aggregate_t a;
+  aggregate_init(&a, panes.data(), s.pane_count, s.pane_us, s.ema_shift);
+  Reference ref(s);
+  Result res;
+  aggregate_result_t r;
+
+  uint64_t time_us = s.pane_us * 3 + s.pane_us / 2;  // 窓の開始が0で切れる場合も含める
+  uint64_t pane = 0;                                 // 集計中のペインの番号
+  uint64_t next_poll = 0;
+  for (uint32_t i = 0; i < opt.samples; i++) {
+    if (i) time_us += s.interval(rng);
+    // サンプルが途絶えた間の集計. 終わった窓は1回だけ出力し, 空の窓ではfalse
+    while (i && s.poll_us && next_poll < time_us) {
+      uint64_t p = next_poll / s.pane_us;
+      bool closed = aggregate_poll(&a, next_poll, &r);
+      if (p > pane) {
+        compare(ref, pane, closed, r, &res);
+        pane = p;
+      } else if (closed) {
+        res.mismatches++;
+      }
+      next_poll += s.poll_us;
+    }
+    Sample x = {time_us, s.value(rng, i)};
+    bool closed = aggregate_add(&a, x.time_us, x.value, &r);
+    uint64_t p = x.time_us / s.pane_us;
+    if (i && p > pane) {
+      compare(ref, pane, closed, r, &res);
+    } else if (closed) {
+      res.mismatches++;
+    }
+    pane = p;
+    if (!i && s.poll_us) next_poll = (time_us / s.poll_us + 1) * s.poll_us;
+    ref.add(x);
+  }
+  return res;
+}
+
+std::vector<Scenario> make_scenarios() {
+  auto every = [](uint64_t us) { return [us](std::mt19937&) { return us; }; };
+  return {
+      // 温度[0.01℃]. 1秒おき, 60秒の重ならない窓
+      {"tumbling", 1, 60000000, 4, 0, every(1000000),
+       [](std::mt19937& rng, uint32_t i) {
+         return (int32_t)std::lround(2200 + 300 * std::sin(i / 5000.0) + std::normal_distribution<>(0, 3)(rng));
+       }},
+      // 湿度[0.01%]. 1秒おき, 10秒のペイン6個(60秒)の窓を10秒ごと
+      {"sliding", 6, 10000000, 4, 0, every(1000000),
+       [](std::mt19937& rng, uint32_t i) {
+         return (int32_t)std::lround(4500 + 800 * std::sin(i / 3000.0) + std::normal_distribution<>(0, 20)(rng));
+       }},
+      // 気圧[0.01hPa]. 最初のサンプル(合計の基準値)だけ範囲の下限で, 以降は上限付近. 基準値との差が大きくても合計があふれない
+      {"offset", 3, 60000000, 4, 0, every(1000000),
+       [](std::mt19937& rng, uint32_t i) {
+         return i ? 110000 - (int32_t)std::uniform_int_distribution<>(0, 500)(rng) : 30000;
+       }},
+      // 負の値を含む小さな整数. 平均の小数部が0.5になる窓が多く, 丸めた平均で分散を補正する
+      {"half_mean", 1, 4000000, 2, 0, every(1000000),
+       [](std::mt19937& rng, uint32_t) { return (int32_t)std::uniform_int_distribution<>(-2, 1)(rng); }},
+      // 照度[0.1lux]. 0から約10万luxまで. 2秒おき, 60秒のペイン2個の窓
+      {"wide_range", 2, 60000000, 6, 0, every(2000000),
+       [](std::mt19937& rng, uint32_t) { return (int32_t)std::uniform_int_distribution<>(0, 1000000)(rng); }},
+      // CO2濃度[ppm]. 間隔がばらつき, ときどき数分途絶える. 1秒おきにaggregate_pollを呼び, 空のペインを進める
+      {"gaps", 3, 10000000, 3, 1000000,
+       [](std::mt19937& rng) {
+         bool gap = std::uniform_int_distribution<>(0, 19)(rng) == 0;  // 5%の確率で30秒から5分途絶える
+         return gap ? std::uniform_int_distribution<uint64_t>(30000000, 300000000)(rng)
+                    : std::uniform_int_distribution<uint64_t>(1, 15000000)(rng);
+       },
+       [](std::mt19937& rng, uint32_t i) {
+         return (int32_t)std::lround(800 + 400 * std::sin(i / 700.0) + std::normal_distribution<>(0, 5)(rng));
+       }},
+  };
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--samples") {
+      opt.samples = std::strtoul(check::next_arg(argc, argv, &i, usage), nullptr, 0);
+    } else if (arg == "--seed") {
+      opt.seed = std::strtoul(check::next_arg(argc, argv, &i, usage), nullptr, 0);
+    } else if (arg == "--scenario") {
+      opt.scenario = check::next_arg(argc, argv, &i, usage);
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opt.samples < 2) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::printf("scenario,panes,windows,empty,mismatches,mean_err,variance_err,ema_err\n");
+  return check::run_cases(make_scenarios(), opt.scenario, [&](const Scenario& s) {
+    Result res = run(s, opt);
+    // EMAは更新ごとに小数部16bitで切り捨てるので, 2^ema_shift倍の1/65536まで偏る
+    double ema_limit = 0.5 + std::ldexp(1.0, s.ema_shift - 16);
+    std::printf("%s,%u,%u,%u,%u,%.3f,%.3f,%.3f\n", s.name, s.pane_count, res.windows, res.empty, res.mismatches,
+                res.mean.max, res.variance.max, res.ema.max);
+    bool ok = res.windows > 0 && res.mismatches == 0 && res.mean.max <= 0.5 + 1e-9 &&
+              res.variance.max <= 0.75 + 1e-6 && res.ema.max <= ema_limit + 1e-9;
+    if (!ok) {
+      std::fprintf(stderr, "%s: mismatches %u, worst mean at %llu, variance at %llu, ema at %llu[us]\n", s.name,
+                   res.mismatches, (unsigned long long)res.mean.at, (unsigned long long)res.variance.at,
+                   (unsigned long long)res.ema.at);
+    }
+    return ok;
+  });
+}
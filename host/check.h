@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+// 期待値と比べる確認ツール(rules_sim, aggregate_check, deadband_check)の共通部分.
+// 名前付きのケースを順に実行し, 1つでも期待と異なれば終了コード1を返す. CTestからも同じ終了コードで判定する.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace check {
+
+// オプションの値を取り出す. 値が無ければusageを表示し, 終了コード2で終了する
+//
+// Args:
+//   argc, argv: mainの引数
+//   i: オプションの位置. 値の位置に進める
+//   usage: 使い方を表示する関数
+//
+// Returns: オプションの値
+inline const char* next_arg(int argc, char** argv, int* i, void (*usage)(const char*)) {
+  if (*i + 1 >= argc) {
+    usage(argv[0]);
+    std::exit(2);
+  }
+  return argv[++*i];
+}
+
+// ケースを順に実行する
+//
+// Args:
+//   cases: ケースの配列. 要素はnameを持つ
+//   only: 空でなければこの名前のケースだけ実行する
+//   run: ケースを実行し, 期待と一致すればtrueを返す関数
+//
+// Returns: 終了コード. 全て一致で0, 一致しないケースがあれば1, onlyに一致するケースが無ければ2
+template <typename Case, typename Run>
+int run_cases(const std::vector<Case>& cases, const std::string& only, Run run) {
+  int runs = 0;
+  int failures = 0;
+  for (const Case& c : cases) {
+    if (!only.empty() && only != c.name) continue;
+    runs++;
+    if (!run(c)) failures++;
+  }
+  if (!runs) {
+    std::fprintf(stderr, "no case named %s\n", only.c_str());
+    return 2;
+  }
+  return failures ? 1 : 0;
+}
+
+}  // namespace check
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/deadband.hの変化時の出力に, ケースごとに決めた時刻と値の列を与え, 出力するかと出力した値を期待値と比べる.
+// 最初のサンプルの出力, しきい値と割合(permille)の大きい方の選択, 最大の無出力時間, 値の範囲の端を確認する.
+// 期待と異なる結果があれば終了コード1で終了する.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "deadband.h"
+
+namespace {
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  -v           print every step\n"
+      "  --case NAME  run only NAME\n",
+      prog);
+}
+
+// 1回のdeadband_update
+struct Step {
+  uint64_t time_us;
+  int32_t value;
+  bool publish;    // 出力するか
+  int32_t output;  // 呼んだ後のd->value. 前回出力した値
+};
+
+struct Case {
+  const char* name;
+  int32_t threshold;
+  uint16_t permille;
+  uint64_t max_silence_us;
+  std::vector<Step> steps;
+};
+
+const uint64_t S = 1000000;  // 1秒[us]
+
+std::vector<Case> make_cases() {
+  return {
+      // 最初のサンプルは差によらず出力する. 値が0でも出力済みとして扱う
+      {"first_sample", 100, 0, 0, {{0, 0, true, 0}, {1 * S, 50, false, 0}, {2 * S, 101, true, 101}}},
+      // 差がthresholdちょうどは出力しない. 超えたら出力し, 次の差は出力した値から測る
+      {"threshold",
+       10,
+       0,
+       0,
+       {{0, 2000, true, 2000},
+        {1 * S, 2010, false, 2000},
+        {2 * S, 1990, false, 2000},
+        {3 * S, 2011, true, 2011},
+        {4 * S, 2005, false, 2011},
+        {5 * S, 2000, true, 2000}}},
+      // 少しずつ変化しても, 前回出力した値からの差が積み重なれば出力する
+      {"drift", 10, 0, 0, {{0, 0, true, 0}, {1 * S, 4, false, 0}, {2 * S, 8, false, 0}, {3 * S, 11, true, 11}}},
+      // thresholdが0なら値が変わるたびに出力する
+      {"zero_threshold", 0, 0, 0, {{0, 5, true, 5}, {1 * S, 5, false, 5}, {2 * S, 6, true, 6}, {3 * S, 5, true, 5}}},
+      // 割合の方が大きい場合は割合. 1000の5%は50
+      {"permille_wins",
+       10,
+       50,
+       0,
+       {{0, 1000, true, 1000}, {1 * S, 1050, false, 1000}, {2 * S, 1051, true, 1051}, {3 * S, 1100, false, 1051}}},
+      // 割合が小さい値ではthreshold. 100の5%は5なので10を使う
+      {"threshold_wins",
+       10,
+       50,
+       0,
+       {{0, 100, true, 100}, {1 * S, 110, false, 100}, {2 * S, 111, true, 111}, {3 * S, 0, true, 0},
+        {4 * S, 10, false, 0}}},
+      // 割合は前回の値の絶対値に対して. -2000の5%は100
+      {"permille_negative",
+       0,
+       50,
+       0,
+       {{0, -2000, true, -2000}, {1 * S, -1900, false, -2000}, {2 * S, -2101, true, -2101}}},
+      // 最大の無出力時間が過ぎたら, 値が同じでも出力する. 時間は最後に出力した時刻から測る
+      {"max_silence",
+       10,
+       0,
+       10 * S,
+       {{0, 500, true, 500},
+        {9 * S, 500, false, 500},
+        {10 * S, 500, true, 500},
+        {15 * S, 520, true, 520},
+        {24 * S, 525, false, 520},
+        {25 * S, 525, true, 525}}},
+      // 最大の無出力時間が0なら無制限
+      {"no_silence", 10, 0, 0, {{0, 500, true, 500}, {1000000 * S, 500, false, 500}}},
+      // 値の範囲の端. 差は64bitで求めるのであふれない
+      {"extremes",
+       1000,
+       10,
+       0,
+       {{0, INT32_MIN, true, INT32_MIN},
+        {1 * S, INT32_MAX, true, INT32_MAX},
+        {2 * S, INT32_MAX - 1000, false, INT32_MAX},
+        {3 * S, INT32_MIN, true, INT32_MIN}}},
+  };
+}
+
+// Returns: 期待と一致すればtrue
+bool run(const Case& c, bool verbose, uint32_t* publishes) {
+  deadband_t d;
+  deadband_init(&d, c.threshold, c.permille, c.max_silence_us);
+  bool ok = true;
+  for (const Step& s : c.steps) {
+    bool publish = deadband_update(&d, s.time_us, s.value);
+    bool match = publish == s.publish && d.value == s.output;
+    if (verbose || !match) {
+      std::fprintf(match ? stdout : stderr,
+                   "%s: time %llu[us] value %d publish %d (expected %d) output %d (expected %d)\n", c.name,
+                   (unsigned long long)s.time_us, s.value, publish, s.publish, d.value, s.output);
+    }
+    if (!match) ok = false;
+  }
+  uint32_t expected = 0;
+  for (const Step& s : c.steps) expected += s.publish;
+  if (d.updates != c.steps.size() || d.publishes != expected) {
+    std::fprintf(stderr, "%s: updates %u publishes %u (expected %zu, %u)\n", c.name, d.updates, d.publishes,
+                 c.steps.size(), expected);
+    ok = false;
+  }
+  *publishes = d.publishes;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool verbose = false;
+  std::string only;  // 空で全て
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-v") {
+      verbose = true;
+    } else if (arg == "--case") {
+      only = check::next_arg(argc, argv, &i, usage);
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  std::printf("case,steps,publishes,result\n");
+  return check::run_cases(make_cases(), only, [&](const Case& c) {
+    uint32_t publishes = 0;
+    bool ok = run(c, verbose, &publishes);
+    std::printf("%s,%zu,%u,%s\n", c.name, c.steps.size(), publishes, ok ? "ok" : "NG");
+    return ok;
+  });
+}
@@ -0,0 +1,697 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "devsim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// 値を範囲内に収めて丸める
+uint32_t clamp_round(double v, uint32_t max) {
+  if (!(v > 0)) return 0;  // NaNも0
+  if (v >= max) return max;
+  return (uint32_t)std::lround(v);
+}
+
+// SCD41のCRC. 多項式0x31, 初期値0xFF
+uint8_t sensirion_crc(uint16_t word) {
+  uint8_t data[] = {(uint8_t)(word >> 8), (uint8_t)(word & 0xFF)};
+  uint8_t crc = 0xFF;
+  for (uint8_t b : data) {
+    crc ^= b;
+    for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+  }
+  return crc;
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// SimTrack, SimEnvironment
+
+double SimTrack::at(uint64_t time_us) const {
+  // time_us以前の最後の点
+  auto it = std::upper_bound(points_.begin(), points_.end(), time_us,
+                             [](uint64_t t, const std::pair<uint64_t, double>& p) { return t < p.first; });
+  if (it == points_.begin()) return points_.front().second;
+  const auto& a = *(it - 1);
+  if (it == points_.end()) return a.second;
+  const auto& b = *it;
+  return a.second + (b.second - a.second) * (double)(time_us - a.first) / (double)(b.first - a.first);
+}
+
+std::vector<uint64_t> SimTrack::steps() const {
+  std::vector<uint64_t> result;
+  for (size_t i = 1; i < points_.size(); i++) {
+    if (points_[i].first == points_[i - 1].first && points_[i].second != points_[i - 1].second) {
+      result.push_back(points_[i].first);
+    }
+  }
+  return result;
+}
+
+SimTrack* SimEnvironment::find(const std::string& name) {
+  if (name == "temperature") return &temperature;
+  if (name == "humidity") return &humidity;
+  if (name == "pressure") return &pressure;
+  if (name == "co2") return &co2;
+  if (name == "lux") return &lux;
+  if (name == "ir_ratio") return &ir_ratio;
+  return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// SimDevice
+
+int SimDevice::fault(uint64_t now_us) {
+  if (nak_count_) {
+    nak_count_--;
+    return PICO_ERROR_GENERIC;
+  }
+  for (const Window& w : faults_) {
+    if (now_us >= w.start_us && now_us < w.end_us) {
+      return w.fault == FAULT_HANG ? PICO_ERROR_TIMEOUT : PICO_ERROR_GENERIC;
+    }
+  }
+  return 0;
+}
+
+int SimDevice::write(const uint8_t* src, size_t len, bool nostop) {
+  uint64_t now = hal_time_us_64();
+  int f = fault(now);
+  if (f) {
+    injected++;
+    return f;
+  }
+  return device_write(src, len, now);
+}
+
+int SimDevice::read(uint8_t* dst, size_t len, bool nostop) {
+  uint64_t now = hal_time_us_64();
+  int f = fault(now);
+  if (f) {
+    injected++;
+    return f;
+  }
+  return device_read(dst, len, now);
+}
+
+uint64_t SimDevice::byte_time_us(uint64_t now_us, size_t index, size_t len) {
+  uint64_t before = (uint64_t)(len - 1 - index) * 9 * 1000000 / hal_host_baudrate();
+  return now_us > before ? now_us - before : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Bme280Sim
+
+// データシートの計算例のキャリブレーションデータ. dig_T1からdig_P9まで
+static const uint16_t kBme280CalibrationTP[] = {27504, 26435, (uint16_t)-1000, 36477, (uint16_t)-10685, 3024,
+                                                2855,  140,   (uint16_t)-7,    15500, (uint16_t)-14600, 6000};
+static const uint8_t kBme280H1 = 75;
+static const int16_t kBme280H2 = 362;
+static const uint8_t kBme280H3 = 0;
+static const int16_t kBme280H4 = 324;
+static const int16_t kBme280H5 = 50;
+static const int8_t kBme280H6 = 30;
+
+Bme280Sim::Bme280Sim(const SimEnvironment* env) : SimDevice(env) {
+  reset();
+}
+
+// パワーオンリセット, ソフトリセット後の状態
+void Bme280Sim::reset() {
+  std::memset(regs, 0, sizeof(regs));
+  for (size_t i = 0; i < 12; i++) {
+    regs[0x88 + i * 2] = kBme280CalibrationTP[i] & 0xFF;
+    regs[0x89 + i * 2] = kBme280CalibrationTP[i] >> 8;
+  }
+  regs[0xA1] = kBme280H1;
+  regs[0xE1] = kBme280H2 & 0xFF;
+  regs[0xE2] = kBme280H2 >> 8;
+  regs[0xE3] = kBme280H3;
+  regs[0xE4] = kBme280H4 >> 4;
+  regs[0xE5] = (kBme280H4 & 0xF) | ((kBme280H5 & 0xF) << 4);
+  regs[0xE6] = kBme280H5 >> 4;
+  regs[0xE7] = kBme280H6;
+  regs[0xD0] = 0x60;  // ID
+  regs[0xF7] = 0x80;  // 測定前のADCの値
+  regs[0xFA] = 0x80;
+  regs[0xFD] = 0x80;
+  ctrl_hum_ = 0;
+  measuring_ = false;
+}
+
+// オーバーサンプリングの設定値を倍率にする. 0は測定しない
+static uint32_t bme280_oversampling(uint8_t osrs) {
+  if (osrs == 0) return 0;
+  return osrs >= 5 ? 16 : 1 << (osrs - 1);
+}
+
+uint64_t Bme280Sim::measurement_time_us() const {
+  uint32_t t = bme280_oversampling(regs[0xF4] >> 5);
+  uint32_t p = bme280_oversampling((regs[0xF4] >> 2) & 0x7);
+  uint32_t h = bme280_oversampling(ctrl_hum_ & 0x7);
+  uint64_t us = 1000 + 2000 * t;
+  if (p) us += 2000 * p + 500;
+  if (h) us += 2000 * h + 500;
+  return us;
+}
+
+void Bme280Sim::start_measurement(uint64_t now_us) {
+  measuring_ = true;
+  measure_start_us_ = now_us;
+}
+
+// 測定の完了を処理する. Normalモードでは待機時間の後に次の測定を開始する
+void Bme280Sim::update(uint64_t now_us) {
+  static const uint32_t standby_us[] = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+  while (measuring_) {
+    uint64_t end = measure_start_us_ + measurement_time_us();
+    if (now_us < end) break;
+    latch(end);
+    conversions++;
+    if ((regs[0xF4] & 0x3) == 0x3) {
+      measure_start_us_ = end + standby_us[regs[0xF5] >> 5];
+    } else {
+      measuring_ = false;
+      regs[0xF4] &= ~0x3;  // Forcedモードは測定後にSleepモードに戻る
+    }
+  }
+  bool busy = measuring_ && now_us >= measure_start_us_;
+  regs[0xF3] = (busy ? 0x08 : 0) | (now_us < reset_end_us_ ? 0x01 : 0);
+}
+
+// データシートの浮動小数の計算式
+double Bme280Sim::compensate_t(int32_t adc, double* t_fine) const {
+  double t1 = kBme280CalibrationTP[0], t2 = (int16_t)kBme280CalibrationTP[1], t3 = (int16_t)kBme280CalibrationTP[2];
+  double var1 = (adc / 16384.0 - t1 / 1024.0) * t2;
+  double var2 = (adc / 131072.0 - t1 / 8192.0) * (adc / 131072.0 - t1 / 8192.0) * t3;
+  *t_fine = var1 + var2;
+  return (var1 + var2) / 5120.0;
+}
+
+double Bme280Sim::compensate_p(int32_t adc, double t_fine) const {
+  double p1 = kBme280CalibrationTP[3];
+  double p[10];
+  for (int i = 2; i <= 9; i++) p[i] = (int16_t)kBme280CalibrationTP[i + 2];
+  double var1 = t_fine / 2.0 - 64000.0;
+  double var2 = var1 * var1 * p[6] / 32768.0;
+  var2 = var2 + var1 * p[5] * 2.0;
+  var2 = var2 / 4.0 + p[4] * 65536.0;
+  var1 = (p[3] * var1 * var1 / 524288.0 + p[2] * var1) / 524288.0;
+  var1 = (1.0 + var1 / 32768.0) * p1;
+  if (var1 == 0) return 0;
+  double pa = 1048576.0 - adc;
+  pa = (pa - var2 / 4096.0) * 6250.0 / var1;
+  var1 = p[9] * pa * pa / 2147483648.0;
+  var2 = pa * p[8] / 32768.0;
+  return (pa + (var1 + var2 + p[7]) / 16.0) / 100.0;  // hPa
+}
+
+double Bme280Sim::compensate_h(int32_t adc, double t_fine) const {
+  double h = t_fine - 76800.0;
+  h = (adc - (kBme280H4 * 64.0 + kBme280H5 / 16384.0 * h)) *
+      (kBme280H2 / 65536.0 * (1.0 + kBme280H6 / 67108864.0 * h * (1.0 + kBme280H3 / 67108864.0 * h)));
+  h = h * (1.0 - kBme280H1 * h / 524288.0);
+  return std::min(100.0, std::max(0.0, h));
+}
+
+// 時刻time_usの環境の値を, キャリブレーションデータの計算式を逆算してADCの値にし, データレジスターに入れる.
+// 測定しない設定の項目は0x80000(湿度は0x8000)になる. IIRフィルターは再現しない
+void Bme280Sim::latch(uint64_t time_us) {
+  double target_t = env_->temperature.at(time_us);
+  double target_p = env_->pressure.at(time_us);
+  double target_h = env_->humidity.at(time_us);
+  double t_fine;
+
+  // 温度はADCの値に対して増加. target_t以上になる最小の値
+  int32_t lo = 0, hi = (1 << 20) - 1;
+  while (lo < hi) {
+    int32_t mid = (lo + hi) / 2;
+    if (compensate_t(mid, &t_fine) >= target_t) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  uint32_t adc_t = lo;
+  compensate_t(adc_t, &t_fine);
+
+  // 気圧はADCの値に対して減少. target_p以上になる最大の値
+  lo = 0;
+  hi = (1 << 20) - 1;
+  while (lo < hi) {
+    int32_t mid = (lo + hi + 1) / 2;
+    if (compensate_p(mid, t_fine) >= target_p) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  uint32_t adc_p = lo;
+
+  // 湿度はADCの値に対して増加
+  lo = 0;
+  hi = 0xFFFF;
+  while (lo < hi) {
+    int32_t mid = (lo + hi) / 2;
+    if (compensate_h(mid, t_fine) >= target_h) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  uint32_t adc_h = lo;
+
+  if (!(regs[0xF4] >> 5)) adc_t = 0x80000;
+  if (!((regs[0xF4] >> 2) & 0x7)) adc_p = 0x80000;
+  if (!(ctrl_hum_ & 0x7)) adc_h = 0x8000;
+  regs[0xF7] = adc_p >> 12;
+  regs[0xF8] = adc_p >> 4;
+  regs[0xF9] = (adc_p << 4) & 0xF0;
+  regs[0xFA] = adc_t >> 12;
+  regs[0xFB] = adc_t >> 4;
+  regs[0xFC] = (adc_t << 4) & 0xF0;
+  regs[0xFD] = adc_h >> 8;
+  regs[0xFE] = adc_h;
+}
+
+void Bme280Sim::write_register(uint8_t reg, uint8_t value, uint64_t now_us) {
+  switch (reg) {
+    case 0xE0:  // reset
+      if (value == 0xB6) {
+        reset();
+        reset_end_us_ = now_us + 2000;
+      }
+      break;
+    case 0xF2:  // ctrl_hum. ctrl_measの書き込みで有効になる
+    case 0xF5:  // config
+      regs[reg] = value;
+      break;
+    case 0xF4:  // ctrl_meas
+      regs[reg] = value;
+      ctrl_hum_ = regs[0xF2];
+      if ((value & 0x3) == 0) {
+        measuring_ = false;
+      } else if ((value & 0x3) != 0x3 || !measuring_) {
+        start_measurement(now_us);
+      }
+      break;
+    default:  // 読み出し専用
+      break;
+  }
+}
+
+// 書き込みはレジスターアドレスとデータの組の繰り返し
+int Bme280Sim::device_write(const uint8_t* src, size_t len, uint64_t now_us) {
+  update(now_us);
+  if (len == 0) return 0;
+  pointer_ = src[0];
+  for (size_t i = 0; i + 1 < len; i += 2) write_register(src[i], src[i + 1], now_us);
+  update(now_us);
+  return (int)len;
+}
+
+int Bme280Sim::device_read(uint8_t* dst, size_t len, uint64_t now_us) {
+  update(now_us);
+  for (size_t i = 0; i < len; i++) dst[i] = regs[pointer_++];
+  return (int)len;
+}
+
+// ---------------------------------------------------------------------------
+// Scd41Sim
+
+namespace {
+
+struct Scd41Command {
+  uint16_t code;
+  uint32_t exec_ms;  // 実行時間. 読み出しのあるコマンドの1msは再現しない
+  bool periodic_ok;  // 定期測定中に使用できる
+};
+
+const Scd41Command kScd41Commands[] = {
+    {0x21b1, 0, false},      // start_periodic_measurement
+    {0x21ac, 0, false},      // start_low_power_periodic_measurement
+    {0x3f86, 500, true},     // stop_periodic_measurement
+    {0xec05, 0, true},       // read_measurement
+    {0xe4b8, 0, true},       // get_data_ready_status
+    {0x241d, 1, false},      // set_temperature_offset
+    {0x2318, 0, false},      // get_temperature_offset
+    {0x2427, 1, false},      // set_sensor_altitude
+    {0x2322, 0, false},      // get_sensor_altitude
+    {0xe000, 1, true},       // set_ambient_pressure, get_ambient_pressure
+    {0x362f, 400, false},    // perform_forced_recalibration
+    {0x2416, 1, false},      // set_automatic_self_calibration_enabled
+    {0x2313, 0, false},      // get_automatic_self_calibration_enabled
+    {0x3615, 800, false},    // persist_settings
+    {0x3682, 0, false},      // get_serial_number
+    {0x3639, 10000, false},  // perform_self_test
+    {0x3632, 1200, false},   // perform_factory_reset
+    {0x3646, 30, false},     // reinit
+    {0x219d, 5000, false},   // measure_single_shot
+};
+
+const uint16_t kScd41DefaultOffset = 1498;  // 4℃. offset x 65536 / 175
+
+}  // namespace
+
+void Scd41Sim::measure(uint64_t time_us) {
+  double co2 = env_->co2.at(time_us) + frc_offset_;
+  double offset = temperature_offset_ * 175.0 / 65536;
+  double t = env_->temperature.at(time_us) + 4.0 - offset;  // 温度オフセットが初期値の4℃なら環境の温度
+  double rh = env_->humidity.at(time_us);
+  data_[0] = clamp_round(co2, 40000);
+  data_[1] = clamp_round((t + 45) * 65536 / 175, 0xFFFF);
+  data_[2] = clamp_round(rh * 65536 / 100, 0xFFFF);
+  data_ready_ = true;
+  measurements++;
+}
+
+// 定期測定, 単発測定の完了を処理する
+void Scd41Sim::update(uint64_t now_us) {
+  uint64_t period = (mode_ == LOW_POWER ? 30000000 : 5000000);
+  if (mode_ != IDLE) {
+    while (next_measurement_us_ <= now_us) {
+      measure(next_measurement_us_);
+      next_measurement_us_ += period;
+    }
+  } else if (single_shot_ && next_measurement_us_ <= now_us) {
+    measure(next_measurement_us_);
+    single_shot_ = false;
+  }
+}
+
+// 2バイトのコマンドと, CRC付きのワード. コマンドの実行中はNAK
+int Scd41Sim::device_write(const uint8_t* src, size_t len, uint64_t now_us) {
+  update(now_us);
+  if (now_us < busy_until_us_) return PICO_ERROR_GENERIC;
+  if (len < 2) return (int)len;
+
+  uint16_t code = (src[0] << 8) | src[1];
+  const Scd41Command* cmd = nullptr;
+  for (const Scd41Command& c : kScd41Commands) {
+    if (c.code == code) cmd = &c;
+  }
+  if (!cmd) return PICO_ERROR_GENERIC;  // 未対応のコマンド
+  if (mode_ != IDLE && !cmd->periodic_ok) {
+    rejected++;
+    return PICO_ERROR_GENERIC;
+  }
+
+  std::vector<uint16_t> words;
+  for (size_t i = 2; i + 3 <= len; i += 3) {
+    uint16_t w = (src[i] << 8) | src[i + 1];
+    if (sensirion_crc(w) != src[i + 2]) {
+      crc_errors++;
+      return (int)len;  // ACKは返すが実行しない
+    }
+    words.push_back(w);
+  }
+
+  busy_until_us_ = now_us + cmd->exec_ms * 1000;
+  if (code != 0x362f) response_.clear();  // 強制校正の結果はコマンドだけの書き込み後に読み出す
+  switch (code) {
+    case 0x21b1:
+      mode_ = PERIODIC;
+      next_measurement_us_ = now_us + 5000000;
+      break;
+    case 0x21ac:
+      mode_ = LOW_POWER;
+      next_measurement_us_ = now_us + 30000000;
+      break;
+    case 0x3f86:
+      mode_ = IDLE;
+      break;
+    case 0xec05:
+      if (data_ready_) {
+        response_.assign(data_, data_ + 3);
+        data_ready_ = false;
+      }
+      break;
+    case 0xe4b8:
+      response_ = {(uint16_t)(data_ready_ ? 0x8006 : 0x8000)};
+      break;
+    case 0x241d:
+      if (!words.empty()) temperature_offset_ = words[0];
+      break;
+    case 0x2318:
+      response_ = {temperature_offset_};
+      break;
+    case 0x2427:
+      if (!words.empty()) altitude_ = words[0];
+      break;
+    case 0x2322:
+      response_ = {altitude_};
+      break;
+    case 0xe000:
+      if (words.empty()) {
+        response_ = {ambient_pressure_};
+      } else {
+        ambient_pressure_ = words[0];
+      }
+      break;
+    case 0x362f:
+      if (!words.empty()) {
+        if (!measurements) {  // 測定前は失敗
+          response_ = {0xFFFF};
+        } else {
+          int32_t correction = (int32_t)words[0] - data_[0];
+          frc_offset_ += correction;
+          response_ = {(uint16_t)(0x8000 + correction)};
+        }
+      } else {
+        busy_until_us_ = now_us;
+      }
+      break;
+    case 0x2416:
+      if (!words.empty()) asc_ = words[0];
+      break;
+    case 0x2313:
+      response_ = {asc_};
+      break;
+    case 0x3682:
+      response_ = {(uint16_t)(serial >> 32), (uint16_t)(serial >> 16), (uint16_t)serial};
+      break;
+    case 0x3639:
+      response_ = {0};
+      break;
+    case 0x3632:
+      temperature_offset_ = kScd41DefaultOffset;
+      altitude_ = 0;
+      asc_ = 1;
+      frc_offset_ = 0;
+      break;
+    case 0x219d:
+      single_shot_ = true;
+      next_measurement_us_ = busy_until_us_;
+      break;
+  }
+  return (int)len;
+}
+
+// 直前のコマンドの結果を, ワードごとにCRCを付けて返す. 結果が無ければNAK
+int Scd41Sim::device_read(uint8_t* dst, size_t len, uint64_t now_us) {
+  update(now_us);
+  if (now_us < busy_until_us_ || response_.empty()) return PICO_ERROR_GENERIC;
+  for (size_t i = 0; i < len; i++) {
+    size_t w = i / 3;
+    uint16_t word = w < response_.size() ? response_[w] : 0xFFFF;
+    switch (i % 3) {
+      case 0:
+        dst[i] = word >> 8;
+        break;
+      case 1:
+        dst[i] = word & 0xFF;
+        break;
+      default:
+        dst[i] = sensirion_crc(word);
+        break;
+    }
+  }
+  response_.clear();
+  return (int)len;
+}
+
+// ---------------------------------------------------------------------------
+// Tsl2572Sim
+
+Tsl2572Sim::Tsl2572Sim(const SimEnvironment* env) : SimDevice(env) {
+  regs[0x01] = 0xFF;  // ATIME
+  regs[0x03] = 0xFF;  // WTIME
+  regs[0x12] = 0x34;  // ID. TSL25721
+}
+
+uint64_t Tsl2572Sim::integration_time_us() const {
+  return (uint64_t)(256 - regs[0x01]) * 2730;
+}
+
+// 時刻time_usに完了した測定の結果をADCレジスターに入れる. ADCの値は照度の計算式から逆算する
+void Tsl2572Sim::latch(uint64_t time_us) {
+  static const double gains[] = {1, 8, 16, 120};
+  double lux = env_->lux.at(time_us);
+  double r = env_->ir_ratio.at(time_us);
+  double g = gains[regs[0x0F] & 0x3];
+  if ((regs[0x0D] & 0x4) && g == 1) g = 0.16;  // AGL
+  double cpl = integration_time_us() / 1000.0 * g / 60;
+  double k = std::max(std::max(1 - 1.87 * r, 0.63 - r), 0.01);  // ch0あたりの照度の係数
+  double ch0 = lux * cpl / k;
+  uint32_t max = std::min<uint32_t>(65535, 1024 * (256 - regs[0x01]));  // 飽和
+  uint32_t c0 = clamp_round(ch0, max);
+  uint32_t c1 = clamp_round(ch0 * r, max);
+  regs[0x14] = c0 & 0xFF;
+  regs[0x15] = c0 >> 8;
+  regs[0x16] = c1 & 0xFF;
+  regs[0x17] = c1 >> 8;
+}
+
+// 完了した測定を処理する. APERSが0なら毎回AINTが1になる
+void Tsl2572Sim::update(uint64_t now_us) {
+  if ((regs[0x00] & 0x3) != 0x3) return;  // PON, AEN
+  uint64_t integ = integration_time_us();
+  uint64_t cycle = integ;
+  if (regs[0x00] & 0x8) cycle += (uint64_t)(256 - regs[0x03]) * 2730 * ((regs[0x0D] & 0x2) ? 12 : 1);  // WEN, WLONG
+  uint64_t elapsed = now_us - cycle_start_us_;
+  uint64_t completed = elapsed >= integ ? (elapsed - integ) / cycle + 1 : 0;
+  if (completed <= latched_) return;
+  latch(cycle_start_us_ + integ + (completed - 1) * cycle);
+  integrations += completed - latched_;
+  latched_ = completed;
+  regs[0x13] |= 0x01;                               // AVALID
+  if ((regs[0x0C] & 0xF) == 0) regs[0x13] |= 0x10;  // AINT
+}
+
+// 1バイト目はコマンド. bit7が1, bit6-5が01で自動インクリメント, 11で特殊機能
+int Tsl2572Sim::device_write(const uint8_t* src, size_t len, uint64_t now_us) {
+  update(now_us);
+  if (len == 0 || !(src[0] & 0x80)) return (int)len;
+  uint8_t type = (src[0] >> 5) & 0x3;
+  if (type == 0x3) {
+    if ((src[0] & 0x1F) == 0x06) regs[0x13] &= ~0x10;  // ALS割り込みのクリア
+    return (int)len;
+  }
+  pointer_ = src[0] & 0x1F;
+  auto_increment_ = (type == 0x1);
+  for (size_t i = 1; i < len; i++) {
+    if (pointer_ == 0x00) {
+      bool started = (regs[0x00] & 0x3) != 0x3 && (src[i] & 0x3) == 0x3;
+      if (started) {  // AENを1にすると測定を開始し, AVALIDは0になる
+        cycle_start_us_ = now_us;
+        latched_ = 0;
+        regs[0x13] &= ~0x01;
+      }
+    }
+    if (pointer_ < 0x10) regs[pointer_] = src[i];  // 0x10以降は読み出し専用
+    if (auto_increment_) pointer_ = (pointer_ + 1) & 0x1F;
+  }
+  return (int)len;
+}
+
+int Tsl2572Sim::device_read(uint8_t* dst, size_t len, uint64_t now_us) {
+  update(now_us);
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = regs[pointer_];
+    if (auto_increment_) pointer_ = (pointer_ + 1) & 0x1F;
+  }
+  return (int)len;
+}
+
+// ---------------------------------------------------------------------------
+// AqmLcdSim
+
+AqmLcdSim::AqmLcdSim(const SimEnvironment* env) : SimDevice(env) {
+  std::memset(ddram, ' ', sizeof(ddram));
+}
+
+std::string AqmLcdSim::line(int n) const {
+  std::string s;
+  for (int col = 0; col < kCols; col++) {
+    uint8_t c = ddram[(n ? 0x40 : 0x00) + col];
+    s += (c < 8) ? (char)('0' + c) : (char)c;
+  }
+  return s;
+}
+
+void AqmLcdSim::instruction(uint8_t c, uint64_t now_us) {
+  uint32_t exec_us = 27;  // 26.3us
+  instructions++;
+  if (c == 0x01) {  // Clear display
+    std::memset(ddram, ' ', sizeof(ddram));
+    address = 0;
+    cgram_mode = false;
+    increment = true;
+    exec_us = 1080;
+  } else if ((c & 0xFE) == 0x02) {  // Return home
+    address = 0;
+    cgram_mode = false;
+    exec_us = 1080;
+  } else if ((c & 0xFC) == 0x04) {  // Entry mode set
+    increment = c & 0x2;
+  } else if ((c & 0xF8) == 0x08) {  // Display ON/OFF
+    display_on = c & 0x4;
+  } else if ((c & 0xE0) == 0x20) {  // Function set
+    extended_ = c & 0x1;
+  } else if (c & 0x80) {  // Set DDRAM address
+    address = c & 0x7F;
+    cgram_mode = false;
+  } else if (!extended_ && (c & 0xC0) == 0x40) {  // Set CGRAM address
+    address = c & 0x3F;
+    cgram_mode = true;
+  } else if (extended_ && (c & 0xF0) == 0x50) {  // Power/ICON/Contrast set. C5, C4
+    contrast = (contrast & 0x0F) | ((c & 0x3) << 4);
+  } else if (extended_ && (c & 0xF0) == 0x60) {  // Follower control. 電源が安定するまで200ms
+    exec_us = 200000;
+  } else if (extended_ && (c & 0xF0) == 0x70) {  // Contrast set. C3-C0
+    contrast = (contrast & 0x30) | (c & 0x0F);
+  }
+  busy_until_us_ = now_us + exec_us;
+}
+
+void AqmLcdSim::data(uint8_t d, uint64_t now_us) {
+  data_writes++;
+  if (cgram_mode) {
+    cgram[address & 0x3F] = d;
+    address = (address + (increment ? 1 : -1)) & 0x3F;
+  } else {
+    ddram[address & 0x7F] = d;
+    // 1行目0x00-0x27, 2行目0x40-0x67
+    if (increment) {
+      address = (address == 0x27) ? 0x40 : (address == 0x67) ? 0x00 : address + 1;
+    } else {
+      address = (address == 0x40) ? 0x27 : (address == 0x00) ? 0x67 : address - 1;
+    }
+  }
+  busy_until_us_ = now_us + 27;
+}
+
+// コントロールバイトのCo=1なら次の1バイト, Co=0なら以降の全てのバイトが, RS=0で命令, RS=1でデータ
+int AqmLcdSim::device_write(const uint8_t* src, size_t len, uint64_t now_us) {
+  size_t i = 0;
+  while (i < len) {
+    uint8_t control = src[i++];
+    size_t end = (control & 0x80) ? std::min(i + 1, len) : len;
+    for (; i < end; i++) {
+      uint64_t t = byte_time_us(now_us, i, len);
+      if (t < busy_until_us_) {
+        busy_violations++;
+        continue;
+      }
+      if (control & 0x40) {
+        data(src[i], t);
+      } else {
+        instruction(src[i], t);
+      }
+    }
+  }
+  return (int)len;
+}
+
+// 読み出しには対応していない
+int AqmLcdSim::device_read(uint8_t* dst, size_t len, uint64_t now_us) {
+  return PICO_ERROR_GENERIC;
+}
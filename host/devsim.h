@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef DEVSIM_H
+#define DEVSIM_H
+
+// BME280, SCD41, TSL2572, AQM LCD(ST7032)のレジスターレベルのシミュレーター.
+// hal_host_attachでI2Cアドレスに接続し, ドライバーをそのままPC上で動かす.
+// 測定値はSimEnvironmentの値の時間変化から作り, 測定時間やステータスビットも仮想的な時刻で再現する.
+// 通信の異常(NAK, クロックストレッチで止まる)を時間帯や回数で注入できる.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hal_host.h"
+
+// 環境の値の時間変化. 時刻と値の点を直線でつなぐ. 同じ時刻に2点を置くとステップ変化になる
+class SimTrack {
+ public:
+  explicit SimTrack(double value = 0) : points_{{0, value}} {}
+
+  // 全ての点を消して一定の値にする
+  void set(double value) { points_ = {{0, value}}; }
+
+  // 点を追加する. 時刻は前の点以降であること
+  //
+  // Args:
+  //   time_us: 時刻[us]
+  //   value: 値
+  void point(uint64_t time_us, double value) { points_.push_back({time_us, value}); }
+
+  // Returns: 時刻time_us[us]での値
+  double at(uint64_t time_us) const;
+
+  // Returns: ステップ変化の時刻[us]の一覧
+  std::vector<uint64_t> steps() const;
+
+ private:
+  std::vector<std::pair<uint64_t, double>> points_;
+};
+
+// センサーが測定する環境
+struct SimEnvironment {
+  SimTrack temperature{25};    // 温度[℃]
+  SimTrack humidity{50};       // 湿度[%]
+  SimTrack pressure{1013.25};  // 気圧[hPa]
+  SimTrack co2{400};           // CO2濃度[ppm]
+  SimTrack lux{300};           // 照度[lux]
+  SimTrack ir_ratio{0.2};      // 赤外線の比率. TSL2572のCH1/CH0
+
+  // Returns: 名前(temperature, humidity, ...)に対応する値. 無ければnullptr
+  SimTrack* find(const std::string& name);
+};
+
+// シミュレーターの基底クラス. 通信の異常の注入と, 転送時刻の管理を行う
+class SimDevice : public HalI2cDevice {
+ public:
+  enum Fault {
+    FAULT_NAK,   // アドレスにNAKを返す
+    FAULT_HANG,  // クロックストレッチで止まったままになる
+  };
+
+  uint64_t injected = 0;  // 注入した異常で失敗させた転送の回数
+
+  explicit SimDevice(const SimEnvironment* env) : env_(env) {}
+
+  // 時刻start_us以上end_us未満[us]の転送を失敗させる
+  void inject(Fault fault, uint64_t start_us, uint64_t end_us) { faults_.push_back({fault, start_us, end_us}); }
+
+  // 次のcount回の転送にNAKを返す
+  void inject_naks(uint32_t count) { nak_count_ += count; }
+
+  int write(const uint8_t* src, size_t len, bool nostop) final;
+  int read(uint8_t* dst, size_t len, bool nostop) final;
+
+ protected:
+  const SimEnvironment* env_;
+
+  // 異常が無い場合の転送. now_usは転送の最後のバイトの時刻
+  virtual int device_write(const uint8_t* src, size_t len, uint64_t now_us) = 0;
+  virtual int device_read(uint8_t* dst, size_t len, uint64_t now_us) = 0;
+
+  // Returns: 転送のindexバイト目(アドレスバイトの次が0)を受け取った時刻[us]
+  static uint64_t byte_time_us(uint64_t now_us, size_t index, size_t len);
+
+ private:
+  struct Window {
+    Fault fault;
+    uint64_t start_us;
+    uint64_t end_us;
+  };
+  std::vector<Window> faults_;
+  uint32_t nak_count_ = 0;
+
+  // Returns: 異常を注入する場合はその戻り値, 注入しない場合は0
+  int fault(uint64_t now_us);
+};
+
+// BME280. レジスターマップ, キャリブレーションデータ, ステータスビット, 測定時間を再現する.
+// ADCの値は, 環境の値になるようにキャリブレーションデータの計算式を逆算して作る
+class Bme280Sim : public SimDevice {
+ public:
+  uint8_t regs[256] = {};
+  uint32_t conversions = 0;  // 完了した測定の回数
+
+  explicit Bme280Sim(const SimEnvironment* env);
+
+  // Returns: 現在の設定での測定時間[us]. データシートのtypical値
+  uint64_t measurement_time_us() const;
+
+ protected:
+  int device_write(const uint8_t* src, size_t len, uint64_t now_us) override;
+  int device_read(uint8_t* dst, size_t len, uint64_t now_us) override;
+
+ private:
+  uint8_t pointer_ = 0;
+  uint8_t ctrl_hum_ = 0;           // ctrl_measの書き込みで有効になったctrl_hum
+  bool measuring_ = false;         // 測定中
+  uint64_t measure_start_us_ = 0;  // 測定開始時刻
+  uint64_t reset_end_us_ = 0;      // リセット後のNVM読み込み(im_update)の完了時刻
+
+  void reset();
+  void update(uint64_t now_us);
+  void start_measurement(uint64_t now_us);
+  void latch(uint64_t time_us);
+  void write_register(uint8_t reg, uint8_t value, uint64_t now_us);
+  double compensate_t(int32_t adc, double* t_fine) const;
+  double compensate_p(int32_t adc, double t_fine) const;
+  double compensate_h(int32_t adc, double t_fine) const;
+};
+
+// SCD41. CRC付きの16bitワードでのコマンド, 実行時間, 定期測定のデータ準備, 定期測定中のコマンド制限を再現する
+class Scd41Sim : public SimDevice {
+ public:
+  enum Mode { IDLE, PERIODIC, LOW_POWER };
+
+  uint64_t serial = 0x123456789ABCull;  // シリアル番号(48bit)
+  uint32_t measurements = 0;            // 完了した測定の回数
+  uint32_t rejected = 0;                // 定期測定中のため拒否したコマンドの回数
+  uint32_t crc_errors = 0;              // CRCが一致しなかった書き込みの回数
+
+  explicit Scd41Sim(const SimEnvironment* env) : SimDevice(env) {}
+
+  Mode mode() const { return mode_; }
+
+ protected:
+  int device_write(const uint8_t* src, size_t len, uint64_t now_us) override;
+  int device_read(uint8_t* dst, size_t len, uint64_t now_us) override;
+
+ private:
+  Mode mode_ = IDLE;
+  uint64_t busy_until_us_ = 0;          // コマンドの実行完了時刻
+  uint64_t next_measurement_us_ = 0;    // 定期測定, 単発測定の次の完了時刻
+  bool single_shot_ = false;            // 単発測定中
+  bool data_ready_ = false;             // 読み出していない測定データがある
+  uint16_t data_[3] = {};               // CO2, 温度, 湿度
+  std::vector<uint16_t> response_;      // 次の読み出しで返すワード
+  uint16_t temperature_offset_ = 1498;  // 温度オフセット. 4℃ x 65536 / 175
+  uint16_t altitude_ = 0;               // 高度[m]
+  uint16_t ambient_pressure_ = 1013;    // 気圧[hPa]
+  uint16_t asc_ = 1;                    // 自動校正の有効, 無効
+  int32_t frc_offset_ = 0;              // 強制校正で求めたCO2の補正値[ppm]
+
+  void update(uint64_t now_us);
+  void measure(uint64_t time_us);
+};
+
+// TSL2572. コマンドレジスター, ATIME, ゲイン, AVALID/AINTビット, ADCの飽和を再現する
+class Tsl2572Sim : public SimDevice {
+ public:
+  uint8_t regs[32] = {};
+  uint32_t integrations = 0;  // 完了した測定の回数
+
+  explicit Tsl2572Sim(const SimEnvironment* env);
+
+  // Returns: 現在の設定での1回の測定時間[us]
+  uint64_t integration_time_us() const;
+
+ protected:
+  int device_write(const uint8_t* src, size_t len, uint64_t now_us) override;
+  int device_read(uint8_t* dst, size_t len, uint64_t now_us) override;
+
+ private:
+  uint8_t pointer_ = 0;
+  bool auto_increment_ = true;
+  uint64_t cycle_start_us_ = 0;  // AENを1にしてから最初の測定の開始時刻
+  uint64_t latched_ = 0;         // cycle_start_us_からラッチ済みの測定の数
+
+  void update(uint64_t now_us);
+  void latch(uint64_t time_us);
+};
+
+// AQM LCD(ST7032). コントロールバイト, 命令テーブル, DDRAM, CGRAM, カーソル, 命令の実行時間を再現する.
+// 実行中に次の命令やデータが届いた場合はbusy_violationsに数え, 処理しない
+class AqmLcdSim : public SimDevice {
+ public:
+  static constexpr int kCols = 8;  // AQM0802の表示桁数
+
+  uint8_t ddram[0x80] = {};
+  uint8_t cgram[64] = {};
+  uint8_t address = 0;      // アドレスカウンター
+  bool cgram_mode = false;  // trueならアドレスカウンターはCGRAMを指す
+  bool increment = true;    // Entry mode setのI/D
+  bool display_on = false;
+  uint8_t contrast = 0;          // 6bit
+  uint32_t instructions = 0;     // 実行した命令の数
+  uint32_t data_writes = 0;      // 書き込んだデータの数
+  uint32_t busy_violations = 0;  // 実行中に届いて処理しなかった命令, データの数
+
+  explicit AqmLcdSim(const SimEnvironment* env);
+
+  // Returns: 表示中の1行. CGRAMの文字(0-7)は'0'-'7'にする
+  std::string line(int n) const;
+
+ protected:
+  int device_write(const uint8_t* src, size_t len, uint64_t now_us) override;
+  int device_read(uint8_t* dst, size_t len, uint64_t now_us) override;
+
+ private:
+  bool extended_ = false;        // Function setのIS. trueで拡張命令テーブル
+  uint64_t busy_until_us_ = 0;
+
+  void instruction(uint8_t c, uint64_t now_us);
+  void data(uint8_t d, uint64_t now_us);
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// デバイスドライバー(bme280, scd41, tsl2572, lcdaqm)をホスト上で実行し, 1回の処理あたりの
+// I2C転送回数, バイト数, 通信時間, 待機時間と, ホストのCPU時間を測定する.
+// デバイスはdevsim.hのシミュレーターで, 測定時間の待機も仮想的な時刻で再現する.
+// 測定値の計算結果も確認し, 結果が違えば終了コード1で終了する.
+//
+// --baselineで以前の出力を指定すると, 転送回数かバイト数が増えた処理があれば終了コード1で終了する.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bme280.h"
+#include "devsim.h"
+#include "lcdaqm.h"
+#include "scd41.h"
+#include "tsl2572.h"
+
+namespace {
+
+// 1つの処理の測定結果. 転送回数などは1回あたりの平均
+struct Result {
+  std::string name;
+  uint64_t calls = 0;
+  double transactions = 0;
+  double bytes = 0;
+  double bus_us = 0;
+  double sleep_us = 0;
+  double host_ns = 0;
+};
+
+struct Options {
+  int repeat = 10000;
+  std::string baseline;
+  double cpu_tolerance = -1;  // ホストのCPU時間の許容増加率[%]. 負なら確認しない
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --repeat N           number of calls per benchmark (default: 10000)\n"
+      "  --baseline PATH      previous output. exit 1 if transactions or bytes increased\n"
+      "  --cpu-tolerance PCT  with --baseline, also exit 1 if host time increased more than PCT %%\n",
+      prog);
+}
+
+// 処理をrepeat回実行し, 1回あたりの転送回数, 通信時間, CPU時間を求める
+Result measure(const std::string& name, int repeat, const std::function<void()>& fn) {
+  hal_host_reset_stats();
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeat; i++) fn();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  const HalStats& s = hal_host_stats();
+
+  Result r;
+  r.name = name;
+  r.calls = repeat;
+  r.transactions = (double)s.transactions / repeat;
+  r.bytes = (double)s.bytes / repeat;
+  r.bus_us = s.bus_ns / 1000.0 / repeat;
+  r.sleep_us = (double)s.sleep_us / repeat;
+  r.host_ns = elapsed * 1e9 / repeat;
+  return r;
+}
+
+// 以前の出力を読み込む
+bool load_baseline(const std::string& path, std::map<std::string, Result>* results) {
+  std::ifstream f(path);
+  if (!f) return false;
+  std::string line;
+  while (std::getline(f, line)) {
+    Result r;
+    char name[64];
+    unsigned long long calls;
+    if (std::sscanf(line.c_str(), "%63[^,],%llu,%lf,%lf,%lf,%lf,%lf", name, &calls, &r.transactions, &r.bytes,
+                    &r.bus_us, &r.sleep_us, &r.host_ns) != 7) {
+      continue;  // ヘッダー
+    }
+    r.name = name;
+    r.calls = calls;
+    (*results)[r.name] = r;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--repeat") {
+      opt.repeat = std::atoi(next());
+    } else if (arg == "--baseline") {
+      opt.baseline = next();
+    } else if (arg == "--cpu-tolerance") {
+      opt.cpu_tolerance = std::atof(next());
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opt.repeat < 1) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::map<std::string, Result> baseline;
+  if (!opt.baseline.empty() && !load_baseline(opt.baseline, &baseline)) {
+    std::fprintf(stderr, "cannot read baseline file\n");
+    return 2;
+  }
+
+  SimEnvironment env;  // 25℃, 50%, 1013.25hPa, 400ppm, 300lux
+  Bme280Sim bme280_device(&env);
+  Tsl2572Sim tsl2572_device(&env);
+  Scd41Sim scd41_device(&env);
+  AqmLcdSim lcd_device(&env);
+  hal_host_reset();
+  hal_host_attach(0x76, &bme280_device);
+  hal_host_attach(TSL2572_I2C_ADDRESS, &tsl2572_device);
+  hal_host_attach(SCD41_I2C_ADDRESS, &scd41_device);
+  hal_host_attach(LCDAQM_I2C_ADDRESS, &lcd_device);
+
+  BME280 bme280(0x76);
+  bme280.init_i2c();
+  std::vector<Result> results;
+  bool ok = true;
+  auto check = [&](bool cond, const char* what) {
+    if (!cond) {
+      std::fprintf(stderr, "check failed: %s\n", what);
+      ok = false;
+    }
+  };
+
+  // BME280
+  bool forced_ok = true;
+  results.push_back(measure("bme280_forced", opt.repeat, [&] { forced_ok &= bme280.forced(); }));
+  check(forced_ok, "bme280 forced");
+  check(std::abs(bme280.temperature_x100 - 2500) <= 1, "bme280 temperature");
+
+  bme280.read_calibration_data();
+  results.push_back(measure("bme280_read_adc", opt.repeat, [&] {
+    if (!(bme280.read_status() & 0x8)) bme280.read_adc();
+  }));
+  check(bme280.adc_temperature != 0x80000, "bme280 adc");
+
+  results.push_back(measure("bme280_calculate", opt.repeat, [&] { bme280.calculate_measured_values(); }));
+  check(std::abs(bme280.temperature_x100 - 2500) <= 1, "bme280 calculate");
+
+  // TSL2572
+  bool tsl2572_ok = true;
+  results.push_back(
+      measure("tsl2572_auto_measure", opt.repeat, [&] { tsl2572_ok &= tsl2572_single_auto_measure(); }));
+  check(tsl2572_ok && std::fabs(tsl2572_illuminance - 300) < 15, "tsl2572 auto measure");
+
+  volatile float lux = 0;
+  results.push_back(measure("tsl2572_lux", opt.repeat, [&] { lux = tsl2572_lux(1000, 200, 64, TSL2572_AGAIN_1); }));
+  check(lux > 0, "tsl2572 lux");
+
+  // SCD41. 5秒おきの定期測定の結果を読み出す
+  bool scd41_ok = true;
+  scd41_start_periodic_measurement();
+  results.push_back(measure("scd41_read_measurement", opt.repeat, [&] {
+    hal_host_advance_us(5000000);
+    scd41_ok &= scd41_read_measurement(0);
+  }));
+  check(scd41_ok && scd41_co2 == 400 && std::abs(scd41_temperature_x100 - 2500) <= 1, "scd41 read measurement");
+
+  // LCD. 1文字だけ変化した表示内容の送信
+  lcdaqm_init();
+  lcdaqm_fb_clear();
+  lcdaqm_fb_flush();
+  uint32_t count = 0;
+  results.push_back(measure("lcdaqm_fb_flush_1char", opt.repeat, [&] {
+    lcdaqm_fb_putc(1, LCDAQM_COLS - 1, '0' + count++ % 10);
+    lcdaqm_fb_flush();
+  }));
+  results.push_back(measure("lcdaqm_fb_flush_all", opt.repeat, [&] {
+    lcdaqm_fb_invalidate();
+    lcdaqm_fb_flush();
+  }));
+
+  std::printf("name,calls,transactions,bytes,bus_us,sleep_us,host_ns\n");
+  for (const Result& r : results) {
+    std::printf("%s,%llu,%.2f,%.2f,%.1f,%.1f,%.1f\n", r.name.c_str(), (unsigned long long)r.calls, r.transactions,
+                r.bytes, r.bus_us, r.sleep_us, r.host_ns);
+  }
+
+  for (const Result& r : results) {
+    auto it = baseline.find(r.name);
+    if (it == baseline.end()) continue;
+    const Result& b = it->second;
+    if (r.transactions > b.transactions + 0.005 || r.bytes > b.bytes + 0.005) {
+      std::fprintf(stderr, "%s: transactions %.2f -> %.2f, bytes %.2f -> %.2f\n", r.name.c_str(), b.transactions,
+                   r.transactions, b.bytes, r.bytes);
+      ok = false;
+    }
+    if (opt.cpu_tolerance >= 0 && r.host_ns > b.host_ns * (1 + opt.cpu_tolerance / 100)) {
+      std::fprintf(stderr, "%s: host time %.1f -> %.1f [ns]\n", r.name.c_str(), b.host_ns, r.host_ns);
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
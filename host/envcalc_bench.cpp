@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/envcalc.hの整数演算の指標(露点, 絶対湿度, 暑さ指数, 海面気圧, 標高)を, 入力の範囲全体で
+// 倍精度の計算と比べ, 最大誤差と平均誤差, ホストでの1回あたりの処理時間を表示する.
+// 最大誤差が許容値を超えた指標があれば終了コード1で終了する. 実機での処理時間はbenchで測定する.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "envcalc.h"
+
+namespace {
+
+struct Options {
+  int repeat = 1000000;
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --repeat N  number of calls per timing benchmark (default: 1000000)\n",
+      prog);
+}
+
+// 1つの指標の誤差. 単位は指標の出力の最小単位
+struct Error {
+  double max = 0;
+  double sum = 0;
+  uint64_t count = 0;
+  std::string worst;  // 最大誤差になった入力. 入力の整数を' 'で区切る
+
+  void add(double fixed, double reference, std::initializer_list<long> input) {
+    double e = std::fabs(fixed - reference);
+    if (e > max) {
+      max = e;
+      worst.clear();
+      for (long v : input) worst += (worst.empty() ? "" : " ") + std::to_string(v);
+    }
+    sum += e;
+    count++;
+  }
+};
+
+// 倍精度の計算. 整数版と同じ式と係数を使う
+double ref_dew_point(double t, double rh) {
+  double gamma = std::log(rh / 100) + 17.62 * t / (243.12 + t);
+  return 243.12 * gamma / (17.62 - gamma);
+}
+
+double ref_absolute_humidity(double t, double rh) {
+  double e = 6.112 * std::exp(17.62 * t / (243.12 + t)) * rh / 100;
+  return 216.679 * e / (t + 273.15);
+}
+
+double ref_heat_index(double t_c, double rh) {
+  double t = t_c * 9 / 5 + 32;
+  double hi = 0.5 * (t + 61.0 + (t - 68.0) * 1.2 + rh * 0.094);
+  if ((hi + t) / 2 >= 80) {
+    hi = -42.379 + 2.04901523 * t + 10.14333127 * rh - 0.22475541 * t * rh - 0.00683783 * t * t -
+         0.05481717 * rh * rh + 0.00122874 * t * t * rh + 0.00085282 * t * rh * rh - 0.00000199 * t * t * rh * rh;
+    if (rh < 13 && t > 80 && t < 112) {
+      hi -= (13 - rh) / 4 * std::sqrt((17 - std::fabs(t - 95)) / 17);
+    } else if (rh > 85 && t > 80 && t < 87) {
+      hi += (rh - 85) / 10 * (87 - t) / 5;
+    }
+  }
+  return (hi - 32) * 5 / 9;
+}
+
+double ref_sea_level_pressure(double p, double t, double h) {
+  double tk = t + 273.15;
+  return p * std::pow((tk + 0.0065 * h) / tk, 5.25588);
+}
+
+double ref_altitude(double p, double p0) {
+  return 44330.8 * (1 - std::pow(p / p0, 1 / 5.25588));
+}
+
+// fnをrepeat回実行し, 1回あたりの時間[ns]を求める. 入力は呼ぶたびに変える
+double time_ns(int repeat, const std::function<int32_t(uint32_t)>& fn) {
+  volatile int32_t sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeat; i++) sink = sink + fn((uint32_t)i);
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  return elapsed * 1e9 / repeat;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--repeat") {
+      opt.repeat = std::atoi(next());
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  // 温度-40～85℃, 湿度0～100%(BME280の測定範囲)
+  Error dew, absolute, heat;
+  for (int32_t t = -4000; t <= 8500; t += 7) {
+    for (uint32_t rh = 100; rh <= 10000; rh += 13) {
+      dew.add(envcalc_dew_point_x100(t, rh), ref_dew_point(t / 100.0, rh / 100.0) * 100, {t, (long)rh});
+      absolute.add(envcalc_absolute_humidity_x100(t, rh), ref_absolute_humidity(t / 100.0, rh / 100.0) * 100,
+                   {t, (long)rh});
+      heat.add(envcalc_heat_index_x100(t, rh), ref_heat_index(t / 100.0, rh / 100.0) * 100, {t, (long)rh});
+    }
+  }
+
+  // 気圧300～1100hPa, 標高0～4000m
+  Error sea_level, altitude;
+  for (uint32_t p = 30000; p <= 110000; p += 37) {
+    for (int32_t t = -4000; t <= 8500; t += 500) {
+      for (int32_t h = 0; h <= 4000; h += 250) {
+        sea_level.add(envcalc_sea_level_pressure_x100(p, t, h), ref_sea_level_pressure(p, t / 100.0, h),
+                      {(long)p, t, h});
+      }
+    }
+    for (uint32_t p0 = 97000; p0 <= 105000; p0 += 1000) {
+      altitude.add(envcalc_altitude_m(p, p0), ref_altitude(p, p0), {(long)p, (long)p0});
+    }
+  }
+
+  struct Row {
+    const char* name;
+    const char* unit;
+    const Error* error;
+    double limit;  // 許容する最大誤差[出力の単位]
+    std::function<int32_t(uint32_t)> fn;
+  };
+  const std::vector<Row> rows = {
+      {"dew_point", "0.01C", &dew, 1,
+       [](uint32_t i) { return envcalc_dew_point_x100(-4000 + (int32_t)(i % 12500), 100 + i % 9900); }},
+      {"absolute_humidity", "0.01g/m3", &absolute, 1,
+       [](uint32_t i) { return (int32_t)envcalc_absolute_humidity_x100(-4000 + (int32_t)(i % 12500), i % 10000); }},
+      {"heat_index", "0.01C", &heat, 2,
+       [](uint32_t i) { return envcalc_heat_index_x100(2000 + (int32_t)(i % 2500), i % 10000); }},
+      {"sea_level_pressure", "0.01hPa", &sea_level, 2,
+       [](uint32_t i) {
+         return (int32_t)envcalc_sea_level_pressure_x100(90000 + i % 15000, 2500, (int32_t)(i % 1000));
+       }},
+      {"altitude", "m", &altitude, 1,
+       [](uint32_t i) { return envcalc_altitude_m(90000 + i % 15000, ENVCALC_SEA_LEVEL_PRESSURE_X100); }},
+  };
+
+  int failures = 0;
+  std::printf("metric,unit,points,max_err,mean_err,limit,host_ns,worst_input\n");
+  for (const Row& r : rows) {
+    double ns = time_ns(opt.repeat, r.fn);
+    std::printf("%s,%s,%llu,%.3f,%.3f,%.0f,%.1f,%s\n", r.name, r.unit, (unsigned long long)r.error->count,
+                r.error->max, r.error->sum / r.error->count, r.limit, ns, r.error->worst.c_str());
+    if (r.error->max > r.limit) {
+      std::fprintf(stderr, "%s: max error %.3f exceeds %.0f\n", r.name, r.error->max, r.limit);
+      failures++;
+    }
+  }
+  return failures ? 1 : 0;
+}
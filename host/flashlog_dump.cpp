@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/flashlog.hのflashlog_exportの出力を, ファイル, 標準入力, USBシリアル(/dev/ttyACM0など)から読み込み,
+// 記録を古い順にCSVで出力する. 出力の前のテキスト(printfの表示など)は読み飛ばす.
+// --requestではUSBシリアルへ書き出しのコマンド文字を送ってから読み込む.
+// 終了時にページ数, サンプル数, 受信時間を標準エラー出力に表示する.
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "flashlog.h"
+
+namespace {
+
+struct Column {
+  std::string name;
+  int decimals = 0;  // 小数点以下の桁数. 記録した整数を10^decimalsで割って表示する
+};
+
+struct Options {
+  std::string input;     // 空なら標準入力
+  std::vector<Column> columns;  // 空ならch0, ch1, ...
+  int request = 0;       // 読み込む前に送る文字. 0なら送らない
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options] [INPUT]\n"
+      "  INPUT           export file or serial device (default: stdin)\n"
+      "  --names LIST    column names, NAME[:DECIMALS] separated by ',' (default: ch0,ch1,...)\n"
+      "  --request C     send the character C to INPUT before reading (hub: x)\n"
+      "Example: %s /dev/ttyACM0 --request x --names temperature:1,pressure:1,humidity:1,lux,co2\n",
+      prog, prog);
+}
+
+std::vector<Column> parse_columns(const std::string& list) {
+  std::vector<Column> columns;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos) end = list.size();
+    std::string item = list.substr(start, end - start);
+    Column c;
+    size_t colon = item.find(':');
+    c.name = item.substr(0, colon);
+    if (colon != std::string::npos) c.decimals = std::atoi(item.c_str() + colon + 1);
+    columns.push_back(c);
+    start = end + 1;
+  }
+  return columns;
+}
+
+// 入力がUSBシリアルなら, 改行コードの変換やエコーをしない生のモードにする
+void set_raw(int fd) {
+  termios tio;
+  if (tcgetattr(fd, &tio) != 0) return;
+  cfmakeraw(&tio);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &tio);
+}
+
+// Returns: 読み込んだ場合はtrue. 入力の終わりか読み込みの誤りならfalse
+bool read_exact(int fd, uint8_t* buf, size_t len) {
+  while (len) {
+    ssize_t n = read(fd, buf, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+void print_value(int32_t v, int decimals) {
+  if (v == FLASHLOG_NO_VALUE) return;
+  if (decimals <= 0) {
+    std::printf("%ld", (long)v);
+    return;
+  }
+  long div = 1;
+  for (int i = 0; i < decimals; i++) div *= 10;
+  long long a = v < 0 ? -(long long)v : v;
+  std::printf("%s%lld.%0*lld", v < 0 ? "-" : "", a / div, decimals, a % div);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--names") {
+      opt.columns = parse_columns(next());
+    } else if (arg == "--request") {
+      opt.request = next()[0];
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg[0] != '-' && opt.input.empty()) {
+      opt.input = arg;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  int fd = 0;
+  if (!opt.input.empty()) {
+    fd = open(opt.input.c_str(), (opt.request ? O_RDWR : O_RDONLY) | O_NOCTTY);
+    if (fd < 0) {
+      std::fprintf(stderr, "cannot open %s\n", opt.input.c_str());
+      return 2;
+    }
+  }
+  if (isatty(fd)) {
+    set_raw(fd);
+    tcflush(fd, TCIFLUSH);
+  }
+  if (opt.request) {
+    char c = (char)opt.request;
+    if (write(fd, &c, 1) != 1) {
+      std::fprintf(stderr, "cannot write %s\n", opt.input.c_str());
+      return 2;
+    }
+  }
+
+  // 先頭の"FLASHLOG"までを読み飛ばす
+  static const char kMarker[] = "FLASHLOG";
+  size_t matched = 0;
+  uint8_t b;
+  auto start = std::chrono::steady_clock::now();
+  while (matched < sizeof(kMarker) - 1) {
+    if (!read_exact(fd, &b, 1)) {
+      std::fprintf(stderr, "no flashlog export in input\n");
+      return 1;
+    }
+    matched = b == (uint8_t)kMarker[matched] ? matched + 1 : (b == (uint8_t)kMarker[0]);
+  }
+  uint8_t head[4];
+  if (!read_exact(fd, head, sizeof(head))) {
+    std::fprintf(stderr, "truncated export\n");
+    return 1;
+  }
+  uint32_t count = head[0] | head[1] << 8 | head[2] << 16 | (uint32_t)head[3] << 24;
+  std::vector<uint8_t> pages((size_t)count * FLASHLOG_PAGE_SIZE);
+  if (!read_exact(fd, pages.data(), pages.size())) {
+    std::fprintf(stderr, "truncated export (%u pages expected)\n", count);
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  flashlog_reader_t reader;
+  flashlog_reader_init(&reader, pages.data(), (uint32_t)pages.size());
+  flashlog_sample_t s;
+  uint64_t samples = 0;
+  uint8_t header_channels = 0;
+  while (flashlog_read(&reader, &s)) {
+    if (s.channels != header_channels) {
+      header_channels = s.channels;
+      std::printf("boot,time");
+      for (uint32_t i = 0; i < s.channels; i++) {
+        if (i < opt.columns.size()) {
+          std::printf(",%s", opt.columns[i].name.c_str());
+        } else {
+          std::printf(",ch%u", i);
+        }
+      }
+      std::printf("\n");
+    }
+    std::printf("%u,%lu", s.boot, (unsigned long)s.time);
+    for (uint32_t i = 0; i < s.channels; i++) {
+      std::printf(",");
+      print_value(s.values[i], i < opt.columns.size() ? opt.columns[i].decimals : 0);
+    }
+    std::printf("\n");
+    samples++;
+  }
+  std::fflush(stdout);
+
+  std::fprintf(stderr, "pages %u (%zu bytes), samples %llu, %.2f s\n", count, pages.size(),
+               (unsigned long long)samples, seconds);
+  return 0;
+}
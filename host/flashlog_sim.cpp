@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/flashlog.hの記録を, RAM上のNORフラッシュのシミュレーターで試す.
+// hubと同じ1秒おきの温度, 気圧, 湿度, 照度, CO2濃度を仮想的な時刻で作って記録し,
+// 1サンプルあたりのバイト数と領域に残る日数, セクターごとの消去回数を表示する.
+// hubと同じく測定値ごとの変化時の出力(common/deadband.h)を通し, 変化した秒だけ記録する. --every-secondで毎秒記録する.
+// --power-cutsでは書き込み, 消去の途中で電源を切り, 再起動(flashlog_init)して記録を続ける.
+// 最後に全ての記録を読み出し, 作った値と一致するか, 時刻の順序が正しいかを確認する. 不一致があれば終了コード1.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "deadband.h"
+#include "flashlog.h"
+
+namespace {
+
+constexpr int kChannels = 5;  // temperature_x10, pressure_x10, humidity_x10, lux, co2
+
+struct Options {
+  double days = 28;        // 記録する日数
+  uint32_t size = 512 * 1024;  // 領域のバイト数
+  uint32_t power_cuts = 0;     // 電源を切る回数
+  uint32_t seed = 1;
+  bool every_second = false;  // trueで変化時の出力を通さず, 毎秒記録する(HUB_USE_DEADBANDが0のhub)
+  std::string export_path;    // flashlog_exportの出力先. 空なら出力しない
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --days N         simulated days at 1 sample/s (default: 28)\n"
+      "  --size BYTES     log region size, multiple of 4096 (default: 524288)\n"
+      "  --power-cuts N   cut power during N random flash operations and remount\n"
+      "  --seed N         random seed (default: 1)\n"
+      "  --every-second   log every second instead of on change (hub with HUB_USE_DEADBAND 0)\n"
+      "  --export FILE    write the flashlog_export stream to FILE\n",
+      prog);
+}
+
+// NORフラッシュ. 書き込みは0のビットだけを反映し(元の値とのAND), 消去でセクターを0xFFにする.
+// 電源を切る操作では, 書き込みは先頭の一部のバイト, 消去はセクターの先頭の一部だけを行い, 以降の操作は失敗する
+class NorFlash {
+ public:
+  explicit NorFlash(uint32_t size) : mem(size, 0xFF), erases(size / FLASHLOG_SECTOR_SIZE, 0) {}
+
+  std::vector<uint8_t> mem;
+  std::vector<uint32_t> erases;  // セクターごとの消去回数
+  uint64_t ops = 0;              // 書き込み, 消去の回数
+  uint64_t cut_at = UINT64_MAX;  // この回数目の操作の途中で電源を切る
+  bool off = false;
+  std::mt19937* rng = nullptr;
+
+  flashlog_flash_t flash() {
+    return flashlog_flash_t{mem.data(), (uint32_t)mem.size(), erase_cb, program_cb, this};
+  }
+
+ private:
+  // Returns: 操作するバイト数. 途中で電源を切る場合はlength未満, 電源が切れていれば0
+  uint32_t begin(uint32_t length) {
+    if (off) return 0;
+    if (++ops != cut_at) return length;
+    off = true;
+    return std::uniform_int_distribution<uint32_t>(0, length - 1)(*rng);
+  }
+
+  static bool erase_cb(uint32_t offset, void* ctx) {
+    NorFlash* f = static_cast<NorFlash*>(ctx);
+    uint32_t n = f->begin(FLASHLOG_SECTOR_SIZE);
+    for (uint32_t i = 0; i < n; i++) f->mem[offset + i] = 0xFF;
+    if (n == FLASHLOG_SECTOR_SIZE) f->erases[offset / FLASHLOG_SECTOR_SIZE]++;
+    return n == FLASHLOG_SECTOR_SIZE;
+  }
+
+  static bool program_cb(uint32_t offset, const uint8_t* data, void* ctx) {
+    NorFlash* f = static_cast<NorFlash*>(ctx);
+    uint32_t n = f->begin(FLASHLOG_PAGE_SIZE);
+    for (uint32_t i = 0; i < n; i++) f->mem[offset + i] &= data[i];
+    return n == FLASHLOG_PAGE_SIZE;
+  }
+};
+
+// 測定値の生成. 真の値は日周変化などのなめらかな変化とし, 測定ごとにセンサーの雑音を加えてhubの測定値の単位で丸める.
+// 温度[0.01℃], 気圧[0.01hPa], 湿度[0.01%], 照度[0.1lux], CO2濃度[ppm]. 測定の周期はhubと同じ
+class Environment {
+ public:
+  explicit Environment(uint32_t seed) : rng_(seed) {}
+
+  // Returns: 時刻tに測定したチャンネルのビット. valuesの測定していないチャンネルは変えない
+  uint32_t sample(uint32_t t, int32_t* values) {
+    double day = 2 * M_PI * t / 86400.0;
+    double hour = std::fmod(t / 3600.0, 24.0);
+    // BME280 1秒. 雑音は温度0.005℃, 気圧0.013hPa, 湿度0.02%(データシートのRMS雑音)
+    values[0] = quantize(22.0 + 2.5 * std::sin(day) + noise(0.005), 100);
+    values[1] = quantize(1010.0 + 6.0 * std::sin(day / 3.7) + noise(0.013), 100);
+    values[2] = quantize(45.0 - 8.0 * std::sin(day) + noise(0.02), 100);
+    uint32_t measured = 0x7;
+    // TSL2572 2秒. 昼間のみ, 雑音1%
+    if (t % 2 == 0) {
+      double lux = hour >= 6 && hour < 18 ? 400.0 * std::sin(M_PI * (hour - 6) / 12) : 0;
+      values[3] = quantize(lux * (1 + noise(0.01)), 10);
+      measured |= 1u << 3;
+    }
+    // SCD41 5秒. 在室中(9時から12時, 13時から18時)に上昇, 雑音5ppm
+    if (t % 5 == 0) {
+      bool occupied = (hour >= 9 && hour < 12) || (hour >= 13 && hour < 18);
+      co2_ += occupied ? (1400 - co2_) / 1800.0 : (420 - co2_) / 1200.0;
+      values[4] = (int32_t)std::lround(co2_ + noise(5));
+      measured |= 1u << 4;
+    }
+    return measured;
+  }
+
+ private:
+  std::mt19937 rng_;
+  std::normal_distribution<double> normal_;
+  double co2_ = 420;
+
+  double noise(double sd) { return normal_(rng_) * sd; }
+
+  static int32_t quantize(double v, int scale) { return (int32_t)std::lround(v * scale); }
+};
+
+// hub.hのHUB_DEADBAND_xと同じ変化時の出力のしきい値[測定値の単位], 割合[0.1%]と, 記録の分解能への除数
+const struct {
+  int32_t threshold;
+  uint16_t permille;
+  int32_t div;
+} kChannelConfig[kChannels] = {
+    {10, 0, 10},   // 温度. 0.1℃を超える変化で0.1℃単位
+    {10, 0, 10},   // 気圧. 0.1hPa
+    {50, 0, 10},   // 湿度. 0.5%で0.1%単位
+    {10, 50, 10},  // 照度. 1luxか5%で1lux単位
+    {20, 0, 1},    // CO2濃度. 20ppm
+};
+constexpr uint64_t kMaxSilenceUs = 600000000;  // HUB_MAX_SILENCE_MS
+
+// Returns: valueを1/divにして四捨五入した値. hubのround_divと同じ
+int32_t round_div(int32_t value, int32_t div) {
+  return (value + (value < 0 ? -div / 2 : div / 2)) / div;
+}
+
+struct Reference {
+  bool logged;  // この時刻に記録した
+  int32_t values[kChannels];
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--days") {
+      opt.days = std::atof(next());
+    } else if (arg == "--size") {
+      opt.size = std::strtoul(next(), nullptr, 0);
+    } else if (arg == "--power-cuts") {
+      opt.power_cuts = std::strtoul(next(), nullptr, 0);
+    } else if (arg == "--seed") {
+      opt.seed = std::strtoul(next(), nullptr, 0);
+    } else if (arg == "--every-second") {
+      opt.every_second = true;
+    } else if (arg == "--export") {
+      opt.export_path = next();
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opt.days <= 0 || opt.size % FLASHLOG_SECTOR_SIZE || opt.size < FLASHLOG_SECTOR_SIZE * 2) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::mt19937 rng(opt.seed);
+  NorFlash nor(opt.size);
+  nor.rng = &rng;
+  flashlog_flash_t flash = nor.flash();
+  flashlog_t log;
+  flashlog_init(&log, &flash, kChannels);
+
+  // 電源を切る時刻. 1日あたりの操作回数が分からないので, 時刻で決めて次の操作の途中で切る
+  uint32_t seconds = (uint32_t)(opt.days * 86400);
+  std::vector<uint32_t> cuts;
+  for (uint32_t i = 0; i < opt.power_cuts; i++) cuts.push_back(std::uniform_int_distribution<uint32_t>(1, seconds - 1)(rng));
+  std::sort(cuts.begin(), cuts.end());
+  size_t next_cut = 0;
+
+  Environment env(opt.seed);
+  std::vector<Reference> reference(seconds);
+  int32_t measured[kChannels] = {};
+  int32_t published[kChannels] = {};  // 変化時の出力を通った値. hubのchannel_values
+  deadband_t deadbands[kChannels];
+  for (int i = 0; i < kChannels; i++) {
+    deadband_init(&deadbands[i], kChannelConfig[i].threshold, kChannelConfig[i].permille, kMaxSilenceUs);
+  }
+  uint32_t last_logged = 0;
+  flashlog_stats_t total = {};
+  uint32_t boots = 1;
+  double append_ns = 0;
+  auto accumulate = [&]() {
+    total.samples += log.stats.samples;
+    total.blocks += log.stats.blocks;
+    total.erases += log.stats.erases;
+    total.dropped += log.stats.dropped;
+    total.errors += log.stats.errors;
+  };
+
+  for (uint32_t t = 0; t < seconds; t++) {
+    // hubのchannel_sampleとlog_taskと同じく, 変化時の出力を通った値があれば, 出力済みの値を記録の分解能にして記録する
+    uint32_t m = env.sample(t, measured);
+    bool changed = opt.every_second;
+    for (int i = 0; i < kChannels; i++) {
+      if (opt.every_second) {
+        published[i] = measured[i];
+      } else if ((m & (1u << i)) && deadband_update(&deadbands[i], t * 1000000ull, measured[i])) {
+        published[i] = deadbands[i].value;
+        changed = true;
+      }
+    }
+    if (changed) {
+      Reference& r = reference[t];
+      r.logged = true;
+      for (int i = 0; i < kChannels; i++) r.values[i] = round_div(published[i], kChannelConfig[i].div);
+      auto start = std::chrono::steady_clock::now();
+      flashlog_append(&log, t, r.values);
+      append_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+      last_logged = t;
+    }
+
+    if (next_cut < cuts.size() && t >= cuts[next_cut]) {
+      nor.cut_at = nor.ops + 1;
+      next_cut++;
+    }
+    while (flashlog_service(&log) && !nor.off) {
+    }
+    if (nor.off) {
+      // 再起動. RAM上の符号化中と書き込み待ちのブロックは失われる
+      accumulate();
+      nor.off = false;
+      nor.cut_at = UINT64_MAX;
+      flashlog_init(&log, &flash, kChannels);
+      boots++;
+    }
+  }
+  nor.cut_at = UINT64_MAX;
+  flashlog_flush(&log);
+  while (flashlog_service(&log)) {
+  }
+  accumulate();
+
+  // 全ての記録を読み出して確認する
+  flashlog_reader_t reader;
+  flashlog_reader_init(&reader, nor.mem.data(), opt.size);
+  flashlog_sample_t s;
+  uint64_t read = 0, mismatches = 0, order_errors = 0;
+  uint32_t first = 0, last = 0;
+  uint16_t last_boot = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (flashlog_read(&reader, &s)) {
+    if (read && (s.time <= last || s.boot < last_boot)) order_errors++;
+    if (s.time >= seconds || !reference[s.time].logged || s.channels != kChannels ||
+        !std::equal(s.values, s.values + kChannels, reference[s.time].values)) {
+      if (mismatches++ < 5) std::printf("mismatch at time %u\n", s.time);
+    }
+    if (!read) first = s.time;
+    last = s.time;
+    last_boot = s.boot;
+    read++;
+  }
+  double read_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  // 残っている期間と, そのうち読み出せなかったサンプル(電源を切ったときRAM上にあったもの)
+  uint64_t span = read ? last - first + 1 : 0;
+  uint64_t expected = std::count_if(reference.begin() + (read ? first : 0), reference.begin() + (read ? last + 1 : 0),
+                                    [](const Reference& r) { return r.logged; });
+  uint32_t pages = opt.size / FLASHLOG_PAGE_SIZE;
+  uint32_t used = 0;
+  for (uint32_t p = 0; p < pages; p++) used += flashlog_block_valid(nor.mem.data() + p * FLASHLOG_PAGE_SIZE);
+  double bytes_per_sample = read ? (double)used * FLASHLOG_PAGE_SIZE / read : 0;
+  double bytes_per_day = span ? (double)used * FLASHLOG_PAGE_SIZE * 86400 / span : 0;
+  auto [min_erase, max_erase] = std::minmax_element(nor.erases.begin(), nor.erases.end());
+
+  std::printf("samples       %llu (%.1f days, %u boots, %.1f%% of seconds)\n", (unsigned long long)total.samples,
+              opt.days, boots, 100.0 * total.samples / seconds);
+  std::printf("blocks        %llu written, %u valid in %u pages\n", (unsigned long long)total.blocks, used, pages);
+  std::printf("bytes/sample  %.3f (raw %d)\n", bytes_per_sample, 4 * (1 + kChannels));
+  std::printf("retained      %.1f days (%llu samples, %llu lost)\n", span / 86400.0, (unsigned long long)read,
+              (unsigned long long)(expected - read));
+  std::printf("capacity      %.1f days at %.0f bytes/day\n",
+              bytes_per_day > 0 ? (opt.size - FLASHLOG_SECTOR_SIZE) / bytes_per_day : 0.0, bytes_per_day);
+  std::printf("erases        %llu, per sector min %u max %u\n", (unsigned long long)total.erases, *min_erase,
+              *max_erase);
+  std::printf("dropped       %llu, errors %llu\n", (unsigned long long)total.dropped,
+              (unsigned long long)total.errors);
+  std::printf("append        %.0f ns/sample\n", append_ns / total.samples);
+  std::printf("read          %.0f ns/sample\n", read ? read_ns / read : 0.0);
+
+  if (!opt.export_path.empty()) {
+    std::FILE* f = std::fopen(opt.export_path.c_str(), "wb");
+    if (!f) {
+      std::fprintf(stderr, "cannot write %s\n", opt.export_path.c_str());
+      return 2;
+    }
+    flashlog_export(
+        &log, [](const uint8_t* data, uint32_t len, void* ctx) { std::fwrite(data, 1, len, (std::FILE*)ctx); }, f);
+    std::fclose(f);
+  }
+
+  bool ok = read > 0 && mismatches == 0 && order_errors == 0 && last == last_logged;
+  std::printf("%s (mismatches %llu, order errors %llu)\n", ok ? "PASS" : "FAIL", (unsigned long long)mismatches,
+              (unsigned long long)order_errors);
+  return ok ? 0 : 1;
+}
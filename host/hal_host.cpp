@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#define HAL_IMPL  // hal_関数の実装. common/hal.hで計測付きの関数に置き換えない
+#include "hal_host.h"
+
+namespace {
+
+HalI2cDevice* devices[128] = {};  // I2Cアドレスごとの接続デバイス
+uint32_t baudrate = 100000;       // I2C周波数[Hz]
+uint64_t now_ns = 0;              // 仮想的な時刻[ns]
+HalStats stats;
+
+// 1回の転送の通信時間を仮想的な時刻に加算する.
+// START, アドレス, データ各9bit(ACK含む), STOPとして計算する
+void bus_transfer(size_t len) {
+  uint64_t bits = 1 + (len + 1) * 9 + 1;
+  uint64_t ns = bits * 1000000000ull / baudrate;
+  now_ns += ns;
+  stats.bus_ns += ns;
+  stats.transactions++;
+}
+
+// 転送結果を統計に記録する. デバイスが止まった場合, タイムアウトの無い転送はPicoでは戻らないが,
+// ホスト側ではhangsに数えて失敗として返す
+//
+// Returns: 転送関数の戻り値
+int record(int n, uint timeout_us) {
+  if (n == PICO_ERROR_TIMEOUT) {
+    if (timeout_us) {
+      now_ns += (uint64_t)timeout_us * 1000;
+      stats.timeouts++;
+      return PICO_ERROR_TIMEOUT;
+    }
+    stats.hangs++;
+    n = PICO_ERROR_GENERIC;
+  }
+  if (n < 0) {
+    stats.naks++;
+  } else {
+    stats.bytes += n;
+  }
+  return n;
+}
+
+}  // namespace
+
+void hal_host_attach(uint8_t addr, HalI2cDevice* device) {
+  devices[addr & 0x7F] = device;
+}
+
+void hal_host_reset() {
+  for (HalI2cDevice*& d : devices) d = nullptr;
+  baudrate = 100000;
+  now_ns = 0;
+  stats = HalStats();
+}
+
+void hal_host_reset_stats() {
+  stats = HalStats();
+}
+
+const HalStats& hal_host_stats() {
+  return stats;
+}
+
+uint32_t hal_host_baudrate() {
+  return baudrate;
+}
+
+void hal_host_advance_us(uint64_t us) {
+  now_ns += us * 1000;
+}
+
+extern "C" {
+
+void hal_i2c_init_pins(i2c_inst_t* i2c, uint baud, uint sda_pin, uint scl_pin) {
+  if (baud) baudrate = baud;
+}
+
+int hal_i2c_write_blocking(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop) {
+  bus_transfer(len);
+  HalI2cDevice* d = devices[addr & 0x7F];
+  return record(d ? d->write(src, len, nostop) : PICO_ERROR_GENERIC, 0);
+}
+
+int hal_i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop,
+                             uint timeout_us) {
+  bus_transfer(len);
+  HalI2cDevice* d = devices[addr & 0x7F];
+  return record(d ? d->write(src, len, nostop) : PICO_ERROR_GENERIC, timeout_us);
+}
+
+int hal_i2c_read_blocking(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop) {
+  bus_transfer(len);
+  HalI2cDevice* d = devices[addr & 0x7F];
+  return record(d ? d->read(dst, len, nostop) : PICO_ERROR_GENERIC, 0);
+}
+
+void hal_sleep_ms(uint32_t ms) {
+  now_ns += (uint64_t)ms * 1000000;
+  stats.sleep_us += (uint64_t)ms * 1000;
+}
+
+uint64_t hal_time_us_64() {
+  return now_ns / 1000;
+}
+
+}  // extern "C"
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+// common/hal.hのホスト側の実装.
+// I2Cはアドレスごとに接続したHalI2cDeviceへ転送し, 時刻は仮想的な時刻で扱う.
+// 仮想的な時刻はhal_sleep_msの待機時間と, I2Cの通信時間だけ進む.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hal.h"
+
+// I2Cデバイスのシミュレーター
+class HalI2cDevice {
+ public:
+  virtual ~HalI2cDevice() = default;
+
+  // マスターからの書き込み
+  //
+  // Args:
+  //   src: データ
+  //   len: バイト数
+  //   nostop: trueならSTOPを出さずに続けて転送する(リピートスタート)
+  //
+  // Returns: 受け取ったバイト数. 応答しない(NAK)場合はPICO_ERROR_GENERIC.
+  //   クロックストレッチで止まったままの場合はPICO_ERROR_TIMEOUT
+  virtual int write(const uint8_t* src, size_t len, bool nostop) = 0;
+
+  // マスターへの読み出し
+  //
+  // Args:
+  //   dst: データ格納先
+  //   len: バイト数
+  //   nostop: trueならSTOPを出さずに続けて転送する(リピートスタート)
+  //
+  // Returns: 送ったバイト数. 応答しない(NAK)場合はPICO_ERROR_GENERIC.
+  //   クロックストレッチで止まったままの場合はPICO_ERROR_TIMEOUT
+  virtual int read(uint8_t* dst, size_t len, bool nostop) = 0;
+};
+
+// 通信と待機の統計
+struct HalStats {
+  uint64_t transactions = 0;  // 書き込みと読み出しの回数
+  uint64_t bytes = 0;         // アドレスバイトを除くデータのバイト数
+  uint64_t naks = 0;          // 応答の無かった転送の回数
+  uint64_t timeouts = 0;      // hal_i2c_write_timeout_usがタイムアウトした回数
+  uint64_t hangs = 0;         // タイムアウト無しの転送でデバイスが止まった回数. Picoでは処理が戻らない
+  uint64_t bus_ns = 0;        // 通信時間の合計[ns]
+  uint64_t sleep_us = 0;      // hal_sleep_msで待機した時間の合計[us]
+};
+
+// I2Cアドレスにデバイスを接続する. nullptrで切断
+void hal_host_attach(uint8_t addr, HalI2cDevice* device);
+
+// 全てのデバイスを切断し, 仮想的な時刻と統計を0に戻す
+void hal_host_reset();
+
+// 統計を0に戻す. 仮想的な時刻は戻さない
+void hal_host_reset_stats();
+
+// 統計
+const HalStats& hal_host_stats();
+
+// hal_i2c_init_pinsで設定したI2C周波数[Hz]
+uint32_t hal_host_baudrate();
+
+// 仮想的な時刻を進める. センサーの測定時間の経過などに使う
+void hal_host_advance_us(uint64_t us);
+
+#endif
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// infrared.pioの送信/受信プログラムをホスト上でサイクル精度でシミュレーションし,
+// infrared_sendの送信データがどのような波形になり, 受信プログラムでどう測定されるかを表示する.
+//
+// 送信: infrared_encode_send_wordで変換したワードをinfrared_sendプログラムに渡し, サイドセットピンの波形を記録
+// 受信: 38KHzの波形を赤外線受信器で復調したものとして受信プログラムに入力し, RX FIFOの値を記録
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "infrared_timing.h"
+#include "pio_sim.h"
+
+namespace {
+
+constexpr uint32_t kDefaultThreshold = 100000;  // infrared.hのINFRARED_RECEIVE_THRESHOLDと同じ
+constexpr uint32_t kDefaultMinPulse = 10;       // infrared.hのINFRARED_RECEIVE_MIN_PULSEと同じ
+constexpr uint32_t kIdleBeforeUs = 100;         // 受信プログラム開始から波形入力までの時間[us]
+
+struct Edge {
+  uint64_t cycle;  // システムクロックのサイクル
+  bool level;
+};
+
+// 送信波形の1区間. 38KHzバースト(ON)または停止(OFF)
+struct Segment {
+  uint64_t start;
+  uint64_t end;
+};
+
+struct Options {
+  std::string pio_path = IR_PIO_PATH;
+  uint32_t sys_hz = 150000000;  // Pico 2の標準システムクロック
+  uint32_t threshold = kDefaultThreshold;
+  double demod_hold_us = INFRARED_SEND_BURST_PERIOD;
+  bool waveform = false;
+  int repeat = 1;
+  double max_error_us = -1;
+  uint32_t min_pulse = kDefaultMinPulse;
+  std::vector<Segment> spikes;  // 受信器出力に加えるグリッチ[us]
+  std::vector<uint32_t> data;
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options] [data]\n"
+      "  data               comma separated ON/OFF times [us] (default: NEC frame)\n"
+      "  --file PATH        read data from file (same format as infrared/main.c output)\n"
+      "  --pio PATH         infrared.pio path (default: %s)\n"
+      "  --clk HZ           clk_sys frequency (default: 150000000)\n"
+      "  --threshold US     receive threshold (default: %u)\n"
+      "  --demod-hold US    receiver output hold time after the last carrier pulse (default: %d)\n"
+      "  --waveform         print send pin edges\n"
+      "  --repeat N         repeat the simulation N times for benchmarking\n"
+      "  --max-error US     exit with 1 if any |error| exceeds US\n"
+      "  --spike AT:WIDTH   invert the receiver output for WIDTH us at AT us (glitch injection, repeatable)\n"
+      "  --min-pulse US     glitch filter minimum pulse width, 0 to disable (default: %u)\n",
+      prog, IR_PIO_PATH, kDefaultThreshold, INFRARED_SEND_BURST_PERIOD, kDefaultMinPulse);
+}
+
+bool parse_data(const std::string& text, std::vector<uint32_t>* data) {
+  std::string s = text;
+  for (char& c : s) {
+    if (c == ',' || c == '\n' || c == '\r' || c == '\t') c = ' ';
+  }
+  std::istringstream is(s);
+  std::string token;
+  while (is >> token) {
+    char* end = nullptr;
+    unsigned long v = std::strtoul(token.c_str(), &end, 10);
+    if (*end != 0) return false;
+    data->push_back((uint32_t)v);
+  }
+  return true;
+}
+
+// NECフォーマットのフレーム. カスタムコード0x00FF, データ0x45
+std::vector<uint32_t> nec_frame() {
+  std::vector<uint32_t> data = {9000, 4500};
+  uint32_t code = 0x00FF45BA;
+  for (int i = 0; i < 32; i++) {
+    data.push_back(560);
+    data.push_back((code >> i) & 1 ? 1690 : 560);
+  }
+  data.push_back(560);
+  return data;
+}
+
+std::vector<uint32_t> encode(const std::vector<uint32_t>& data) {
+  // infrared_sendと同じ手順でワードに変換する
+  std::vector<uint32_t> words(data.size() + 1);
+  words.resize(infrared_encode_send_words(data.data(), (uint32_t)data.size(), 0, words.data()));
+  return words;
+}
+
+// infrared_sendプログラムを実行し, 送信ピンのエッジを返す
+std::vector<Edge> simulate_send(const PioProgram& program, const Options& opt, const std::vector<uint32_t>& words,
+                                uint64_t* cycles) {
+  // infrared_send_program_initと同じ設定
+  PioStateMachine::Config config;
+  config.clkdiv_fixed = pio_clkdiv_fixed(opt.sys_hz, INFRARED_SEND_SM_HZ);
+  config.out_shift_right = false;
+  config.autopull = true;
+  config.pull_threshold = 32;
+  config.tx_depth = 8;  // PIO_FIFO_JOIN_TX
+  PioStateMachine sm(program, config);
+
+  std::vector<Edge> edges;
+  bool level = false;
+  size_t next = 0;
+  uint64_t cycle = 0;
+  uint64_t start = 0;  // 最初の命令を実行したサイクル. エッジの時刻はここからの相対
+  bool started = false;
+  while (true) {
+    // pio_sm_put_blockingと同様に, FIFOに空きがあればすぐに書き込む
+    while (next < words.size() && !sm.tx_full()) sm.tx_fifo.push_back(words[next++]);
+
+    bool ran = sm.step();
+    if (ran && !started) {
+      start = cycle;
+      started = true;
+    }
+    if (sm.sideset_output() != level) {
+      level = sm.sideset_output();
+      edges.push_back({cycle - start, level});
+    }
+
+    // 全ワード送信後, 次のワード待ちでストールしたら終了
+    if (ran && next >= words.size() && sm.tx_fifo.empty() && sm.stalled()) break;
+    cycle++;
+  }
+  *cycles = cycle - start;
+  return edges;
+}
+
+// 立ち上がりエッジの間隔からバーストを区切り, 受信器の出力(アクティブLow)となる区間を返す
+std::vector<Segment> demodulate(const std::vector<Edge>& edges, uint64_t period_cycles, uint64_t hold_cycles) {
+  std::vector<Segment> bursts;
+  for (const Edge& e : edges) {
+    if (!e.level) continue;
+    if (!bursts.empty() && e.cycle - bursts.back().end < period_cycles * 3 / 2) {
+      bursts.back().end = e.cycle;  // 同じバースト内. endは一旦最後の立ち上がり
+    } else {
+      bursts.push_back({e.cycle, e.cycle});
+    }
+  }
+  for (Segment& b : bursts) b.end += hold_cycles;
+  return bursts;
+}
+
+// infrared_receiveプログラムに復調波形を入力し, RX FIFOに出力された値を返す
+std::vector<uint32_t> simulate_receive(const PioProgram& program, const Options& opt,
+                                       const std::vector<Segment>& bursts, uint64_t* cycles) {
+  // infrared_receive_program_initと同じ設定
+  PioStateMachine::Config config;
+  config.clkdiv_fixed = pio_clkdiv_fixed(opt.sys_hz, INFRARED_RECEIVE_SM_HZ);
+  config.out_shift_right = false;
+  config.autopull = true;
+  config.pull_threshold = 32;
+  config.in_shift_right = false;
+  config.autopush = true;
+  config.push_threshold = 32;
+  PioStateMachine sm(program, config);
+  sm.tx_fifo.push_back(opt.threshold);
+
+  uint64_t offset = (uint64_t)kIdleBeforeUs * opt.sys_hz / 1000000;
+  std::vector<uint32_t> received;
+  size_t seg = 0;
+  uint64_t cycle = 0;
+  while (true) {
+    // 受信器の出力. バースト中はLow, それ以外はプルアップでHigh
+    bool level = true;
+    if (cycle >= offset) {
+      uint64_t t = cycle - offset;
+      while (seg < bursts.size() && t >= bursts[seg].end) seg++;
+      if (seg < bursts.size() && t >= bursts[seg].start) level = false;
+    }
+    for (const Segment& g : opt.spikes) {
+      uint64_t start = offset + g.start * opt.sys_hz / 1000000;
+      uint64_t end = offset + g.end * opt.sys_hz / 1000000;
+      if (cycle >= start && cycle < end) level = !level;
+    }
+    sm.set_input(level);
+    sm.step();
+    cycle++;
+
+    // pio_sm_get_blockingと同様に, 受信した値をすぐに読み出す
+    if (!sm.rx_fifo.empty()) {
+      uint32_t rec = sm.rx_fifo.front();
+      sm.rx_fifo.pop_front();
+      if (rec == 0) break;
+      received.push_back(rec);
+    }
+  }
+  *cycles = cycle;
+  return received;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--pio") {
+      opt.pio_path = next();
+    } else if (arg == "--clk") {
+      opt.sys_hz = (uint32_t)std::strtoul(next(), nullptr, 0);
+    } else if (arg == "--threshold") {
+      opt.threshold = (uint32_t)std::strtoul(next(), nullptr, 0);
+    } else if (arg == "--demod-hold") {
+      opt.demod_hold_us = std::atof(next());
+    } else if (arg == "--waveform") {
+      opt.waveform = true;
+    } else if (arg == "--repeat") {
+      opt.repeat = std::atoi(next());
+    } else if (arg == "--max-error") {
+      opt.max_error_us = std::atof(next());
+    } else if (arg == "--min-pulse") {
+      opt.min_pulse = (uint32_t)std::strtoul(next(), nullptr, 0);
+    } else if (arg == "--spike") {
+      unsigned long at, width;
+      if (std::sscanf(next(), "%lu:%lu", &at, &width) != 2) {
+        usage(argv[0]);
+        return 2;
+      }
+      opt.spikes.push_back({at, at + width});
+    } else if (arg == "--file") {
+      std::ifstream f(next());
+      std::stringstream ss;
+      ss << f.rdbuf();
+      if (!f || !parse_data(ss.str(), &opt.data)) {
+        std::fprintf(stderr, "cannot read data file\n");
+        return 2;
+      }
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (!parse_data(arg, &opt.data)) {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opt.data.empty()) opt.data = nec_frame();
+  if (opt.sys_hz < INFRARED_RECEIVE_SM_HZ || opt.repeat < 1) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::string error;
+  PioProgram send_program, receive_program;
+  if (!send_program.load(opt.pio_path, "infrared_send", &error) ||
+      !receive_program.load(opt.pio_path, "infrared_receive", &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 2;
+  }
+
+  uint32_t send_div = pio_clkdiv_fixed(opt.sys_hz, INFRARED_SEND_SM_HZ);
+  uint32_t receive_div = pio_clkdiv_fixed(opt.sys_hz, INFRARED_RECEIVE_SM_HZ);
+  double us_per_cycle = 1e6 / opt.sys_hz;
+  uint64_t period_cycles = (uint64_t)INFRARED_SEND_BURST_PERIOD * send_div / 256;
+  uint64_t hold_cycles = (uint64_t)std::llround(opt.demod_hold_us / us_per_cycle);
+
+  std::vector<uint32_t> words = encode(opt.data);
+  std::vector<Edge> edges;
+  std::vector<Segment> bursts;
+  std::vector<uint32_t> raw;
+  std::vector<uint32_t> received;
+  uint64_t send_cycles = 0, receive_cycles = 0;
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < opt.repeat; r++) {
+    edges = simulate_send(send_program, opt, words, &send_cycles);
+    bursts = demodulate(edges, period_cycles, hold_cycles);
+    raw = simulate_receive(receive_program, opt, bursts, &receive_cycles);
+
+    // infrared_receive_pollと同じグリッチ除去
+    received.assign(raw.size(), 0);
+    infrared_receive_filter_t filter;
+    infrared_receive_filter_init(&filter, received.data(), (uint32_t)received.size(), opt.min_pulse);
+    for (uint32_t v : raw) infrared_receive_filter_push(&filter, v);
+    received.resize(infrared_receive_filter_finish(&filter));
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  std::printf("clk_sys: %u Hz\n", opt.sys_hz);
+  std::printf("send clkdiv: %u + %u/256\n", send_div >> 8, send_div & 0xFF);
+  std::printf("receive clkdiv: %u + %u/256\n", receive_div >> 8, receive_div & 0xFF);
+
+  if (opt.waveform) {
+    std::printf("\nSend pin edges [us]\n");
+    for (const Edge& e : edges) std::printf(" %.3f %d\n", e.cycle * us_per_cycle, e.level ? 1 : 0);
+  }
+
+  // 送信波形の各要素の長さ. ON: 最初の立ち上がりから復調出力の終わりまで. OFF: 次のバーストまで.
+  std::vector<double> sent;
+  for (size_t i = 0; i < bursts.size(); i++) {
+    sent.push_back((bursts[i].end - bursts[i].start) * us_per_cycle);
+    if (i + 1 < bursts.size()) sent.push_back((bursts[i + 1].start - bursts[i].end) * us_per_cycle);
+  }
+
+  std::printf("\n%5s %4s %10s %10s %10s %10s %9s %9s\n", "index", "kind", "request", "word", "sent", "received",
+              "err_sent", "err_recv");
+  double max_sent_err = 0, max_recv_err = 0, sum_recv_err = 0;
+  size_t rows = opt.data.size();
+  for (size_t i = 0; i < rows; i++) {
+    double req = opt.data[i];
+    std::printf("%5zu %4s %10u %10u", i, i % 2 ? "OFF" : "ON", opt.data[i], words[i]);
+    if (i < sent.size()) {
+      std::printf(" %10.2f", sent[i]);
+      max_sent_err = std::fmax(max_sent_err, std::fabs(sent[i] - req));
+    } else {
+      std::printf(" %10s", "-");
+    }
+    if (i < received.size()) {
+      double err = (double)received[i] - req;
+      std::printf(" %10u", received[i]);
+      max_recv_err = std::fmax(max_recv_err, std::fabs(err));
+      sum_recv_err += err;
+    } else {
+      std::printf(" %10s", "-");
+    }
+    if (i < sent.size()) std::printf(" %9.2f", sent[i] - req);
+    if (i < received.size()) std::printf(" %9.2f", (double)received[i] - req);
+    std::printf("\n");
+  }
+
+  // 最後がOFF要素の場合, その後にバーストが無いため受信側ではしきい値超過となり測定されない
+  size_t expected = rows % 2 ? rows : rows - 1;
+  bool complete = received.size() == expected;
+  uint64_t total_cycles = (send_cycles + receive_cycles) * (uint64_t)opt.repeat;
+
+  std::printf("\nelements: %zu\n", rows);
+  std::printf("received elements: %zu%s (%zu before glitch filter)\n", received.size(), complete ? "" : " (MISMATCH)",
+              raw.size());
+  std::printf("send duration: %.1f us (expected %llu us)\n", send_cycles * us_per_cycle,
+              (unsigned long long)infrared_send_words_duration(words.data(), (uint32_t)words.size()));
+  std::printf("max |error| sent: %.2f us\n", max_sent_err);
+  std::printf("max |error| received: %.2f us\n", max_recv_err);
+  if (!received.empty()) std::printf("mean error received: %.3f us\n", sum_recv_err / received.size());
+  std::printf("simulated cycles: %llu\n", (unsigned long long)total_cycles);
+  std::printf("simulation speed: %.1f Mcycles/s\n", elapsed > 0 ? total_cycles / elapsed / 1e6 : 0.0);
+
+  if (!complete) return 1;
+  if (opt.max_error_us >= 0 && (max_sent_err > opt.max_error_us || max_recv_err > opt.max_error_us)) return 1;
+  return 0;
+}
@@ -0,0 +1,484 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pio_sim.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+std::string trim(const std::string& s) {
+  size_t b = s.find_first_not_of(" \t\r\n");
+  if (b == std::string::npos) return "";
+  size_t e = s.find_last_not_of(" \t\r\n");
+  return s.substr(b, e - b + 1);
+}
+
+// コメントを除去. "//" と ";" 以降を無視する
+std::string strip_comment(const std::string& line) {
+  size_t pos = line.find("//");
+  std::string s = pos == std::string::npos ? line : line.substr(0, pos);
+  pos = s.find(';');
+  if (pos != std::string::npos) s = s.substr(0, pos);
+  return trim(s);
+}
+
+// カンマと空白で区切る
+std::vector<std::string> tokenize(const std::string& s) {
+  std::vector<std::string> tokens;
+  std::string cur;
+  for (char c : s) {
+    if (c == ' ' || c == '\t' || c == ',') {
+      if (!cur.empty()) tokens.push_back(cur);
+      cur.clear();
+    } else {
+      cur += c;
+    }
+  }
+  if (!cur.empty()) tokens.push_back(cur);
+  return tokens;
+}
+
+bool parse_operand(std::string s, PioInstruction::Operand* op, bool* invert) {
+  *invert = false;
+  if (!s.empty() && (s[0] == '~' || s[0] == '!')) {
+    *invert = true;
+    s = s.substr(1);
+  }
+  if (s == "pins") *op = PioInstruction::PINS;
+  else if (s == "x") *op = PioInstruction::X;
+  else if (s == "y") *op = PioInstruction::Y;
+  else if (s == "null") *op = PioInstruction::NULL_;
+  else if (s == "isr") *op = PioInstruction::ISR;
+  else if (s == "osr") *op = PioInstruction::OSR;
+  else if (s == "status") *op = PioInstruction::STATUS;
+  else if (s == "pc") *op = PioInstruction::PC;
+  else if (s == "exec") *op = PioInstruction::EXEC;
+  else return false;
+  return true;
+}
+
+bool parse_number(const std::string& s, uint32_t* value) {
+  if (s.empty()) return false;
+  char* end = nullptr;
+  unsigned long v = std::strtoul(s.c_str(), &end, 0);
+  if (*end != 0) return false;
+  *value = (uint32_t)v;
+  return true;
+}
+
+}  // namespace
+
+bool PioProgram::load(const std::string& path, const std::string& program_name, std::string* error) {
+  std::ifstream file(path);
+  if (!file) {
+    *error = "cannot open " + path;
+    return false;
+  }
+
+  // ラベル解決のため, 1パス目で命令行を集めて2パス目で変換する
+  struct Line {
+    std::string text;
+    int number;
+  };
+  std::vector<Line> lines;
+  bool in_program = false;
+  bool found = false;
+  bool wrap_set = false;
+  std::string raw;
+  int number = 0;
+  while (std::getline(file, raw)) {
+    number++;
+    std::string s = strip_comment(raw);
+    if (s.empty()) continue;
+
+    if (s[0] == '.') {
+      std::vector<std::string> t = tokenize(s);
+      if (t[0] == ".program") {
+        in_program = t.size() > 1 && t[1] == program_name;
+        if (in_program) found = true;
+      } else if (in_program && t[0] == ".side_set") {
+        if (t.size() < 2 || !parse_number(t[1], &sideset_bits)) {
+          *error = path + ":" + std::to_string(number) + ": bad .side_set";
+          return false;
+        }
+        sideset_optional = t.size() > 2 && t[2] == "opt";
+      } else if (in_program && t[0] == ".wrap_target") {
+        wrap_target = (uint32_t)lines.size();
+      } else if (in_program && t[0] == ".wrap") {
+        wrap = (uint32_t)lines.size() - 1;
+        wrap_set = true;
+      }
+      continue;
+    }
+    if (!in_program) continue;
+
+    // ラベル
+    size_t colon = s.find(':');
+    if (colon != std::string::npos) {
+      labels[trim(s.substr(0, colon))] = (uint32_t)lines.size();
+      s = trim(s.substr(colon + 1));
+      if (s.empty()) continue;
+    }
+    lines.push_back({s, number});
+  }
+
+  if (!found) {
+    *error = "program " + program_name + " not found in " + path;
+    return false;
+  }
+  if (lines.empty()) {
+    *error = "program " + program_name + " is empty";
+    return false;
+  }
+  if (!wrap_set) wrap = (uint32_t)lines.size() - 1;
+  name = program_name;
+
+  for (const Line& line : lines) {
+    std::string where = path + ":" + std::to_string(line.number) + ": ";
+    std::string s = line.text;
+    PioInstruction ins;
+    ins.text = s;
+
+    // 遅延 [n]
+    size_t bracket = s.find('[');
+    if (bracket != std::string::npos) {
+      size_t close = s.find(']', bracket);
+      if (close == std::string::npos || !parse_number(trim(s.substr(bracket + 1, close - bracket - 1)), &ins.delay)) {
+        *error = where + "bad delay";
+        return false;
+      }
+      s = trim(s.substr(0, bracket));
+    }
+
+    std::vector<std::string> t = tokenize(s);
+
+    // サイドセット side n
+    for (size_t i = 0; i < t.size(); i++) {
+      if (t[i] == "side") {
+        uint32_t v;
+        if (i + 1 >= t.size() || !parse_number(t[i + 1], &v)) {
+          *error = where + "bad side-set";
+          return false;
+        }
+        ins.side = (int)v;
+        t.erase(t.begin() + i, t.begin() + i + 2);
+        break;
+      }
+    }
+    if (sideset_bits > 0 && !sideset_optional && ins.side < 0) {
+      *error = where + "side-set is mandatory";
+      return false;
+    }
+    uint32_t delay_max = (1u << (5 - sideset_bits - (sideset_optional ? 1 : 0))) - 1;
+    if (ins.delay > delay_max) {
+      *error = where + "delay too large";
+      return false;
+    }
+
+    const std::string& op = t[0];
+    bool ok = true;
+    if (op == "nop") {
+      ins.op = PioInstruction::MOV;  // nopはmov y, yと同じ
+      ins.dest = ins.src = PioInstruction::Y;
+    } else if (op == "jmp") {
+      ins.op = PioInstruction::JMP;
+      std::string label;
+      if (t.size() == 2) {
+        label = t[1];
+      } else if (t.size() == 3) {
+        label = t[2];
+        const std::string& c = t[1];
+        if (c == "!x") ins.cond = PioInstruction::NOT_X;
+        else if (c == "x--") ins.cond = PioInstruction::X_DEC;
+        else if (c == "!y") ins.cond = PioInstruction::NOT_Y;
+        else if (c == "y--") ins.cond = PioInstruction::Y_DEC;
+        else if (c == "x!=y") ins.cond = PioInstruction::X_NE_Y;
+        else if (c == "pin") ins.cond = PioInstruction::PIN;
+        else if (c == "!osre") ins.cond = PioInstruction::NOT_OSRE;
+        else ok = false;
+      } else {
+        ok = false;
+      }
+      if (ok) {
+        auto it = labels.find(label);
+        if (it != labels.end()) {
+          ins.target = it->second;
+        } else {
+          ok = parse_number(label, &ins.target);
+        }
+      }
+    } else if (op == "wait") {
+      ins.op = PioInstruction::WAIT;
+      ok = t.size() == 4 && t[2] == "pin" && parse_number(t[3], &ins.wait_index);
+      if (ok) ins.polarity = t[1] == "1";
+    } else if (op == "in" || op == "out") {
+      ins.op = op == "in" ? PioInstruction::IN : PioInstruction::OUT;
+      bool inv;
+      ok = t.size() == 3 && parse_operand(t[1], op == "in" ? &ins.src : &ins.dest, &inv) &&
+           parse_number(t[2], &ins.bit_count) && ins.bit_count >= 1 && ins.bit_count <= 32;
+    } else if (op == "push" || op == "pull") {
+      ins.op = op == "push" ? PioInstruction::PUSH : PioInstruction::PULL;
+      for (size_t i = 1; i < t.size(); i++) {
+        if (t[i] == "noblock") ins.block = false;
+        else if (t[i] != "block") ok = false;
+      }
+    } else if (op == "mov") {
+      ins.op = PioInstruction::MOV;
+      bool inv;
+      ok = t.size() == 3 && parse_operand(t[1], &ins.dest, &inv) && parse_operand(t[2], &ins.src, &ins.invert);
+    } else if (op == "set") {
+      ins.op = PioInstruction::SET;
+      bool inv;
+      ok = t.size() == 3 && parse_operand(t[1], &ins.dest, &inv) && parse_number(t[2], &ins.value);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      *error = where + "unsupported instruction: " + line.text;
+      return false;
+    }
+    code.push_back(ins);
+  }
+  return true;
+}
+
+uint32_t pio_clkdiv_fixed(uint32_t sys_hz, uint32_t sm_hz) {
+  // sm_config_set_clkdivと同じ計算. floatで割って整数部と小数部8bitに切り捨てる
+  float div = (float)sys_hz / sm_hz;
+  uint32_t div_int = (uint32_t)div;
+  uint32_t div_frac = (uint32_t)((div - div_int) * 256);
+  if (div_int == 0) return 256;
+  return (div_int << 8) | div_frac;
+}
+
+PioStateMachine::PioStateMachine(const PioProgram& program, const Config& config)
+    : program_(program), config_(config) {
+  reset();
+}
+
+// pio_sm_initに相当. レジスター, FIFO, PCを初期化する
+void PioStateMachine::reset() {
+  tx_fifo.clear();
+  rx_fifo.clear();
+  phase_ = 0;
+  pc_ = 0;
+  x_ = y_ = osr_ = isr_ = 0;
+  osr_count_ = 32;
+  isr_count_ = 0;
+  delay_ = 0;
+  stalled_ = false;
+  executed_ = 0;
+}
+
+bool PioStateMachine::step() {
+  // 分周器. 平均してclkdiv_fixed/256サイクルに1回クロックイネーブルが立つ
+  phase_ += 256;
+  if (phase_ < config_.clkdiv_fixed) return false;
+  phase_ -= config_.clkdiv_fixed;
+
+  if (delay_ > 0) {
+    delay_--;
+    return true;
+  }
+  execute();
+  return true;
+}
+
+uint32_t PioStateMachine::read_operand(PioInstruction::Operand src) {
+  switch (src) {
+    case PioInstruction::PINS:
+      return input_ ? 1 : 0;
+    case PioInstruction::X:
+      return x_;
+    case PioInstruction::Y:
+      return y_;
+    case PioInstruction::ISR:
+      return isr_;
+    case PioInstruction::OSR:
+      return osr_;
+    default:
+      return 0;
+  }
+}
+
+void PioStateMachine::write_operand(PioInstruction::Operand dest, uint32_t value) {
+  switch (dest) {
+    case PioInstruction::X:
+      x_ = value;
+      break;
+    case PioInstruction::Y:
+      y_ = value;
+      break;
+    case PioInstruction::ISR:
+      isr_ = value;
+      isr_count_ = 0;
+      break;
+    case PioInstruction::OSR:
+      osr_ = value;
+      osr_count_ = 0;
+      break;
+    case PioInstruction::PC:
+      pc_ = value;
+      break;
+    default:
+      break;
+  }
+}
+
+void PioStateMachine::advance_pc() {
+  if (pc_ == program_.wrap) {
+    pc_ = program_.wrap_target;
+  } else {
+    pc_++;
+  }
+}
+
+void PioStateMachine::execute() {
+  const PioInstruction& ins = program_.code[pc_];
+
+  // サイドセットはストール中でも命令の1サイクル目から出力される
+  if (ins.side >= 0) sideset_out_ = ins.side & 1;
+
+  bool stall = false;
+  bool jumped = false;
+  switch (ins.op) {
+    case PioInstruction::JMP: {
+      bool take = false;
+      switch (ins.cond) {
+        case PioInstruction::ALWAYS:
+          take = true;
+          break;
+        case PioInstruction::NOT_X:
+          take = x_ == 0;
+          break;
+        case PioInstruction::X_DEC:
+          take = x_ != 0;
+          x_--;
+          break;
+        case PioInstruction::NOT_Y:
+          take = y_ == 0;
+          break;
+        case PioInstruction::Y_DEC:
+          take = y_ != 0;
+          y_--;
+          break;
+        case PioInstruction::X_NE_Y:
+          take = x_ != y_;
+          break;
+        case PioInstruction::PIN:
+          take = input_;
+          break;
+        case PioInstruction::NOT_OSRE:
+          take = osr_count_ < config_.pull_threshold;
+          break;
+      }
+      if (take) {
+        pc_ = ins.target;
+        jumped = true;
+      }
+      break;
+    }
+    case PioInstruction::WAIT:
+      stall = input_ != ins.polarity;
+      break;
+    case PioInstruction::IN: {
+      if (config_.autopush && isr_count_ >= config_.push_threshold) {
+        // 前回のINでしきい値に達したが, RX FIFOが満杯でプッシュできていない
+        if (rx_fifo.size() >= config_.rx_depth) {
+          stall = true;
+          break;
+        }
+        rx_fifo.push_back(isr_);
+        isr_ = 0;
+        isr_count_ = 0;
+      }
+      uint32_t mask = ins.bit_count == 32 ? 0xFFFFFFFF : ((1u << ins.bit_count) - 1);
+      uint32_t data = read_operand(ins.src) & mask;
+      if (config_.in_shift_right) {
+        isr_ = ins.bit_count == 32 ? data : (isr_ >> ins.bit_count) | (data << (32 - ins.bit_count));
+      } else {
+        isr_ = ins.bit_count == 32 ? data : (isr_ << ins.bit_count) | data;
+      }
+      isr_count_ += ins.bit_count;
+      if (config_.autopush && isr_count_ >= config_.push_threshold && rx_fifo.size() < config_.rx_depth) {
+        rx_fifo.push_back(isr_);
+        isr_ = 0;
+        isr_count_ = 0;
+      }
+      break;
+    }
+    case PioInstruction::OUT: {
+      if (config_.autopull && osr_count_ >= config_.pull_threshold) {
+        if (tx_fifo.empty()) {
+          stall = true;
+          break;
+        }
+        osr_ = tx_fifo.front();
+        tx_fifo.pop_front();
+        osr_count_ = 0;
+      }
+      uint32_t data;
+      if (ins.bit_count == 32) {
+        data = osr_;
+        osr_ = 0;
+      } else if (config_.out_shift_right) {
+        data = osr_ & ((1u << ins.bit_count) - 1);
+        osr_ >>= ins.bit_count;
+      } else {
+        data = osr_ >> (32 - ins.bit_count);
+        osr_ <<= ins.bit_count;
+      }
+      osr_count_ += ins.bit_count;
+      write_operand(ins.dest, data);
+      if (ins.dest == PioInstruction::PC) jumped = true;
+      if (ins.dest == PioInstruction::OSR) osr_count_ = 0;
+      break;
+    }
+    case PioInstruction::PUSH:
+      if (rx_fifo.size() >= config_.rx_depth) {
+        stall = ins.block;
+        if (stall) break;
+      } else {
+        rx_fifo.push_back(isr_);
+      }
+      isr_ = 0;
+      isr_count_ = 0;
+      break;
+    case PioInstruction::PULL:
+      if (tx_fifo.empty()) {
+        if (ins.block) {
+          stall = true;
+          break;
+        }
+        osr_ = x_;  // noblockで空の場合はXをコピー
+      } else {
+        osr_ = tx_fifo.front();
+        tx_fifo.pop_front();
+      }
+      osr_count_ = 0;
+      break;
+    case PioInstruction::MOV: {
+      uint32_t v = read_operand(ins.src);
+      if (ins.invert) v = ~v;
+      write_operand(ins.dest, v);
+      if (ins.dest == PioInstruction::PC) jumped = true;
+      break;
+    }
+    case PioInstruction::SET:
+      write_operand(ins.dest, ins.value);
+      break;
+  }
+
+  stalled_ = stall;
+  if (stall) return;  // ストール中は遅延を消費せず, 次のサイクルで同じ命令を再実行する
+
+  executed_++;
+  delay_ = ins.delay;
+  if (!jumped) advance_pc();
+}
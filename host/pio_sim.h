@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef PIO_SIM_H
+#define PIO_SIM_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// .pioファイルの1命令
+struct PioInstruction {
+  enum Op { JMP, WAIT, IN, OUT, PUSH, PULL, MOV, SET };
+  enum Cond { ALWAYS, NOT_X, X_DEC, NOT_Y, Y_DEC, X_NE_Y, PIN, NOT_OSRE };
+  enum Operand { PINS, X, Y, NULL_, ISR, OSR, STATUS, PC, EXEC };
+
+  Op op = MOV;
+  Cond cond = ALWAYS;       // JMPの条件
+  uint32_t target = 0;      // JMPの飛び先アドレス
+  Operand dest = Y;         // MOV, SET, OUTの書き込み先
+  Operand src = Y;          // MOV, INの読み出し元
+  bool invert = false;      // MOVの~
+  uint32_t bit_count = 32;  // IN, OUTのビット数
+  uint32_t value = 0;       // SETの値
+  bool polarity = false;    // WAITの極性
+  uint32_t wait_index = 0;  // WAIT pinのピン番号(in_base相対)
+  bool block = true;        // PUSH, PULLのblock
+  int side = -1;            // サイドセットの値. -1で指定なし
+  uint32_t delay = 0;       // 遅延サイクル数
+  std::string text;         // 元のソース(表示用)
+};
+
+// .pioファイルの1プログラム
+struct PioProgram {
+  std::string name;
+  std::vector<PioInstruction> code;
+  std::map<std::string, uint32_t> labels;
+  uint32_t sideset_bits = 0;
+  bool sideset_optional = false;
+  uint32_t wrap_target = 0;
+  uint32_t wrap = 0;
+
+  // .pioファイルからプログラムを読み込む. 対応する命令はinfrared.pioで使っているもの程度.
+  //
+  // Args:
+  //   path: .pioファイルのパス
+  //   name: .programで指定したプログラム名
+  //   error: 失敗時のメッセージ格納先
+  //
+  // Returns: 成功でtrue, 失敗でfalse
+  bool load(const std::string& path, const std::string& name, std::string* error);
+};
+
+// SDKのsm_config_set_clkdivと同じく, 浮動小数の分周比を16.8固定小数に変換する
+//
+// Args:
+//   sys_hz: システムクロック[Hz]
+//   sm_hz: ステートマシンの命令実行周波数[Hz]
+//
+// Returns: 分周比x256
+uint32_t pio_clkdiv_fixed(uint32_t sys_hz, uint32_t sm_hz);
+
+// PIOステートマシン1つ分のサイクル精度シミュレーター
+// システムクロック1サイクルごとにstep()を呼ぶ
+class PioStateMachine {
+ public:
+  // 設定はinfrared_xxx_program_initでSDKに渡すものと同じ
+  struct Config {
+    uint32_t clkdiv_fixed = 256;  // 分周比x256
+    bool out_shift_right = false;
+    bool autopull = false;
+    uint32_t pull_threshold = 32;
+    bool in_shift_right = false;
+    bool autopush = false;
+    uint32_t push_threshold = 32;
+    uint32_t tx_depth = 4;  // FIFO段数. PIO_FIFO_JOIN_TXなら8
+    uint32_t rx_depth = 4;
+  };
+
+  std::deque<uint32_t> tx_fifo;
+  std::deque<uint32_t> rx_fifo;
+
+  PioStateMachine(const PioProgram& program, const Config& config);
+  void reset();
+  void set_input(bool level) { input_ = level; }  // in_baseおよびjmp_pinのピンの入力
+  bool sideset_output() const { return sideset_out_; }
+  bool tx_full() const { return tx_fifo.size() >= config_.tx_depth; }
+  bool stalled() const { return stalled_; }
+  uint32_t pc() const { return pc_; }
+  uint64_t executed() const { return executed_; }
+
+  // システムクロック1サイクル進める
+  //
+  // Returns: このサイクルで命令を実行(もしくはストール)したらtrue
+  bool step();
+
+ private:
+  const PioProgram& program_;
+  Config config_;
+  uint32_t phase_ = 0;  // 分周器の位相
+  uint32_t pc_ = 0;
+  uint32_t x_ = 0;
+  uint32_t y_ = 0;
+  uint32_t osr_ = 0;
+  uint32_t osr_count_ = 32;  // OSRからシフトアウト済みのビット数. 32で空
+  uint32_t isr_ = 0;
+  uint32_t isr_count_ = 0;
+  uint32_t delay_ = 0;
+  bool stalled_ = false;
+  bool input_ = true;
+  bool sideset_out_ = false;
+  uint64_t executed_ = 0;
+
+  void execute();
+  uint32_t read_operand(PioInstruction::Operand src);
+  void write_operand(PioInstruction::Operand dest, uint32_t value);
+  void advance_pc();
+};
+
+#endif
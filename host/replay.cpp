@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "replay.h"
+
+#include <algorithm>
+
+#include "scd41.h"
+#include "tsl2572.h"
+
+void Bme280Columns::clear() {
+  time_us.clear();
+  adc_temperature.clear();
+  adc_pressure.clear();
+  adc_humidity.clear();
+  temperature_x100.clear();
+  pressure_x100.clear();
+  humidity_x100.clear();
+}
+
+void Tsl2572Columns::clear() {
+  time_us.clear();
+  id.clear();
+  ch0.clear();
+  ch1.clear();
+  integ_cycles.clear();
+  again.clear();
+  lux.clear();
+}
+
+void Scd41Columns::clear() {
+  time_us.clear();
+  id.clear();
+  co2.clear();
+  temperature_raw.clear();
+  humidity_raw.clear();
+  temperature_x100.clear();
+  humidity_x100.clear();
+}
+
+// 補正計算はt_fineを介して温度, 気圧, 湿度の順に依存するため, サンプルごとにcalculate_measured_valuesを呼ぶ.
+// 気圧の64bitの除算が大部分を占める
+void replay_bme280(BME280& sensor, Bme280Columns& c) {
+  size_t n = c.size();
+  c.temperature_x100.resize(n);
+  c.pressure_x100.resize(n);
+  c.humidity_x100.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    sensor.adc_temperature = c.adc_temperature[i];
+    sensor.adc_pressure = c.adc_pressure[i];
+    sensor.adc_humidity = c.adc_humidity[i];
+    sensor.calculate_measured_values();
+    c.temperature_x100[i] = sensor.temperature_x100;
+    c.pressure_x100[i] = sensor.pressure_x100;
+    c.humidity_x100[i] = sensor.humidity_x100;
+  }
+}
+
+void replay_tsl2572(Tsl2572Columns& c) {
+  size_t n = c.size();
+  c.lux.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    c.lux[i] = tsl2572_lux(c.ch0[i], c.ch1[i], c.integ_cycles[i], c.again[i]);
+  }
+}
+
+void replay_scd41(Scd41Columns& c) {
+  size_t n = c.size();
+  c.temperature_x100.resize(n);
+  c.humidity_x100.resize(n);
+  const uint16_t* t = c.temperature_raw.data();
+  const uint16_t* h = c.humidity_raw.data();
+  int32_t* t_x100 = c.temperature_x100.data();
+  uint32_t* h_x100 = c.humidity_x100.data();
+  for (size_t i = 0; i < n; i++) {
+    t_x100[i] = scd41_convert_temperature_x100(t[i]);
+    h_x100[i] = scd41_convert_humidity_x100(h[i]);
+  }
+}
+
+namespace {
+
+// Returns: valuesが全てmin以上max以下ならtrue
+bool in_range(const std::vector<int32_t>& values, int32_t min, int32_t max) {
+  for (int32_t v : values) {
+    if (v < min || v > max) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+void SensorReplay::add(const TelemetryRecord& r) {
+  switch (r.type) {
+    case TELEMETRY_BME280_CAL: {
+      if (r.values.size() != BME280::CAL_LENGTH || !in_range(r.values, 0, 0xFF)) {
+        stats_.invalid++;
+        return;
+      }
+      Bme280State& s = bme280_[r.id];
+      BME280::CalibrationData cal;
+      for (size_t i = 0; i < r.values.size(); i++) cal.byte[i] = (uint8_t)r.values[i];
+      if (s.calibrated && std::equal(cal.byte, cal.byte + BME280::CAL_LENGTH, s.sensor.calibration_data.byte)) {
+        return;  // 同じキャリブレーションデータは毎回送られるので, 列を区切らない
+      }
+      flush_bme280(s);
+      s.sensor.calibration_data = cal;
+      s.calibrated = true;
+      s.columns.id = r.id;
+      break;
+    }
+    case TELEMETRY_BME280_RAW: {
+      if (r.values.size() != 3 || !in_range(r.values, 0, 0xFFFFF)) {  // ADCは20bit
+        stats_.invalid++;
+        return;
+      }
+      auto it = bme280_.find(r.id);
+      if (it == bme280_.end() || !it->second.calibrated) {
+        stats_.no_calibration++;
+        return;
+      }
+      Bme280Columns& c = it->second.columns;
+      c.time_us.push_back(r.time_us);
+      c.adc_temperature.push_back(r.values[0]);
+      c.adc_pressure.push_back(r.values[1]);
+      c.adc_humidity.push_back(r.values[2]);
+      if (c.size() >= kBatch) flush_bme280(it->second);
+      break;
+    }
+    case TELEMETRY_TSL2572_RAW: {
+      if (r.values.size() != 4 || !in_range(r.values, 0, 0xFFFF) || r.values[2] < 1 || r.values[2] > 256 ||
+          r.values[3] > TSL2572_AGAIN_120) {
+        stats_.invalid++;
+        return;
+      }
+      tsl2572_.time_us.push_back(r.time_us);
+      tsl2572_.id.push_back(r.id);
+      tsl2572_.ch0.push_back(r.values[0]);
+      tsl2572_.ch1.push_back(r.values[1]);
+      tsl2572_.integ_cycles.push_back(r.values[2]);
+      tsl2572_.again.push_back(r.values[3]);
+      if (tsl2572_.size() >= kBatch) flush_tsl2572();
+      break;
+    }
+    case TELEMETRY_SCD41_RAW: {
+      if (r.values.size() != 3 || !in_range(r.values, 0, 0xFFFF)) {
+        stats_.invalid++;
+        return;
+      }
+      scd41_.time_us.push_back(r.time_us);
+      scd41_.id.push_back(r.id);
+      scd41_.co2.push_back(r.values[0]);
+      scd41_.temperature_raw.push_back(r.values[1]);
+      scd41_.humidity_raw.push_back(r.values[2]);
+      if (scd41_.size() >= kBatch) flush_scd41();
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void SensorReplay::flush() {
+  for (auto& [id, s] : bme280_) flush_bme280(s);
+  flush_tsl2572();
+  flush_scd41();
+}
+
+void SensorReplay::flush_bme280(Bme280State& s) {
+  if (!s.columns.size()) return;
+  replay_bme280(s.sensor, s.columns);
+  stats_.bme280 += s.columns.size();
+  if (output_.bme280) output_.bme280(s.columns);
+  s.columns.clear();
+}
+
+void SensorReplay::flush_tsl2572() {
+  if (!tsl2572_.size()) return;
+  replay_tsl2572(tsl2572_);
+  stats_.tsl2572 += tsl2572_.size();
+  if (output_.tsl2572) output_.tsl2572(tsl2572_);
+  tsl2572_.clear();
+}
+
+void SensorReplay::flush_scd41() {
+  if (!scd41_.size()) return;
+  replay_scd41(scd41_);
+  stats_.scd41 += scd41_.size();
+  if (output_.scd41) output_.scd41(scd41_);
+  scd41_.clear();
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// 記録した変換前の値(common/telemetry.hのBME280_RAW, BME280_CAL, TSL2572_RAW, SCD41_RAW)から,
+// ドライバーと同じ計算で測定値を求め直す. 計算はBME280::calculate_measured_values, tsl2572_lux,
+// scd41_convert_temperature_x100などドライバーの関数をそのまま呼ぶので, ドライバーを修正して再ビルドすれば
+// 記録した値から修正後の測定値が得られる.
+//
+// レコードは種類ごとに列(値の種類ごとの配列)にため, kBatch個ごとにまとめて計算する.
+// 計算のループは配列を順に読み書きするだけにして, レコードの復号や分岐を含めない.
+// SCD41の変換はヘッダーのインライン関数なので, コンパイラーがベクトル化できる.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "bme280.h"
+#include "telemetry_decoder.h"
+
+// BME280の列. 同じセンサー番号, 同じキャリブレーションデータのサンプル
+struct Bme280Columns {
+  uint8_t id = 0;
+  std::vector<uint64_t> time_us;
+  std::vector<uint32_t> adc_temperature;
+  std::vector<uint32_t> adc_pressure;
+  std::vector<uint32_t> adc_humidity;
+  std::vector<int32_t> temperature_x100;  // 計算結果. 温度[0.01℃]
+  std::vector<uint32_t> pressure_x100;    // 計算結果. 気圧[0.01hPa]
+  std::vector<uint32_t> humidity_x100;    // 計算結果. 湿度[0.01%]
+
+  size_t size() const { return time_us.size(); }
+  void clear();
+};
+
+// TSL2572の列
+struct Tsl2572Columns {
+  std::vector<uint64_t> time_us;
+  std::vector<uint8_t> id;
+  std::vector<uint16_t> ch0;
+  std::vector<uint16_t> ch1;
+  std::vector<uint16_t> integ_cycles;
+  std::vector<uint8_t> again;
+  std::vector<float> lux;  // 計算結果. 照度[lux]
+
+  size_t size() const { return time_us.size(); }
+  void clear();
+};
+
+// SCD41の列
+struct Scd41Columns {
+  std::vector<uint64_t> time_us;
+  std::vector<uint8_t> id;
+  std::vector<uint16_t> co2;
+  std::vector<uint16_t> temperature_raw;
+  std::vector<uint16_t> humidity_raw;
+  std::vector<int32_t> temperature_x100;  // 計算結果. 温度[0.01℃]
+  std::vector<uint32_t> humidity_x100;    // 計算結果. 湿度[0.01%]
+
+  size_t size() const { return time_us.size(); }
+  void clear();
+};
+
+// 列単位の計算. 入力の列から計算結果の列を作る. sensorにはキャリブレーションデータを入れておく
+void replay_bme280(BME280& sensor, Bme280Columns& c);
+void replay_tsl2572(Tsl2572Columns& c);
+void replay_scd41(Scd41Columns& c);
+
+struct ReplayStats {
+  uint64_t bme280 = 0;          // 計算したBME280のサンプル数
+  uint64_t tsl2572 = 0;         // 計算したTSL2572のサンプル数
+  uint64_t scd41 = 0;           // 計算したSCD41のサンプル数
+  uint64_t no_calibration = 0;  // キャリブレーションデータを受信する前で計算できなかったBME280のサンプル数
+  uint64_t invalid = 0;         // 値の個数や範囲がレコードの種類の定義と違うレコードの数
+};
+
+class SensorReplay {
+ public:
+  static constexpr size_t kBatch = 4096;  // まとめて計算するサンプル数
+
+  // 計算した列を受け取る関数. 不要な種類は空のままでよい
+  struct Output {
+    std::function<void(const Bme280Columns&)> bme280;
+    std::function<void(const Tsl2572Columns&)> tsl2572;
+    std::function<void(const Scd41Columns&)> scd41;
+  };
+
+  explicit SensorReplay(Output output) : output_(std::move(output)) {}
+
+  // レコードを渡す. 変換前の値以外の種類は無視する. 列がkBatch個になったら計算して出力する
+  void add(const TelemetryRecord& r);
+
+  // ためているサンプルを全て計算して出力する. 出力の順序は種類ごと, BME280はセンサー番号ごと
+  void flush();
+
+  const ReplayStats& stats() const { return stats_; }
+
+ private:
+  struct Bme280State {
+    BME280 sensor;
+    bool calibrated = false;
+    Bme280Columns columns;
+  };
+
+  Output output_;
+  std::map<uint8_t, Bme280State> bme280_;
+  Tsl2572Columns tsl2572_;
+  Scd41Columns scd41_;
+  ReplayStats stats_;
+
+  void flush_bme280(Bme280State& s);
+  void flush_tsl2572();
+  void flush_scd41();
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/rules.hのルールに, シナリオごとの入力の列を時刻順に与え, actionが呼ばれた時刻を期待値と比べる.
+// 継続時間の判定はファームウェアと同じくrules_time_to_nextとrules_pollで行い, --poll-msで周期的に呼ぶ場合の遅れも確認する.
+// 入力の更新で評価したルールの数も数え, 変化した入力を参照するルールだけを評価していることを確認する.
+// 期待と異なる結果があれば終了コード1で終了する.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "rules.h"
+
+namespace {
+
+struct Options {
+  uint32_t poll_ms = 0;  // 0でrules_time_to_nextの時刻ちょうどにrules_pollを呼ぶ
+  std::string scenario;  // 空で全て
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --poll-ms N      call rules_poll every N ms like a periodic task (default: 0, at rules_time_to_next)\n"
+      "  --scenario NAME  run only NAME (co2_hold, co2_spike, vacancy, incremental, wrap)\n",
+      prog);
+}
+
+enum { IN_CO2, IN_MOTION, IN_LUX_X10 };
+
+// 入力の更新. 時刻はシナリオの開始からの時間[ms]
+struct Step {
+  uint32_t time_ms;
+  uint32_t input;
+  int32_t value;
+};
+
+// actionの呼び出し
+struct Event {
+  uint32_t time_ms;
+  uint32_t rule;
+  bool active;
+};
+
+struct Scenario {
+  const char* name;
+  std::vector<rules_rule_t> table;  // argはルール番号にする
+  std::vector<Step> steps;
+  std::vector<Event> expected;
+  uint32_t end_ms;           // この時刻まで継続時間の判定を続ける
+  uint32_t start_ms = 0;     // rules.cに渡す時刻の開始値. 桁あふれを確認する
+  long expected_evals = -1;  // ルールを評価する回数. 負の値で確認しない
+};
+
+const uint32_t MINUTE = 60000;
+
+// rules_actionの呼び出しを記録する
+std::vector<Event> events;
+uint32_t now_ms = 0;  // シナリオの開始からの時間
+
+void record_action(uint32_t arg, bool active) {
+  events.push_back({now_ms, arg, active});
+}
+
+rules_rule_t co2_rule() {
+  // CO2 > 1000ppmが60秒続いたらON, 900ppm以下でOFF
+  return {{RULES_COND(IN_CO2, RULES_GT, 1000, 100, MINUTE)}, 1, record_action, 0};
+}
+
+std::vector<Scenario> make_scenarios() {
+  std::vector<Scenario> list;
+
+  // しきい値を超えてから60秒後にON. ヒステリシスの範囲に下がっても継続し, 900ppm以下でOFF
+  list.push_back({"co2_hold",
+                  {co2_rule()},
+                  {{0, IN_CO2, 800},
+                   {10000, IN_CO2, 1050},
+                   {40000, IN_CO2, 950},
+                   {100000, IN_CO2, 910},
+                   {120000, IN_CO2, 900},
+                   {130000, IN_CO2, 990},
+                   {140000, IN_CO2, 1001}},
+                  {{70000, 0, true}, {120000, 0, false}, {200000, 0, true}},
+                  5 * MINUTE});
+
+  // 継続時間の前に下がった場合はONにしない. 再び超えた時刻から数え直す
+  list.push_back({"co2_spike",
+                  {co2_rule()},
+                  {{0, IN_CO2, 1100}, {30000, IN_CO2, 880}, {40000, IN_CO2, 1200}, {90000, IN_CO2, 1000}},
+                  {{100000, 0, true}},
+                  3 * MINUTE});
+
+  // 10分間人感センサーの検知なし, かつ50lux超ならON. 検知か45lux以下でOFF
+  rules_rule_t vacancy = {
+      {RULES_COND(IN_MOTION, RULES_LT, 1, 0, 10 * MINUTE), RULES_COND(IN_LUX_X10, RULES_GT, 500, 50, 0)},
+      2,
+      record_action,
+      0};
+  list.push_back({"vacancy",
+                  {vacancy},
+                  {{0, IN_MOTION, 1},
+                   {0, IN_LUX_X10, 800},
+                   {5000, IN_MOTION, 0},
+                   {300000, IN_MOTION, 1},
+                   {301000, IN_MOTION, 0},
+                   {1000000, IN_LUX_X10, 480},
+                   {1010000, IN_LUX_X10, 440},
+                   {1020000, IN_LUX_X10, 600},
+                   {1100000, IN_MOTION, 1}},
+                  {{901000, 0, true}, {1010000, 0, false}, {1020000, 0, true}, {1100000, 0, false}},
+                  20 * MINUTE});
+
+  // 32ルールのうち, 変化した入力を参照するルールだけを評価する. 同じ値の更新では評価しない
+  Scenario incremental = {"incremental", {}, {}, {}, MINUTE};
+  for (uint32_t i = 0; i < RULES_MAX; i++) {
+    incremental.table.push_back(
+        {{RULES_COND((uint8_t)(i % RULES_INPUT_MAX), RULES_GT, 100, 10, 0)}, 1, record_action, i});
+  }
+  incremental.steps = {{0, 3, 50}, {1000, 3, 50}, {2000, 3, 150}, {3000, 3, 150}, {4000, 7, 200}, {5000, 3, 80}};
+  incremental.expected = {{2000, 3, true}, {2000, 19, true}, {4000, 7, true}, {4000, 23, true},
+                          {5000, 3, false}, {5000, 19, false}};
+  incremental.expected_evals = 8;  // 変化した4回の更新 x 2ルール
+  list.push_back(incremental);
+
+  // 時刻の桁あふれをまたいで継続時間を判定する
+  Scenario wrap = list[0];
+  wrap.name = "wrap";
+  wrap.start_ms = UINT32_MAX - 50000;
+  list.push_back(wrap);
+
+  for (Scenario& s : list) {
+    for (uint32_t i = 0; i < s.table.size(); i++) s.table[i].arg = i;
+  }
+  return list;
+}
+
+// 継続時間の判定をuntil_msまで進める. poll_msが0ならrules_time_to_nextの時刻に, それ以外は周期的にrules_pollを呼ぶ
+void advance(const Scenario& s, uint32_t poll_ms, uint32_t until_ms) {
+  while (now_ms < until_ms) {
+    uint32_t next;
+    if (poll_ms) {
+      next = (now_ms / poll_ms + 1) * poll_ms;
+    } else {
+      uint32_t wait = rules_time_to_next(s.start_ms + now_ms);
+      if (wait == UINT32_MAX) break;
+      next = now_ms + wait;
+    }
+    if (next > until_ms) break;
+    now_ms = next;
+    rules_poll(s.start_ms + now_ms);
+  }
+  now_ms = until_ms;
+}
+
+// シナリオを実行して結果を表示する
+//
+// Returns: 期待と一致すればtrue
+bool run(const Scenario& s, uint32_t poll_ms) {
+  events.clear();
+  now_ms = 0;
+  if (!rules_init(s.table.data(), s.table.size())) {
+    std::fprintf(stderr, "%s: rules_init failed\n", s.name);
+    return false;
+  }
+
+  for (const Step& step : s.steps) {
+    advance(s, poll_ms, step.time_ms);
+    rules_update(step.input, step.value, s.start_ms + now_ms);
+  }
+  advance(s, poll_ms, s.end_ms);
+
+  // 入力で変わる場合は遅れなし. 継続時間で変わる場合はrules_pollの周期まで遅れる
+  bool ok = events.size() == s.expected.size();
+  for (size_t i = 0; i < s.expected.size() || i < events.size(); i++) {
+    const Event* e = i < s.expected.size() ? &s.expected[i] : nullptr;
+    const Event* a = i < events.size() ? &events[i] : nullptr;
+    long latency = e && a ? (long)a->time_ms - (long)e->time_ms : 0;
+    bool match = e && a && e->rule == a->rule && e->active == a->active && latency >= 0 &&
+                 latency <= (long)(poll_ms ? poll_ms - 1 : 0);
+    const Event* r = e ? e : a;
+    std::printf("%s,%u,%s,", s.name, r->rule, r->active ? "on" : "off");
+    if (e) std::printf("%u", e->time_ms);
+    std::printf(",");
+    if (a) std::printf("%u", a->time_ms);
+    std::printf(",%ld,%s\n", latency, match ? "ok" : "NG");
+    if (!match) ok = false;
+  }
+
+  uint32_t evals = rules_evaluations();
+  std::printf("%s,evaluations,%u", s.name, evals);
+  if (s.expected_evals >= 0) {
+    std::printf(",expected %ld", s.expected_evals);
+    if ((long)evals != s.expected_evals) ok = false;
+  }
+  std::printf("\n");
+  if (!ok) std::fprintf(stderr, "%s: unexpected result\n", s.name);
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--poll-ms") {
+      opt.poll_ms = std::strtoul(check::next_arg(argc, argv, &i, usage), nullptr, 0);
+    } else if (arg == "--scenario") {
+      opt.scenario = check::next_arg(argc, argv, &i, usage);
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  std::printf("scenario,rule,state,expected_ms,actual_ms,latency_ms,result\n");
+  return check::run_cases(make_scenarios(), opt.scenario, [&](const Scenario& s) { return run(s, opt.poll_ms); });
+}
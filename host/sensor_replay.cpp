@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/telemetry.hで記録した変換前の値(BME280_RAW, BME280_CAL, TSL2572_RAW, SCD41_RAW)を読み込み,
+// replay.hでドライバーと同じ計算を行って測定値を求め直す. ファイルか標準入力から読み込み,
+// 1サンプル1行のテキストか, センサーごとのCSV(変換前の値と計算結果)に出力する.
+//
+// --benchでは乱数で作った変換前の値で, 列単位の計算と, 復号から計算までの処理速度を測定する.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "replay.h"
+#include "telemetry.h"
+#include "tsl2572.h"
+
+namespace {
+
+struct Options {
+  std::string input;  // 空なら標準入力
+  std::string csv;    // CSVのファイル名の先頭. 空なら1サンプル1行で表示
+  long bench = 0;     // 0より大きければ, このサンプル数で処理速度を測定する
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options] [INPUT]\n"
+      "  INPUT         capture file with raw records (default: stdin)\n"
+      "  --csv PREFIX  write PREFIX_bme280.csv, PREFIX_tsl2572.csv and PREFIX_scd41.csv\n"
+      "  --bench N     measure conversion throughput with N synthetic samples per sensor\n",
+      prog);
+}
+
+// 固定小数の値を表示用の文字列にする. 例: value=2345, scale=100で"23.45"
+std::string fixed(int64_t value, int scale) {
+  char buf[32];
+  int digits = scale == 1000 ? 3 : scale == 100 ? 2 : 1;
+  std::snprintf(buf, sizeof(buf), "%s%lld.%0*lld", value < 0 ? "-" : "", (long long)(std::llabs(value) / scale),
+                digits, (long long)(std::llabs(value) % scale));
+  return buf;
+}
+
+// センサーごとのCSV. ファイルは最初の出力で作る
+class CsvFiles {
+ public:
+  explicit CsvFiles(const std::string& prefix) : prefix_(prefix) {}
+  ~CsvFiles() {
+    for (std::FILE* f : {bme280_, tsl2572_, scd41_}) {
+      if (f) std::fclose(f);
+    }
+  }
+  bool ok() const { return ok_; }
+
+  void bme280(const Bme280Columns& c) {
+    if (!open(&bme280_, "bme280",
+              "time_us,id,adc_temperature,adc_pressure,adc_humidity,temperature_x100,pressure_x100,humidity_x100")) {
+      return;
+    }
+    for (size_t i = 0; i < c.size(); i++) {
+      std::fprintf(bme280_, "%llu,%u,%lu,%lu,%lu,%ld,%lu,%lu\n", (unsigned long long)c.time_us[i], c.id,
+                   (unsigned long)c.adc_temperature[i], (unsigned long)c.adc_pressure[i],
+                   (unsigned long)c.adc_humidity[i], (long)c.temperature_x100[i], (unsigned long)c.pressure_x100[i],
+                   (unsigned long)c.humidity_x100[i]);
+    }
+  }
+
+  void tsl2572(const Tsl2572Columns& c) {
+    if (!open(&tsl2572_, "tsl2572", "time_us,id,ch0,ch1,integ_cycles,again,lux")) return;
+    for (size_t i = 0; i < c.size(); i++) {
+      std::fprintf(tsl2572_, "%llu,%u,%u,%u,%u,%u,%.3f\n", (unsigned long long)c.time_us[i], c.id[i], c.ch0[i],
+                   c.ch1[i], c.integ_cycles[i], c.again[i], c.lux[i]);
+    }
+  }
+
+  void scd41(const Scd41Columns& c) {
+    if (!open(&scd41_, "scd41", "time_us,id,co2,temperature_raw,humidity_raw,temperature_x100,humidity_x100")) return;
+    for (size_t i = 0; i < c.size(); i++) {
+      std::fprintf(scd41_, "%llu,%u,%u,%u,%u,%ld,%lu\n", (unsigned long long)c.time_us[i], c.id[i], c.co2[i],
+                   c.temperature_raw[i], c.humidity_raw[i], (long)c.temperature_x100[i],
+                   (unsigned long)c.humidity_x100[i]);
+    }
+  }
+
+ private:
+  std::string prefix_;
+  std::FILE* bme280_ = nullptr;
+  std::FILE* tsl2572_ = nullptr;
+  std::FILE* scd41_ = nullptr;
+  bool ok_ = true;
+
+  bool open(std::FILE** f, const char* name, const char* header) {
+    if (*f) return true;
+    if (!ok_) return false;
+    std::string path = prefix_ + "_" + name + ".csv";
+    *f = std::fopen(path.c_str(), "w");
+    if (!*f) {
+      std::fprintf(stderr, "cannot write %s\n", path.c_str());
+      ok_ = false;
+      return false;
+    }
+    std::fprintf(*f, "%s\n", header);
+    return true;
+  }
+};
+
+// 1サンプル1行で表示する
+SensorReplay::Output print_output() {
+  SensorReplay::Output out;
+  out.bme280 = [](const Bme280Columns& c) {
+    for (size_t i = 0; i < c.size(); i++) {
+      std::printf("%llu bme280 %u %s %s %s\n", (unsigned long long)c.time_us[i], c.id,
+                  fixed(c.temperature_x100[i], 100).c_str(), fixed(c.pressure_x100[i], 100).c_str(),
+                  fixed(c.humidity_x100[i], 100).c_str());
+    }
+  };
+  out.tsl2572 = [](const Tsl2572Columns& c) {
+    for (size_t i = 0; i < c.size(); i++) {
+      std::printf("%llu tsl2572 %u %.3f\n", (unsigned long long)c.time_us[i], c.id[i], c.lux[i]);
+    }
+  };
+  out.scd41 = [](const Scd41Columns& c) {
+    for (size_t i = 0; i < c.size(); i++) {
+      std::printf("%llu scd41 %u %u %s %s\n", (unsigned long long)c.time_us[i], c.id[i], c.co2[i],
+                  fixed(c.temperature_x100[i], 100).c_str(), fixed(c.humidity_x100[i], 100).c_str());
+    }
+  };
+  return out;
+}
+
+// 記録を読み込んで計算する
+int replay(const Options& opt) {
+  int fd = 0;
+  if (!opt.input.empty()) {
+    fd = open(opt.input.c_str(), O_RDONLY);
+    if (fd < 0) {
+      std::fprintf(stderr, "cannot open %s\n", opt.input.c_str());
+      return 2;
+    }
+  }
+
+  CsvFiles csv(opt.csv);
+  SensorReplay::Output out;
+  if (opt.csv.empty()) {
+    out = print_output();
+  } else {
+    out.bme280 = [&](const Bme280Columns& c) { csv.bme280(c); };
+    out.tsl2572 = [&](const Tsl2572Columns& c) { csv.tsl2572(c); };
+    out.scd41 = [&](const Scd41Columns& c) { csv.scd41(c); };
+  }
+  SensorReplay engine(out);
+  TelemetryDecoder decoder;
+  auto on_record = [&](const TelemetryRecord& r) { engine.add(r); };
+
+  int rc = 0;
+  std::vector<uint8_t> buf(1 << 16);
+  while (csv.ok()) {
+    ssize_t n = read(fd, buf.data(), buf.size());
+    if (n == 0) break;
+    if (n < 0) {
+      std::fprintf(stderr, "read error\n");
+      rc = 2;
+      break;
+    }
+    decoder.feed(buf.data(), n, on_record);
+  }
+  engine.flush();
+  std::fflush(stdout);
+  if (!csv.ok()) rc = 2;
+
+  const TelemetryStats& t = decoder.stats();
+  const ReplayStats& s = engine.stats();
+  std::fprintf(stderr,
+               "records %llu, crc errors %llu, format errors %llu, bme280 %llu, tsl2572 %llu, scd41 %llu, "
+               "no calibration %llu, invalid %llu\n",
+               (unsigned long long)t.records, (unsigned long long)t.crc_errors, (unsigned long long)t.format_errors,
+               (unsigned long long)s.bme280, (unsigned long long)s.tsl2572, (unsigned long long)s.scd41,
+               (unsigned long long)s.no_calibration, (unsigned long long)s.invalid);
+  return rc;
+}
+
+// データシートの計算例のキャリブレーションデータ(T, P)と, 実際のセンサーで読み出した値の例(H)
+BME280::CalibrationData bench_calibration() {
+  BME280::CalibrationData cal;
+  cal.dig_T1 = 27504;
+  cal.dig_T2 = 26435;
+  cal.dig_T3 = -1000;
+  cal.dig_P1 = 36477;
+  cal.dig_P2 = -10685;
+  cal.dig_P3 = 3024;
+  cal.dig_P4 = 2855;
+  cal.dig_P5 = 140;
+  cal.dig_P6 = -7;
+  cal.dig_P7 = 15500;
+  cal.dig_P8 = -14600;
+  cal.dig_P9 = 6000;
+  cal.dig_H1 = 75;
+  cal.dig_H2 = 362;
+  cal.dig_H3 = 0;
+  cal.dig_H4 = 324;
+  cal.dig_H5 = 50;
+  cal.dig_H6 = 30;
+  return cal;
+}
+
+// fnを実行し, 1サンプルあたりの時間を表示する
+void bench_print(const char* name, size_t samples, const std::function<void()>& fn) {
+  auto t0 = std::chrono::steady_clock::now();
+  fn();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  std::printf("%s,%zu,%.2f,%.0f\n", name, samples, elapsed * 1e9 / samples, samples / elapsed);
+}
+
+// 列単位の計算と, レコードの復号から計算までの処理速度を測定する
+int bench(const Options& opt) {
+  size_t n = opt.bench;
+  std::mt19937 rng(1);
+  auto uniform = [&](uint32_t lo, uint32_t hi) { return std::uniform_int_distribution<uint32_t>(lo, hi)(rng); };
+
+  BME280 sensor;
+  sensor.calibration_data = bench_calibration();
+  Bme280Columns bme280;
+  Tsl2572Columns tsl2572;
+  Scd41Columns scd41;
+  for (size_t i = 0; i < n; i++) {
+    bme280.time_us.push_back(i * 1000);
+    bme280.adc_temperature.push_back(uniform(480000, 560000));
+    bme280.adc_pressure.push_back(uniform(300000, 430000));
+    bme280.adc_humidity.push_back(uniform(20000, 40000));
+    tsl2572.time_us.push_back(i * 1000);
+    tsl2572.id.push_back(0);
+    tsl2572.ch0.push_back(uniform(100, 60000));
+    tsl2572.ch1.push_back(uniform(0, 30000));
+    tsl2572.integ_cycles.push_back(64);
+    tsl2572.again.push_back(uniform(TSL2572_AGAIN_016, TSL2572_AGAIN_120));
+    scd41.time_us.push_back(i * 1000);
+    scd41.id.push_back(0);
+    scd41.co2.push_back(uniform(400, 5000));
+    scd41.temperature_raw.push_back(uniform(0, 0xFFFF));
+    scd41.humidity_raw.push_back(uniform(0, 0xFFFF));
+  }
+
+  // 同じ値を変換前のレコードとして符号化する
+  std::vector<uint8_t> stream;
+  telemetry_t telemetry;
+  telemetry_init(
+      &telemetry,
+      [](const uint8_t* data, uint32_t len, void* ctx) {
+        auto* s = static_cast<std::vector<uint8_t>*>(ctx);
+        s->insert(s->end(), data, data + len);
+      },
+      &stream);
+  telemetry_begin(&telemetry, TELEMETRY_BME280_CAL, 0, 0);
+  for (int i = 0; i < BME280::CAL_LENGTH; i++) telemetry_put(&telemetry, sensor.calibration_data.byte[i]);
+  telemetry_end(&telemetry);
+  for (size_t i = 0; i < n; i++) {
+    int32_t b[3] = {(int32_t)bme280.adc_temperature[i], (int32_t)bme280.adc_pressure[i],
+                    (int32_t)bme280.adc_humidity[i]};
+    telemetry_send(&telemetry, TELEMETRY_BME280_RAW, 0, i * 1000, b, 3);
+    int32_t t[4] = {tsl2572.ch0[i], tsl2572.ch1[i], tsl2572.integ_cycles[i], tsl2572.again[i]};
+    telemetry_send(&telemetry, TELEMETRY_TSL2572_RAW, 0, i * 1000, t, 4);
+    int32_t s[3] = {scd41.co2[i], scd41.temperature_raw[i], scd41.humidity_raw[i]};
+    telemetry_send(&telemetry, TELEMETRY_SCD41_RAW, 0, i * 1000, s, 3);
+  }
+
+  // 計算結果の列の確保(ページの割り当て)を測定に含めないよう, 1度計算してから測定する
+  replay_bme280(sensor, bme280);
+  replay_tsl2572(tsl2572);
+  replay_scd41(scd41);
+  std::printf("name,samples,ns_per_sample,samples_per_s\n");
+  bench_print("bme280_columns", n, [&] { replay_bme280(sensor, bme280); });
+  bench_print("tsl2572_columns", n, [&] { replay_tsl2572(tsl2572); });
+  bench_print("scd41_columns", n, [&] { replay_scd41(scd41); });
+
+  // 復号から計算まで. 結果が列単位の計算と一致することも確認する
+  size_t mismatches = 0;
+  size_t offset[3] = {};
+  SensorReplay::Output out;
+  out.bme280 = [&](const Bme280Columns& c) {
+    for (size_t i = 0; i < c.size(); i++, offset[0]++) {
+      mismatches += c.temperature_x100[i] != bme280.temperature_x100[offset[0]] ||
+                    c.pressure_x100[i] != bme280.pressure_x100[offset[0]] ||
+                    c.humidity_x100[i] != bme280.humidity_x100[offset[0]];
+    }
+  };
+  out.tsl2572 = [&](const Tsl2572Columns& c) {
+    for (size_t i = 0; i < c.size(); i++, offset[1]++) mismatches += c.lux[i] != tsl2572.lux[offset[1]];
+  };
+  out.scd41 = [&](const Scd41Columns& c) {
+    for (size_t i = 0; i < c.size(); i++, offset[2]++) {
+      mismatches += c.temperature_x100[i] != scd41.temperature_x100[offset[2]] ||
+                    c.humidity_x100[i] != scd41.humidity_x100[offset[2]];
+    }
+  };
+  SensorReplay engine(out);
+  TelemetryDecoder decoder;
+  bench_print("decode_and_replay", n * 3, [&] {
+    decoder.feed(stream.data(), stream.size(), [&](const TelemetryRecord& r) { engine.add(r); });
+    engine.flush();
+  });
+
+  const ReplayStats& s = engine.stats();
+  if (mismatches || s.bme280 != n || s.tsl2572 != n || s.scd41 != n) {
+    std::fprintf(stderr, "replay mismatch: %zu values differ, bme280 %llu, tsl2572 %llu, scd41 %llu\n", mismatches,
+                 (unsigned long long)s.bme280, (unsigned long long)s.tsl2572, (unsigned long long)s.scd41);
+    return 1;
+  }
+  std::fprintf(stderr, "stream %zu bytes, %.1f bytes/record\n", stream.size(), (double)stream.size() / (n * 3));
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--csv") {
+      opt.csv = next();
+    } else if (arg == "--bench") {
+      opt.bench = std::atol(next());
+      if (opt.bench < 1) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg[0] != '-' && opt.input.empty()) {
+      opt.input = arg;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  return opt.bench ? bench(opt) : replay(opt);
+}
@@ -0,0 +1,498 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// BME280, SCD41, TSL2572, AQM LCDのシミュレーター(devsim.h)にドライバーをつなぎ, 仮想的な時刻で測定を続ける.
+// 環境の変化に対する測定値の誤差と遅れ, I2Cの使用率, シミュレーションの速度を表示する.
+// 測定の周期はhubと同じで, BME280 1秒, TSL2572 2秒, SCD41 5秒(定期測定), LCD 1秒.
+//
+// --faultsでは通信の異常を注入し, ドライバーのタイムアウトや再試行の処理を確認する.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bme280.h"
+#include "devsim.h"
+#include "lcdaqm.h"
+#include "scd41.h"
+#include "tsl2572.h"
+
+namespace {
+
+// 既定のシナリオ. 温度のランプ, 湿度, CO2, 照度のステップ変化
+const char* kDefaultScript =
+    "0 temperature 20\n"
+    "600 temperature 26\n"
+    "0 humidity 45\n"
+    "300 humidity 45\n"
+    "300 humidity 60\n"
+    "0 co2 450\n"
+    "200 co2 450\n"
+    "200 co2 1500\n"
+    "400 co2 1500\n"
+    "400 co2 800\n"
+    "0 lux 300\n"
+    "100 lux 300\n"
+    "100 lux 20000\n"
+    "300 lux 20000\n"
+    "300 lux 2\n";
+
+// シミュレーターと環境
+struct Bench {
+  SimEnvironment env;
+  Bme280Sim bme280{&env};
+  Scd41Sim scd41{&env};
+  Tsl2572Sim tsl2572{&env};
+  AqmLcdSim lcd{&env};
+
+  // 仮想的な時刻を0に戻し, シミュレーターをI2Cアドレスに接続する
+  Bench() {
+    hal_host_reset();
+    hal_host_attach(0x76, &bme280);
+    hal_host_attach(SCD41_I2C_ADDRESS, &scd41);
+    hal_host_attach(TSL2572_I2C_ADDRESS, &tsl2572);
+    hal_host_attach(LCDAQM_I2C_ADDRESS, &lcd);
+    hal_i2c_init_pins(i2c_default, 100000, PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN);
+  }
+
+  SimDevice* device(const std::string& name) {
+    if (name == "bme280") return &bme280;
+    if (name == "scd41") return &scd41;
+    if (name == "tsl2572") return &tsl2572;
+    if (name == "lcd") return &lcd;
+    return nullptr;
+  }
+};
+
+// 仮想的な時刻をtime_us[us]まで進める
+void advance_to(uint64_t time_us) {
+  uint64_t now = hal_time_us_64();
+  if (time_us > now) hal_host_advance_us(time_us - now);
+}
+
+// シナリオを読み込む. 1行に1つ, "時刻[s] 項目 値"で環境の値の点を追加する.
+// 項目はtemperature, humidity, pressure, co2, lux, ir_ratio. 同じ時刻に2点を置くとステップ変化.
+// "時刻[s] nak|hang デバイス 長さ[s]"で通信の異常を注入する. デバイスはbme280, scd41, tsl2572, lcd.
+//
+// Returns: 成功でtrue, 書式が違う行があればfalse
+bool load_script(const std::string& text, Bench* bench, std::string* error) {
+  struct Entry {
+    double time;
+    std::string item, arg;
+    double value;
+  };
+  std::vector<Entry> entries;
+  std::istringstream in(text);
+  std::string line;
+  int n = 0;
+  while (std::getline(in, line)) {
+    n++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream ls(line);
+    Entry e;
+    if (!(ls >> e.time)) continue;  // 空行
+    ls >> e.item;
+    bool ok;
+    if (e.item == "nak" || e.item == "hang") {
+      ok = (bool)(ls >> e.arg >> e.value) && bench->device(e.arg);
+    } else {
+      ok = (bool)(ls >> e.value) && bench->env.find(e.item);
+    }
+    if (!ok || e.time < 0) {
+      *error = "line " + std::to_string(n) + ": " + line;
+      return false;
+    }
+    entries.push_back(e);
+  }
+
+  // 項目ごとに時刻順に追加する. 同じ時刻の点は書いた順
+  std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+  for (const Entry& e : entries) {
+    uint64_t t = (uint64_t)std::llround(e.time * 1e6);
+    if (e.item == "nak" || e.item == "hang") {
+      SimDevice::Fault fault = e.item == "nak" ? SimDevice::FAULT_NAK : SimDevice::FAULT_HANG;
+      bench->device(e.arg)->inject(fault, t, t + (uint64_t)std::llround(e.value * 1e6));
+    } else {
+      SimTrack* track = bench->env.find(e.item);
+      if (t == 0) {
+        track->set(e.value);
+      } else {
+        track->point(t, e.value);
+      }
+    }
+  }
+  return true;
+}
+
+// 1つの測定値
+struct Sample {
+  uint64_t time_us;
+  std::string quantity;
+  double value;
+  double truth;  // 読み出した時刻の環境の値
+};
+
+// 測定値の誤差と, ステップ変化への遅れ
+struct Summary {
+  uint32_t count = 0;
+  uint32_t failures = 0;  // ドライバーが失敗を返した回数
+  double sum_error = 0;
+  double max_error = 0;
+  double max_latency_s = -1;  // ステップ変化から, 変化量の5%以内に収まるまでの最大の時間. -1ならステップ無し
+};
+
+struct Options {
+  double duration_s = 600;
+  std::string script;
+  bool csv = false;
+  bool faults = false;
+};
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --duration S   simulated time [s] (default: 600)\n"
+      "  --script PATH  environment and fault script (default: built-in scenario)\n"
+      "  --csv          print every sample as CSV\n"
+      "  --faults       run fault-injection tests. exit 1 on failure\n",
+      prog);
+}
+
+// ステップ変化の後, 測定値が新しい値の近くに収まるまでの時間を求める
+//
+// Returns: 最大の時間[s]. ステップ変化が無ければ-1
+double step_latency(const SimTrack& track, const std::vector<Sample>& samples, const std::string& quantity) {
+  double latency = -1;
+  for (uint64_t step : track.steps()) {
+    double before = track.at(step - 1);
+    double after = track.at(step);
+    double tolerance = std::fabs(after - before) * 0.05;
+    for (const Sample& s : samples) {
+      if (s.quantity != quantity || s.time_us < step) continue;
+      if (std::fabs(s.value - after) <= tolerance) {
+        latency = std::max(latency, (s.time_us - step) / 1e6);
+        break;
+      }
+    }
+  }
+  return latency;
+}
+
+// hubと同じ周期でドライバーを呼び, 測定値を記録する
+int run_scenario(const Options& opt) {
+  Bench bench;
+  std::string error;
+  std::string script = kDefaultScript;
+  if (!opt.script.empty()) {
+    std::ifstream f(opt.script);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    if (!f) {
+      std::fprintf(stderr, "cannot read script file\n");
+      return 2;
+    }
+    script = ss.str();
+  }
+  if (!load_script(script, &bench, &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 2;
+  }
+#if HAL_INSTR
+  instr_init();
+#endif
+
+  std::vector<Sample> samples;
+  std::map<std::string, uint32_t> failures;
+  auto record = [&](const char* quantity, double value, const SimTrack& track) {
+    uint64_t now = hal_time_us_64();
+    samples.push_back({now, quantity, value, track.at(now)});
+  };
+
+  auto t0 = std::chrono::steady_clock::now();
+  BME280 bme280(0x76);
+  lcdaqm_init();
+  scd41_stop_periodic_measurement(true);
+  scd41_start_periodic_measurement();
+
+  uint64_t end = (uint64_t)std::llround(opt.duration_s * 1e6);
+  uint64_t next_bme280 = 1000000, next_tsl2572 = 1000000, next_scd41 = 1000000, next_lcd = 1000000;
+  while (hal_time_us_64() < end) {
+    advance_to(std::min(std::min(next_bme280, next_tsl2572), std::min(next_scd41, next_lcd)));
+    uint64_t now = hal_time_us_64();
+    if (now >= next_bme280) {
+      if (bme280.forced()) {
+        record("temperature", bme280.temperature_x100 / 100.0, bench.env.temperature);
+        record("humidity", bme280.humidity_x100 / 100.0, bench.env.humidity);
+        record("pressure", bme280.pressure_x100 / 100.0, bench.env.pressure);
+      } else {
+        failures["temperature"]++;
+      }
+      next_bme280 += 1000000;
+    }
+    if (now >= next_tsl2572) {
+      if (tsl2572_single_auto_measure()) {
+        record("lux", tsl2572_illuminance, bench.env.lux);
+      } else {
+        failures["lux"]++;
+      }
+      next_tsl2572 += 2000000;
+    }
+    if (now >= next_scd41) {
+      if (scd41_get_data_ready_status()) {
+        if (scd41_read_measurement(0)) {
+          record("co2", scd41_co2, bench.env.co2);
+        } else {
+          failures["co2"]++;
+        }
+      }
+      next_scd41 += 1000000;
+    }
+    if (now >= next_lcd) {
+      lcdaqm_fb_clear();
+      lcdaqm_fb_print_fixed(0, 0, bme280.temperature_x100, 2, 1, 6);
+      lcdaqm_fb_print(0, 6, "C");
+      lcdaqm_fb_print_fixed(1, 0, scd41_co2, 0, 0, 5);
+      lcdaqm_fb_print(1, 5, "ppm");
+      lcdaqm_fb_flush();
+      next_lcd += 1000000;
+    }
+  }
+  double host_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  double virtual_s = hal_time_us_64() / 1e6;
+
+  if (opt.csv) {
+    std::printf("time_s,quantity,value,truth\n");
+    for (const Sample& s : samples) {
+      std::printf("%.3f,%s,%.2f,%.2f\n", s.time_us / 1e6, s.quantity.c_str(), s.value, s.truth);
+    }
+    std::printf("\n");
+  }
+
+  const char* quantities[] = {"temperature", "humidity", "pressure", "co2", "lux"};
+  std::printf("%-12s %6s %6s %10s %10s %10s\n", "quantity", "count", "fail", "mean_err", "max_err", "latency_s");
+  for (const char* q : quantities) {
+    Summary sum;
+    for (const Sample& s : samples) {
+      if (s.quantity != q) continue;
+      double e = std::fabs(s.value - s.truth);
+      sum.count++;
+      sum.sum_error += e;
+      sum.max_error = std::max(sum.max_error, e);
+    }
+    sum.failures = failures[q];
+    sum.max_latency_s = step_latency(*bench.env.find(q), samples, q);
+    std::printf("%-12s %6u %6u %10.3f %10.3f ", q, sum.count, sum.failures, sum.count ? sum.sum_error / sum.count : 0,
+                sum.max_error);
+    if (sum.max_latency_s < 0) {
+      std::printf("%10s\n", "-");
+    } else {
+      std::printf("%10.3f\n", sum.max_latency_s);
+    }
+  }
+
+  const HalStats& s = hal_host_stats();
+  std::printf("\nvirtual time    %.1f [s]\n", virtual_s);
+  std::printf("host time       %.3f [s] (x%.0f)\n", host_s, host_s > 0 ? virtual_s / host_s : 0);
+  std::printf("transactions    %llu (%.1f /s)\n", (unsigned long long)s.transactions, s.transactions / virtual_s);
+  std::printf("bus usage       %.2f [%%]\n", s.bus_ns / 1e9 / virtual_s * 100);
+  std::printf("naks            %llu timeouts %llu hangs %llu\n", (unsigned long long)s.naks,
+              (unsigned long long)s.timeouts, (unsigned long long)s.hangs);
+  std::printf("conversions     bme280 %u scd41 %u tsl2572 %u\n", bench.bme280.conversions, bench.scd41.measurements,
+              bench.tsl2572.integrations);
+  std::printf("scd41           rejected %u crc errors %u\n", bench.scd41.rejected, bench.scd41.crc_errors);
+  std::printf("lcd             \"%s\" \"%s\" busy violations %u\n", bench.lcd.line(0).c_str(), bench.lcd.line(1).c_str(),
+              bench.lcd.busy_violations);
+#if HAL_INSTR
+  std::printf("\n");
+  instr_print();  // ドライバーと処理ごとの計測結果. 時間は仮想的な時刻
+#endif
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 通信の異常を注入するテスト. 失敗の理由を返し, 成功なら空文字
+
+std::string test_scd41_nak() {
+  Bench b;
+  b.env.co2.set(900);
+  scd41_start_periodic_measurement();
+  advance_to(5100000);
+  uint64_t now = hal_time_us_64();
+  b.scd41.inject(SimDevice::FAULT_NAK, now, now + 1000000);
+  if (scd41_read_measurement(0)) return "read succeeded during NAK";
+  advance_to(now + 1000000);
+  if (!scd41_read_measurement(0)) return "read failed after NAK";
+  if (scd41_co2 != 900) return "co2 " + std::to_string(scd41_co2);
+  return "";
+}
+
+std::string test_scd41_hang() {
+  Bench b;
+  scd41_start_periodic_measurement();
+  advance_to(5100000);
+  uint64_t now = hal_time_us_64();
+  b.scd41.inject(SimDevice::FAULT_HANG, now, now + 1000000);
+  if (scd41_read_measurement(0)) return "read succeeded during hang";
+  uint64_t elapsed = hal_time_us_64() - now;
+  if (hal_host_stats().timeouts != 1) return "timeouts " + std::to_string(hal_host_stats().timeouts);
+  if (hal_host_stats().hangs) return "blocking transfer hung";
+  if (elapsed > 20000) return "took " + std::to_string(elapsed) + " us";
+  return "";
+}
+
+std::string test_scd41_periodic_restrictions() {
+  Bench b;
+  scd41_start_periodic_measurement();
+  if (scd41_get_serial_number(nullptr)) return "serial number read in periodic mode";
+  if (!b.scd41.rejected) return "command not rejected";
+  scd41_stop_periodic_measurement(true);
+  if (!scd41_get_serial_number(nullptr)) return "serial number read failed after stop";
+  return "";
+}
+
+std::string test_scd41_single_shot() {
+  Bench b;
+  b.env.co2.set(1234);
+  uint64_t t0 = hal_time_us_64();
+  if (!scd41_measure_single_shot(10)) return "single shot failed";
+  if (hal_time_us_64() - t0 < 5000000) return "returned before 5 s";
+  if (scd41_co2 != 1234) return "co2 " + std::to_string(scd41_co2);
+  return "";
+}
+
+std::string test_bme280_conversion_time() {
+  Bench b;
+  b.env.temperature.set(-5.5);
+  BME280 bme280(0x76);
+  uint64_t t0 = hal_time_us_64();
+  if (!bme280.forced()) return "forced failed";
+  if (hal_time_us_64() - t0 < b.bme280.measurement_time_us()) return "returned before conversion";
+  if (std::abs(bme280.temperature_x100 + 550) > 1) return "temperature " + std::to_string(bme280.temperature_x100);
+  return "";
+}
+
+std::string test_bme280_nak() {
+  Bench b;
+  BME280 bme280(0x76);
+  b.bme280.inject_naks(1);
+  if (bme280.forced()) return "forced succeeded with NAK on ID read";
+  if (!bme280.forced()) return "forced failed after NAK";
+  return "";
+}
+
+std::string test_tsl2572_nak_while_polling() {
+  Bench b;
+  b.env.lux.set(500);
+  uint64_t now = hal_time_us_64();
+  b.tsl2572.inject(SimDevice::FAULT_NAK, now + 5000, now + 60000);
+  if (!tsl2572_single_auto_measure()) return "auto measure failed";
+  if (!b.tsl2572.injected) return "no NAK injected";
+  if (std::fabs(tsl2572_illuminance - 500) > 25) return "lux " + std::to_string(tsl2572_illuminance);
+  return "";
+}
+
+std::string test_tsl2572_saturation() {
+  Bench b;
+  b.env.lux.set(200000);
+  if (!tsl2572_single_auto_measure()) return "auto measure failed";
+  if (tsl2572_adc_ch0 != 65535) return "ch0 " + std::to_string(tsl2572_adc_ch0);
+  return "";
+}
+
+std::string test_lcd_init() {
+  Bench b;
+  lcdaqm_init();
+  lcdaqm_print("Hello");
+  if (b.lcd.busy_violations) return "busy violations " + std::to_string(b.lcd.busy_violations);
+  if (b.lcd.line(0) != "Hello   ") return "line 0 \"" + b.lcd.line(0) + "\"";
+  return "";
+}
+
+std::string test_lcd_queue() {
+  Bench b;
+  auto drain = [] {
+    while (lcdaqm_queue_service()) advance_to(lcdaqm_queue_ready_time());
+  };
+  lcdaqm_queue_init();
+  drain();
+  lcdaqm_fb_print(0, 0, "12.3C");
+  lcdaqm_fb_print(1, 0, "800ppm");
+  lcdaqm_queue_fb_flush();
+  drain();
+  if (b.lcd.busy_violations) return "busy violations " + std::to_string(b.lcd.busy_violations);
+  if (b.lcd.line(0) != "12.3C   " || b.lcd.line(1) != "800ppm  ") return "\"" + b.lcd.line(0) + b.lcd.line(1) + "\"";
+  return "";
+}
+
+int run_faults() {
+  const std::pair<const char*, std::function<std::string()>> tests[] = {
+      {"scd41_nak", test_scd41_nak},
+      {"scd41_hang", test_scd41_hang},
+      {"scd41_periodic_restrictions", test_scd41_periodic_restrictions},
+      {"scd41_single_shot", test_scd41_single_shot},
+      {"bme280_conversion_time", test_bme280_conversion_time},
+      {"bme280_nak", test_bme280_nak},
+      {"tsl2572_nak_while_polling", test_tsl2572_nak_while_polling},
+      {"tsl2572_saturation", test_tsl2572_saturation},
+      {"lcd_init", test_lcd_init},
+      {"lcd_queue", test_lcd_queue},
+  };
+  int failed = 0;
+  for (const auto& t : tests) {
+    std::string error = t.second();
+    if (error.empty()) {
+      std::printf("PASS %s\n", t.first);
+    } else {
+      std::printf("FAIL %s: %s\n", t.first, error.c_str());
+      failed++;
+    }
+  }
+  return failed ? 1 : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--duration") {
+      opt.duration_s = std::atof(next());
+    } else if (arg == "--script") {
+      opt.script = next();
+    } else if (arg == "--csv") {
+      opt.csv = true;
+    } else if (arg == "--faults") {
+      opt.faults = true;
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opt.duration_s <= 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  return opt.faults ? run_faults() : run_scenario(opt);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "telemetry_decoder.h"
+
+#include <map>
+
+namespace {
+
+// varintを1つ復号する
+//
+// Returns: 成功でtrue. データの終わりを超える場合やmax_bitsを超える場合はfalse
+bool read_varint(const uint8_t*& p, const uint8_t* end, int max_bits, uint64_t* value) {
+  uint64_t v = 0;
+  for (int shift = 0; shift < max_bits; shift += 7) {
+    if (p >= end) return false;
+    uint8_t b = *p++;
+    if (shift + 7 > max_bits && (b >> (max_bits - shift))) return false;
+    v |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *value = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+void TelemetryDecoder::feed(const uint8_t* data, size_t len, const Callback& on_record) {
+  stats_.bytes += len;
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] != 0) {
+      if (frame_.size() < kMaxFrame) {
+        frame_.push_back(data[i]);
+      } else {
+        overflow_ = true;
+      }
+      continue;
+    }
+    // フレームの区切り. 連続した0x00は空のフレームとして無視する
+    if (overflow_) {
+      stats_.format_errors++;
+    } else if (!frame_.empty()) {
+      bool crc_error = false;
+      if (decode_frame(frame_.data(), frame_.size(), &record_, &crc_error, &decoded_)) {
+        stats_.records++;
+        on_record(record_);
+      } else if (crc_error) {
+        stats_.crc_errors++;
+      } else {
+        stats_.format_errors++;
+      }
+    }
+    frame_.clear();
+    overflow_ = false;
+  }
+}
+
+bool TelemetryDecoder::decode_frame(const uint8_t* frame, size_t len, TelemetryRecord* record, bool* crc_error) {
+  std::vector<uint8_t> decoded;
+  return decode_frame(frame, len, record, crc_error, &decoded);
+}
+
+// decodedはCOBSを復号したレコードの作業領域. 連続して復号する場合に使い回す
+bool TelemetryDecoder::decode_frame(const uint8_t* frame, size_t len, TelemetryRecord* record, bool* crc_error,
+                                    std::vector<uint8_t>* decoded) {
+  *crc_error = false;
+
+  // COBSの復号. コードバイトnの後にn-1byteのデータが続き, n<0xFFなら最後のブロック以外は0x00を補う
+  std::vector<uint8_t>& rec = *decoded;
+  rec.clear();
+  size_t i = 0;
+  while (i < len) {
+    uint8_t code = frame[i++];
+    if (code == 0 || i + code - 1 > len) return false;
+    rec.insert(rec.end(), frame + i, frame + i + code - 1);
+    i += code - 1;
+    if (code < 0xFF && i < len) rec.push_back(0);
+  }
+
+  // 種類, センサー番号, 時刻(1byte以上), CRC
+  if (rec.size() < 5) return false;
+  size_t body = rec.size() - 2;
+  uint16_t crc = ((uint16_t)rec[body] << 8) | rec[body + 1];
+  if (telemetry_crc16(0xFFFF, rec.data(), body) != crc) {
+    *crc_error = true;
+    return false;
+  }
+
+  const uint8_t* p = rec.data();
+  const uint8_t* end = p + body;
+  record->type = *p++;
+  record->id = *p++;
+  if (!read_varint(p, end, 64, &record->time_us)) return false;
+  record->values.clear();
+  while (p < end) {
+    uint64_t z;
+    if (!read_varint(p, end, 32, &z)) return false;
+    record->values.push_back((int32_t)((uint32_t)z >> 1) ^ -(int32_t)(z & 1));  // zigzag
+  }
+  return true;
+}
+
+const TelemetrySchema& telemetry_schema(uint8_t type) {
+  static const std::map<uint8_t, TelemetrySchema> known = {
+      {TELEMETRY_EVENT, {"event", {"event", "type"}, false}},
+      {TELEMETRY_BME280, {"bme280", {"temperature_x100", "pressure_x100", "humidity_x100"}, false}},
+      {TELEMETRY_SCD41, {"scd41", {"co2", "temperature_x100", "humidity_x100"}, false}},
+      {TELEMETRY_IR, {"ir", {"duration_us"}, true}},
+      {TELEMETRY_BME280_RAW, {"bme280_raw", {"adc_temperature", "adc_pressure", "adc_humidity"}, false}},
+      {TELEMETRY_BME280_CAL, {"bme280_cal", {"byte"}, true}},
+      {TELEMETRY_TSL2572_RAW, {"tsl2572_raw", {"ch0", "ch1", "integ_cycles", "again"}, false}},
+      {TELEMETRY_SCD41_RAW, {"scd41_raw", {"co2", "temperature_raw", "humidity_raw"}, false}},
+  };
+  static std::map<uint8_t, TelemetrySchema> unknown;
+
+  auto it = known.find(type);
+  if (it != known.end()) return it->second;
+  auto u = unknown.find(type);
+  if (u == unknown.end()) {
+    u = unknown.emplace(type, TelemetrySchema{"type" + std::to_string(type), {"value"}, true}).first;
+  }
+  return u->second;
+}
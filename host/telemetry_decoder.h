@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TELEMETRY_DECODER_H
+#define TELEMETRY_DECODER_H
+
+// common/telemetry.hのバイナリのレコードを復号する.
+// 受信したバイト列を区切りの0x00でフレームに分け, COBSの復号, CRCの確認, varintの復号を行う.
+// 途中から受信した最初のフレームや壊れたフレームは誤りとして数えて捨て, 次の0x00から復号を続ける.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "telemetry.h"
+
+struct TelemetryRecord {
+  uint8_t type = 0;  // telemetry_type_t
+  uint8_t id = 0;    // センサー番号
+  uint64_t time_us = 0;
+  std::vector<int32_t> values;
+};
+
+struct TelemetryStats {
+  uint64_t bytes = 0;          // 受信したバイト数
+  uint64_t records = 0;        // 復号できたレコードの数
+  uint64_t crc_errors = 0;     // CRCが一致しなかったフレームの数
+  uint64_t format_errors = 0;  // COBS, varintの誤りや長さの不足, 超過で捨てたフレームの数
+};
+
+// レコードの種類ごとの値の名前
+struct TelemetrySchema {
+  std::string name;                  // 種類の名前. 出力ファイル名に使う
+  std::vector<std::string> columns;  // 値の名前. listなら1つ
+  bool list = false;                 // trueなら値の個数が可変(赤外線データなど)
+};
+
+class TelemetryDecoder {
+ public:
+  static constexpr size_t kMaxFrame = 65536;  // これより長いフレームは捨てる
+
+  using Callback = std::function<void(const TelemetryRecord&)>;
+
+  // 受信したバイト列を渡す. レコードを復号するたびにon_recordを呼ぶ. 渡すレコードはon_recordの中でのみ有効
+  void feed(const uint8_t* data, size_t len, const Callback& on_record);
+
+  const TelemetryStats& stats() const { return stats_; }
+
+  // COBSで符号化したフレーム(区切りの0x00を除く)を復号する
+  //
+  // Returns: 成功でtrue. 失敗の理由はcrc_errorに入れる(trueならCRCの不一致, falseなら形式の誤り)
+  static bool decode_frame(const uint8_t* frame, size_t len, TelemetryRecord* record, bool* crc_error);
+  static bool decode_frame(const uint8_t* frame, size_t len, TelemetryRecord* record, bool* crc_error,
+                           std::vector<uint8_t>* decoded);
+
+ private:
+  std::vector<uint8_t> frame_;
+  std::vector<uint8_t> decoded_;  // COBSを復号したレコード. 領域を使い回す
+  TelemetryRecord record_;        // on_recordに渡すレコード. valuesの領域を使い回す
+  bool overflow_ = false;  // 現在のフレームがkMaxFrameを超えた
+  TelemetryStats stats_;
+};
+
+// Returns: レコードの種類typeの値の名前. 不明な種類は"type<番号>"で個数可変とする
+const TelemetrySchema& telemetry_schema(uint8_t type);
+
+#endif
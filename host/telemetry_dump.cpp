@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// common/telemetry.hのバイナリのレコードをファイル, 標準入力, USBシリアル(/dev/ttyACM0など)から読み込んで復号し,
+// 1レコード1行のテキスト, レコードの種類ごとのCSV, 列ごとのバイナリファイル(列指向)に出力する.
+// USBシリアルは生のモードに設定して読み込み, Ctrl-Cで終了する.
+// 終了時に受信バイト数, レコード数, 誤りの数を標準エラー出力に表示する.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "telemetry_decoder.h"
+
+namespace {
+
+struct Options {
+  std::string input;     // 空なら標準入力
+  std::string csv;       // CSVのファイル名の先頭. 空なら出力しない
+  std::string columnar;  // 列指向の出力先ディレクトリー. 空なら出力しない
+};
+
+volatile sig_atomic_t interrupted = 0;
+
+void usage(const char* prog) {
+  std::printf(
+      "Usage: %s [options] [INPUT]\n"
+      "  INPUT           capture file or serial device (default: stdin)\n"
+      "  --csv PREFIX    write PREFIX_<type>.csv for each record type\n"
+      "  --columnar DIR  write DIR/<type>/<column>.<int32|uint64|...> and DIR/<type>/schema.txt\n"
+      "Without --csv or --columnar, records are printed one per line.\n",
+      prog);
+}
+
+// レコードの種類ごとのCSV. listの種類は値1つを1行にし, レコードの番号と値の位置を付ける
+class CsvWriter {
+ public:
+  CsvWriter(const std::string& path, const TelemetrySchema& schema) : schema_(schema) {
+    f_ = std::fopen(path.c_str(), "w");
+    if (!f_) return;
+    std::fprintf(f_, schema.list ? "time_us,id,record,index" : "time_us,id");
+    for (const std::string& c : schema.columns) std::fprintf(f_, ",%s", c.c_str());
+    std::fprintf(f_, "\n");
+  }
+  ~CsvWriter() {
+    if (f_) std::fclose(f_);
+  }
+  bool ok() const { return f_ != nullptr; }
+
+  void write(const TelemetryRecord& r) {
+    if (schema_.list) {
+      for (size_t i = 0; i < r.values.size(); i++) {
+        std::fprintf(f_, "%llu,%u,%llu,%zu,%ld\n", (unsigned long long)r.time_us, r.id, (unsigned long long)rows_, i,
+                     (long)r.values[i]);
+      }
+    } else {
+      std::fprintf(f_, "%llu,%u", (unsigned long long)r.time_us, r.id);
+      for (int32_t v : r.values) std::fprintf(f_, ",%ld", (long)v);
+      std::fprintf(f_, "\n");
+    }
+    rows_++;
+  }
+
+ private:
+  const TelemetrySchema& schema_;
+  std::FILE* f_ = nullptr;
+  uint64_t rows_ = 0;
+};
+
+// レコードの種類ごとの列指向の出力. 列ごとにリトルエンディアンの固定長の値を並べたファイルを作る.
+// listの種類は, レコードごとの値の個数(length)と, 全レコードの値を連結した列に分ける
+class ColumnarWriter {
+ public:
+  ColumnarWriter(const std::string& dir, const TelemetrySchema& schema) : dir_(dir), schema_(schema) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    open("time_us.uint64");
+    open("id.uint8");
+    if (schema.list) open("length.uint32");
+    for (const std::string& c : schema.columns) open(c + ".int32");
+  }
+  ~ColumnarWriter() {
+    for (std::FILE* f : files_) {
+      if (f) std::fclose(f);
+    }
+    write_schema();
+  }
+  bool ok() const {
+    for (std::FILE* f : files_) {
+      if (!f) return false;
+    }
+    return true;
+  }
+
+  void write(const TelemetryRecord& r) {
+    size_t n = 0;
+    put(files_[n++], r.time_us, 8);
+    put(files_[n++], r.id, 1);
+    if (schema_.list) {
+      put(files_[n++], r.values.size(), 4);
+      for (int32_t v : r.values) put(files_[n], (uint32_t)v, 4);
+      values_ += r.values.size();
+    } else {
+      for (int32_t v : r.values) put(files_[n++], (uint32_t)v, 4);
+    }
+    rows_++;
+  }
+
+ private:
+  std::string dir_;
+  const TelemetrySchema& schema_;
+  std::vector<std::FILE*> files_;
+  uint64_t rows_ = 0;
+  uint64_t values_ = 0;  // listの種類の値の総数
+
+  void open(const std::string& name) { files_.push_back(std::fopen((dir_ + "/" + name).c_str(), "wb")); }
+
+  static void put(std::FILE* f, uint64_t v, int bytes) {
+    uint8_t b[8];
+    for (int i = 0; i < bytes; i++) b[i] = (uint8_t)(v >> (i * 8));
+    std::fwrite(b, 1, bytes, f);
+  }
+
+  // 列の名前, 型, 行数. 読み込む側はこれを見て各ファイルを配列として読む
+  void write_schema() {
+    std::FILE* f = std::fopen((dir_ + "/schema.txt").c_str(), "w");
+    if (!f) return;
+    std::fprintf(f, "type %s\nrows %llu\n", schema_.name.c_str(), (unsigned long long)rows_);
+    std::fprintf(f, "column time_us uint64 %llu\n", (unsigned long long)rows_);
+    std::fprintf(f, "column id uint8 %llu\n", (unsigned long long)rows_);
+    if (schema_.list) std::fprintf(f, "column length uint32 %llu\n", (unsigned long long)rows_);
+    for (const std::string& c : schema_.columns) {
+      std::fprintf(f, "column %s int32 %llu\n", c.c_str(), (unsigned long long)(schema_.list ? values_ : rows_));
+    }
+    std::fclose(f);
+  }
+};
+
+// 入力がUSBシリアルなら, 改行コードの変換やエコーをしない生のモードにする
+void set_raw(int fd) {
+  termios tio;
+  if (tcgetattr(fd, &tio) != 0) return;
+  cfmakeraw(&tio);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  tcsetattr(fd, TCSANOW, &tio);
+}
+
+void on_signal(int) {
+  interrupted = 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        usage(argv[0]);
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--csv") {
+      opt.csv = next();
+    } else if (arg == "--columnar") {
+      opt.columnar = next();
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg[0] != '-' && opt.input.empty()) {
+      opt.input = arg;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  int fd = 0;
+  if (!opt.input.empty()) {
+    fd = open(opt.input.c_str(), O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+      std::fprintf(stderr, "cannot open %s\n", opt.input.c_str());
+      return 2;
+    }
+  }
+  if (isatty(fd)) set_raw(fd);
+
+  // Ctrl-Cでreadを中断し, 出力ファイルを閉じてから終了する
+  struct sigaction sa = {};
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  std::map<uint8_t, std::unique_ptr<CsvWriter>> csv;
+  std::map<uint8_t, std::unique_ptr<ColumnarWriter>> columnar;
+  uint64_t schema_errors = 0;
+  bool print = opt.csv.empty() && opt.columnar.empty();
+  int rc = 0;
+
+  TelemetryDecoder decoder;
+  auto on_record = [&](const TelemetryRecord& r) {
+    if (rc) return;  // 出力できないので終了する
+    const TelemetrySchema& schema = telemetry_schema(r.type);
+    if (!schema.list && r.values.size() != schema.columns.size()) {
+      schema_errors++;  // 値の個数が種類の定義と違う
+      return;
+    }
+    if (print) {
+      std::printf("%llu %s %u", (unsigned long long)r.time_us, schema.name.c_str(), r.id);
+      for (int32_t v : r.values) std::printf(" %ld", (long)v);
+      std::printf("\n");
+    }
+    if (!opt.csv.empty()) {
+      auto& w = csv[r.type];
+      if (!w) {
+        w = std::make_unique<CsvWriter>(opt.csv + "_" + schema.name + ".csv", schema);
+        if (!w->ok()) {
+          std::fprintf(stderr, "cannot write %s_%s.csv\n", opt.csv.c_str(), schema.name.c_str());
+          rc = 2;
+          interrupted = 1;
+          return;
+        }
+      }
+      w->write(r);
+    }
+    if (!opt.columnar.empty()) {
+      auto& w = columnar[r.type];
+      if (!w) {
+        w = std::make_unique<ColumnarWriter>(opt.columnar + "/" + schema.name, schema);
+        if (!w->ok()) {
+          std::fprintf(stderr, "cannot write %s/%s\n", opt.columnar.c_str(), schema.name.c_str());
+          rc = 2;
+          interrupted = 1;
+          return;
+        }
+      }
+      w->write(r);
+    }
+  };
+
+  uint8_t buf[4096];
+  while (!interrupted) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n == 0) break;
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      std::fprintf(stderr, "read error\n");
+      rc = 2;
+      break;
+    }
+    decoder.feed(buf, n, on_record);
+  }
+  std::fflush(stdout);
+  csv.clear();
+  columnar.clear();
+
+  const TelemetryStats& s = decoder.stats();
+  std::fprintf(stderr, "bytes %llu, records %llu, crc errors %llu, format errors %llu, schema errors %llu\n",
+               (unsigned long long)s.bytes, (unsigned long long)s.records, (unsigned long long)s.crc_errors,
+               (unsigned long long)s.format_errors, (unsigned long long)schema_errors);
+  return rc;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// デバイスとの通信. I2C, PIO, GPIO割り込みはこのファイルのタスクだけが扱う.
+// HUB_MULTICOREが1の場合は全てコア1で動作する.
+// HUB_LOW_POWERが1の場合は, タスクの間をcommon/powerで低消費電力の状態で待機する.
+
+#include "envcalc.h"
+#include "hardware/i2c.h"
+#include "hub.h"
+#include "infrared.h"
+#include "pir.h"
+#include "power.h"
+#include "scd41.h"
+#include "sched.h"
+#include "tsl2572.h"
+
+BME280 hub_bme280(0x76);
+int32_t hub_altitude_m = HUB_ALTITUDE_M;
+
+static hub_sample_t sample_buf[HUB_SAMPLE_QUEUE_LENGTH];
+ring_t hub_samples = RING_INIT(sample_buf);
+static hub_display_t display_buf[4];
+ring_t hub_display = RING_INIT(display_buf);
+
+// サンプルを処理側へ渡し, __wfe()で待っている処理側のコアを起こす
+static void hub_push(hub_sample_t* sample) {
+  ring_push(&hub_samples, sample);
+  __sev();
+}
+
+#if HUB_USE_IR
+static uint32_t ir_buffer[HUB_IR_BUFFER_LENGTH];
+
+// 赤外線受信. PIOのRX FIFOがあふれないよう1msおきに読み出す
+static uint32_t ir_task(void* arg) {
+  int n = infrared_receive_poll();
+  if (n == INFRARED_RECEIVE_PENDING) return 0;
+  if (n > 0) {
+    hub_sample_t s = {time_us_64(), HUB_SAMPLE_IR};
+    s.ir.length = n;
+    hub_push(&s);
+  }
+  infrared_receive_start(ir_buffer, HUB_IR_BUFFER_LENGTH, 0);  // 受信完了, もしくは初回. 次の受信を開始
+  return 0;
+}
+#endif
+
+// PIRセンサーの記録を取り出す
+static uint32_t pir_task(void* arg) {
+  pir_event_t event;
+  while (pir_get_event(&event)) {
+    hub_sample_t s = {event.time_us, HUB_SAMPLE_PIR};
+    s.pir.motion = event.motion;
+    hub_push(&s);
+  }
+  return 0;
+}
+
+// BME280はNormalモードで定期測定しているので, 測定中でなければADCの値を読み出す.
+// HUB_LOW_POWERが1の場合はForcedモードで1回測定し, 測定の間はセンサーも待機させる
+static uint32_t bme280_task(void* arg) {
+#if HUB_LOW_POWER
+  static bool measuring = false;
+  if (!measuring) {
+    hub_bme280.write_ctrl(BME280::MODE_FORCED, BME280::OVER_SAMPLING_16, BME280::OVER_SAMPLING_16,
+                          BME280::OVER_SAMPLING_16);
+    measuring = true;
+    return 115000;  // 16倍のオーバーサンプリングで約113ms
+  }
+  if (hub_bme280.read_status() & 0x8) return 10000;
+  measuring = false;
+#else
+  if (hub_bme280.read_status() & 0x8) return 10000;  // 測定中. 10ms後にもう一度読み出す
+#endif
+  hub_bme280.read_adc();
+  hub_sample_t s = {time_us_64(), HUB_SAMPLE_BME280};
+  s.bme280.adc_temperature = hub_bme280.adc_temperature;
+  s.bme280.adc_pressure = hub_bme280.adc_pressure;
+  s.bme280.adc_humidity = hub_bme280.adc_humidity;
+  hub_push(&s);
+  return 0;
+}
+
+#if HUB_TSL2572_INT_PIN >= 0
+static int tsl2572_task_id = -1;
+
+// TSL2572のINTピンがLowになった. 照度が変化したので, 周期を待たずに測定する
+static void tsl2572_int_callback(void* arg) {
+  if (tsl2572_task_id >= 0) sched_trigger(tsl2572_task_id);
+}
+#endif
+
+// TSL2572は短い測定で範囲を決めてから本番の測定を行う. 測定時間はsleepせず, スケジューラーに戻して待つ.
+// HUB_TSL2572_INT_PINが0以上の場合は, 測定後に同じ範囲で照度の監視をセンサーに任せ, 変化したらINTピンで呼ばれる
+static uint32_t tsl2572_task(void* arg) {
+  static uint step = 0;
+  switch (step) {
+    case 0:  // 範囲を決めるための短い測定を開始
+#if HUB_TSL2572_INT_PIN >= 0
+      tsl2572_stop_als_monitor();
+#endif
+      tsl2572_integ_cycles = 4;
+      tsl2572_again = TSL2572_AGAIN_1;
+      step = 1;
+      return tsl2572_start_als_integration() + 1000;
+    case 1:  // 結果から本番の測定を開始
+      if (!tsl2572_als_integration_done()) return 3000;
+      tsl2572_select_range();
+      step = 2;
+      return tsl2572_start_als_integration() + 1000;
+    default: {  // 本番の測定結果を渡す
+      if (!tsl2572_als_integration_done()) return 3000;
+      hub_sample_t s = {time_us_64(), HUB_SAMPLE_TSL2572};
+      s.tsl2572.ch0 = tsl2572_adc_ch0;
+      s.tsl2572.ch1 = tsl2572_adc_ch1;
+      s.tsl2572.integ_cycles = tsl2572_integ_cycles;
+      s.tsl2572.again = tsl2572_again;
+      hub_push(&s);
+#if HUB_TSL2572_INT_PIN >= 0
+      // CH0が測定値からHUB_TSL2572_INT_PERMILLE以上変化した測定が続いたら割り込み
+      uint32_t margin = tsl2572_adc_ch0 * HUB_TSL2572_INT_PERMILLE / 1000 + 1;
+      uint32_t high = tsl2572_adc_ch0 + margin;
+      tsl2572_start_als_monitor(tsl2572_adc_ch0 > margin ? tsl2572_adc_ch0 - margin : 0,
+                                high < 0xFFFF ? high : 0xFFFF, 2);
+#endif
+      step = 0;
+      return 0;
+    }
+  }
+}
+
+// SCD41は5秒おき(HUB_LOW_POWERが1なら30秒おき)に定期測定しているので, 新しいデータがあれば読み出す
+static uint32_t scd41_task(void* arg) {
+#if HUB_LOW_POWER
+  if (!scd41_get_data_ready_status()) return 1000000;  // 30秒おきの測定では1秒の遅れは問題にならない. 起きる回数を減らす
+#else
+  if (!scd41_get_data_ready_status()) return 100000;  // 測定前. 100ms後にもう一度確認
+#endif
+  if (scd41_read_measurement(0)) {
+    hub_sample_t s = {time_us_64(), HUB_SAMPLE_SCD41};
+    s.scd41.co2 = scd41_co2;
+    s.scd41.temperature_x100 = scd41_temperature_x100;
+    s.scd41.humidity_x100 = scd41_humidity_x100;
+    hub_push(&s);
+  }
+  return 0;
+}
+
+// 処理側から届いた最新の表示内容をフレームバッファーに書き, 変化した部分をキューから送信する.
+// コマンドの実行時間は待たずに戻る
+static uint32_t lcd_task(void* arg) {
+  static bool flushing = false;
+  if (!flushing) {
+    hub_display_t display;
+    bool updated = false;
+    while (ring_pop(&hub_display, &display)) updated = true;  // 古い表示内容は捨てる
+    if (updated) {
+      for (uint line = 0; line < LCDAQM_LINES; line++) lcdaqm_fb_print(line, 0, display.text[line]);
+      lcdaqm_queue_fb_flush();
+    }
+    flushing = true;
+  }
+  if (lcdaqm_queue_service()) {
+    int64_t wait = absolute_time_diff_us(get_absolute_time(), lcdaqm_queue_ready_time());
+    return wait > 0 ? (uint32_t)wait : 1;
+  }
+  flushing = false;
+  return 0;
+}
+
+#if HUB_LOW_POWER
+// DEEP_SLEEP, DORMANTから復帰した. 待機中はPIOのクロックが遅くなるか止まるので, 受信中のデータは捨てる
+static void hub_resume(void* arg) {
+#if HUB_USE_IR
+  infrared_receive_cancel();  // 次のir_taskで受信を開始し直す
+#endif
+}
+#endif
+
+// sched_addでタスクを登録する. 登録できない場合はタスクが動かないまま気付けないので, 停止する.
+// HUB_MULTICOREが0の場合は処理側(main.cpp)のタスクも登録するので, SCHED_MAX_TASKSはCMakeLists.txtで指定する
+//
+// Returns: タスク番号
+int hub_sched_add(const char* name, sched_task_fn_t fn, void* arg, uint32_t period_ms, uint32_t deadline_ms,
+                  uint32_t offset_ms) {
+  int id = sched_add(name, fn, arg, period_ms, deadline_ms, offset_ms);
+  if (id < 0) panic("Failed to add task %s. Increase SCHED_MAX_TASKS (%d)\n", name, SCHED_MAX_TASKS);
+  return id;
+}
+
+// I2C, 赤外線受信, PIRセンサーを初期化し, 接続を確認したデバイスのタスクをschedに登録する.
+// HUB_MULTICOREが1の場合は, 割り込みがコア1で処理されるようにコア1から呼ぶ.
+//
+// Returns: 接続を確認したデバイス. HUB_DEVICE_xのビットの組み合わせ
+uint32_t hub_acquire_init() {
+  uint32_t devices = 0;
+#if HAL_INSTR
+  instr_init();  // サイクルカウンターはコアごとにあるので, ドライバーを呼ぶコアで有効にする
+#endif
+  scd41_init_i2c();  // 全てのセンサーで同じI2Cインスタンスとピンを使用
+  i2c_set_baudrate(i2c_default, HUB_I2C_BAUD);
+
+#if HUB_LOW_POWER
+#if PIR_USE_PIO || PIR_E9_WORKAROUND
+  // PIRをサンプリングする場合はSLEEPまで. PIOはクロックが変わると時刻がずれ, E9対策のタイマーは2msおきに起こす
+  power_init(POWER_SLEEP, hub_resume, NULL);
+#else
+  power_init(POWER_DORMANT, hub_resume, NULL);
+#endif
+  sched_set_idle(power_wait_until);
+#endif
+
+  // 周期[ms], 期限[ms], 開始時刻のずれ[ms]
+#if HUB_USE_IR
+  infrared_receive_init();
+  hub_sched_add("ir", ir_task, NULL, 1, 1, 0);
+#endif
+
+  pir_init();
+#if HUB_LOW_POWER && !PIR_E9_WORKAROUND && !PIR_USE_PIO
+  // 変化はエッジ割り込みで時刻とともに記録されるので, 読み出しは1秒おきでよい. DORMANTからもエッジで復帰する
+  power_add_wake_pin(PIR_PIN, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, NULL, NULL);
+  hub_sched_add("pir", pir_task, NULL, 1000, 1000, 0);
+#else
+  hub_sched_add("pir", pir_task, NULL, 100, 100, 0);
+#endif
+
+  if (hub_bme280.check_id()) {
+    if (hub_altitude_m < 0 && hub_bme280.forced()) {
+      // 1回測定した気圧から標高を推定する. 海面より低い場合は0mとする
+      int32_t altitude = envcalc_altitude_m(hub_bme280.pressure_x100, HUB_SEA_LEVEL_PRESSURE_X100);
+      hub_altitude_m = altitude > 0 ? altitude : 0;
+    }
+    hub_bme280.read_calibration_data();
+#if HUB_LOW_POWER
+    hub_bme280.write_config(BME280::T_STANDBY_05MS, BME280::FILTER_OFF);  // 測定はbme280_taskで開始する
+    hub_sched_add("bme280", bme280_task, NULL, HUB_BME280_FORCED_PERIOD_MS, 500, 200);
+#else
+    hub_bme280.write_config(BME280::T_STANDBY_1000MS, BME280::FILTER_OFF);
+    hub_bme280.write_ctrl(BME280::MODE_NORMAL, BME280::OVER_SAMPLING_16, BME280::OVER_SAMPLING_16,
+                          BME280::OVER_SAMPLING_16);
+    hub_sched_add("bme280", bme280_task, NULL, 1000, 200, 200);
+#endif
+    devices |= HUB_DEVICE_BME280;
+  }
+
+  if (tsl2572_check_id()) {
+#if HUB_TSL2572_INT_PIN >= 0
+    // INTはオープンドレインでLowになる. 監視中は変化したときに呼ばれるので, 周期は変化が無い場合の確認だけ
+    gpio_init(HUB_TSL2572_INT_PIN);
+    gpio_pull_up(HUB_TSL2572_INT_PIN);
+    tsl2572_task_id = hub_sched_add("tsl2572", tsl2572_task, NULL, HUB_TSL2572_INT_PERIOD_MS, 1000, 300);
+    power_add_wake_pin(HUB_TSL2572_INT_PIN, GPIO_IRQ_EDGE_FALL, tsl2572_int_callback, NULL);
+#else
+    hub_sched_add("tsl2572", tsl2572_task, NULL, 2000, 1000, 300);
+#endif
+    devices |= HUB_DEVICE_TSL2572;
+  }
+
+  uint64_t serial;
+  scd41_stop_periodic_measurement(true);  // 前回の起動で開始した定期測定を停止
+  if (scd41_get_serial_number(&serial)) {
+    if (hub_altitude_m >= 0) scd41_set_sensor_altitude((uint16_t)hub_altitude_m);  // 標高による気圧の補正. 停止中に設定する
+#if HUB_LOW_POWER
+    scd41_start_low_power_periodic_measurement();  // 30秒おきに測定. 5秒おきより消費電流が小さい
+    hub_sched_add("scd41", scd41_task, NULL, 30000, 30000, 30000);
+#else
+    scd41_start_periodic_measurement();
+    hub_sched_add("scd41", scd41_task, NULL, 5000, 5000, 5000);
+#endif
+    devices |= HUB_DEVICE_SCD41;
+  }
+
+  if (HUB_USE_LCD) {  // LCDはACKに応答しないため, 接続を確認できない
+    lcdaqm_queue_init();
+    hub_sched_add("lcd", lcd_task, NULL, 1000, 100, 500);
+    devices |= HUB_DEVICE_LCD;
+  }
+  return devices;
+}
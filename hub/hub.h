@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef HUB_H
+#define HUB_H
+
+// デバイスとの通信(acquire.cpp)と, 測定値の計算, 表示(main.cpp)の間の受け渡し.
+// 通信側は読み出した値を計算せずにサンプルとしてhub_samplesへ入れ, 処理側が取り出して計算する.
+// LCDの表示内容は逆向きにhub_displayで渡す. どちらもSPSCのリングバッファーなので,
+// HUB_MULTICOREが1の場合は通信側をコア1, 処理側をコア0で動かしても排他処理は不要.
+
+#include "bme280.h"
+#include "lcdaqm.h"
+#include "pico/stdlib.h"
+#include "ring.h"
+#include "sched.h"
+
+// -----------------
+// Configurations
+
+#ifndef HUB_LOW_POWER
+#define HUB_LOW_POWER 0  // 1でタスクの間を低消費電力の状態で待機する(common/power.h). 全てコア0で動かす. CMakeのHUB_LOW_POWERで指定する
+#endif
+#ifndef HUB_MULTICORE
+#define HUB_MULTICORE (!HUB_LOW_POWER)  // 1で通信をコア1, 計算と表示をコア0で行う. 0で全てコア0
+#endif
+#ifndef HUB_USE_LCD
+#define HUB_USE_LCD 1  // 1でLCDに表示する(RPi TPH Monitor). LCDは接続を確認できないので指定する
+#endif
+#define HUB_I2C_BAUD 400000                 // I2C周波数[Hz]. 1回の通信を短くし, 赤外線受信の読み出しを遅らせないようにする
+#define HUB_IR_BUFFER_LENGTH 1000           // 赤外線受信データの最大要素数
+#define HUB_SAMPLE_QUEUE_LENGTH 32          // 通信側から処理側へのキューの長さ. 2のべき乗
+#define HUB_REPORT_PERIOD_MS 10000          // 測定値とタスクの統計情報を表示する周期[ms]
+#define HUB_USE_FLASHLOG 1                  // 1で測定値をフラッシュに記録する(common/flashlog.h). USBシリアルから'x'で書き出す
+#define HUB_FLASHLOG_SIZE (512 * 1024)      // 記録の領域[byte]. フラッシュの最後から確保するので, プログラムと重ならない大きさにする
+#define HUB_FLASHLOG_PERIOD_MS 1000         // 記録の周期[ms]
+#define HUB_AGGREGATE_PERIOD_MS 60000       // 測定値の集計(common/aggregate.h)を表示する周期[ms]. 0で集計しない
+#define HUB_AGGREGATE_PANES 1               // 集計する窓の長さ(周期の数). 1で周期ごとに区切る. 2以上で直近の複数周期を周期ごとに集計
+#define HUB_AGGREGATE_EMA_SHIFT 4           // 集計のEMAの係数 1/2^n
+#define HUB_USE_DEADBAND 1                  // 1で測定値が変化した場合だけ出力する(common/deadband.h). 0で測定のたびに出力
+#define HUB_DEADBAND_TEMPERATURE 10         // 温度を出力する変化[0.01℃]. この値を超えて変化したら出力する
+#define HUB_DEADBAND_HUMIDITY 50            // 湿度を出力する変化[0.01%]
+#define HUB_DEADBAND_PRESSURE 10            // 気圧を出力する変化[0.01hPa]
+#define HUB_DEADBAND_LUX 10                 // 照度を出力する変化[0.1lux]
+#define HUB_DEADBAND_LUX_PERMILLE 50        // 照度を出力する変化の前回の値に対する割合[0.1%]. HUB_DEADBAND_LUXと大きい方を使う
+#define HUB_DEADBAND_CO2 20                 // CO2濃度を出力する変化[ppm]
+#define HUB_MAX_SILENCE_MS 600000           // 変化しなくても出力する間隔[ms]. 0で変化したときだけ出力
+#define HUB_ALTITUDE_M -1                   // 設置場所の標高[m]. 海面気圧の換算とSCD41の気圧補正に使う. 負の値で起動時の気圧から推定する
+#define HUB_SEA_LEVEL_PRESSURE_X100 101325  // 標高の推定に使う海面気圧[0.01hPa]. 天候で±30hPa程度変わるので, 推定の誤差は±250m程度
+#define HUB_USE_IR 1                        // 1で赤外線を受信する. 1msおきに読み出すため, HUB_LOW_POWERでは0にしないと深い状態で待機できない
+#define HUB_BME280_FORCED_PERIOD_MS 10000   // HUB_LOW_POWERでBME280をForcedモードで測定する周期[ms]
+#define HUB_TSL2572_INT_PIN -1              // TSL2572のINTピンを接続したGPIO番号. 0以上で照度の変化をセンサーが監視し, 変化したら測定する
+#define HUB_TSL2572_INT_PERMILLE 100        // INTピンで測定する照度(CH0)の変化の割合[0.1%]
+#define HUB_TSL2572_INT_PERIOD_MS 60000     // INTピンを使う場合に, 変化が無くても測定する周期[ms]
+#define HUB_USE_RULES 1                     // 1で測定値のルール(common/rules.h)を評価し, 満たした時と満たさなくなった時に動作する
+#define HUB_RULES_USE_RELAY 0               // 1で換気のルールを満たしている間リレー(relay/relay.h)をON. 0ならHUB_RULES_LED_PINのLEDを点灯
+#define HUB_RULES_LED_PIN 3                 // 換気のルールで点灯するLEDのGPIO番号(RPZ-PIRS, RPZ-CO2-SensorのLED1 緑)
+#define HUB_RULES_IR_NEC_CODE 0x00FF45BA    // 消し忘れのルールで送信する照明OFFの赤外線. NECフォーマットの32bitを送信順(LSBから). 0で送信しない
+#define HUB_RULES_IR_REPEAT 2               // 照明OFFの赤外線を送信する回数. フレームの間は40ms
+
+// -----------------
+
+#if HUB_LOW_POWER && HUB_MULTICORE
+#error "HUB_LOW_POWER requires HUB_MULTICORE 0"
+#endif
+
+// 接続を確認したデバイス. hub_acquire_initの戻り値. LCDはHUB_USE_LCDが1なら常に含む
+#define HUB_DEVICE_BME280 (1u << 0)
+#define HUB_DEVICE_TSL2572 (1u << 1)
+#define HUB_DEVICE_SCD41 (1u << 2)
+#define HUB_DEVICE_LCD (1u << 3)
+
+typedef enum {
+  HUB_SAMPLE_BME280,
+  HUB_SAMPLE_TSL2572,
+  HUB_SAMPLE_SCD41,
+  HUB_SAMPLE_PIR,
+  HUB_SAMPLE_IR,
+} hub_sample_type_t;
+
+// 通信側が読み出した値. 計算は処理側で行う
+typedef struct {
+  uint64_t time_us;  // 読み出した時刻. PIRは変化した時刻
+  uint8_t type;      // hub_sample_type_t
+  union {
+    struct {
+      uint32_t adc_temperature;
+      uint32_t adc_pressure;
+      uint32_t adc_humidity;
+    } bme280;  // ADCレジスターの値
+    struct {
+      uint16_t ch0;
+      uint16_t ch1;
+      uint16_t integ_cycles;
+      uint8_t again;
+    } tsl2572;  // ADCレジスターの値と測定条件
+    struct {
+      uint16_t co2;
+      int32_t temperature_x100;
+      uint32_t humidity_x100;
+    } scd41;  // 測定値. 変換は読み出し時に整数演算で済むので通信側で行う
+    struct {
+      bool motion;
+    } pir;
+    struct {
+      int length;
+    } ir;  // 受信した要素数
+  };
+} hub_sample_t;
+
+// LCDの表示内容
+typedef struct {
+  char text[LCDAQM_LINES][LCDAQM_COLS + 1];
+} hub_display_t;
+
+extern ring_t hub_samples;      // 通信側 -> 処理側
+extern ring_t hub_display;      // 処理側 -> 通信側
+extern BME280 hub_bme280;       // 通信側のBME280. キャリブレーションデータはhub_acquire_init後に変化しない
+extern int32_t hub_altitude_m;  // 設置場所の標高[m]. 負の値なら不明. hub_acquire_init後に変化しない
+
+uint32_t hub_acquire_init();
+int hub_sched_add(const char* name, sched_task_fn_t fn, void* arg, uint32_t period_ms, uint32_t deadline_ms,
+                  uint32_t offset_ms);
+
+#endif
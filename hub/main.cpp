@@ -0,0 +1,552 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// 測定値の計算と表示. 通信側(acquire.cpp)から届いたサンプルを計算し, USBシリアルとLCDに表示する.
+// USBの送信が詰まっても, 通信側のタスクが遅れることはない.
+// HUB_USE_FLASHLOGが1の場合は測定値をフラッシュに記録し, USBシリアルから'x'を受信したら書き出す.
+// HUB_AGGREGATE_PERIOD_MSごとに, 測定値の最小, 最大, 平均, 標準偏差, EMAを表示する.
+// HUB_USE_DEADBANDが1の場合は, 測定値が変化したときだけUSBシリアル, フラッシュ, LCDへ出力する.
+// 温度, 湿度, 気圧から露点, 絶対湿度, 暑さ指数, 海面気圧を整数演算で求めて表示する.
+// HUB_LOW_POWERが1の場合は, 待機した状態ごとの時間と復帰の時間を表示する.
+// HUB_USE_RULESが1の場合は, 測定値のルールを評価し, 換気を促すLEDかリレー, 照明を消す赤外線の送信を行う.
+
+#include <stdio.h>
+
+#include "envcalc.h"
+#include "hub.h"
+#include "numfmt.h"
+#include "pico/stdlib.h"
+#include "sched.h"
+#include "tsl2572.h"
+#if HUB_MULTICORE
+#include "pico/multicore.h"
+#endif
+#if HUB_AGGREGATE_PERIOD_MS
+#include "aggregate.h"
+#endif
+#if HUB_USE_DEADBAND
+#include "deadband.h"
+#endif
+#if HUB_LOW_POWER
+#include "power.h"
+#endif
+#if HUB_USE_RULES
+#include "infrared.h"
+#include "rules.h"
+#if HUB_RULES_USE_RELAY
+#include "relay.h"
+#endif
+#endif
+#if HUB_USE_FLASHLOG
+#include "flashlog.h"
+#include "pico/flash.h"
+#include "telemetry.h"
+#endif
+
+static BME280 bme280;  // 計算用. 通信はしない
+static uint32_t devices = 0;
+
+// 測定値を1度でも計算したらtrue
+static bool bme280_valid = false;
+static bool scd41_valid = false;
+static bool tsl2572_valid = false;
+static uint32_t ir_count = 0;  // 赤外線を受信した回数
+
+// 出力する測定値
+typedef enum {
+  CHANNEL_TEMPERATURE,
+  CHANNEL_HUMIDITY,
+  CHANNEL_PRESSURE,
+  CHANNEL_LUX,
+  CHANNEL_CO2,
+  CHANNELS,
+} channel_t;
+
+// 測定値の名前と表示. 値はscale桁の固定小数で, 小数点以下frac_digits桁を表示する
+static const struct {
+  const char* name;
+  uint8_t scale;
+  uint8_t frac_digits;
+  const char* unit;
+} channel_info[CHANNELS] = {
+    {"temperature", 2, 2, "C"},
+    {"humidity", 2, 2, "%"},
+    {"pressure", 2, 2, "hPa"},
+    {"lux", 1, 1, "lux"},
+    {"co2", 0, 0, "ppm"},
+};
+
+// 測定値の出力先. 出力先ごとに, 前回の出力から変化した測定値を記録する
+typedef enum {
+  SINK_REPORT,   // USBシリアル
+  SINK_LOG,      // フラッシュの記録
+  SINK_DISPLAY,  // LCD
+  SINKS,
+} sink_t;
+
+// 出力する値. 温度[0.01℃], 湿度[0.01%], 気圧[0.01hPa], 照度[0.1lux], CO2濃度[ppm]
+static int32_t channel_values[CHANNELS];
+static uint32_t channel_changed[SINKS];  // 出力先が最後に出力してから変化した測定値. 1u << channel_t
+
+#if HUB_USE_DEADBAND
+// 測定値ごとのしきい値[値の単位], 前回の値に対する割合[0.1%], 最大の無出力時間[ms]
+static const struct {
+  int32_t threshold;
+  uint16_t permille;
+  uint32_t max_silence_ms;
+} deadband_config[CHANNELS] = {
+    {HUB_DEADBAND_TEMPERATURE, 0, HUB_MAX_SILENCE_MS},
+    {HUB_DEADBAND_HUMIDITY, 0, HUB_MAX_SILENCE_MS},
+    {HUB_DEADBAND_PRESSURE, 0, HUB_MAX_SILENCE_MS},
+    {HUB_DEADBAND_LUX, HUB_DEADBAND_LUX_PERMILLE, HUB_MAX_SILENCE_MS},
+    {HUB_DEADBAND_CO2, 0, HUB_MAX_SILENCE_MS},
+};
+
+static deadband_t deadbands[CHANNELS];
+
+static void deadband_setup() {
+  for (uint i = 0; i < CHANNELS; i++) {
+    deadband_init(&deadbands[i], deadband_config[i].threshold, deadband_config[i].permille,
+                  deadband_config[i].max_silence_ms * 1000ull);
+  }
+}
+#endif
+
+#if HUB_AGGREGATE_PERIOD_MS
+static aggregate_t aggregates[CHANNELS];
+static aggregate_pane_t aggregate_panes[CHANNELS][HUB_AGGREGATE_PANES];
+
+static void aggregate_setup() {
+  for (uint i = 0; i < CHANNELS; i++) {
+    aggregate_init(&aggregates[i], aggregate_panes[i], HUB_AGGREGATE_PANES, HUB_AGGREGATE_PERIOD_MS * 1000ull,
+                   HUB_AGGREGATE_EMA_SHIFT);
+  }
+}
+
+// 測定値を集計に追加し, 窓が終わったら集計結果を1行表示する
+static void aggregate_sample(channel_t ch, uint64_t time_us, int32_t value) {
+  aggregate_result_t r;
+  if (!aggregate_add(&aggregates[ch], time_us, value, &r)) return;
+
+  const auto& info = channel_info[ch];
+  char buf[112];
+  unsigned n = numfmt_str(buf, sizeof(buf), "agg ");
+  n += numfmt_str(buf + n, sizeof(buf) - n, info.name);
+  n += numfmt_str(buf + n, sizeof(buf) - n, " n ");
+  n += numfmt_uint(buf + n, sizeof(buf) - n, r.count, 0, ' ');
+  const char* labels[] = {" min ", " max ", " mean ", " sd ", " ema "};
+  int32_t values[] = {r.min, r.max, r.mean, (int32_t)aggregate_sqrt(r.variance), r.ema};
+  for (uint i = 0; i < 5; i++) {
+    n += numfmt_str(buf + n, sizeof(buf) - n, labels[i]);
+    n += numfmt_fixed(buf + n, sizeof(buf) - n, values[i], info.scale, info.frac_digits, 0, ' ');
+  }
+  n += numfmt_str(buf + n, sizeof(buf) - n, " ");
+  numfmt_str(buf + n, sizeof(buf) - n, info.unit);
+  puts(buf);
+}
+#endif
+
+#if HUB_USE_RULES
+// ルールの入力. 測定値はchannel_tの番号で, 単位もchannel_valuesと同じ
+#define RULE_INPUT_MOTION CHANNELS  // 人感センサー. 1で検知中
+
+#define RULE_IR_LENGTH (2 + 64 + 1)  // NECフォーマットの1フレームの要素数. リーダー, 32bit, ストップビット
+
+static const char* const rule_names[] = {"ventilate", "lights-left-on"};
+static uint32_t rule_ir_words[RULE_IR_LENGTH + 1];  // 照明OFFの赤外線を送信用に変換したワード列
+static uint rule_ir_word_count = 0;                 // 0なら赤外線を送信しない
+
+// 照明OFFの赤外線(HUB_RULES_IR_NEC_CODE)を送信用のワード列にする. 送信用PIOを確保できなければ送信しない
+static void rule_ir_prepare() {
+  if (HUB_RULES_IR_NEC_CODE == 0 || !infrared_send_init()) return;
+  uint32_t data[RULE_IR_LENGTH];
+  uint n = 0;
+  data[n++] = 9000;
+  data[n++] = 4500;
+  for (int i = 0; i < 32; i++) {
+    data[n++] = 560;
+    data[n++] = (HUB_RULES_IR_NEC_CODE >> i) & 1 ? 1690 : 560;
+  }
+  data[n++] = 560;
+  rule_ir_word_count = infrared_encode_send_words(data, n, 40000, rule_ir_words);  // フレーム後に40msの停止時間
+}
+
+// 換気を促す. 満たしている間リレーをONにするかLEDを点灯する
+static void rule_ventilate(bool active) {
+#if HUB_RULES_USE_RELAY
+  if (active) {
+    relay_on();  // 最小ON/OFF時間はリレーの制御が守る
+  } else {
+    relay_off();
+  }
+#else
+  gpio_put(HUB_RULES_LED_PIN, active);
+#endif
+}
+
+// 照明の消し忘れ. 満たした時に照明OFFの赤外線を送信する. 送信はDMAとPIOで行い待たない
+static void rule_lights_off(bool active) {
+  if (!active || !rule_ir_word_count) return;
+  infrared_playback_entry_t entry = {rule_ir_words, rule_ir_word_count, HUB_RULES_IR_REPEAT};
+  if (!infrared_playback_start(&entry, 1)) printf("rule lights-left-on IR busy\n");
+}
+
+// ルールを満たした時と満たさなくなった時に動作する. 表示は動作の確認用
+static void rule_action(uint32_t arg, bool active) {
+  printf("rule %s %s\n", rule_names[arg], active ? "on" : "off");
+  if (arg == 0) {
+    rule_ventilate(active);
+  } else {
+    rule_lights_off(active);
+  }
+}
+
+// CO2濃度が1000ppmを超えた状態が60秒続いたら換気を促す. 900ppm以下で解除
+// 人感センサーの検知なしが10分続き, かつ50lux超なら消し忘れ. 検知か45lux以下で解除
+static const rules_rule_t rule_table[] = {
+    {{RULES_COND(CHANNEL_CO2, RULES_GT, 1000, 100, 60000)}, 1, rule_action, 0},
+    {{RULES_COND(RULE_INPUT_MOTION, RULES_LT, 1, 0, 600000), RULES_COND(CHANNEL_LUX, RULES_GT, 500, 50, 0)},
+     2,
+     rule_action,
+     1},
+};
+
+// ルールで操作する出力を初期化し, ルールの評価を開始する
+static void rules_setup() {
+#if HUB_RULES_USE_RELAY
+  if (!relay_init()) printf("relay init failed\n");
+#else
+  gpio_init(HUB_RULES_LED_PIN);
+  gpio_set_dir(HUB_RULES_LED_PIN, GPIO_OUT);
+#endif
+  rule_ir_prepare();
+  rules_init(rule_table, count_of(rule_table));
+}
+#endif
+
+// 測定値を集計し, 変化時の出力の判定を通った値を出力先へ渡す. 集計とルールには全ての測定値を使う
+static void channel_sample(channel_t ch, uint64_t time_us, int32_t value) {
+#if HUB_AGGREGATE_PERIOD_MS
+  aggregate_sample(ch, time_us, value);
+#endif
+#if HUB_USE_RULES
+  rules_update(ch, value, (uint32_t)(time_us / 1000));
+#endif
+#if HUB_USE_DEADBAND
+  if (!deadband_update(&deadbands[ch], time_us, value)) return;
+#endif
+  channel_values[ch] = value;
+  for (uint i = 0; i < SINKS; i++) channel_changed[i] |= 1u << ch;
+}
+
+// Returns: 出力先sinkが最後に出力してから変化した測定値. 呼ぶと変化なしに戻る
+static uint32_t channel_take_changed(sink_t sink) {
+  uint32_t changed = channel_changed[sink];
+  channel_changed[sink] = 0;
+  return changed;
+}
+
+#if HUB_USE_FLASHLOG
+// 記録する値. 温度[0.1℃], 気圧[0.1hPa], 湿度[0.1%], 照度[lux], CO2濃度[ppm]
+#define HUB_FLASHLOG_CHANNELS 5
+
+static flashlog_t flashlog;
+static bool flashlog_ready = false;
+
+// Returns: valueを1/divにして四捨五入した値
+static int32_t round_div(int32_t value, int32_t div) {
+  return (value + (value < 0 ? -div / 2 : div / 2)) / div;
+}
+
+// 前回の記録から測定値が変化していれば記録し, フラッシュの書き込みか消去を1回行う. 測定していない値はFLASHLOG_NO_VALUE.
+// 時刻は起動からの秒数. 起動の番号はflashlog_initで記録ごとに付く
+static uint32_t log_task(void* arg) {
+  if (!flashlog_ready) return 0;
+  if (!channel_take_changed(SINK_LOG)) {
+    flashlog_service(&flashlog);
+    return 0;
+  }
+  int32_t values[HUB_FLASHLOG_CHANNELS] = {FLASHLOG_NO_VALUE, FLASHLOG_NO_VALUE, FLASHLOG_NO_VALUE,
+                                           FLASHLOG_NO_VALUE, FLASHLOG_NO_VALUE};
+  if (bme280_valid) {
+    values[0] = round_div(channel_values[CHANNEL_TEMPERATURE], 10);
+    values[1] = round_div(channel_values[CHANNEL_PRESSURE], 10);
+    values[2] = round_div(channel_values[CHANNEL_HUMIDITY], 10);
+  }
+  if (tsl2572_valid) values[3] = round_div(channel_values[CHANNEL_LUX], 10);
+  if (scd41_valid) values[4] = channel_values[CHANNEL_CO2];
+  flashlog_append(&flashlog, (uint32_t)(time_us_64() / 1000000), values);
+  flashlog_service(&flashlog);
+  return 0;
+}
+
+// 記録を全てstdio(USBシリアルかUART)へ書き出す. 書き込み待ちのブロックを先に書き込む
+static void export_flashlog() {
+  if (!flashlog_ready) return;
+  flashlog_flush(&flashlog);
+  for (int i = 0; i < 16 && flashlog_busy(&flashlog); i++) flashlog_service(&flashlog);
+  stdio_flush();
+#if LIB_PICO_STDIO_USB
+  flashlog_export(&flashlog, telemetry_usb_write, NULL);
+#else
+  flashlog_export(&flashlog, telemetry_uart_write, NULL);
+#endif
+}
+#endif
+
+// USBシリアルから受信したコマンドを処理する. ブロックしない
+static void command_poll() {
+  int c = getchar_timeout_us(0);
+#if HAL_INSTR
+  instr_command(c);  // 'i'でドライバーの計測結果を表示する
+#endif
+#if HUB_USE_FLASHLOG
+  if (c == 'x') export_flashlog();
+#endif
+}
+
+// 届いたサンプルを全て計算する
+static uint32_t process_task(void* arg) {
+  command_poll();
+  hub_sample_t s;
+  while (ring_pop(&hub_samples, &s)) {
+    switch (s.type) {
+      case HUB_SAMPLE_BME280:
+        bme280.adc_temperature = s.bme280.adc_temperature;
+        bme280.adc_pressure = s.bme280.adc_pressure;
+        bme280.adc_humidity = s.bme280.adc_humidity;
+        bme280.calculate_measured_values();
+        bme280_valid = true;
+        channel_sample(CHANNEL_TEMPERATURE, s.time_us, bme280.temperature_x100);
+        channel_sample(CHANNEL_HUMIDITY, s.time_us, bme280.humidity_x100);
+        channel_sample(CHANNEL_PRESSURE, s.time_us, bme280.pressure_x100);
+        break;
+      case HUB_SAMPLE_TSL2572: {
+        float lux = tsl2572_lux(s.tsl2572.ch0, s.tsl2572.ch1, s.tsl2572.integ_cycles, s.tsl2572.again);
+        tsl2572_valid = true;
+        channel_sample(CHANNEL_LUX, s.time_us, (int32_t)(lux * 10 + (lux < 0 ? -0.5f : 0.5f)));
+        break;
+      }
+      case HUB_SAMPLE_SCD41:
+        scd41_valid = true;
+        channel_sample(CHANNEL_CO2, s.time_us, s.scd41.co2);
+        break;
+      case HUB_SAMPLE_PIR:
+        printf("%lu.%03lu[s] %s\n", (unsigned long)(s.time_us / 1000000), (unsigned long)(s.time_us / 1000 % 1000),
+               s.pir.motion ? "motion" : "clear");
+#if HUB_USE_RULES
+        rules_update(RULE_INPUT_MOTION, s.pir.motion, (uint32_t)(s.time_us / 1000));
+#endif
+        break;
+      case HUB_SAMPLE_IR:
+        ir_count++;
+        printf("IR received %d\n", s.ir.length);
+        break;
+    }
+  }
+#if HUB_USE_RULES
+  rules_poll((uint32_t)(time_us_64() / 1000));  // 継続時間の判定. 少なくとも1秒おきに呼ばれる
+#if HUB_LOW_POWER
+  // 赤外線の送信中にPIOのクロックが遅くなると波形が崩れるので, 送信が終わるまでSLEEPだけで待つ
+  if (infrared_playback_busy()) return 1000;
+#endif
+#endif
+  return 0;
+}
+
+// 表示する測定値が変化していれば, LCDの表示内容を作り通信側へ渡す
+static uint32_t display_task(void* arg) {
+  if (!(devices & HUB_DEVICE_LCD)) return 0;
+  if (!channel_take_changed(SINK_DISPLAY)) return 0;
+  hub_display_t display;
+  for (uint line = 0; line < LCDAQM_LINES; line++) numfmt_str(display.text[line], LCDAQM_COLS + 1, "        ");
+  if (bme280_valid) {
+    unsigned n = numfmt_fixed(display.text[0], LCDAQM_COLS + 1, channel_values[CHANNEL_TEMPERATURE], 2, 1, 6, ' ');
+    numfmt_str(display.text[0] + n, LCDAQM_COLS + 1 - n, "C ");
+  }
+  if (scd41_valid) {
+    unsigned n = numfmt_uint(display.text[1], LCDAQM_COLS + 1, channel_values[CHANNEL_CO2], 5, ' ');
+    numfmt_str(display.text[1] + n, LCDAQM_COLS + 1 - n, "ppm");
+  } else if (bme280_valid) {
+    unsigned n = numfmt_fixed(display.text[1], LCDAQM_COLS + 1, channel_values[CHANNEL_HUMIDITY], 2, 1, 6, ' ');
+    numfmt_str(display.text[1] + n, LCDAQM_COLS + 1 - n, "% ");
+  }
+  ring_push(&hub_display, &display);
+  return 0;
+}
+
+// 温度, 湿度, 気圧から求めた露点, 絶対湿度, 暑さ指数を表示する. 標高が分かっていれば海面気圧も表示する
+static void report_derived() {
+  int32_t t = channel_values[CHANNEL_TEMPERATURE];
+  uint32_t h = (uint32_t)channel_values[CHANNEL_HUMIDITY];
+  char buf[80];
+  unsigned n = numfmt_str(buf, sizeof(buf), "dew ");
+  n += numfmt_fixed(buf + n, sizeof(buf) - n, envcalc_dew_point_x100(t, h), 2, 1, 0, ' ');
+  n += numfmt_str(buf + n, sizeof(buf) - n, "C abs ");
+  n += numfmt_fixed(buf + n, sizeof(buf) - n, (int32_t)envcalc_absolute_humidity_x100(t, h), 2, 1, 0, ' ');
+  n += numfmt_str(buf + n, sizeof(buf) - n, "g/m3 HI ");
+  n += numfmt_fixed(buf + n, sizeof(buf) - n, envcalc_heat_index_x100(t, h), 2, 1, 0, ' ');
+  n += numfmt_str(buf + n, sizeof(buf) - n, "C");
+  if (hub_altitude_m >= 0) {
+    uint32_t p = envcalc_sea_level_pressure_x100((uint32_t)channel_values[CHANNEL_PRESSURE], t, hub_altitude_m);
+    n += numfmt_str(buf + n, sizeof(buf) - n, " SLP ");
+    n += numfmt_fixed(buf + n, sizeof(buf) - n, (int32_t)p, 2, 1, 0, ' ');
+    numfmt_str(buf + n, sizeof(buf) - n, "hPa");
+  }
+  puts(buf);
+}
+
+// 前回の表示から変化した測定値と, タスクの統計情報を表示する
+static uint32_t report_task(void* arg) {
+  char buf[80] = "";
+  unsigned n = 0;
+  uint32_t changed = channel_take_changed(SINK_REPORT);
+  bool bme280_changed =
+      bme280_valid && (changed & (1u << CHANNEL_TEMPERATURE | 1u << CHANNEL_HUMIDITY | 1u << CHANNEL_PRESSURE));
+  if (bme280_changed) {
+    n += numfmt_str(buf + n, sizeof(buf) - n, "T ");
+    n += numfmt_fixed(buf + n, sizeof(buf) - n, channel_values[CHANNEL_TEMPERATURE], 2, 1, 0, ' ');
+    n += numfmt_str(buf + n, sizeof(buf) - n, "C H ");
+    n += numfmt_fixed(buf + n, sizeof(buf) - n, channel_values[CHANNEL_HUMIDITY], 2, 1, 0, ' ');
+    n += numfmt_str(buf + n, sizeof(buf) - n, "% P ");
+    n += numfmt_fixed(buf + n, sizeof(buf) - n, channel_values[CHANNEL_PRESSURE], 2, 1, 0, ' ');
+    n += numfmt_str(buf + n, sizeof(buf) - n, "hPa ");
+  }
+  if (tsl2572_valid && (changed & 1u << CHANNEL_LUX)) {
+    n += numfmt_str(buf + n, sizeof(buf) - n, "L ");
+    n += numfmt_fixed(buf + n, sizeof(buf) - n, channel_values[CHANNEL_LUX], 1, 1, 0, ' ');
+    n += numfmt_str(buf + n, sizeof(buf) - n, "lux ");
+  }
+  if (scd41_valid && (changed & 1u << CHANNEL_CO2)) {
+    n += numfmt_str(buf + n, sizeof(buf) - n, "CO2 ");
+    n += numfmt_uint(buf + n, sizeof(buf) - n, channel_values[CHANNEL_CO2], 0, ' ');
+    n += numfmt_str(buf + n, sizeof(buf) - n, "ppm");
+  }
+  if (n) puts(buf);
+  if (bme280_changed) report_derived();
+  printf("IR %lu dropped samples %lu\n", (unsigned long)ir_count, (unsigned long)hub_samples.drops);
+#if HUB_USE_FLASHLOG
+  printf("log samples %lu blocks %lu erases %lu dropped %lu errors %lu\n", (unsigned long)flashlog.stats.samples,
+         (unsigned long)flashlog.stats.blocks, (unsigned long)flashlog.stats.erases,
+         (unsigned long)flashlog.stats.dropped, (unsigned long)flashlog.stats.errors);
+#endif
+#if HUB_USE_DEADBAND
+  uint32_t updates = 0;
+  uint32_t publishes = 0;
+  for (uint i = 0; i < CHANNELS; i++) {
+    updates += deadbands[i].updates;
+    publishes += deadbands[i].publishes;
+  }
+  printf("measured %lu published %lu\n", (unsigned long)updates, (unsigned long)publishes);
+#endif
+#if HUB_LOW_POWER
+  power_print();
+#endif
+
+  // 期限を過ぎたタスクがあれば, 実行時間の長いタスクに遅らされていないか確認する
+  // HUB_MULTICOREが1の場合はコア1のタスクの統計情報. 表示中に更新されることがあるので目安とする
+  for (uint i = 0; i < sched_task_count(); i++) {
+    sched_stats_t stats;
+    sched_get_stats(i, &stats);
+    printf("%-8s runs %lu miss %lu skip %lu late %lu[us] exec %lu[us]\n", stats.name, (unsigned long)stats.runs,
+           (unsigned long)stats.misses, (unsigned long)stats.skipped, (unsigned long)stats.max_late_us,
+           (unsigned long)stats.max_exec_us);
+  }
+  return 0;
+}
+
+#if HUB_MULTICORE
+// コア1. デバイスを初期化し, 通信のタスクを実行し続ける
+static void core1_main() {
+#if HUB_USE_FLASHLOG
+  flash_safe_execute_core_init();  // コア0がフラッシュに書き込む間, コア1を止められるようにする
+#endif
+  uint32_t d = hub_acquire_init();
+  multicore_fifo_push_blocking(d);  // 初期化の完了と接続を確認したデバイスをコア0へ通知
+  sched_run();
+}
+
+// コア0. サンプルが届くか, 表示の時刻になるまで__wfe()で待機する
+static void process_loop() {
+  absolute_time_t display_time = make_timeout_time_ms(1000);
+  absolute_time_t report_time = make_timeout_time_ms(HUB_REPORT_PERIOD_MS);
+#if HUB_USE_FLASHLOG
+  absolute_time_t log_time = make_timeout_time_ms(HUB_FLASHLOG_PERIOD_MS);
+#else
+  absolute_time_t log_time = at_the_end_of_time;
+#endif
+  while (1) {
+    process_task(NULL);
+    if (time_reached(display_time)) {
+      display_task(NULL);
+      display_time = delayed_by_ms(display_time, 1000);
+    }
+    if (time_reached(report_time)) {
+      report_task(NULL);
+      report_time = delayed_by_ms(report_time, HUB_REPORT_PERIOD_MS);
+    }
+#if HUB_USE_FLASHLOG
+    if (time_reached(log_time)) {
+      log_task(NULL);
+      log_time = delayed_by_ms(log_time, HUB_FLASHLOG_PERIOD_MS);
+    }
+#endif
+    // 確認後にサンプルが届いても, コア1の__sev()でイベントが残るので__wfe()はすぐに戻る
+    if (!ring_count(&hub_samples)) {
+      best_effort_wfe_or_timeout(absolute_time_min(absolute_time_min(display_time, report_time), log_time));
+    }
+  }
+}
+#endif
+
+#if !HUB_MULTICORE
+// 通信側の最大6タスクと処理側の最大4タスクを1つのスケジューラーに登録する
+static_assert(SCHED_MAX_TASKS >= 10, "SCHED_MAX_TASKS is too small for HUB_MULTICORE 0");
+#endif
+
+int main() {
+  stdio_init_all();
+
+#if HUB_MULTICORE
+  multicore_launch_core1(core1_main);
+  devices = multicore_fifo_pop_blocking();
+#else
+  devices = hub_acquire_init();
+#endif
+  bme280.calibration_data = hub_bme280.calibration_data;  // 通信側が読み出したキャリブレーションデータで計算する
+#if HUB_USE_DEADBAND
+  deadband_setup();
+#endif
+#if HUB_AGGREGATE_PERIOD_MS
+  aggregate_setup();
+#endif
+#if HUB_USE_RULES
+  rules_setup();
+#endif
+#if HUB_USE_FLASHLOG
+  flashlog_flash_t flash;
+  flashlog_pico_flash(&flash, HUB_FLASHLOG_SIZE);
+  flashlog_ready = flashlog_init(&flashlog, &flash, HUB_FLASHLOG_CHANNELS);
+#endif
+
+#if HUB_MULTICORE
+  process_loop();  // 処理は返らない
+#else
+  // 周期[ms], 期限[ms], 開始時刻のずれ[ms]
+#if HUB_LOW_POWER
+  // 待機から起きる回数を減らす. 通信側のタスクは1周期に1つしかサンプルを入れないので, キューはあふれない
+  hub_sched_add("process", process_task, NULL, 1000, 1000, 0);
+#else
+  hub_sched_add("process", process_task, NULL, 10, 10, 0);
+#endif
+  hub_sched_add("display", display_task, NULL, 1000, 100, 1000);
+  hub_sched_add("report", report_task, NULL, HUB_REPORT_PERIOD_MS, 1000, HUB_REPORT_PERIOD_MS);
+#if HUB_USE_FLASHLOG
+  hub_sched_add("log", log_task, NULL, HUB_FLASHLOG_PERIOD_MS, 100, HUB_FLASHLOG_PERIOD_MS);
+#endif
+  sched_run();  // タスクを実行し続ける. 処理は返らない
+#endif
+}
@@ -4,19 +4,37 @@
  * SPDX-License-Identifier: MIT
  */
 
+#define HAL_DRIVER INSTR_INFRARED  // 計測(common/instr.h)でのドライバーの番号
 #include "infrared.h"
 
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
 #include "infrared.pio.h"
 
 PIO send_pio;
 uint send_sm;
 uint send_offset;
 
+// 再生用DMAの制御ブロック. データ転送チャンネルのal3_transfer_count, al3_read_addr_trigに順に書き込む
+typedef struct {
+  uint32_t length;
+  const uint32_t* words;
+} infrared_dma_block_t;
+
+static infrared_dma_block_t playback_blocks[INFRARED_PLAYBACK_MAX_BLOCKS + 1] __attribute__((aligned(8)));
+static const uint32_t* volatile playback_loop_words;  // 繰り返し再生中のワード列. NULLにすると停止
+static int playback_data_chan = -1;                    // ワード列をPIOへ転送するチャンネル
+static int playback_ctrl_chan = -1;                    // データ転送チャンネルを再設定するチャンネル
+
 PIO receive_pio;
 uint receive_sm;
 uint receive_offset;
 
+static infrared_receive_filter_t receive_filter;
+static uint32_t receive_min_pulse = INFRARED_RECEIVE_MIN_PULSE;
+static absolute_time_t receive_deadline;
+static bool receive_active = false;
+
 // 送信用PIOの割り当て, 初期化
 bool infrared_send_init() {
   if (!pio_claim_free_sm_and_add_program_for_gpio_range(
@@ -33,7 +51,7 @@ void infrared_send_program_init(PIO pio, uint sm, uint offset, uint pin) {
   pio_sm_config c = infrared_send_program_get_default_config(offset);
   sm_config_set_sideset_pins(&c, pin);
   sm_config_set_out_shift(&c, false, true, 32);
-  sm_config_set_clkdiv(&c, ((float)clock_get_hz(clk_sys)) / 1000000);  // 1us/命令
+  sm_config_set_clkdiv(&c, ((float)clock_get_hz(clk_sys)) / INFRARED_SEND_SM_HZ);  // 1us/命令
   sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
   pio_sm_init(pio, sm, offset, &c);
   pio_sm_set_consecutive_pindirs(pio, sm, pin, 1, true);
@@ -42,6 +60,13 @@ void infrared_send_program_init(PIO pio, uint sm, uint offset, uint pin) {
 
 // 送信用PIOの開放
 void infrared_send_deinit() {
+  if (playback_data_chan >= 0) {
+    infrared_playback_stop();
+    dma_channel_unclaim(playback_data_chan);
+    dma_channel_unclaim(playback_ctrl_chan);
+    playback_data_chan = -1;
+    playback_ctrl_chan = -1;
+  }
   pio_remove_program_and_unclaim_sm(&infrared_send_program, send_pio, send_sm, send_offset);
 }
 
@@ -54,29 +79,20 @@ void infrared_send_deinit() {
 //
 // Returns: 送信成功でtrue. PIO初期化失敗でfalse.
 void infrared_send(uint32_t* data, uint length, bool wait_complete) {
-  uint i = 0;  // 送信中のインデックス
+  uint i = 0;        // 送信中のインデックス
+  uint32_t mod = 0;  // ON時間の余り. 次のOFF時間に加算する
   while (1) {
     // 偶数要素
     if (i >= length) break;
-
-    uint burst_loop = data[i] / 26;
-    uint mod = data[i] % 26;  // 余りは次のOFF時間に加算する
-    if (burst_loop == 0) {
-      burst_loop++;  // 最低1周期はON送信
-      mod = 0;
-    }
-    pio_sm_put_blocking(send_pio, send_sm, burst_loop - 1);  // PIO仕様により繰り返し回数-1を入力
+    hal_pio_sm_put_blocking(send_pio, send_sm, infrared_encode_send_word(data[i], true, &mod));
     i++;
 
     // 奇数要素
     if (i >= length) {
-      pio_sm_put_blocking(send_pio, send_sm, 0);  // 合計が偶数になるように調整して送信終了
+      hal_pio_sm_put_blocking(send_pio, send_sm, 0);  // 合計が偶数になるように調整して送信終了
       break;
     }
-    uint space = data[i] + mod;
-    if (space == 0) space++;                            // 最低1[us]はOFF時間が必要
-    pio_sm_put_blocking(send_pio, send_sm, space - 1);  // PIO仕様によりOFF時間[us]-1を入力
-
+    hal_pio_sm_put_blocking(send_pio, send_sm, infrared_encode_send_word(data[i], false, &mod));
     i++;
   }
 
@@ -86,6 +102,124 @@ void infrared_send(uint32_t* data, uint length, bool wait_complete) {
   }
 }
 
+// 再生用のDMAチャンネルを確保し, データ転送チャンネルを設定する
+//
+// Returns: 成功でtrue. DMAチャンネルが不足していればfalse.
+static bool infrared_playback_claim() {
+  if (playback_data_chan < 0) playback_data_chan = dma_claim_unused_channel(false);
+  if (playback_ctrl_chan < 0) playback_ctrl_chan = dma_claim_unused_channel(false);
+  if (playback_data_chan < 0 || playback_ctrl_chan < 0) {
+    if (playback_data_chan >= 0) dma_channel_unclaim(playback_data_chan);
+    if (playback_ctrl_chan >= 0) dma_channel_unclaim(playback_ctrl_chan);
+    playback_data_chan = -1;
+    playback_ctrl_chan = -1;
+    return false;
+  }
+
+  // ワード列を送信用PIOのTX FIFOへ転送し, 完了したら制御チャンネルを起動する
+  dma_channel_config c = dma_channel_get_default_config(playback_data_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(send_pio, send_sm, true));
+  channel_config_set_chain_to(&c, playback_ctrl_chan);
+  dma_channel_configure(playback_data_chan, &c, &send_pio->txf[send_sm], NULL, 0, false);
+  return true;
+}
+
+// 再生シーケンスを開始する. 処理はすぐに返り, 再生はDMAとPIOのみで行われCPUは使用しない.
+// フレーム間の停止時間はinfrared_encode_send_wordsのgapでワード列に含めておく.
+// 停止時間も送信用PIOが1us単位で数えるため, CPUの負荷に関係なく一定となる.
+//
+// Args:
+//   entries: 再生するエントリーの配列. 再生終了までwordsの内容を保持すること.
+//   count: エントリー数
+//
+// Returns: 開始できればtrue. 再生中, 繰り返し回数の合計がINFRARED_PLAYBACK_MAX_BLOCKSを超える,
+//          DMAチャンネル不足の場合はfalse.
+bool infrared_playback_start(const infrared_playback_entry_t* entries, uint count) {
+  if (infrared_playback_busy()) return false;
+
+  uint n = 0;
+  for (uint i = 0; i < count; i++) {
+    if (entries[i].length == 0) continue;
+    for (uint r = 0; r < entries[i].repeat; r++) {
+      if (n >= INFRARED_PLAYBACK_MAX_BLOCKS) return false;
+      playback_blocks[n].length = entries[i].length;
+      playback_blocks[n].words = entries[i].words;
+      n++;
+    }
+  }
+  playback_blocks[n].length = 0;
+  playback_blocks[n].words = NULL;  // read_addr_trigにNULLを書くとDMAが停止する
+  if (n == 0) return true;
+  if (!infrared_playback_claim()) return false;
+
+  // 制御ブロックを1つ(2ワード)ずつデータ転送チャンネルに書き込み, 転送を開始させる
+  dma_channel_config c = dma_channel_get_default_config(playback_ctrl_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_ring(&c, true, 3);  // 書き込み先はal3_transfer_countから8バイトで折り返す
+  dma_channel_configure(playback_ctrl_chan, &c, &dma_hw->ch[playback_data_chan].al3_transfer_count,
+                        playback_blocks, 2, true);
+  return true;
+}
+
+// ワード列をinfrared_playback_releaseを呼ぶまで繰り返し再生する. ボタンを押している間のリピート送信用.
+// 繰り返し周期はinfrared_set_send_words_periodで指定する.
+//
+// Args:
+//   words: infrared_encode_send_wordsで変換したワード列. 再生終了まで保持すること.
+//   length: ワード数
+//
+// Returns: 開始できればtrue. 再生中かDMAチャンネル不足の場合はfalse.
+bool infrared_playback_loop(const uint32_t* words, uint length) {
+  if (infrared_playback_busy() || length == 0) return false;
+  if (!infrared_playback_claim()) return false;
+
+  // データ転送チャンネルの転送数は再起動ごとに最後に書き込んだ値に戻るため, 読み出しアドレスのみ書き込む
+  playback_loop_words = words;
+  dma_channel_set_trans_count(playback_data_chan, length, false);
+
+  dma_channel_config c = dma_channel_get_default_config(playback_ctrl_chan);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, false);
+  dma_channel_configure(playback_ctrl_chan, &c, &dma_hw->ch[playback_data_chan].al3_read_addr_trig,
+                        &playback_loop_words, 1, true);
+  return true;
+}
+
+// infrared_playback_loopの繰り返しを, 送信中のフレームが終わったところで停止する
+void infrared_playback_release() {
+  playback_loop_words = NULL;  // 次の再設定でread_addr_trigにNULLが書き込まれDMAが停止する
+}
+
+// 再生中か確認する
+//
+// Returns: DMA転送中, もしくは送信用PIOがワードを送信中ならtrue
+bool infrared_playback_busy() {
+  if (playback_data_chan < 0) return false;
+  if (dma_channel_is_busy(playback_ctrl_chan) || dma_channel_is_busy(playback_data_chan)) return true;
+  if (!pio_sm_is_tx_fifo_empty(send_pio, send_sm)) return true;
+  return pio_sm_get_pc(send_pio, send_sm) != send_offset;  // 先頭のoutで次のワード待ちなら送信完了
+}
+
+// 再生を直ちに中止し, 送信ピンをOFFにする
+void infrared_playback_stop() {
+  if (playback_data_chan < 0) return;
+  playback_loop_words = NULL;
+  uint32_t mask = (1u << playback_data_chan) | (1u << playback_ctrl_chan);
+  dma_hw->abort = mask;
+  while (dma_hw->abort & mask) tight_loop_contents();
+
+  // 送信途中のワードを破棄し, サイドセット0で先頭のoutへ戻す
+  pio_sm_clear_fifos(send_pio, send_sm);
+  pio_sm_restart(send_pio, send_sm);
+  pio_sm_exec(send_pio, send_sm, pio_encode_jmp(send_offset) | pio_encode_sideset(1, 0));
+}
+
 // 受信用PIOの割り当て
 bool infrared_receive_init() {
   if (!pio_claim_free_sm_and_add_program_for_gpio_range(
@@ -105,7 +239,7 @@ void infrared_receive_program_init(PIO pio, uint sm, uint offset, uint pin) {
   sm_config_set_jmp_pin(&c, pin);
   sm_config_set_out_shift(&c, false, true, 32);
   sm_config_set_in_shift(&c, false, true, 32);
-  sm_config_set_clkdiv(&c, ((float)clock_get_hz(clk_sys)) / 10 / 1000000);  // 0.1us/命令
+  sm_config_set_clkdiv(&c, ((float)clock_get_hz(clk_sys)) / INFRARED_RECEIVE_SM_HZ);  // 0.1us/命令
   pio_sm_init(pio, sm, offset, &c);
   pio_sm_set_consecutive_pindirs(pio, sm, pin, 1, false);
   pio_sm_set_enabled(pio, sm, true);
@@ -116,6 +250,16 @@ void infrared_receive_deinit() {
   pio_remove_program_and_unclaim_sm(&infrared_receive_program, receive_pio, receive_sm, receive_offset);
 }
 
+// 受信用PIOを初期化して受信を開始する
+static void infrared_receive_arm(uint32_t* data, uint length) {
+  // 1回分のデータを受信するとPIOプログラムが停止する仕様のため, 再度初期化する
+  infrared_receive_program_init(receive_pio, receive_sm, receive_offset, INFRARED_RECEIVE_PIN);
+  pio_sm_put(receive_pio, receive_sm, INFRARED_RECEIVE_THRESHOLD);  // しきい値をPIOプログラムへ送信. FIFOは空
+
+  infrared_receive_filter_init(&receive_filter, data, length, receive_min_pulse);
+  receive_active = true;
+}
+
 // 赤外線受信を開始し, 1回分のデータを受信すると制御を返す
 //
 // Args:
@@ -124,16 +268,63 @@ void infrared_receive_deinit() {
 //
 // Returns: 受信した要素数.
 int infrared_receive_blocking(uint32_t* data, uint length) {
-  // 1回分のデータを受信するとPIOプログラムが停止する仕様のため, 再度初期化する
-  infrared_receive_program_init(receive_pio, receive_sm, receive_offset, INFRARED_RECEIVE_PIN);
-
-  pio_sm_put_blocking(receive_pio, receive_sm, INFRARED_RECEIVE_THRESHOLD);  // しきい値をPIOプログラムへ送信
-  uint i = 0;
+  infrared_receive_start(data, length, 0);
   while (1) {
-    uint32_t rec = pio_sm_get_blocking(receive_pio, receive_sm);
-    if (rec == 0) break;
-    data[i++] = rec;
-    if (i >= length) break;
+    int ret = infrared_receive_poll();
+    if (ret != INFRARED_RECEIVE_PENDING) return ret;
+  }
+}
+
+// グリッチ除去の最小パルス幅を変更する. 次回の受信開始から有効.
+//
+// Args:
+//   min_pulse: これより短いON/OFF[us]は前後の要素と結合する. 0で無効.
+void infrared_receive_set_min_pulse(uint32_t min_pulse) {
+  receive_min_pulse = min_pulse;
+}
+
+// 赤外線受信を開始し, すぐに処理を返す. 受信結果はinfrared_receive_pollで確認する.
+//
+// Args:
+//   data: 受信データ格納バッファー. 形式はinfrared_receive_blockingと同じ. 受信終了まで保持すること.
+//   length: バッファーの最大要素数.
+//   timeout_ms: 受信を打ち切るまでの時間[ms]. 受信途中でも打ち切る. 0なら期限なし.
+void infrared_receive_start(uint32_t* data, uint length, uint32_t timeout_ms) {
+  receive_deadline = timeout_ms ? make_timeout_time_ms(timeout_ms) : at_the_end_of_time;
+  infrared_receive_arm(data, length);
+}
+
+// 受信用PIOのFIFOに届いたデータを読み出し, 受信状態を返す. ブロックしない.
+//
+// Returns: 受信完了なら受信した要素数(0以上). 受信中ならINFRARED_RECEIVE_PENDING.
+//          期限切れならINFRARED_RECEIVE_TIMEOUT. 受信を開始していなければINFRARED_RECEIVE_IDLE.
+int infrared_receive_poll() {
+  if (!receive_active) return INFRARED_RECEIVE_IDLE;
+
+  while (!pio_sm_is_rx_fifo_empty(receive_pio, receive_sm)) {
+    uint32_t rec = pio_sm_get(receive_pio, receive_sm);
+    bool full = rec != 0 && infrared_receive_filter_push(&receive_filter, rec);
+    if (rec == 0 || full) {
+      pio_sm_set_enabled(receive_pio, receive_sm, false);
+      receive_active = false;
+      uint count = infrared_receive_filter_finish(&receive_filter);
+      if (count == 0 && rec == 0) {
+        infrared_receive_arm(receive_filter.data, receive_filter.length);  // グリッチのみだった場合は受信を継続
+        break;
+      }
+      return count;
+    }
+  }
+
+  if (time_reached(receive_deadline)) {
+    infrared_receive_cancel();
+    return INFRARED_RECEIVE_TIMEOUT;
   }
-  return i;
-}
\ No newline at end of file
+  return INFRARED_RECEIVE_PENDING;
+}
+
+// 受信を中止する
+void infrared_receive_cancel() {
+  pio_sm_set_enabled(receive_pio, receive_sm, false);
+  receive_active = false;
+}
@@ -8,7 +8,13 @@
 #define INFRARED_H
 
 #include "pico/stdlib.h"
+#include "hal.h"
 #include "hardware/pio.h"
+#include "infrared_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // -----------------
 // Configurations
@@ -19,18 +25,49 @@
 // 受信時のしきい値[us]. この時間以上ONまたはOFFが続く場合は受信終了
 #define INFRARED_RECEIVE_THRESHOLD 100000
 
-#define infrared_delay(x) sleep_ms(x)  // xミリ秒待機
+// 受信時のグリッチ除去の最小パルス幅[us]. これより短いON/OFFは前後の要素と結合する. 0で無効
+#define INFRARED_RECEIVE_MIN_PULSE 10
+
+#define INFRARED_PLAYBACK_MAX_BLOCKS 64  // 再生シーケンスの最大フレーム数(繰り返し回数の合計)
+
+#define infrared_delay(x) hal_sleep_ms(x)  // xミリ秒待機
 
 // -----------------
 
+// infrared_receive_pollの戻り値
+#define INFRARED_RECEIVE_PENDING (-1)  // 受信中
+#define INFRARED_RECEIVE_TIMEOUT (-2)  // 期限までに受信が完了しなかった
+#define INFRARED_RECEIVE_IDLE (-3)     // 受信を開始していない
+
 bool infrared_send_init();
 void infrared_send_program_init(PIO pio, uint sm, uint offset, uint pin);
 void infrared_send_deinit();
 void infrared_send(uint32_t* data, uint length, bool wait_complete);
 
+// 再生シーケンスの1エントリー
+typedef struct {
+  const uint32_t* words;  // infrared_encode_send_wordsで変換したワード列. 再生終了まで保持すること
+  uint length;            // ワード数
+  uint repeat;            // 送信回数
+} infrared_playback_entry_t;
+
+bool infrared_playback_start(const infrared_playback_entry_t* entries, uint count);
+bool infrared_playback_loop(const uint32_t* words, uint length);
+void infrared_playback_release();
+bool infrared_playback_busy();
+void infrared_playback_stop();
+
 bool infrared_receive_init();
 void infrared_receive_program_init(PIO pio, uint sm, uint offset, uint pin);
 void infrared_receive_deinit();
 int infrared_receive_blocking(uint32_t* data, uint length);
+void infrared_receive_set_min_pulse(uint32_t min_pulse);
+void infrared_receive_start(uint32_t* data, uint length, uint32_t timeout_ms);
+int infrared_receive_poll();
+void infrared_receive_cancel();
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
\ No newline at end of file
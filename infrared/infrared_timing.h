@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef INFRARED_TIMING_H
+#define INFRARED_TIMING_H
+
+// infrared.pioのタイミングと送信データの変換処理.
+// Pico SDKに依存しないため, ホスト側のPIOシミュレーター(host/ir_pio_sim)からも利用する.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define INFRARED_SEND_SM_HZ 1000000      // 送信用PIOの命令実行周波数[Hz]. 1us/命令
+#define INFRARED_RECEIVE_SM_HZ 10000000  // 受信用PIOの命令実行周波数[Hz]. 0.1us/命令
+#define INFRARED_SEND_BURST_PERIOD 26    // 38KHzバースト1周期の長さ[us]. 8us ON / 18us OFF
+
+// 送信データ1要素分を, infrared_sendプログラムへ渡すワードに変換する
+// ON時間は26us周期の繰り返し回数に丸め, 余りは次のOFF時間に加算する
+//
+// Args:
+//   value: 送信データの要素[us]
+//   on: 偶数要素(ON)ならtrue. 奇数要素(OFF)ならfalse.
+//   mod: ON要素の余り[us]の受け渡し用. ON要素で更新し, OFF要素で加算する.
+//
+// Returns: PIOのTX FIFOへ渡すワード
+static inline uint32_t infrared_encode_send_word(uint32_t value, bool on, uint32_t* mod) {
+  if (on) {
+    uint32_t burst_loop = value / INFRARED_SEND_BURST_PERIOD;
+    *mod = value % INFRARED_SEND_BURST_PERIOD;  // 余りは次のOFF時間に加算する
+    if (burst_loop == 0) {
+      burst_loop++;  // 最低1周期はON送信
+      *mod = 0;
+    }
+    return burst_loop - 1;  // PIO仕様により繰り返し回数-1を入力
+  }
+
+  uint32_t space = value + *mod;
+  if (space == 0) space++;  // 最低1[us]はOFF時間が必要
+  return space - 1;         // PIO仕様によりOFF時間[us]-1を入力
+}
+
+// 送信データ1フレーム分を, infrared_sendと同じ手順でPIOへ渡すワード列に変換する. DMAでの送信用.
+// フレームの最後のOFF時間にgap[us]を加算する. 送信時間はgapを指定しない場合よりちょうどgap[us]長くなる.
+//
+// Args:
+//   data: 送信データ. 偶数要素はON時間[us], 奇数要素はOFF時間[us].
+//   length: 送信データの要素数
+//   gap: フレーム送信後に追加する停止時間[us]
+//   words: 変換後のワード格納バッファー. length+1要素以上必要.
+//
+// Returns: ワード数. 常に偶数. lengthが0の場合は0で, wordsに書き込まない.
+static inline uint32_t infrared_encode_send_words(const uint32_t* data, uint32_t length, uint32_t gap,
+                                                  uint32_t* words) {
+  if (length == 0) return 0;
+  uint32_t mod = 0;
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    words[n++] = infrared_encode_send_word(data[i], (i % 2) == 0, &mod);
+  }
+  if (n % 2) words[n++] = 0;  // 合計が偶数になるように調整
+  words[n - 1] += gap;
+  return n;
+}
+
+// ワード列をinfrared_sendプログラムで送信するのにかかる時間[us]
+// ON/OFFのペアごとに, out命令2回分の2usが加わる
+//
+// Args:
+//   words: infrared_encode_send_wordsで変換したワード列
+//   n: ワード数
+//
+// Returns: 送信時間[us]
+static inline uint64_t infrared_send_words_duration(const uint32_t* words, uint32_t n) {
+  uint64_t us = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    if ((i % 2) == 0) {
+      us += 1 + (uint64_t)(words[i] + 1) * INFRARED_SEND_BURST_PERIOD;  // out + バースト
+    } else {
+      us += 1 + (uint64_t)words[i] + 1;  // out + 停止
+    }
+  }
+  return us;
+}
+
+// 送信開始から次の送信開始までがperiod[us]になるように, ワード列の最後のOFF時間を延長する.
+// 一定周期のリピート送信用.
+//
+// Args:
+//   words: infrared_encode_send_wordsで変換したワード列
+//   n: ワード数
+//   period: 繰り返し周期[us]
+//
+// Returns: 成功でtrue. フレームの送信時間がperiodより長い場合はfalse.
+static inline bool infrared_set_send_words_period(uint32_t* words, uint32_t n, uint32_t period) {
+  uint64_t duration = infrared_send_words_duration(words, n);
+  if (n == 0 || duration > period) return false;
+  words[n - 1] += (uint32_t)(period - duration);
+  return true;
+}
+
+// 受信データのグリッチ除去フィルターの状態
+// 外乱光などによるmin_pulse[us]未満の短いパルスを, 前後の要素と結合して取り除く
+typedef struct {
+  uint32_t* data;      // 受信データ格納バッファー
+  uint32_t length;     // バッファーの最大要素数
+  uint32_t count;      // 格納済みの要素数
+  uint32_t min_pulse;  // これ未満の長さ[us]の要素をグリッチとみなす. 0で無効
+  bool merge_next;     // 次の要素を直前の要素に結合する
+  bool skip_next;      // 次の要素を破棄する(先頭のグリッチの直後の停止時間)
+} infrared_receive_filter_t;
+
+// グリッチ除去フィルターを初期化する
+static inline void infrared_receive_filter_init(infrared_receive_filter_t* f, uint32_t* data, uint32_t length,
+                                                uint32_t min_pulse) {
+  f->data = data;
+  f->length = length;
+  f->count = 0;
+  f->min_pulse = min_pulse;
+  f->merge_next = false;
+  f->skip_next = false;
+}
+
+// 受信用PIOから読み出した要素をフィルターに入力する.
+// グリッチは直前の要素(反対の種類)に加算し, 続く要素(直前と同じ種類)も直前の要素に結合するため,
+// ON/OFFの並びは崩れない.
+//
+// Args:
+//   f: フィルター
+//   value: 受信用PIOから読み出した0以外の値[us]
+//
+// Returns: バッファーが満杯になったらtrue
+static inline bool infrared_receive_filter_push(infrared_receive_filter_t* f, uint32_t value) {
+  if (f->skip_next) {
+    f->skip_next = false;
+  } else if (f->merge_next) {
+    f->data[f->count - 1] += value;
+    f->merge_next = false;
+  } else if (value < f->min_pulse) {
+    if (f->count == 0) {
+      f->skip_next = true;  // 先頭のグリッチはその後の停止時間ごと破棄する
+    } else {
+      f->data[f->count - 1] += value;
+      f->merge_next = true;
+    }
+  } else {
+    f->data[f->count++] = value;
+  }
+  return f->count >= f->length;
+}
+
+// 受信終了時の処理を行い, 要素数を返す
+//
+// Returns: 受信した要素数
+static inline uint32_t infrared_receive_filter_finish(infrared_receive_filter_t* f) {
+  // 最後のON要素の後にグリッチがあった場合, 直前の停止時間はフレームの一部ではないので取り除く
+  if (f->merge_next && f->count > 0) f->count--;
+  f->merge_next = false;
+  return f->count;
+}
+
+#endif
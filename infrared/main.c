@@ -8,17 +8,36 @@
 
 #include "infrared.h"
 #include "pico/stdlib.h"
+#include "telemetry.h"
 
 #define BUFFER_LENGTH 2000
 
+// 1なら受信データをバイナリのレコード(common/telemetry.h)で送信する. PC側はhost/telemetry_dumpで表示する.
+// 0ならテキストで表示する
+#define OUTPUT_TELEMETRY 1
+
 uint32_t data[BUFFER_LENGTH];
 
+#if OUTPUT_TELEMETRY
+static telemetry_t telemetry;
+#endif
+
 int main() {
   stdio_init_all();
   infrared_send_init();     // 赤外線送信機能を初期化. PIOを使用
   infrared_receive_init();  // 赤外線受信機能を初期化. PIOを使用
+#if OUTPUT_TELEMETRY
+  telemetry_init(&telemetry, telemetry_usb_write, NULL);  // printfを通さずUSBシリアルへ送信する
+#endif
 
   while (1) {
+#if OUTPUT_TELEMETRY
+    int rec_length = infrared_receive_blocking(data, BUFFER_LENGTH);  // 受信処理. ブロッキング.
+    // 受信バッファーから直接符号化して送信する. 時刻は受信完了時
+    telemetry_begin(&telemetry, TELEMETRY_IR, 0, time_us_64());
+    telemetry_put_array(&telemetry, data, rec_length);
+    telemetry_end(&telemetry);
+#else
     printf("Waiting for IR receive...\n");
     int rec_length = infrared_receive_blocking(data, BUFFER_LENGTH);  // 受信処理. ブロッキング.
     printf("Received data length: %d\n", rec_length);                 // 受信データの要素数
@@ -26,9 +45,12 @@ int main() {
       printf("%u, ", data[i]);  // 受信データを表示
     }
     printf("\n");
+#endif
     sleep_ms(3000);  // 3秒待機
 
+#if !OUTPUT_TELEMETRY
     printf("Sending IR...\n");
+#endif
     infrared_send(data, rec_length, true);  // 受信したデータと同じものを送信
 
     sleep_ms(1000);
@@ -4,25 +4,44 @@
  * SPDX-License-Identifier: MIT
  */
 
+#define HAL_DRIVER INSTR_LCDAQM  // 計測(common/instr.h)でのドライバーの番号
 #include "lcdaqm.h"
 
-#include "hardware/i2c.h"
+#include <string.h>
+
+#include "numfmt.h"
 
 uint8_t cursor_line = 0;  // 現在の行. 1行目なら0, 2行目なら1.
 uint8_t cursor_char = 0;  // 現在の入力位置. 左端が0.
 
+static char fb[LCDAQM_LINES][LCDAQM_COLS];       // フレームバッファー
+static char fb_sent[LCDAQM_LINES][LCDAQM_COLS];  // 最後にLCDへ送信した表示内容
+static bool fb_sent_valid = false;               // fb_sentがLCDの表示内容と一致しているか
+
+// 非同期コマンドキューの1エントリー. 1回のI2C転送と, その後LCDの処理完了を待つ時間
+typedef struct {
+  uint8_t bytes[3 + LCDAQM_COLS];
+  uint8_t length;
+  uint32_t wait_us;
+} lcdaqm_queue_entry_t;
+
+static lcdaqm_queue_entry_t queue[LCDAQM_QUEUE_LENGTH];
+static uint queue_head = 0;          // 次に送信するエントリー
+static uint queue_count = 0;         // キュー内のエントリー数
+static absolute_time_t queue_ready;  // この時刻以降に次のエントリーを送信できる
+
+// CGRAMの各スロットに登録されている文字. 5x8ドット, 1バイト1行で下位5bitを使用
+static uint8_t glyph_pattern[LCDAQM_GLYPH_SLOTS][8];
+static uint32_t glyph_used[LCDAQM_GLYPH_SLOTS];  // 最後に使用した順番. 0なら未登録
+static uint32_t glyph_clock = 0;                 // 使用順番のカウンター
+static bool glyph_queue = false;                 // trueならCGRAMへの書き込みをキューに追加する
+uint32_t lcdaqm_glyph_hits = 0;
+uint32_t lcdaqm_glyph_misses = 0;
+
 // I2Cインスタンスとピンを初期化
 // すでに初期化している場合は不要
 void lcdaqm_init_i2c() {
-  i2c_init(LCDAQM_I2C_INST, 100000);
-
-  gpio_init(LCDAQM_I2C_SDA_PIN);
-  gpio_pull_up(LCDAQM_I2C_SDA_PIN);
-  gpio_set_function(LCDAQM_I2C_SDA_PIN, GPIO_FUNC_I2C);
-
-  gpio_init(LCDAQM_I2C_SCL_PIN);
-  gpio_pull_up(LCDAQM_I2C_SCL_PIN);
-  gpio_set_function(LCDAQM_I2C_SCL_PIN, GPIO_FUNC_I2C);
+  hal_i2c_init_pins(LCDAQM_I2C_INST, 100000, LCDAQM_I2C_SDA_PIN, LCDAQM_I2C_SCL_PIN);
 }
 
 // LCDにI2Cで書き込み
@@ -35,7 +54,7 @@ void lcdaqm_init_i2c() {
 // Returns: i2c_write_blockingの戻り値.
 int lcdaqm_write_register(uint8_t reg_addr, uint8_t data) {
   uint8_t buf[] = {reg_addr, data};
-  return i2c_write_blocking(LCDAQM_I2C_INST, LCDAQM_I2C_ADDRESS, buf, sizeof(buf), false);
+  return hal_i2c_write_blocking(LCDAQM_I2C_INST, LCDAQM_I2C_ADDRESS, buf, sizeof(buf), false);
 }
 
 // LCDの初期化
@@ -50,11 +69,14 @@ void lcdaqm_init() {
   lcdaqm_write_register(0, 0x38);
   lcdaqm_write_register(0, 0x0C);
   lcdaqm_clear();
+  lcdaqm_fb_clear();
+  lcdaqm_glyph_reset();
 }
 
 // LCDに文字列を書き込み
 // 行末に達した場合は自動的に改行する
 void lcdaqm_print(const char* str) {
+  fb_sent_valid = false;  // フレームバッファーを経由しないため, 次回のflushは全体を送信する
   for (int i = 0; i < 16; i++) {
     if (str[i] == 0) return;  // NULL文字
 
@@ -77,6 +99,9 @@ void lcdaqm_clear() {
   cursor_line = 0;
   lcdaqm_write_register(0, 1);
   lcdaqm_delay(2);
+
+  memset(fb_sent, ' ', sizeof(fb_sent));  // クリア後は全て空白
+  fb_sent_valid = true;
 }
 
 // カーソルを指定行の一番左に戻す
@@ -97,3 +122,367 @@ void lcdaqm_goto_line(uint line) {
   }
   lcdaqm_delay(2);
 }
+
+// フレームバッファーを空白で埋める. LCDへの送信はlcdaqm_fb_flushで行う.
+void lcdaqm_fb_clear() {
+  memset(fb, ' ', sizeof(fb));
+}
+
+// フレームバッファーに1文字書き込む
+//
+// Args:
+//   line: 1行目なら0, 2行目なら1
+//   col: 左端が0
+//   c: 文字
+void lcdaqm_fb_putc(uint line, uint col, char c) {
+  if (line >= LCDAQM_LINES || col >= LCDAQM_COLS) return;
+  fb[line][col] = c;
+}
+
+// フレームバッファーに文字列を書き込む. 行末を超えた部分は書き込まない.
+//
+// Args:
+//   line: 1行目なら0, 2行目なら1
+//   col: 書き込み開始位置. 左端が0
+//   str: 文字列
+void lcdaqm_fb_print(uint line, uint col, const char* str) {
+  if (line >= LCDAQM_LINES) return;
+  for (; col < LCDAQM_COLS && *str; col++, str++) fb[line][col] = *str;
+}
+
+// フレームバッファーに固定小数の数値を右詰めで書き込む. printfを使わずに変換する.
+// 例: value=2345, scale=2, frac_digits=1, width=5で" 23.5"
+//
+// Args:
+//   line: 1行目なら0, 2行目なら1
+//   col: 書き込み開始位置. 左端が0
+//   value: 10^scale倍した整数値
+//   scale: valueの小数点以下の桁数
+//   frac_digits: 表示する小数点以下の桁数. scale以下
+//   width: 表示幅. 数値が収まらない場合は'*'で埋める
+void lcdaqm_fb_print_fixed(uint line, uint col, int32_t value, uint scale, uint frac_digits, uint width) {
+  char buf[LCDAQM_COLS + 1];
+  if (width > LCDAQM_COLS) width = LCDAQM_COLS;
+  if (numfmt_fixed(buf, width + 1, value, scale, frac_digits, width, ' ') == 0) {
+    memset(buf, '*', width);
+    buf[width] = '\0';
+  }
+  lcdaqm_fb_print(line, col, buf);
+}
+
+// LCDの表示内容が不明になったものとして, 次回のlcdaqm_fb_flushで全体を送信させる
+void lcdaqm_fb_invalidate() {
+  fb_sent_valid = false;
+}
+
+// フレームバッファー内の変化した文字の連続
+typedef struct {
+  uint8_t line;
+  uint8_t col;
+  uint8_t n;
+} lcdaqm_run_t;
+
+#define LCDAQM_MAX_RUNS (LCDAQM_LINES * (LCDAQM_COLS + 1) / 2)
+
+// 指定位置から連続した文字を1回のI2C転送で書き込むためのデータを作る.
+// コントロールバイトのCo=1でDDRAMアドレス設定コマンドを送り, 続くCo=0, RS=1以降を全てデータとして送る.
+//
+// Returns: データのバイト数
+static uint lcdaqm_build_run(uint8_t* buf, const lcdaqm_run_t* run) {
+  buf[0] = 0x80;                                          // Co=1, RS=0: 次の1バイトはコマンド
+  buf[1] = 0x80 | (run->line ? 0x40 : 0x00) | run->col;  // Set DDRAM address
+  buf[2] = 0x40;                                          // Co=0, RS=1: 以降は全てデータ
+  memcpy(buf + 3, &fb[run->line][run->col], run->n);
+  return run->n + 3;
+}
+
+// フレームバッファーのうち, 前回送信時から変化した文字の連続を探す.
+// 間の変化していない文字が少なければ, 転送を分けずにまとめる.
+//
+// Returns: 見つかった数
+static uint lcdaqm_fb_find_runs(lcdaqm_run_t* runs) {
+  // 変化していない文字がこの数以下なら, 転送を分けずに再送する. 分けると3バイト+アドレスが余分にかかる
+  const uint merge_gap = 3;
+  uint count = 0;
+
+  for (uint line = 0; line < LCDAQM_LINES; line++) {
+    uint col = 0;
+    while (col < LCDAQM_COLS) {
+      if (fb_sent_valid && fb[line][col] == fb_sent[line][col]) {
+        col++;
+        continue;
+      }
+
+      // 変化した文字の連続の終わりを探す
+      uint end = col + 1;  // 最後に変化した文字の次
+      for (uint i = end; i < LCDAQM_COLS; i++) {
+        if (!fb_sent_valid || fb[line][i] != fb_sent[line][i]) {
+          if (i - end > merge_gap) break;
+          end = i + 1;
+        }
+      }
+
+      runs[count].line = line;
+      runs[count].col = col;
+      runs[count].n = end - col;
+      count++;
+      col = end;
+    }
+  }
+  return count;
+}
+
+// フレームバッファーのうち, 前回送信時から変化した部分のみLCDへ送信する.
+// 変化した文字の連続ごとに1回のI2C転送となる.
+// lcdaqm_clear, lcdaqm_goto_lineと異なり待機時間は不要.
+//
+// Returns: 送信したバイト数. 変化が無ければ0.
+int lcdaqm_fb_flush() {
+  lcdaqm_run_t runs[LCDAQM_MAX_RUNS];
+  uint count = lcdaqm_fb_find_runs(runs);
+  int bytes = 0;
+
+  for (uint i = 0; i < count; i++) {
+    uint8_t buf[3 + LCDAQM_COLS];
+    uint n = lcdaqm_build_run(buf, &runs[i]);
+    hal_i2c_write_blocking(LCDAQM_I2C_INST, LCDAQM_I2C_ADDRESS, buf, n, false);
+    memcpy(&fb_sent[runs[i].line][runs[i].col], &fb[runs[i].line][runs[i].col], runs[i].n);
+    bytes += n;
+  }
+  fb_sent_valid = true;
+  return bytes;
+}
+
+// I2C転送1回分をキューに追加する
+//
+// Returns: 追加したエントリー. キューが満杯ならNULL.
+static lcdaqm_queue_entry_t* lcdaqm_queue_push(uint32_t wait_us) {
+  if (queue_count >= LCDAQM_QUEUE_LENGTH) return NULL;
+  lcdaqm_queue_entry_t* e = &queue[(queue_head + queue_count) % LCDAQM_QUEUE_LENGTH];
+  e->wait_us = wait_us;
+  queue_count++;
+  return e;
+}
+
+// コマンドをキューに追加する. 送信はlcdaqm_queue_serviceで行う.
+// LCDはACKに応答せずビジー状態も読み出せないため, 送信後はwait_usが経過するまで次のエントリーを送信しない.
+//
+// Args:
+//   cmd: コマンド
+//   wait_us: コマンドの実行時間[us]. LCDAQM_WAIT_xで指定.
+//
+// Returns: 成功でtrue. キューが満杯ならfalse.
+bool lcdaqm_queue_command(uint8_t cmd, uint32_t wait_us) {
+  lcdaqm_queue_entry_t* e = lcdaqm_queue_push(wait_us);
+  if (e == NULL) return false;
+  e->bytes[0] = 0;
+  e->bytes[1] = cmd;
+  e->length = 2;
+  return true;
+}
+
+// lcdaqm_initと同じ初期化をキューに追加する. 250msの待機を含めて処理はすぐに返る.
+//
+// Returns: 成功でtrue. キューに空きが無ければfalse.
+bool lcdaqm_queue_init() {
+  static const uint8_t cmds[] = {0x38, 0x39, 0x14, 0x70, 0x56, 0x6C, 0x38, 0x0C};
+  if (queue_count + sizeof(cmds) + 1 > LCDAQM_QUEUE_LENGTH) return false;
+  for (uint i = 0; i < sizeof(cmds); i++) {
+    lcdaqm_queue_command(cmds[i], cmds[i] == 0x6C ? LCDAQM_WAIT_POWER : LCDAQM_WAIT_COMMAND);
+  }
+  lcdaqm_queue_clear();
+  lcdaqm_fb_clear();
+  lcdaqm_glyph_reset();
+  return true;
+}
+
+// 画面クリアをキューに追加する
+//
+// Returns: 成功でtrue. キューが満杯ならfalse.
+bool lcdaqm_queue_clear() {
+  if (!lcdaqm_queue_command(1, LCDAQM_WAIT_CLEAR)) return false;
+  cursor_char = 0;
+  cursor_line = 0;
+  memset(fb_sent, ' ', sizeof(fb_sent));  // キューは順に処理されるため, 以降のflushはクリア後の状態と比較する
+  fb_sent_valid = true;
+  return true;
+}
+
+// lcdaqm_fb_flushと同じく, フレームバッファーの変化した部分をキューに追加する
+//
+// Returns: 追加したバイト数. 変化が無ければ0. キューに空きが無ければ-1で, 何も追加しない.
+int lcdaqm_queue_fb_flush() {
+  lcdaqm_run_t runs[LCDAQM_MAX_RUNS];
+  uint count = lcdaqm_fb_find_runs(runs);
+  if (queue_count + count > LCDAQM_QUEUE_LENGTH) return -1;
+
+  int bytes = 0;
+  for (uint i = 0; i < count; i++) {
+    lcdaqm_queue_entry_t* e = lcdaqm_queue_push(LCDAQM_WAIT_COMMAND);
+    e->length = lcdaqm_build_run(e->bytes, &runs[i]);
+    memcpy(&fb_sent[runs[i].line][runs[i].col], &fb[runs[i].line][runs[i].col], runs[i].n);
+    bytes += e->length;
+  }
+  fb_sent_valid = true;
+  return bytes;
+}
+
+// キューのエントリーを, 前のエントリーの実行時間が経過したものから送信する. メインループから定期的に呼ぶ.
+// 待機はせず, 送信できるエントリーが無ければすぐに処理を返す.
+//
+// Returns: キューに残っているエントリー数
+uint lcdaqm_queue_service() {
+  while (queue_count > 0 && hal_time_reached(queue_ready)) {
+    lcdaqm_queue_entry_t* e = &queue[queue_head];
+    hal_i2c_write_blocking(LCDAQM_I2C_INST, LCDAQM_I2C_ADDRESS, e->bytes, e->length, false);
+    queue_ready = hal_make_timeout_time_us(e->wait_us);
+    queue_head = (queue_head + 1) % LCDAQM_QUEUE_LENGTH;
+    queue_count--;
+  }
+  return queue_count;
+}
+
+// 次のエントリーを送信できる時刻. キューが空の場合も, 最後のコマンドの実行完了時刻を返す.
+absolute_time_t lcdaqm_queue_ready_time() {
+  return queue_ready;
+}
+
+// CGRAMのキャッシュを空にする. 電源投入後のCGRAMの内容は不定のため, 初期化時に呼ばれる.
+void lcdaqm_glyph_reset() {
+  memset(glyph_used, 0, sizeof(glyph_used));
+  glyph_clock = 0;
+}
+
+// CGRAMへの書き込み方法を切り替える
+//
+// Args:
+//   enable: trueならlcdaqm_queue_commandと同じキューに追加する. falseならすぐに書き込む.
+void lcdaqm_glyph_use_queue(bool enable) {
+  glyph_queue = enable;
+}
+
+// CGRAMのスロットに文字パターンを書き込む. Set CGRAM addressとデータを1回のI2C転送で送る.
+//
+// Returns: 成功でtrue. キューが満杯ならfalse.
+static bool lcdaqm_glyph_upload(uint slot, const uint8_t* pattern) {
+  uint8_t buf[3 + 8];
+  buf[0] = 0x80;              // Co=1, RS=0: 次の1バイトはコマンド
+  buf[1] = 0x40 | slot << 3;  // Set CGRAM address
+  buf[2] = 0x40;              // Co=0, RS=1: 以降は全てデータ
+  memcpy(buf + 3, pattern, 8);
+
+  // アドレスカウンターがCGRAMを指したままなので, 次のlcdaqm_printがCGRAMに書き込まないようDDRAMの位置に戻す
+  uint8_t ddram = 0x80 | (cursor_line ? 0x40 : 0) | cursor_char;
+  if (glyph_queue) {
+    // 書き込みとアドレスの復帰は2エントリーに分かれるので, 両方を追加できる場合のみ追加する
+    if (queue_count + 2 > LCDAQM_QUEUE_LENGTH) return false;
+    lcdaqm_queue_entry_t* e = lcdaqm_queue_push(LCDAQM_WAIT_COMMAND);
+    memcpy(e->bytes, buf, sizeof(buf));
+    e->length = sizeof(buf);
+    lcdaqm_queue_command(ddram, LCDAQM_WAIT_COMMAND);
+  } else {
+    hal_i2c_write_blocking(LCDAQM_I2C_INST, LCDAQM_I2C_ADDRESS, buf, sizeof(buf), false);
+    lcdaqm_write_register(0, ddram);
+  }
+  return true;
+}
+
+// 文字パターンに対応する文字コードを返す. CGRAMに登録されていなければ書き込む.
+// 8スロットが埋まっている場合は, フレームバッファーとLCDの表示中の内容のどちらでも使用していないスロットのうち
+// 最も長く使われていないものを置き換える.
+// 書き込みはキャッシュにない場合のみ行うため, 毎回同じパターンを指定しても通信は発生しない.
+//
+// Args:
+//   pattern: 5x8ドットの文字パターン. 8バイト, 1バイト1行(上から)で下位5bitを使用.
+//
+// Returns: 文字コード(8-15). フレームバッファーに書き込んで使用する.
+//          全スロットが表示中で置き換えられない, またはキューが満杯なら-1.
+int lcdaqm_glyph(const uint8_t* pattern) {
+  glyph_clock++;
+  for (uint slot = 0; slot < LCDAQM_GLYPH_SLOTS; slot++) {
+    if (glyph_used[slot] && memcmp(glyph_pattern[slot], pattern, 8) == 0) {
+      glyph_used[slot] = glyph_clock;
+      lcdaqm_glyph_hits++;
+      return 8 + slot;
+    }
+  }
+
+  // フレームバッファーで使用中のスロットは置き換えない. 文字コード0-7と8-15は同じCGRAMを指す.
+  // 表示中(fb_sent)のスロットも, 置き換えるとflushの前に表示中の文字が変わってしまうので置き換えない
+  bool in_use[LCDAQM_GLYPH_SLOTS] = {};
+  for (uint line = 0; line < LCDAQM_LINES; line++) {
+    for (uint col = 0; col < LCDAQM_COLS; col++) {
+      uint8_t c = fb[line][col];
+      if (c < 16) in_use[c & 7] = true;
+      c = fb_sent[line][col];
+      if (fb_sent_valid && c < 16) in_use[c & 7] = true;
+    }
+  }
+
+  int victim = -1;
+  for (uint slot = 0; slot < LCDAQM_GLYPH_SLOTS; slot++) {
+    if (in_use[slot]) continue;
+    if (victim < 0 || glyph_used[slot] < glyph_used[victim]) victim = slot;
+  }
+  if (victim < 0 || !lcdaqm_glyph_upload(victim, pattern)) return -1;
+
+  memcpy(glyph_pattern[victim], pattern, 8);
+  glyph_used[victim] = glyph_clock;
+  lcdaqm_glyph_misses++;
+  return 8 + victim;
+}
+
+// フレームバッファーに横棒グラフを描く. 1文字を5分割するため, width x 5段階の分解能となる.
+// 使用する文字パターンは全て埋まった文字と途中の1文字の最大2種類.
+//
+// Args:
+//   line: 1行目なら0, 2行目なら1
+//   col: 描画開始位置
+//   width: 描画する文字数
+//   value: 値. maxを超える場合はmaxとして扱う
+//   max: 棒がwidth文字全てを埋める値
+void lcdaqm_fb_bar(uint line, uint col, uint width, uint32_t value, uint32_t max) {
+  if (max == 0) return;
+  if (value > max) value = max;
+  uint32_t dots = (uint64_t)value * width * 5 / max;  // 埋めるドット列の数
+  for (uint i = 0; i < width; i++) lcdaqm_fb_putc(line, col + i, ' ');  // 前回の描画のスロットを解放
+
+  for (uint i = 0; i < width; i++) {
+    uint32_t n = dots > 5 ? 5 : dots;  // この文字で埋める列数
+    dots -= n;
+    int c = ' ';
+    if (n > 0) {
+      uint8_t row = (0x1F << (5 - n)) & 0x1F;  // 左からn列
+      uint8_t pattern[8] = {row, row, row, row, row, row, row, row};
+      c = lcdaqm_glyph(pattern);
+      if (c < 0) c = n >= 3 ? '=' : '-';  // CGRAMが使えない場合の代替文字
+    }
+    lcdaqm_fb_putc(line, col + i, c);
+  }
+}
+
+// フレームバッファーにスパークライン(1文字1データの縦棒グラフ)を描く. 1文字8段階.
+//
+// Args:
+//   line: 1行目なら0, 2行目なら1
+//   col: 描画開始位置
+//   values: データ. 古いものから順に並べる
+//   n: データ数. 描画する文字数
+//   min: 棒の高さが1ドットになる値. これ以下は1ドット
+//   max: 棒の高さが8ドットになる値. これ以上は8ドット
+void lcdaqm_fb_sparkline(uint line, uint col, const int32_t* values, uint n, int32_t min, int32_t max) {
+  if (max <= min) return;
+  for (uint i = 0; i < n; i++) lcdaqm_fb_putc(line, col + i, ' ');  // 前回の描画のスロットを解放
+  for (uint i = 0; i < n; i++) {
+    int32_t v = values[i];
+    if (v < min) v = min;
+    if (v > max) v = max;
+    uint h = 1 + (uint)((int64_t)(v - min) * 7 / (max - min));  // 1-8ドット
+
+    uint8_t pattern[8] = {};
+    for (uint r = 8 - h; r < 8; r++) pattern[r] = 0x1F;  // 下からhドット
+    int c = lcdaqm_glyph(pattern);
+    if (c < 0) c = h > 4 ? '-' : '_';  // CGRAMが使えない場合の代替文字
+    lcdaqm_fb_putc(line, col + i, c);
+  }
+}
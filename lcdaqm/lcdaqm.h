@@ -7,7 +7,11 @@
 #ifndef LCDAQM_H
 #define LCDAQM_H
 
-#include "pico/stdlib.h"
+#include "hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // -----------------
 // Configurations
@@ -16,10 +20,19 @@
 #define LCDAQM_I2C_SDA_PIN PICO_DEFAULT_I2C_SDA_PIN  // I2C SDAピン
 #define LCDAQM_I2C_SCL_PIN PICO_DEFAULT_I2C_SCL_PIN  // I2C SCLピン
 #define LCDAQM_I2C_ADDRESS 0x3E                      // I2Cデバイスアドレス
-#define lcdaqm_delay(x) sleep_ms(x)                  // xミリ秒待機
+#define LCDAQM_QUEUE_LENGTH 16                       // 非同期コマンドキューのエントリー数
+#define lcdaqm_delay(x) hal_sleep_ms(x)              // xミリ秒待機
 
 // -----------------
 
+#define LCDAQM_LINES 2  // 行数
+#define LCDAQM_COLS 8   // 1行の文字数
+
+// コマンドの実行時間[us]. ST7032データシートの値に余裕を持たせたもの
+#define LCDAQM_WAIT_COMMAND 27    // 通常のコマンド, データ書き込み. 26.3us
+#define LCDAQM_WAIT_CLEAR 2000    // Clear display, Return home. 1.08ms
+#define LCDAQM_WAIT_POWER 250000  // Follower control後の電源安定待ち. 200ms
+
 void lcdaqm_init_i2c();
 int lcdaqm_write_register(uint8_t reg_addr, uint8_t data);
 void lcdaqm_init();
@@ -27,4 +40,33 @@ void lcdaqm_print(const char* str);
 void lcdaqm_clear();
 void lcdaqm_goto_line(uint line);
 
+void lcdaqm_fb_clear();
+void lcdaqm_fb_putc(uint line, uint col, char c);
+void lcdaqm_fb_print(uint line, uint col, const char* str);
+void lcdaqm_fb_print_fixed(uint line, uint col, int32_t value, uint scale, uint frac_digits, uint width);
+void lcdaqm_fb_invalidate();
+int lcdaqm_fb_flush();
+
+bool lcdaqm_queue_command(uint8_t cmd, uint32_t wait_us);
+bool lcdaqm_queue_init();
+bool lcdaqm_queue_clear();
+int lcdaqm_queue_fb_flush();
+uint lcdaqm_queue_service();
+absolute_time_t lcdaqm_queue_ready_time();
+
+#define LCDAQM_GLYPH_SLOTS 8  // CGRAMに登録できる文字数
+
+extern uint32_t lcdaqm_glyph_hits;    // キャッシュに登録済みだった回数
+extern uint32_t lcdaqm_glyph_misses;  // CGRAMへ書き込んだ回数
+
+void lcdaqm_glyph_reset();
+void lcdaqm_glyph_use_queue(bool enable);
+int lcdaqm_glyph(const uint8_t* pattern);
+void lcdaqm_fb_bar(uint line, uint col, uint width, uint32_t value, uint32_t max);
+void lcdaqm_fb_sparkline(uint line, uint col, const int32_t* values, uint n, int32_t min, int32_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
\ No newline at end of file
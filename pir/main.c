@@ -4,36 +4,46 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <stdio.h>
+
 #include "pico/stdlib.h"
+#include "pir.h"
 
-#define LED_PIN 3  // LEDが接続されているPicoのGPIO番号
-#define PIR_PIN 6  // PIRセンサーが接続されているPicoのGPIO番号
+#define LED_PIN 3                // LEDが接続されているPicoのGPIO番号
+#define STATS_WINDOW_MS 600000   // 在室率を集計する期間[ms]. 10分
+#define STATS_INTERVAL_MS 60000  // 集計結果を表示する間隔[ms]. 1分
 
 int main() {
+  stdio_init_all();
   gpio_init(LED_PIN);               // LED用のGPIOを初期化
   gpio_set_dir(LED_PIN, GPIO_OUT);  // LED用のGPIOを出力に変更
-  gpio_init(PIR_PIN);               // PIR用のGPIOを初期化
+
+  // PIR用のGPIOを初期化し, 検知開始, 終了の記録を開始. PIRのピン番号はpir.hのPIR_PINで指定する.
+  pir_init();
+  gpio_put(LED_PIN, pir_motion());
+
+  absolute_time_t next_stats = make_timeout_time_ms(STATS_INTERVAL_MS);
 
   // 無限ループ
   while (1) {
-#if PICO_RP2350
-    // Errata RP2350-E9対策のためPico2のみコンパイルされる部分
-    hw_set_bits(&pads_bank0_hw->io[PIR_PIN], PADS_BANK0_GPIO0_IE_BITS);  // GPIO読み出し前にinput enableを有効化
-    busy_wait_at_least_cycles(1);                                        // すぐに読み出すとうまく動かないので少し待つ
-#endif
-
-    if (1 == gpio_get(PIR_PIN)) {
-      // PIRセンサーが検知している場合
-      gpio_put(LED_PIN, 1);  // LED点灯 (High, 1を出力するとLEDに電流が流れて点灯)
-    } else {
-      // PIRセンサーが検知していない場合
-      gpio_put(LED_PIN, 0);  // LED点灯 (High, 1を出力するとLEDに電流が流れて点灯)
+    // 次の集計結果の表示までイベントを待つ. 待っている間はコアが停止する.
+    int64_t wait_us = absolute_time_diff_us(get_absolute_time(), next_stats);
+    pir_event_t event;
+    if (wait_us > 1000 && pir_wait_event(&event, (uint32_t)(wait_us / 1000))) {
+      // 検知開始でLED点灯, 検知終了で消灯 (High, 1を出力するとLEDに電流が流れて点灯)
+      gpio_put(LED_PIN, event.motion);
+      printf("%lu.%03lu[s] %s\n", (unsigned long)(event.time_us / 1000000), (unsigned long)(event.time_us / 1000 % 1000),
+             event.motion ? "motion" : "clear");
     }
 
-#if PICO_RP2350
-    // Errata RP2350-E9対策のためPico2のみコンパイルされる部分
-    hw_clear_bits(&pads_bank0_hw->io[PIR_PIN], PADS_BANK0_GPIO0_IE_BITS);  // GPIO読み出し後にinput enableを無効化
-    busy_wait_at_least_cycles(50);                                         // 効果が出るまで少し待つ
-#endif
+    if (time_reached(next_stats)) {
+      // 直近の在室率と検知回数を表示
+      pir_stats_t stats;
+      pir_get_stats(STATS_WINDOW_MS, &stats);
+      printf("window %lu[s] occupancy %lu.%lu[%%] events %lu (%lu/h)\n", (unsigned long)(stats.window_ms / 1000),
+             (unsigned long)(stats.duty_x1000 / 10), (unsigned long)(stats.duty_x1000 % 10), (unsigned long)stats.events,
+             (unsigned long)stats.events_per_hour);
+      next_stats = delayed_by_ms(next_stats, STATS_INTERVAL_MS);
+    }
   }
 }
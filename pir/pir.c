@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pir.h"
+
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "pico/sync.h"
+
+#if PIR_USE_PIO
+#include "pioinput.h"
+#elif PIR_E9_WORKAROUND
+#include "hardware/structs/pads_bank0.h"
+#endif
+
+static pir_event_t pir_log[PIR_LOG_LENGTH];  // 変化の記録. 古いものから上書きする
+static volatile uint32_t pir_log_head = 0;   // 記録したイベントの累計
+static uint32_t pir_log_read = 0;            // pir_get_eventで読み出したイベントの累計
+static uint32_t pir_lost = 0;                // 読み出す前に上書きされたイベントの累計
+static volatile bool pir_state = false;      // 現在の状態
+static uint64_t pir_init_time = 0;           // pir_initの時刻
+static bool pir_init_state = false;          // pir_initの時点の状態
+static critical_section_t pir_cs;            // 割り込みとの排他制御
+
+// 変化を記録する. 割り込みから呼ばれる.
+static void pir_record(uint64_t time_us, bool motion) {
+  critical_section_enter_blocking(&pir_cs);
+  pir_log[pir_log_head & (PIR_LOG_LENGTH - 1)] = (pir_event_t){time_us, motion};
+  pir_log_head++;
+  pir_state = motion;
+  critical_section_exit(&pir_cs);
+}
+
+#if PIR_USE_PIO
+static inline bool pir_sample() {
+  return gpio_get(PIR_PIN);
+}
+
+// pioinputで変化を確定した時に呼ばれる
+static void pir_pioinput_callback(uint pin, bool level, uint64_t time_us) {
+  if (level != pir_state) pir_record(time_us, level);
+}
+#elif PIR_E9_WORKAROUND
+static repeating_timer_t pir_timer;
+
+// 入力を有効にしてPIRのピンを読み出し, 読み出し後は無効に戻す. Errata RP2350-E9対策.
+// 入力を無効にしてから効果が出るまで少しかかるが, 次のサンプルまで十分時間があるので待たない.
+static inline bool pir_sample() {
+  hw_set_bits(&pads_bank0_hw->io[PIR_PIN], PADS_BANK0_GPIO0_IE_BITS);  // 読み出し前にinput enableを有効化
+  busy_wait_at_least_cycles(1);                                        // すぐに読み出すとうまく動かないので少し待つ
+  bool level = gpio_get(PIR_PIN);
+  hw_clear_bits(&pads_bank0_hw->io[PIR_PIN], PADS_BANK0_GPIO0_IE_BITS);  // 読み出し後にinput enableを無効化
+  return level;
+}
+
+static bool pir_sample_callback(repeating_timer_t* rt) {
+  bool level = pir_sample();
+  if (level != pir_state) pir_record(time_us_64() - PIR_SAMPLE_US / 2, level);  // 前回のサンプルとの中間を変化時刻とする
+  return true;
+}
+#else
+#define PIR_EDGES (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE)
+
+static inline bool pir_sample() {
+  return gpio_get(PIR_PIN);
+}
+
+static void pir_gpio_irq_handler() {
+  uint32_t events = gpio_get_irq_event_mask(PIR_PIN) & PIR_EDGES;
+  if (!events) return;
+  uint64_t now = time_us_64();
+  gpio_acknowledge_irq(PIR_PIN, events);
+
+  bool level = gpio_get(PIR_PIN);
+  if (events == PIR_EDGES && level == pir_state) {
+    // 割り込みの遅延より短いパルス. 両方の変化を同じ時刻で記録する
+    pir_record(now, !level);
+    pir_record(now, level);
+  } else if (level != pir_state) {
+    pir_record(now, level);
+  }
+}
+#endif
+
+// PIRセンサーのGPIOを初期化し, 変化の記録を開始する
+//
+// Returns: 成功でtrue. タイマー, アラーム, PIOの空きがない場合false.
+bool pir_init() {
+  critical_section_init(&pir_cs);
+  gpio_init(PIR_PIN);  // PIR用のGPIOを初期化
+
+  pir_log_head = 0;
+  pir_log_read = 0;
+  pir_lost = 0;
+  pir_state = pir_sample();
+  pir_init_state = pir_state;
+  pir_init_time = time_us_64();
+
+#if PIR_USE_PIO
+  // PIOはinput enableを有効にし続けるので, RP2350-E9の原因となる内蔵プルダウンを無効にする. PIRセンサーの出力が駆動する
+  gpio_disable_pulls(PIR_PIN);
+  return pioinput_add(PIR_PIN, pir_pioinput_callback);
+#elif PIR_E9_WORKAROUND
+  hw_clear_bits(&pads_bank0_hw->io[PIR_PIN], PADS_BANK0_GPIO0_IE_BITS);  // サンプル時以外はinput enableを無効化
+  return add_repeating_timer_us(-PIR_SAMPLE_US, pir_sample_callback, NULL, &pir_timer);
+#else
+#if PICO_RP2350
+  // エッジ割り込みはinput enableを有効にし続けるので, PIOと同じく内蔵プルダウンを無効にする
+  gpio_disable_pulls(PIR_PIN);
+#endif
+  gpio_add_raw_irq_handler(PIR_PIN, pir_gpio_irq_handler);
+  gpio_set_irq_enabled(PIR_PIN, PIR_EDGES, true);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+  return true;
+#endif
+}
+
+// 現在の状態
+//
+// Returns: 検知していればtrue
+bool pir_motion() {
+  return pir_state;
+}
+
+// 読み出していないイベントを古いものから1つ取り出す. 待たずに処理を返す.
+//
+// Returns: イベントがあればtrue
+bool pir_get_event(pir_event_t* event) {
+  bool ret = false;
+  critical_section_enter_blocking(&pir_cs);
+  if (pir_log_head - pir_log_read > PIR_LOG_LENGTH) {
+    // 読み出す前に上書きされた分を飛ばす
+    pir_lost += pir_log_head - pir_log_read - PIR_LOG_LENGTH;
+    pir_log_read = pir_log_head - PIR_LOG_LENGTH;
+  }
+  if (pir_log_read != pir_log_head) {
+    *event = pir_log[pir_log_read & (PIR_LOG_LENGTH - 1)];
+    pir_log_read++;
+    ret = true;
+  }
+  critical_section_exit(&pir_cs);
+  return ret;
+}
+
+static int64_t pir_wake_callback(alarm_id_t id, void* user_data) {
+  return 0;  // __wfi()から復帰させるだけ
+}
+
+// イベントを待って1つ取り出す. 待っている間は__wfi()でコアを停止する.
+//
+// Args:
+//   event: イベントの格納先
+//   timeout_ms: 待つ時間[ms]. 0なら期限なし.
+//
+// Returns: イベントがあればtrue, タイムアウトでfalse
+bool pir_wait_event(pir_event_t* event, uint32_t timeout_ms) {
+  absolute_time_t deadline = timeout_ms ? make_timeout_time_ms(timeout_ms) : at_the_end_of_time;
+  alarm_id_t wake = timeout_ms ? add_alarm_at(deadline, pir_wake_callback, NULL, false) : 0;
+
+  bool ret = false;
+  while (1) {
+    if (pir_get_event(event)) {
+      ret = true;
+      break;
+    }
+    if (time_reached(deadline)) break;
+
+    // 確認から__wfi()までの間に割り込みが来ると次の割り込みまで起きないので, 割り込みを止めて確認する
+    uint32_t status = save_and_disable_interrupts();
+    if (pir_log_head == pir_log_read && !time_reached(deadline)) __wfi();
+    restore_interrupts(status);
+  }
+
+  if (wake > 0) cancel_alarm(wake);
+  return ret;
+}
+
+// 読み出す前に上書きされたイベントの数
+uint32_t pir_lost_events() {
+  return pir_lost;
+}
+
+// 直近window_msの在室率と検知回数を集計する. 記録を新しい方から順にたどる.
+// 記録がPIR_LOG_LENGTHを超えて上書きされている場合, 集計期間は残っている最も古いイベントまでになる.
+//
+// Args:
+//   window_ms: 集計する期間[ms]
+//   stats: 集計結果の格納先
+void pir_get_stats(uint32_t window_ms, pir_stats_t* stats) {
+  critical_section_enter_blocking(&pir_cs);
+  uint64_t now = time_us_64();
+  uint64_t win_start = now > (uint64_t)window_ms * 1000 ? now - (uint64_t)window_ms * 1000 : 0;
+  uint32_t count = pir_log_head < PIR_LOG_LENGTH ? pir_log_head : PIR_LOG_LENGTH;
+
+  uint64_t seg_end = now;  // 現在たどっている区間の終わり
+  uint64_t active = 0;
+  uint32_t events = 0;
+  bool covered = false;  // 集計期間の始まりまでたどれた
+  for (uint32_t i = 0; i < count; i++) {
+    const pir_event_t* e = &pir_log[(pir_log_head - 1 - i) & (PIR_LOG_LENGTH - 1)];
+    uint64_t seg_start = e->time_us > win_start ? e->time_us : win_start;
+    if (e->motion) active += seg_end - seg_start;  // イベントから次のイベントまでは検知中
+    if (e->time_us <= win_start) {
+      covered = true;
+      break;
+    }
+    if (e->motion) events++;
+    seg_end = e->time_us;
+  }
+
+  if (!covered) {
+    if (pir_log_head <= PIR_LOG_LENGTH) {
+      // 記録開始からの全イベントをたどった. それより前はpir_initの時点の状態
+      if (pir_init_time > win_start) win_start = pir_init_time;
+      if (pir_init_state && seg_end > win_start) active += seg_end - win_start;
+    } else {
+      win_start = seg_end;  // 最も古いイベントより前の状態は不明なので集計しない
+    }
+  }
+  critical_section_exit(&pir_cs);
+
+  stats->window_ms = (uint32_t)((now - win_start) / 1000);
+  stats->active_ms = (uint32_t)(active / 1000);
+  stats->events = events;
+  stats->duty_x1000 = now > win_start ? (uint32_t)(active * 1000 / (now - win_start)) : 0;
+  stats->events_per_hour = now > win_start ? (uint32_t)((uint64_t)events * 3600000000ull / (now - win_start)) : 0;
+}
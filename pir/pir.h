@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef PIR_H
+#define PIR_H
+
+// PIR(人感)センサーの検知開始, 終了をタイムスタンプ付きで記録する.
+// 記録はリングバッファーに残り, 一定期間の在室率(検知していた時間の割合)と検知回数を集計できる.
+//
+// RP2040ではGPIOのエッジ割り込みで変化を検出し, 割り込み時のタイマー値を記録する.
+// RP2350ではErrata RP2350-E9の対策として, 内蔵プルダウンを無効にしてpioinputでサンプリングする(PIR_USE_PIO).
+// 変化の時刻はPIOのサンプル番号から求めるので誤差はPIOINPUT_SAMPLE_US以内で, CPUは変化の確定時の割り込みだけを処理する.
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#define PIR_PIN 6           // PIRセンサーが接続されているPicoのGPIO番号
+#define PIR_LOG_LENGTH 64   // 記録するイベント数. 2のべき乗
+#ifndef PIR_USE_PIO
+#define PIR_USE_PIO PICO_RP2350  // 1でPIOによるサンプリングを使用. 0ならPIR_E9_WORKAROUNDで選ぶ
+#endif
+#ifndef PIR_E9_WORKAROUND
+// PIR_USE_PIOが0の場合に, 1でRP2350-E9対策のサンプリング, 0でエッジ割り込みを使用.
+// RP2350-E9対策はタイマー割り込みでPIR_SAMPLE_USおきにその瞬間だけ入力を有効にして読み出す.
+// 変化の時刻は前回と今回のサンプルの中間とするので誤差は±PIR_SAMPLE_US/2で,
+// CPUは変化が無くてもPIR_SAMPLE_USおきに起きる(2msなら毎秒500回). 深い低消費電力の状態で待機できない.
+#define PIR_E9_WORKAROUND PICO_RP2350
+#endif
+#define PIR_SAMPLE_US 2000  // RP2350-E9対策時のサンプリング周期[us]
+
+// -----------------
+
+typedef struct {
+  uint64_t time_us;  // 変化した時刻[us]. time_us_64()と同じ基準
+  bool motion;       // 検知開始ならtrue, 検知終了ならfalse
+} pir_event_t;
+
+typedef struct {
+  uint32_t window_ms;        // 集計した期間[ms]. 記録が足りない場合は指定より短い
+  uint32_t active_ms;        // 検知していた時間[ms]
+  uint32_t duty_x1000;       // 在室率. active_ms / window_msの1000倍
+  uint32_t events;           // 検知開始の回数
+  uint32_t events_per_hour;  // 1時間あたりの検知開始の回数
+} pir_stats_t;
+
+bool pir_init();
+bool pir_motion();
+bool pir_get_event(pir_event_t* event);
+bool pir_wait_event(pir_event_t* event, uint32_t timeout_ms);
+uint32_t pir_lost_events();
+void pir_get_stats(uint32_t window_ms, pir_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
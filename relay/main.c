@@ -4,33 +4,39 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include "button.h"
 #include "pico/stdlib.h"
+#include "relay.h"
 
-#define RELAY_PIN 11    // リレーが接続されているPicoのGPIO番号
-#define RED_SW_PIN 8    // 赤スイッチが接続されているPicoのGPIO番号
-#define BLACK_SW_PIN 9  // 黒スイッチが接続されているPicoのGPIO番号
+#define RED_SW_PIN 8               // 赤スイッチが接続されているPicoのGPIO番号
+#define BLACK_SW_PIN 9             // 黒スイッチが接続されているPicoのGPIO番号
+#define TIMER_OFF_MS (10 * 60000)  // 赤スイッチ長押しでONした後, OFFするまでの時間[ms]
 
 int main() {
-  gpio_init(RELAY_PIN);               // リレー用のGPIOを初期化
-  gpio_set_dir(RELAY_PIN, GPIO_OUT);  // リレー用のGPIOを出力に変更
+  // リレー用のGPIOと制御を初期化. リレーのピン番号, 最小ON/OFF時間などはrelay.hで指定する.
+  relay_init();
 
-  // スイッチ用のGPIOを初期化
-  gpio_init(RED_SW_PIN);
-  gpio_init(BLACK_SW_PIN);
-
-  // スイッチ用のGPIOをプルアップ
-  gpio_pull_up(RED_SW_PIN);
-  gpio_pull_up(BLACK_SW_PIN);
-  sleep_ms(5);  // プルアップによるGPIOの電圧が安定するまで待機
+  // スイッチを登録. スイッチが押されるとGNDと導通してLow, 0が入力されるのでactive_lowはtrue.
+  // チャタリングは除去されるので, 1回押すとBUTTON_PRESSは1回だけ発生する.
+  button_add(RED_SW_PIN, true);
+  button_add(BLACK_SW_PIN, true);
 
   // 無限ループ
   while (1) {
-    if (0 == gpio_get(RED_SW_PIN)) {
-      // 赤スイッチが押されている場合 (スイッチが押されるとGNDと導通してLow, 0が入力される)
-      gpio_put(RELAY_PIN, 1);  // リレーON (High, 1を出力するとリレーがONする)
-    } else if (0 == gpio_get(BLACK_SW_PIN)) {
-      // 黒スイッチが押されている場合 (スイッチが押されるとGNDと導通してLow, 0が入力される)
-      gpio_put(RELAY_PIN, 0);  // リレーOFF (Low, 0を出力するとリレーがOFFする)
+    // スイッチのイベントを待つ. 待っている間はコアが停止する.
+    button_event_t event;
+    if (!button_wait_event(&event, 0)) continue;
+
+    if (event.pin == RED_SW_PIN && event.type == BUTTON_PRESS) {
+      // 赤スイッチが押された. リレーON. 最小OFF時間の経過前であれば, 経過後にONする.
+      relay_on();
+    } else if (event.pin == RED_SW_PIN && event.type == BUTTON_LONG_PRESS) {
+      // 赤スイッチが長押しされた. ONしたまま, TIMER_OFF_MS後のOFFを予約する.
+      relay_schedule(make_timeout_time_ms(TIMER_OFF_MS), false);
+    } else if (event.pin == BLACK_SW_PIN && event.type == BUTTON_PRESS) {
+      // 黒スイッチが押された. リレーOFFし, 予約も取り消す.
+      relay_cancel_schedules();
+      relay_off();
     }
   }
 }
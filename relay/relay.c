@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "relay.h"
+
+#include "pico/sync.h"
+#include "ring.h"
+
+typedef enum {
+  RELAY_CMD_ON,
+  RELAY_CMD_OFF,
+  RELAY_CMD_SCHEDULE_ON,
+  RELAY_CMD_SCHEDULE_OFF,
+  RELAY_CMD_CANCEL,
+} relay_cmd_type_t;
+
+typedef struct {
+  uint64_t time_us;  // 要求した時刻, もしくは予約時刻
+  uint8_t type;      // relay_cmd_type_t
+} relay_cmd_t;
+
+typedef struct {
+  uint64_t time_us;
+  bool on;
+} relay_schedule_t;
+
+static relay_cmd_t relay_queue_buf[RELAY_QUEUE_LENGTH];
+static ring_t relay_queue = RING_INIT(relay_queue_buf);  // relay_on等が書き込み, relay_processが読み出す
+static critical_section_t relay_queue_lock;              // 複数の書き込み側(割り込み, 別のコア)のring_pushを排他する
+static alarm_pool_t* relay_pool = NULL;                  // relay_initを呼んだコアで動作するアラームプール
+static volatile bool relay_kick_pending = false;         // 要求を処理するアラームを設定済み
+
+// 以下はrelay_processの中だけで更新する
+static volatile bool relay_current = false;                   // リレーの状態
+static bool relay_desired = false;                            // 要求された状態
+static uint64_t relay_desired_time = 0;                       // 要求された時刻
+static uint64_t relay_last_switch = 0;                        // 最後に切り替えた時刻
+static volatile uint64_t relay_next_switch = 0;               // 制限により遅らせた切り替えの時刻. 0でなし
+static relay_schedule_t relay_schedules[RELAY_SCHEDULE_MAX];  // 予約. 時刻の早い順
+static uint relay_schedule_count = 0;
+static alarm_id_t relay_alarm = 0;
+static relay_stats_t relay_stats;
+
+#if RELAY_RATE_MAX_SWITCHES
+static uint64_t relay_switch_log[RELAY_RATE_MAX_SWITCHES];  // 直近の切り替え時刻. 最大切り替え回数の判定用
+static uint relay_switch_log_pos = 0;
+#endif
+
+static void relay_process();
+
+static int64_t relay_alarm_callback(alarm_id_t id, void* user_data) {
+  relay_alarm = 0;
+  relay_process();
+  return 0;
+}
+
+// 要求をキューに入れた直後のアラーム. キューは全て読み出すので, 以降の要求は新しいアラームで処理する
+static int64_t relay_kick_callback(alarm_id_t id, void* user_data) {
+  relay_kick_pending = false;
+  relay_process();
+  return 0;
+}
+
+// 予約を時刻の早い順に挿入する
+static void relay_insert_schedule(uint64_t time_us, bool on) {
+  if (relay_schedule_count >= RELAY_SCHEDULE_MAX) {
+    relay_stats.dropped_schedules++;
+    return;
+  }
+  uint i = relay_schedule_count++;
+  for (; i > 0 && relay_schedules[i - 1].time_us > time_us; i--) relay_schedules[i] = relay_schedules[i - 1];
+  relay_schedules[i].time_us = time_us;
+  relay_schedules[i].on = on;
+}
+
+// 現在の状態から切り替えられる最も早い時刻
+static uint64_t relay_earliest_switch() {
+  uint64_t t = relay_last_switch + (relay_current ? RELAY_MIN_ON_MS : RELAY_MIN_OFF_MS) * 1000ull;
+#if RELAY_RATE_MAX_SWITCHES
+  // RELAY_RATE_MAX_SWITCHES回前の切り替えからRELAY_RATE_WINDOW_MS経過するまでは切り替えない
+  uint64_t oldest = relay_switch_log[relay_switch_log_pos];
+  if (oldest && oldest + RELAY_RATE_WINDOW_MS * 1000ull > t) t = oldest + RELAY_RATE_WINDOW_MS * 1000ull;
+#endif
+  return t;
+}
+
+// キューの要求と予約を処理し, 制限の範囲内でリレーを切り替える. 次に処理が必要な時刻にアラームを設定する.
+// relay_poolのアラームからのみ呼ばれるので, 同時に実行されることはない.
+static void relay_process() {
+  uint64_t now = time_us_64();
+
+  relay_cmd_t cmd;
+  while (ring_pop(&relay_queue, &cmd)) {
+    switch (cmd.type) {
+      case RELAY_CMD_ON:
+      case RELAY_CMD_OFF:
+        relay_desired = cmd.type == RELAY_CMD_ON;
+        relay_desired_time = cmd.time_us;
+        break;
+      case RELAY_CMD_SCHEDULE_ON:
+      case RELAY_CMD_SCHEDULE_OFF:
+        relay_insert_schedule(cmd.time_us, cmd.type == RELAY_CMD_SCHEDULE_ON);
+        break;
+      case RELAY_CMD_CANCEL:
+        relay_schedule_count = 0;
+        break;
+    }
+  }
+
+  // 時刻になった予約を要求として扱う
+  uint done = 0;
+  while (done < relay_schedule_count && relay_schedules[done].time_us <= now) {
+    relay_desired = relay_schedules[done].on;
+    relay_desired_time = relay_schedules[done].time_us;
+    done++;
+  }
+  if (done) {
+    relay_schedule_count -= done;
+    for (uint i = 0; i < relay_schedule_count; i++) relay_schedules[i] = relay_schedules[i + done];
+  }
+
+  uint64_t wake = UINT64_MAX;
+  bool deferred = relay_next_switch != 0;  // 前回の処理で切り替えを遅らせていた
+  relay_next_switch = 0;
+  if (relay_desired != relay_current) {
+    uint64_t earliest = relay_earliest_switch();
+    if (now >= earliest) {
+      gpio_put(RELAY_PIN, relay_desired);
+      relay_current = relay_desired;
+      relay_last_switch = now;
+#if RELAY_RATE_MAX_SWITCHES
+      relay_switch_log[relay_switch_log_pos] = now;
+      relay_switch_log_pos = (relay_switch_log_pos + 1) % RELAY_RATE_MAX_SWITCHES;
+#endif
+      relay_stats.switches++;
+      if (!deferred && now - relay_desired_time > relay_stats.max_latency_us) {
+        relay_stats.max_latency_us = (uint32_t)(now - relay_desired_time);  // 制限で遅らせた分は含めない
+      }
+    } else {
+      if (!deferred) relay_stats.deferred++;
+      relay_next_switch = earliest;
+      wake = earliest;
+    }
+  }
+  if (relay_schedule_count && relay_schedules[0].time_us < wake) wake = relay_schedules[0].time_us;
+
+  if (relay_alarm) alarm_pool_cancel_alarm(relay_pool, relay_alarm);
+  relay_alarm = 0;
+  if (wake != UINT64_MAX) {
+    // 時刻を過ぎていてもアラームの割り込みから呼ばせ, relay_processを入れ子にしない
+    relay_alarm = alarm_pool_add_alarm_at_force_in_context(relay_pool, from_us_since_boot(wake), relay_alarm_callback,
+                                                           NULL);
+    if (relay_alarm < 0) relay_alarm = 0;
+  }
+}
+
+// 要求をキューに入れ, relay_poolのアラームで処理させる. どのコアのどの処理から呼んでも,
+// 処理はrelay_initを呼んだコアのアラームの割り込みで行う. ユーザー割り込みは呼んだコアでしか発生させられないので使わない.
+// RP2040(Cortex-M0+)には比較交換命令が無いため, 書き込み側の排他はスピンロックで行う. 保持するのは要素のコピーの間だけ.
+static void relay_push(relay_cmd_type_t type, uint64_t time_us) {
+  relay_cmd_t cmd = {time_us, (uint8_t)type};
+  critical_section_enter_blocking(&relay_queue_lock);
+  bool kick = ring_push(&relay_queue, &cmd) && !relay_kick_pending;
+  if (kick) relay_kick_pending = true;
+  critical_section_exit(&relay_queue_lock);
+  if (!kick) return;  // 処理のアラームを設定済み. もしくはキューが満杯
+  if (alarm_pool_add_alarm_at_force_in_context(relay_pool, get_absolute_time(), relay_kick_callback, NULL) < 0) {
+    relay_kick_pending = false;  // アラームの空きがない. 次の要求か予約のアラームで処理する
+  }
+}
+
+// リレー用のGPIOと要求を処理するアラームプールを初期化する. リレーはOFFで開始する.
+// 起動直後のONも最小OFF時間を守る. 要求はこの関数を呼んだコアで処理する.
+//
+// Returns: 成功でtrue. ハードウェアアラームの空きがない場合false.
+bool relay_init() {
+  gpio_init(RELAY_PIN);               // リレー用のGPIOを初期化
+  gpio_set_dir(RELAY_PIN, GPIO_OUT);  // リレー用のGPIOを出力に変更
+  gpio_put(RELAY_PIN, 0);
+  relay_current = false;
+  relay_desired = false;
+  relay_last_switch = time_us_64();
+
+  int alarm_num = hardware_alarm_claim_unused(false);
+  if (alarm_num < 0) return false;
+  critical_section_init(&relay_queue_lock);
+  relay_pool = alarm_pool_create(alarm_num, 4);  // 割り込みはこのコアで処理される. 要求用と予約用
+  return true;
+}
+
+// リレーのONを要求する. 最小OFF時間や最大切り替え回数の制限中は, 制限が解けてからONする.
+void relay_on() {
+  relay_push(RELAY_CMD_ON, time_us_64());
+}
+
+// リレーのOFFを要求する. 最小ON時間や最大切り替え回数の制限中は, 制限が解けてからOFFする.
+void relay_off() {
+  relay_push(RELAY_CMD_OFF, time_us_64());
+}
+
+// 指定時刻のONもしくはOFFを予約する. 時刻になるとrelay_on, relay_offと同じ要求として扱う.
+//
+// Args:
+//   time: 予約時刻
+//   on: ONならtrue, OFFならfalse
+void relay_schedule(absolute_time_t time, bool on) {
+  relay_push(on ? RELAY_CMD_SCHEDULE_ON : RELAY_CMD_SCHEDULE_OFF, to_us_since_boot(time));
+}
+
+// 全ての予約を取り消す
+void relay_cancel_schedules() {
+  relay_push(RELAY_CMD_CANCEL, time_us_64());
+}
+
+// リレーの状態
+//
+// Returns: ONならtrue
+bool relay_state() {
+  return relay_current;
+}
+
+// 制限により遅らせている切り替えの時刻
+//
+// Returns: 切り替え予定の時刻. なければat_the_end_of_time
+absolute_time_t relay_next_switch_time() {
+  uint64_t t = relay_next_switch;
+  return t ? from_us_since_boot(t) : at_the_end_of_time;
+}
+
+// 統計情報を読み出す
+void relay_get_stats(relay_stats_t* stats) {
+  *stats = relay_stats;
+  stats->dropped_commands = relay_queue.drops;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2025 Indoor Corgi
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef RELAY_H
+#define RELAY_H
+
+// リレーの制御. 接点の摩耗を防ぐため, 最小ON時間, 最小OFF時間, 一定時間あたりの最大切り替え回数を守る.
+// 制限中にONとOFFの要求が入れ替わった場合は, 制限が解けた時点の要求だけを反映する.
+// CO2濃度のしきい値付近で要求が細かく変化しても, リレーが頻繁に切り替わることはない.
+//
+// 要求はキューに入れ, relay_initを呼んだコアのアラームの割り込みで処理するので, relay_on等は待たずに処理を返す.
+// 制限が解ける時刻や予約時刻も同じアラームプールで処理する. GPIOの操作はこの割り込みの中だけで行う.
+// relay_on等はどちらのコアの通常の処理, 割り込みハンドラーからも呼べる. キューへの書き込みだけをスピンロックで排他する.
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------
+// Configurations
+
+#define RELAY_PIN 11                  // リレーが接続されているPicoのGPIO番号
+#define RELAY_MIN_ON_MS 5000          // 最小ON時間[ms]
+#define RELAY_MIN_OFF_MS 5000         // 最小OFF時間[ms]
+#define RELAY_RATE_WINDOW_MS 3600000  // 最大切り替え回数を数える期間[ms]
+#define RELAY_RATE_MAX_SWITCHES 60    // RELAY_RATE_WINDOW_MSあたりの最大切り替え回数. 0で制限なし
+#define RELAY_QUEUE_LENGTH 16         // 要求のキューの長さ. 2のべき乗
+#define RELAY_SCHEDULE_MAX 8          // 予約できる数
+
+// -----------------
+
+typedef struct {
+  uint32_t switches;           // 切り替えた回数
+  uint32_t deferred;           // 制限により切り替えを遅らせた回数
+  uint32_t dropped_commands;   // キューが満杯で捨てた要求の数
+  uint32_t dropped_schedules;  // 予約が満杯で捨てた予約の数
+  uint32_t max_latency_us;     // 制限のない要求からGPIO操作までの最大時間[us]
+} relay_stats_t;
+
+bool relay_init();
+void relay_on();
+void relay_off();
+void relay_schedule(absolute_time_t time, bool on);
+void relay_cancel_schedules();
+bool relay_state();
+absolute_time_t relay_next_switch_time();
+void relay_get_stats(relay_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,25 +7,74 @@
 #include <stdio.h>
 
 #include "hardware/i2c.h"
+#include "numfmt.h"
 #include "pico/stdlib.h"
 #include "scd41.h"
+#include "telemetry.h"
+
+// 1なら測定結果をバイナリのレコード(common/telemetry.h)で送信する. PC側はhost/telemetry_dumpで表示する.
+// 0ならテキストで表示する
+#define OUTPUT_TELEMETRY 1
+
+// 1ならOUTPUT_TELEMETRYで, 変換前の温度, 湿度の値も送信する.
+// PC側はhost/sensor_replayで, 記録した値からドライバーと同じ計算で測定値を求め直せる
+#define OUTPUT_RAW 0
+
+#if OUTPUT_TELEMETRY
+static telemetry_t telemetry;
+
+// イベントのレコードを送信する
+static void send_event(telemetry_event_t event) {
+  int32_t values[2] = {event, TELEMETRY_SCD41};
+  telemetry_send(&telemetry, TELEMETRY_EVENT, 0, time_us_64(), values, 2);
+}
+#endif
 
 int main() {
   stdio_init_all();
   scd41_init_i2c();  // 通信に使うI2Cインスタンスとピンを初期化
+#if OUTPUT_TELEMETRY
+  telemetry_init(&telemetry, telemetry_usb_write, NULL);  // printfを通さずUSBシリアルへ送信する
+  send_event(TELEMETRY_EVENT_START);
+#else
   printf("-------------\n");
+#endif
   scd41_start_periodic_measurement();  // 5秒おきのセンサーの継続測定を開始
 
   // 10回測定する
   for (int i = 0; i < 10; i++) {
-    if (scd41_read_measurement(10)) {       // センサーの測定結果が更新されるのを待つ. タイムアウト10秒.
-      printf("CO2: %u[ppm]\n", scd41_co2);  // scd41_co2に入った測定結果を表示
+    if (scd41_read_measurement(10)) {  // センサーの測定結果が更新されるのを待つ. タイムアウト10秒.
+#if OUTPUT_TELEMETRY
+      // 整数の測定値をそのまま送信する
+      int32_t values[3] = {scd41_co2, scd41_temperature_x100, (int32_t)scd41_humidity_x100};
+      uint64_t now = time_us_64();
+      telemetry_send(&telemetry, TELEMETRY_SCD41, 0, now, values, 3);
+#if OUTPUT_RAW
+      int32_t raw[3] = {scd41_co2, scd41_temperature_raw, scd41_humidity_raw};
+      telemetry_send(&telemetry, TELEMETRY_SCD41_RAW, 0, now, raw, 3);
+#endif
+#else
+      // scd41_co2に入った測定結果を表示. printfを使わず変換する
+      char buf[24];
+      unsigned n = numfmt_str(buf, sizeof(buf), "CO2: ");
+      n += numfmt_uint(buf + n, sizeof(buf) - n, scd41_co2, 0, ' ');
+      numfmt_str(buf + n, sizeof(buf) - n, "[ppm]");
+      puts(buf);
+#endif
     } else {
       // 測定失敗
+#if OUTPUT_TELEMETRY
+      send_event(TELEMETRY_EVENT_FAILED);
+#else
       printf("Measurement failed\n");
+#endif
       break;
     }
   }
   scd41_stop_periodic_measurement(true);  // センサーの継続測定を終了
+#if OUTPUT_TELEMETRY
+  send_event(TELEMETRY_EVENT_FINISHED);
+#else
   printf("Finished\n");
+#endif
 }
@@ -4,28 +4,24 @@
  * SPDX-License-Identifier: MIT
  */
 
+#define HAL_DRIVER INSTR_SCD41  // 計測(common/instr.h)でのドライバーの番号
 #include "scd41.h"
 
 #include <math.h>
 #include <string.h>
-#include "hardware/i2c.h"
 
 uint16_t scd41_co2 = 0;
 float scd41_temperature = 0.0f;
 float scd41_humidity = 0.0f;
+int32_t scd41_temperature_x100 = 0;
+uint32_t scd41_humidity_x100 = 0;
+uint16_t scd41_temperature_raw = 0;
+uint16_t scd41_humidity_raw = 0;
 
 // I2Cインスタンスとピンを初期化
 // すでに初期化している場合は不要
 void scd41_init_i2c() {
-  i2c_init(SCD41_I2C_INST, SCD41_I2C_BAUD);
-
-  gpio_init(SCD41_I2C_SDA_PIN);
-  gpio_pull_up(SCD41_I2C_SDA_PIN);
-  gpio_set_function(SCD41_I2C_SDA_PIN, GPIO_FUNC_I2C);
-
-  gpio_init(SCD41_I2C_SCL_PIN);
-  gpio_pull_up(SCD41_I2C_SCL_PIN);
-  gpio_set_function(SCD41_I2C_SCL_PIN, GPIO_FUNC_I2C);
+  hal_i2c_init_pins(SCD41_I2C_INST, SCD41_I2C_BAUD, SCD41_I2C_SDA_PIN, SCD41_I2C_SCL_PIN);
 }
 
 // I2Cでセンサーのレジスターのデータを連続して読み出す
@@ -38,9 +34,9 @@ void scd41_init_i2c() {
 // Returns: 成功でtrue, 失敗でfalse
 bool scd41_read_registers(uint16_t reg_addr, uint8_t* data, uint32_t length) {
   uint8_t addr_write_data[] = {reg_addr >> 8, reg_addr & 0xFF};
-  if (2 != i2c_write_timeout_us(SCD41_I2C_INST, SCD41_I2C_ADDRESS, addr_write_data, 2, true, 10000))
+  if (2 != hal_i2c_write_timeout_us(SCD41_I2C_INST, SCD41_I2C_ADDRESS, addr_write_data, 2, true, 10000))
     return false;
-  if (length != i2c_read_blocking(SCD41_I2C_INST, SCD41_I2C_ADDRESS, data, length, false))
+  if (length != hal_i2c_read_blocking(SCD41_I2C_INST, SCD41_I2C_ADDRESS, data, length, false))
     return false;
   return true;
 }
@@ -58,13 +54,13 @@ bool scd41_write_registers(uint16_t reg_addr, uint8_t* data, uint32_t length) {
   write_data[0] = reg_addr >> 8;
   write_data[1] = reg_addr & 0xFF;
   if (length == 0) {
-    if (2 != i2c_write_blocking(SCD41_I2C_INST, SCD41_I2C_ADDRESS, write_data, 2, false))
+    if (2 != hal_i2c_write_blocking(SCD41_I2C_INST, SCD41_I2C_ADDRESS, write_data, 2, false))
       return false;
   } else {
     memcpy(write_data + 2, data, length);
     *(write_data + 2 + length) = scd41_calculate_crc(data, length);
-    if (length + 3 != i2c_write_blocking(SCD41_I2C_INST, SCD41_I2C_ADDRESS,
-                                         write_data, length + 3, false))
+    if (length + 3 != hal_i2c_write_blocking(SCD41_I2C_INST, SCD41_I2C_ADDRESS,
+                                             write_data, length + 3, false))
       return false;
   }
   return true;
@@ -167,8 +163,13 @@ bool scd41_read_measurement(uint timeout) {
   }
 
   scd41_co2 = ((uint16_t)data[0]) << 8 | data[1];
-  scd41_temperature = -45 + 175 * ((((uint16_t)data[3]) << 8) + data[4]) / pow(2, 16);
-  scd41_humidity = 100 * ((((uint16_t)data[6]) << 8) + data[7]) / pow(2, 16);
+  scd41_temperature_raw = (((uint16_t)data[3]) << 8) + data[4];
+  scd41_humidity_raw = (((uint16_t)data[6]) << 8) + data[7];
+  scd41_temperature = -45 + 175 * scd41_temperature_raw / 65536.0f;
+  scd41_humidity = 100 * scd41_humidity_raw / 65536.0f;
+  scd41_temperature_x100 = scd41_convert_temperature_x100(scd41_temperature_raw);
+  scd41_humidity_x100 = scd41_convert_humidity_x100(scd41_humidity_raw);
+  return true;
 }
 
 // 測定値補正用の温度オフセット値を書き込む.
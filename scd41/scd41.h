@@ -7,7 +7,7 @@
 #ifndef SCD41_H
 #define SCD41_H
 
-#include "pico/stdlib.h"
+#include "hal.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,13 +21,28 @@ extern "C" {
 #define SCD41_I2C_SDA_PIN PICO_DEFAULT_I2C_SDA_PIN  // I2C SDAピン
 #define SCD41_I2C_SCL_PIN PICO_DEFAULT_I2C_SCL_PIN  // I2C SCLピン
 #define SCD41_I2C_ADDRESS 0x62                      // I2Cデバイスアドレス
-#define scd41_delay(x) sleep_ms(x)                  // xミリ秒待機
+#define scd41_delay(x) hal_sleep_ms(x)              // xミリ秒待機
 
 // -----------------
 
 extern uint16_t scd41_co2;
 extern float scd41_temperature;
 extern float scd41_humidity;
+extern int32_t scd41_temperature_x100;  // 測定温度[0.01℃]. 浮動小数を使わずに表示, 計算する場合に使用
+extern uint32_t scd41_humidity_x100;    // 測定湿度[0.01%]
+extern uint16_t scd41_temperature_raw;  // 読み出した温度の値(変換前). 記録してPC側で再計算する場合に使用
+extern uint16_t scd41_humidity_raw;     // 読み出した湿度の値(変換前)
+
+// 読み出した温度の値を温度[0.01℃]に変換する. T = -45 + 175 * raw / 2^16
+// PC側で記録した値を再計算する場合も同じ式を使うため, ヘッダーに置く
+static inline int32_t scd41_convert_temperature_x100(uint16_t raw) {
+  return -4500 + (int32_t)((17500 * (uint32_t)raw + 32768) >> 16);
+}
+
+// 読み出した湿度の値を湿度[0.01%]に変換する. RH = 100 * raw / 2^16
+static inline uint32_t scd41_convert_humidity_x100(uint16_t raw) {
+  return (10000 * (uint32_t)raw + 32768) >> 16;
+}
 
 void scd41_init_i2c();
 bool scd41_read_registers(uint16_t reg_addr, uint8_t* data, uint32_t length);
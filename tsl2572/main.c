@@ -6,23 +6,51 @@
 
 #include <stdio.h>
 
+#include "numfmt.h"
 #include "pico/stdlib.h"
+#include "telemetry.h"
 #include "tsl2572.h"
 
+// 1なら測定に使ったADCの値と測定条件をバイナリのレコード(common/telemetry.h)で送信する.
+// PC側はhost/sensor_replayでドライバーと同じ計算を行い, 照度を求める. 0なら照度をテキストで表示する
+#define OUTPUT_TELEMETRY 0
+
+#if OUTPUT_TELEMETRY
+static telemetry_t telemetry;
+#endif
+
 int main() {
   stdio_init_all();
   tsl2572_init_i2c();  // 通信に使うI2Cインスタンスとピンを初期化
+#if OUTPUT_TELEMETRY
+  telemetry_init(&telemetry, telemetry_usb_write, NULL);  // printfを通さずUSBシリアルへ送信する
+#else
   printf("-------------\n");
+#endif
 
   while (1) {
     // 測定を1回行い, 成功したらtsl2572_illuminance変数に明るさを入れる
     bool ret = tsl2572_single_auto_measure();
+#if OUTPUT_TELEMETRY
+    if (ret) {
+      int32_t values[4] = {tsl2572_adc_ch0, tsl2572_adc_ch1, (int32_t)tsl2572_integ_cycles, (int32_t)tsl2572_again};
+      telemetry_send(&telemetry, TELEMETRY_TSL2572_RAW, 0, time_us_64(), values, 4);
+    } else {
+      int32_t values[2] = {TELEMETRY_EVENT_NOT_FOUND, TELEMETRY_TSL2572_RAW};
+      telemetry_send(&telemetry, TELEMETRY_EVENT, 0, time_us_64(), values, 2);
+    }
+#else
     if (ret) {
-      // 測定成功
-      printf("%.1f[lux]\n", tsl2572_illuminance);  // 明るさを表示
+      // 測定成功. 明るさを0.1[lux]単位の整数に丸めて, printfを使わずに表示
+      float lux_x10 = tsl2572_illuminance * 10;
+      char buf[24];
+      unsigned n = numfmt_fixed(buf, sizeof(buf), (int32_t)(lux_x10 + (lux_x10 < 0 ? -0.5f : 0.5f)), 1, 1, 0, ' ');
+      numfmt_str(buf + n, sizeof(buf) - n, "[lux]");
+      puts(buf);
     } else {
       printf("TSL2572 not found\n");  // 測定失敗
     }
+#endif
     sleep_ms(3000);
   }
 }
@@ -4,9 +4,9 @@
  * SPDX-License-Identifier: MIT
  */
 
+#define HAL_DRIVER INSTR_TSL2572  // 計測(common/instr.h)でのドライバーの番号
 #include "tsl2572.h"
 
-#include "hardware/i2c.h"
 
 uint16_t tsl2572_adc_ch0 = 0;
 uint16_t tsl2572_adc_ch1 = 0;
@@ -17,15 +17,7 @@ float tsl2572_illuminance = 0;
 // I2Cインスタンスとピンを初期化
 // すでに初期化している場合は不要
 void tsl2572_init_i2c() {
-  i2c_init(TSL2572_I2C_INST, TSL2572_I2C_BAUD);
-
-  gpio_init(TSL2572_I2C_SDA_PIN);
-  gpio_pull_up(TSL2572_I2C_SDA_PIN);
-  gpio_set_function(TSL2572_I2C_SDA_PIN, GPIO_FUNC_I2C);
-
-  gpio_init(TSL2572_I2C_SCL_PIN);
-  gpio_pull_up(TSL2572_I2C_SCL_PIN);
-  gpio_set_function(TSL2572_I2C_SCL_PIN, GPIO_FUNC_I2C);
+  hal_i2c_init_pins(TSL2572_I2C_INST, TSL2572_I2C_BAUD, TSL2572_I2C_SDA_PIN, TSL2572_I2C_SCL_PIN);
 }
 
 // I2Cでセンサーのレジスターのデータを連続して読み出す
@@ -38,9 +30,9 @@ void tsl2572_init_i2c() {
 // Returns: 成功でtrue, 失敗でfalse
 bool tsl2572_read_registers(uint8_t reg_addr, uint8_t* data, uint32_t length) {
   uint8_t addr_write_data = reg_addr | 0xA0;
-  if (1 != i2c_write_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, &addr_write_data, 1, true))
+  if (1 != hal_i2c_write_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, &addr_write_data, 1, true))
     return false;
-  if (length != i2c_read_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, data, length, false))
+  if (length != hal_i2c_read_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, data, length, false))
     return false;
   return true;
 }
@@ -66,7 +58,7 @@ uint8_t tsl2572_read_register(uint8_t reg_addr) {
 // Returns: 成功でtrue, 失敗でfalse
 bool tsl2572_write_register(uint8_t reg_addr, uint8_t data) {
   uint8_t buf[] = {reg_addr | 0xA0, data};
-  if (sizeof(buf) != i2c_write_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, buf, sizeof(buf), false))
+  if (sizeof(buf) != hal_i2c_write_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, buf, sizeof(buf), false))
     return false;
   return true;
 }
@@ -147,32 +139,79 @@ void tsl2572_read_adc() {
   tsl2572_adc_ch1 = (data[3] << 8) | data[2];
 }
 
+// integ_cycles, againの設定で測定を開始し, すぐに処理を返す. 完了はtsl2572_als_integration_doneで確認する.
+//
+// Returns: 測定完了までの時間[us]の目安. integ_cycles x 2.73ms
+uint32_t tsl2572_start_als_integration() {
+  tsl2572_write_enable(true, false, false);  // 一度測定を停止
+  tsl2572_write_atime(tsl2572_integ_cycles);
+  tsl2572_write_again(tsl2572_again);
+  tsl2572_write_enable(true, true, false);  // 測定開始
+  return tsl2572_integ_cycles * 2730;
+}
+
+// 測定が完了していれば測定を停止し, adc_ch0, adc_ch1にADCレジスターの値を入れる. 待機はしない.
+//
+// Returns: 測定完了でtrue, 測定中ならfalse
+bool tsl2572_als_integration_done() {
+  if (tsl2572_read_status() != 0x11) return false;
+  tsl2572_write_enable(false, false, false);  // 測定を停止
+  tsl2572_read_adc();
+  return true;
+}
+
 // integ_cycles, againの設定で1回測定を行い, adc_ch0, adc_ch1にADCレジスターの値を入れる.
 void tsl2572_single_als_integration() {
+  tsl2572_start_als_integration();
+  while (!tsl2572_als_integration_done()) tsl2572_delay(10);
+}
+
+// integ_cycles, againの設定で測定を繰り返し, CH0の値がlow未満かhighを超える測定がpersistence回続いたら
+// INTピンをLowにする. センサーが照度の変化を監視するので, その間Pico側は測定せずに待機できる.
+// INTピンはtsl2572_clear_interruptまでLowのまま. 終了はtsl2572_stop_als_monitorで行う.
+//
+// Args:
+//   low, high: CH0の値のしきい値
+//   persistence: 割り込みまでに続けてしきい値を超える測定の回数. 0-3は0,1,2,3回, 4以上は(persistence - 3) x 5回
+void tsl2572_start_als_monitor(uint16_t low, uint16_t high, uint8_t persistence) {
   tsl2572_write_enable(true, false, false);  // 一度測定を停止
   tsl2572_write_atime(tsl2572_integ_cycles);
   tsl2572_write_again(tsl2572_again);
-  tsl2572_write_enable(true, true, false);  // 測定開始
+  uint8_t data[] = {0x04 | 0xA0, low & 0xFF, low >> 8, high & 0xFF, high >> 8};  // AILTL-AIHTHへ連続して書き込む
+  hal_i2c_write_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, data, sizeof(data), false);
+  tsl2572_write_register(0x0C, persistence & 0xF);
+  tsl2572_clear_interrupt();
+  tsl2572_write_register(0x0, 0x13);  // PON, AEN, AIEN. 測定と割り込みを開始
+}
 
-  while (1) {
-    uint8_t status = tsl2572_read_status();
-    if (status == 0x11) {
-      tsl2572_write_enable(false, false, false);  // 測定を停止
-      break;
-    } else {
-      tsl2572_delay(10);
-    }
-  }
+// tsl2572_start_als_monitorの監視を停止し, しきい値を初期値に戻す. tsl2572_start_als_integrationの前に呼ぶ
+void tsl2572_stop_als_monitor() {
+  tsl2572_write_enable(true, false, false);
+  uint8_t data[] = {0x04 | 0xA0, 0, 0, 0, 0};
+  hal_i2c_write_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, data, sizeof(data), false);
+  tsl2572_write_register(0x0C, 0);
+  tsl2572_clear_interrupt();
+}
 
-  tsl2572_read_adc();
+// 割り込みを解除し, INTピンをHighに戻す
+void tsl2572_clear_interrupt() {
+  uint8_t cmd = 0xE6;  // Special function: ALS interrupt clear
+  hal_i2c_write_blocking(TSL2572_I2C_INST, TSL2572_I2C_ADDRESS, &cmd, 1, false);
 }
 
-// adc_ch0, adc_ch1, integ_cycles, againから照度(明るさ)を計算し, illuminanceに入れる.
-void tsl2572_calculate_lux() {
-  float t = tsl2572_integ_cycles * 2.73;
+// ADCレジスターの値と測定条件から照度(明るさ)[lux]を計算する. レジスターの読み書きは行わない.
+//
+// Args:
+//   ch0, ch1: ADCレジスターの値
+//   integ_cycles: 測定時のinteg_cycles
+//   again: 測定時のagain
+//
+// Returns: 照度[lux]. againが範囲外なら0
+float tsl2572_lux(uint16_t ch0, uint16_t ch1, uint integ_cycles, uint again) {
+  float t = integ_cycles * 2.73;
   float g;
 
-  switch (tsl2572_again) {
+  switch (again) {
     case TSL2572_AGAIN_016:
       g = 0.16;
       break;
@@ -189,33 +228,26 @@ void tsl2572_calculate_lux() {
       g = 120.0f;
       break;
     default:
-      return;
+      return 0;
   }
 
   float cpl = t * g / 60;
-  float lux1 = (tsl2572_adc_ch0 - 1.87 * tsl2572_adc_ch1) / cpl;
-  float lux2 = (0.63 * tsl2572_adc_ch0 - tsl2572_adc_ch1) / cpl;
-  if (lux1 > lux2)
-    tsl2572_illuminance = lux1;
-  else
-    tsl2572_illuminance = lux2;
+  float lux1 = (ch0 - 1.87 * ch1) / cpl;
+  float lux2 = (0.63 * ch0 - ch1) / cpl;
+  return lux1 > lux2 ? lux1 : lux2;
 }
 
-// 条件を自動で調整しながら1回測定を行い, luxに結果を入れる
-//
-// Returns:
-//   bool: 成功でTrue, IDチェック失敗でFalse
-bool tsl2572_single_auto_measure() {
-  if (!tsl2572_check_id()) return false;
+// adc_ch0, adc_ch1, integ_cycles, againから照度(明るさ)を計算し, illuminanceに入れる.
+void tsl2572_calculate_lux() {
+  if (tsl2572_again > TSL2572_AGAIN_120) return;
+  tsl2572_illuminance = tsl2572_lux(tsl2572_adc_ch0, tsl2572_adc_ch1, tsl2572_integ_cycles, tsl2572_again);
+}
 
-  // 1度短い時間で測定する
-  tsl2572_integ_cycles = 4;
-  tsl2572_again = TSL2572_AGAIN_1;
-  tsl2572_single_als_integration();
+// 短い時間(integ_cycles=4, again=1倍)で測定したadc_ch0, adc_ch1から, 本番の測定のinteg_cyclesとagainを決める
+void tsl2572_select_range() {
   uint16_t adc_max = MAX(tsl2572_adc_ch0, tsl2572_adc_ch1);
   float margin = 0.8;  // 判定マージン用倍率. ADCレジスターの上限 x margin以上に達したら条件を変える.
 
-  // 1度目の結果をもとにinteg_cyclesとagainを決める
   if (adc_max < 8.53 * margin) {
     tsl2572_integ_cycles = 256;
     tsl2572_again = TSL2572_AGAIN_120;
@@ -232,8 +264,23 @@ bool tsl2572_single_auto_measure() {
     tsl2572_integ_cycles = 64;
     tsl2572_again = TSL2572_AGAIN_016;
   }
+}
+
+// 条件を自動で調整しながら1回測定を行い, luxに結果を入れる
+//
+// Returns:
+//   bool: 成功でTrue, IDチェック失敗でFalse
+bool tsl2572_single_auto_measure() {
+  if (!tsl2572_check_id()) return false;
+
+  // 1度短い時間で測定する
+  tsl2572_integ_cycles = 4;
+  tsl2572_again = TSL2572_AGAIN_1;
+  tsl2572_single_als_integration();
+  tsl2572_select_range();
 
   // 本番の測定
   tsl2572_single_als_integration();
   tsl2572_calculate_lux();
+  return true;
 }
\ No newline at end of file
@@ -7,7 +7,11 @@
 #ifndef TSL2572_H
 #define TSL2572_H
 
-#include "pico/stdlib.h"
+#include "hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // -----------------
 // Configurations
@@ -17,7 +21,7 @@
 #define TSL2572_I2C_SDA_PIN PICO_DEFAULT_I2C_SDA_PIN  // I2C SDAピン
 #define TSL2572_I2C_SCL_PIN PICO_DEFAULT_I2C_SCL_PIN  // I2C SCLピン
 #define TSL2572_I2C_ADDRESS 0x39                      // I2Cデバイスアドレス
-#define tsl2572_delay(x) sleep_ms(x)                  // xミリ秒待機
+#define tsl2572_delay(x) hal_sleep_ms(x)              // xミリ秒待機
 
 // -----------------
 
@@ -30,6 +34,8 @@
 
 extern uint tsl2572_again;         // 測定の倍率(ゲイン). AGAIN_xで指定
 extern uint tsl2572_integ_cycles;  // 測定の時間を決めるサイクル数. 1-256の整数.
+extern uint16_t tsl2572_adc_ch0;   // ADCレジスターCH0の値
+extern uint16_t tsl2572_adc_ch1;   // ADCレジスターCH1の値
 extern float tsl2572_illuminance;   // 測定した照度(明るさ)の値[lux]
 
 void tsl2572_init_i2c();
@@ -42,8 +48,19 @@ void tsl2572_write_atime(uint integ_cycles);
 void tsl2572_write_again(uint again);
 uint8_t tsl2572_read_status();
 void tsl2572_read_adc();
+uint32_t tsl2572_start_als_integration();
+bool tsl2572_als_integration_done();
 void tsl2572_single_als_integration();
+void tsl2572_start_als_monitor(uint16_t low, uint16_t high, uint8_t persistence);
+void tsl2572_stop_als_monitor();
+void tsl2572_clear_interrupt();
+float tsl2572_lux(uint16_t ch0, uint16_t ch1, uint integ_cycles, uint again);
 void tsl2572_calculate_lux();
+void tsl2572_select_range();
 bool tsl2572_single_auto_measure();
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
\ No newline at end of file